@@ -171,6 +171,14 @@
 #define RIPPLE_ENABLE_TICKETS 0
 #endif
 
+/** Config: RIPPLE_TRACING
+    Compiles in the timing spans around transaction processing and
+    ledger close. They record nothing unless [tracing] is configured.
+*/
+#ifndef RIPPLE_TRACING
+#define RIPPLE_TRACING 1
+#endif
+
 // Uses OpenSSL instead of alternatives
 #ifndef RIPPLE_USE_OPENSSL
 #define RIPPLE_USE_OPENSSL 1
@@ -39,7 +39,7 @@ namespace insight {
     using the interface.
 
     @see Counter, Event, Gauge, Hook, Meter
-    @see NullCollector, StatsDCollector
+    @see NullCollector, PrometheusCollector, StatsDCollector
 */
 class Collector
 {
@@ -31,4 +31,7 @@
 #include <beast/insight/impl/Hook.cpp>
 #include <beast/insight/impl/Metric.cpp>
 #include <beast/insight/impl/NullCollector.cpp>
+#include <beast/insight/impl/PrometheusCollector.cpp>
 #include <beast/insight/impl/StatsDCollector.cpp>
+
+#include <beast/insight/tests/PrometheusCollector.test.cpp>
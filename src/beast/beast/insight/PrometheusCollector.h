@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of Beast: https://github.com/vinniefalco/Beast
+    Copyright 2013, Vinnie Falco <vinnie.falco@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef BEAST_INSIGHT_PROMETHEUSCOLLECTOR_H_INCLUDED
+#define BEAST_INSIGHT_PROMETHEUSCOLLECTOR_H_INCLUDED
+
+#include <beast/insight/Collector.h>
+
+namespace beast {
+namespace insight {
+
+/** A Collector that keeps metrics in memory until they are scraped.
+
+    Nothing is sent anywhere. Instead the owner calls render when a
+    scraper asks for the metrics, which runs every hook and then writes
+    each metric out in the Prometheus text exposition format:
+        https://prometheus.io/docs/instrumenting/exposition_formats/
+
+    Counters and meters become counters, gauges become gauges, and
+    events become histograms of the reported values. Metric names are
+    the prefix and name joined with underscores, with every character
+    Prometheus does not allow replaced by an underscore. Metrics that
+    end up with the same name are added together.
+*/
+class PrometheusCollector : public Collector
+{
+public:
+    /** Create a Prometheus collector.
+        @param prefix A string pre-pended before each metric name.
+    */
+    static
+    std::shared_ptr <PrometheusCollector>
+    New (std::string const& prefix);
+
+    /** Run the hooks and return every metric in the text format. */
+    virtual std::string render () = 0;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,585 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of Beast: https://github.com/vinniefalco/Beast
+    Copyright 2013, Vinnie Falco <vinnie.falco@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#include <beast/insight/HookImpl.h>
+#include <beast/insight/CounterImpl.h>
+#include <beast/insight/EventImpl.h>
+#include <beast/insight/GaugeImpl.h>
+#include <beast/insight/MeterImpl.h>
+#include <beast/insight/PrometheusCollector.h>
+#include <beast/intrusive/List.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace beast {
+namespace insight {
+
+namespace detail {
+
+class PrometheusCollectorImp;
+
+//------------------------------------------------------------------------------
+
+// The samples of one scrape, grouped into metric families by name
+class PrometheusFamilies
+{
+public:
+    void add (std::string const& family, char const* type,
+        std::string const& sample, double value)
+    {
+        auto& f = families_[family];
+        if (f.type == nullptr)
+            f.type = type;
+
+        for (auto& s : f.samples)
+        {
+            if (s.first == sample)
+            {
+                s.second += value;
+                return;
+            }
+        }
+        f.samples.emplace_back (sample, value);
+    }
+
+    std::string str () const
+    {
+        std::ostringstream ss;
+        ss.precision (std::numeric_limits <double>::digits10 + 2);
+        for (auto const& f : families_)
+        {
+            ss << "# TYPE " << f.first << " " << f.second.type << "\n";
+            for (auto const& s : f.second.samples)
+                ss << s.first << " " << s.second << "\n";
+        }
+        return ss.str ();
+    }
+
+private:
+    struct Family
+    {
+        char const* type = nullptr;
+        std::vector <std::pair <std::string, double>> samples;
+    };
+
+    std::map <std::string, Family> families_;
+};
+
+//------------------------------------------------------------------------------
+
+// A count spread over several cache lines, so that threads adding to
+// the same metric do not keep taking the line away from each other.
+// Each thread always uses the same cell; reads add up all of them.
+class StripedCount
+{
+public:
+    using value_type = std::int64_t;
+
+    void add (value_type amount)
+    {
+        cells_[cell ()].value.fetch_add (amount, std::memory_order_relaxed);
+    }
+
+    value_type load () const
+    {
+        value_type total = 0;
+        for (auto const& c : cells_)
+            total += c.value.load (std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    static std::size_t const cellCount = 16;
+
+    struct Cell
+    {
+        std::atomic <value_type> value {0};
+        char pad [64 - sizeof (std::atomic <value_type>)];
+    };
+
+    static std::size_t cell ()
+    {
+        static std::atomic <std::size_t> next (0);
+        static thread_local std::size_t const index = next++ % cellCount;
+        return index;
+    }
+
+    std::array <Cell, cellCount> cells_;
+};
+
+//------------------------------------------------------------------------------
+
+class PrometheusMetricBase : public List <PrometheusMetricBase>::Node
+{
+public:
+    virtual void write (PrometheusFamilies& families) const = 0;
+};
+
+//------------------------------------------------------------------------------
+
+class PrometheusHookImpl
+    : public HookImpl
+{
+public:
+    PrometheusHookImpl (HandlerType const& handler,
+        std::shared_ptr <PrometheusCollectorImp> const& impl);
+
+    ~PrometheusHookImpl ();
+
+    void do_process ();
+
+private:
+    PrometheusHookImpl& operator= (PrometheusHookImpl const&);
+
+    std::shared_ptr <PrometheusCollectorImp> m_impl;
+    HandlerType m_handler;
+};
+
+//------------------------------------------------------------------------------
+
+class PrometheusCounterImpl
+    : public CounterImpl
+    , public PrometheusMetricBase
+{
+public:
+    PrometheusCounterImpl (std::string const& name,
+        std::shared_ptr <PrometheusCollectorImp> const& impl);
+
+    ~PrometheusCounterImpl ();
+
+    void increment (CounterImpl::value_type amount) override;
+
+    void write (PrometheusFamilies& families) const override;
+
+private:
+    PrometheusCounterImpl& operator= (PrometheusCounterImpl const&);
+
+    std::shared_ptr <PrometheusCollectorImp> m_impl;
+    std::string m_name;
+    StripedCount m_value;
+};
+
+//------------------------------------------------------------------------------
+
+class PrometheusEventImpl
+    : public EventImpl
+    , public PrometheusMetricBase
+{
+public:
+    PrometheusEventImpl (std::string const& name,
+        std::shared_ptr <PrometheusCollectorImp> const& impl);
+
+    ~PrometheusEventImpl ();
+
+    void notify (EventImpl::value_type const& value) override;
+
+    void write (PrometheusFamilies& families) const override;
+
+private:
+    PrometheusEventImpl& operator= (PrometheusEventImpl const&);
+
+    // Upper bounds of the buckets, in the units of the event
+    static std::array <EventImpl::value_type::rep, 15> const bounds;
+
+    std::shared_ptr <PrometheusCollectorImp> m_impl;
+    std::string m_name;
+    // One more than the bounds, for values above the last one
+    std::array <std::atomic <std::uint64_t>, 16> m_counts;
+    std::atomic <EventImpl::value_type::rep> m_sum;
+};
+
+//------------------------------------------------------------------------------
+
+class PrometheusGaugeImpl
+    : public GaugeImpl
+    , public PrometheusMetricBase
+{
+public:
+    PrometheusGaugeImpl (std::string const& name,
+        std::shared_ptr <PrometheusCollectorImp> const& impl);
+
+    ~PrometheusGaugeImpl ();
+
+    void set (GaugeImpl::value_type value) override;
+    void increment (GaugeImpl::difference_type amount) override;
+
+    void write (PrometheusFamilies& families) const override;
+
+private:
+    PrometheusGaugeImpl& operator= (PrometheusGaugeImpl const&);
+
+    std::shared_ptr <PrometheusCollectorImp> m_impl;
+    std::string m_name;
+    std::atomic <GaugeImpl::value_type> m_value;
+};
+
+//------------------------------------------------------------------------------
+
+class PrometheusMeterImpl
+    : public MeterImpl
+    , public PrometheusMetricBase
+{
+public:
+    PrometheusMeterImpl (std::string const& name,
+        std::shared_ptr <PrometheusCollectorImp> const& impl);
+
+    ~PrometheusMeterImpl ();
+
+    void increment (MeterImpl::value_type amount) override;
+
+    void write (PrometheusFamilies& families) const override;
+
+private:
+    PrometheusMeterImpl& operator= (PrometheusMeterImpl const&);
+
+    std::shared_ptr <PrometheusCollectorImp> m_impl;
+    std::string m_name;
+    StripedCount m_value;
+};
+
+//------------------------------------------------------------------------------
+
+class PrometheusCollectorImp
+    : public PrometheusCollector
+    , public std::enable_shared_from_this <PrometheusCollectorImp>
+{
+private:
+    std::string m_prefix;
+    std::recursive_mutex metricsLock_;
+    List <PrometheusMetricBase> metrics_;
+    std::vector <PrometheusHookImpl*> hooks_;
+    bool processing_ = false;
+
+public:
+    explicit PrometheusCollectorImp (std::string const& prefix)
+        : m_prefix (prefix)
+    {
+    }
+
+    Hook make_hook (HookImpl::HandlerType const& handler) override
+    {
+        return Hook (std::make_shared <detail::PrometheusHookImpl> (
+            handler, shared_from_this ()));
+    }
+
+    Counter make_counter (std::string const& name) override
+    {
+        return Counter (std::make_shared <detail::PrometheusCounterImpl> (
+            name, shared_from_this ()));
+    }
+
+    Event make_event (std::string const& name) override
+    {
+        return Event (std::make_shared <detail::PrometheusEventImpl> (
+            name, shared_from_this ()));
+    }
+
+    Gauge make_gauge (std::string const& name) override
+    {
+        return Gauge (std::make_shared <detail::PrometheusGaugeImpl> (
+            name, shared_from_this ()));
+    }
+
+    Meter make_meter (std::string const& name) override
+    {
+        return Meter (std::make_shared <detail::PrometheusMeterImpl> (
+            name, shared_from_this ()));
+    }
+
+    //--------------------------------------------------------------------------
+
+    void add (PrometheusMetricBase& metric)
+    {
+        std::lock_guard<std::recursive_mutex> _(metricsLock_);
+        metrics_.push_back (metric);
+    }
+
+    void remove (PrometheusMetricBase& metric)
+    {
+        std::lock_guard<std::recursive_mutex> _(metricsLock_);
+        metrics_.erase (metrics_.iterator_to (metric));
+    }
+
+    void add (PrometheusHookImpl& hook)
+    {
+        std::lock_guard<std::recursive_mutex> _(metricsLock_);
+        hooks_.push_back (&hook);
+    }
+
+    void remove (PrometheusHookImpl& hook)
+    {
+        std::lock_guard<std::recursive_mutex> _(metricsLock_);
+        auto const iter = std::find (hooks_.begin (), hooks_.end (), &hook);
+        if (processing_)
+            *iter = nullptr;  // render is walking the hooks
+        else
+            hooks_.erase (iter);
+    }
+
+    // Returns the exported name for a counter, which ends in _total
+    std::string counter_name (std::string const& name) const
+    {
+        std::string const suffix ("_total");
+        auto result = metric_name (name);
+        if (result.size () < suffix.size () || result.compare (
+                result.size () - suffix.size (), suffix.size (), suffix) != 0)
+            result += suffix;
+        return result;
+    }
+
+    // Returns the exported name for a metric
+    std::string metric_name (std::string const& name) const
+    {
+        std::string result (m_prefix.empty () ?
+            name : m_prefix + "_" + name);
+
+        for (auto& c : result)
+        {
+            if (! ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9') || c == '_' || c == ':'))
+                c = '_';
+        }
+
+        if (result.empty () || (result[0] >= '0' && result[0] <= '9'))
+            result.insert (result.begin (), '_');
+
+        return result;
+    }
+
+    //--------------------------------------------------------------------------
+
+    std::string render () override
+    {
+        std::lock_guard<std::recursive_mutex> _(metricsLock_);
+
+        // Hooks run first, and may create or destroy metrics and hooks.
+        // Hooks they create wait for the next scrape.
+        processing_ = true;
+        auto const count = hooks_.size ();
+        for (std::size_t i = 0; i < count; ++i)
+            if (hooks_[i] != nullptr)
+                hooks_[i]->do_process ();
+        processing_ = false;
+        hooks_.erase (std::remove (hooks_.begin (), hooks_.end (), nullptr),
+            hooks_.end ());
+
+        PrometheusFamilies families;
+        for (auto const& m : metrics_)
+            m.write (families);
+        return families.str ();
+    }
+};
+
+//------------------------------------------------------------------------------
+
+PrometheusHookImpl::PrometheusHookImpl (HandlerType const& handler,
+    std::shared_ptr <PrometheusCollectorImp> const& impl)
+    : m_impl (impl)
+    , m_handler (handler)
+{
+    m_impl->add (*this);
+}
+
+PrometheusHookImpl::~PrometheusHookImpl ()
+{
+    m_impl->remove (*this);
+}
+
+void PrometheusHookImpl::do_process ()
+{
+    m_handler ();
+}
+
+//------------------------------------------------------------------------------
+
+PrometheusCounterImpl::PrometheusCounterImpl (std::string const& name,
+    std::shared_ptr <PrometheusCollectorImp> const& impl)
+    : m_impl (impl)
+    , m_name (impl->counter_name (name))
+{
+    m_impl->add (*this);
+}
+
+PrometheusCounterImpl::~PrometheusCounterImpl ()
+{
+    m_impl->remove (*this);
+}
+
+void PrometheusCounterImpl::increment (CounterImpl::value_type amount)
+{
+    m_value.add (amount);
+}
+
+void PrometheusCounterImpl::write (PrometheusFamilies& families) const
+{
+    families.add (m_name, "counter", m_name,
+        static_cast <double> (m_value.load ()));
+}
+
+//------------------------------------------------------------------------------
+
+std::array <EventImpl::value_type::rep, 15> const
+PrometheusEventImpl::bounds = {{
+    1, 2, 5, 10, 20, 50, 100, 200, 500,
+    1000, 2000, 5000, 10000, 30000, 60000 }};
+
+PrometheusEventImpl::PrometheusEventImpl (std::string const& name,
+    std::shared_ptr <PrometheusCollectorImp> const& impl)
+    : m_impl (impl)
+    , m_name (impl->metric_name (name))
+    , m_sum (0)
+{
+    for (auto& count : m_counts)
+        count.store (0);
+    m_impl->add (*this);
+}
+
+PrometheusEventImpl::~PrometheusEventImpl ()
+{
+    m_impl->remove (*this);
+}
+
+void PrometheusEventImpl::notify (EventImpl::value_type const& value)
+{
+    auto const bucket = std::lower_bound (
+        bounds.begin (), bounds.end (), value.count ()) - bounds.begin ();
+    m_counts[bucket].fetch_add (1, std::memory_order_relaxed);
+    m_sum.fetch_add (value.count (), std::memory_order_relaxed);
+}
+
+void PrometheusEventImpl::write (PrometheusFamilies& families) const
+{
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < m_counts.size (); ++i)
+    {
+        total += m_counts[i].load (std::memory_order_relaxed);
+        std::string const le = (i < bounds.size ()) ?
+            std::to_string (bounds[i]) : "+Inf";
+        families.add (m_name, "histogram",
+            m_name + "_bucket{le=\"" + le + "\"}",
+                static_cast <double> (total));
+    }
+    families.add (m_name, "histogram", m_name + "_sum",
+        static_cast <double> (m_sum.load (std::memory_order_relaxed)));
+    families.add (m_name, "histogram", m_name + "_count",
+        static_cast <double> (total));
+}
+
+//------------------------------------------------------------------------------
+
+PrometheusGaugeImpl::PrometheusGaugeImpl (std::string const& name,
+    std::shared_ptr <PrometheusCollectorImp> const& impl)
+    : m_impl (impl)
+    , m_name (impl->metric_name (name))
+    , m_value (0)
+{
+    m_impl->add (*this);
+}
+
+PrometheusGaugeImpl::~PrometheusGaugeImpl ()
+{
+    m_impl->remove (*this);
+}
+
+void PrometheusGaugeImpl::set (GaugeImpl::value_type value)
+{
+    m_value.store (value, std::memory_order_relaxed);
+}
+
+void PrometheusGaugeImpl::increment (GaugeImpl::difference_type amount)
+{
+    GaugeImpl::value_type value (m_value.load (std::memory_order_relaxed));
+    GaugeImpl::value_type next;
+
+    do
+    {
+        next = value;
+
+        if (amount > 0)
+        {
+            GaugeImpl::value_type const d (
+                static_cast <GaugeImpl::value_type> (amount));
+            next +=
+                (d >= std::numeric_limits <GaugeImpl::value_type>::max() - value)
+                ? std::numeric_limits <GaugeImpl::value_type>::max() - value
+                : d;
+        }
+        else if (amount < 0)
+        {
+            GaugeImpl::value_type const d (
+                static_cast <GaugeImpl::value_type> (-amount));
+            next = (d >= value) ? 0 : value - d;
+        }
+    }
+    while (! m_value.compare_exchange_weak (value, next,
+        std::memory_order_relaxed));
+}
+
+void PrometheusGaugeImpl::write (PrometheusFamilies& families) const
+{
+    families.add (m_name, "gauge", m_name,
+        static_cast <double> (m_value.load (std::memory_order_relaxed)));
+}
+
+//------------------------------------------------------------------------------
+
+PrometheusMeterImpl::PrometheusMeterImpl (std::string const& name,
+    std::shared_ptr <PrometheusCollectorImp> const& impl)
+    : m_impl (impl)
+    , m_name (impl->counter_name (name))
+{
+    m_impl->add (*this);
+}
+
+PrometheusMeterImpl::~PrometheusMeterImpl ()
+{
+    m_impl->remove (*this);
+}
+
+void PrometheusMeterImpl::increment (MeterImpl::value_type amount)
+{
+    m_value.add (static_cast <StripedCount::value_type> (amount));
+}
+
+void PrometheusMeterImpl::write (PrometheusFamilies& families) const
+{
+    families.add (m_name, "counter", m_name,
+        static_cast <double> (m_value.load ()));
+}
+
+}
+
+//------------------------------------------------------------------------------
+
+std::shared_ptr <PrometheusCollector> PrometheusCollector::New (
+    std::string const& prefix)
+{
+    return std::make_shared <detail::PrometheusCollectorImp> (prefix);
+}
+
+}
+}
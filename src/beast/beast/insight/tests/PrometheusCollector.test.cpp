@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of Beast: https://github.com/vinniefalco/Beast
+    Copyright 2013, Vinnie Falco <vinnie.falco@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#if BEAST_INCLUDE_BEASTCONFIG
+#include <BeastConfig.h>
+#endif
+
+#include <beast/insight/PrometheusCollector.h>
+#include <beast/unit_test/suite.h>
+#include <thread>
+#include <vector>
+
+namespace beast {
+namespace insight {
+
+class PrometheusCollector_test : public unit_test::suite
+{
+public:
+    // Returns `true` if the text has this exact line
+    static bool hasLine (std::string const& text, std::string const& line)
+    {
+        return ("\n" + text).find ("\n" + line + "\n") != std::string::npos;
+    }
+
+    void testNames ()
+    {
+        testcase ("names");
+
+        auto const c = PrometheusCollector::New ("node");
+        auto const g1 = c->make_gauge ("jobq", "job_count");
+        auto const g2 = c->make_gauge ("cache-TreeNode.size");
+        g1.set (1);
+        g2.set (2);
+        auto const text = c->render ();
+        expect (hasLine (text, "# TYPE node_jobq_job_count gauge"), text);
+        expect (hasLine (text, "node_jobq_job_count 1"), text);
+        expect (hasLine (text, "node_cache_TreeNode_size 2"), text);
+
+        auto const bare = PrometheusCollector::New ("");
+        auto const g3 = bare->make_gauge ("9lives");
+        expect (hasLine (bare->render (), "_9lives 0"));
+    }
+
+    void testCounters ()
+    {
+        testcase ("counters");
+
+        auto const c = PrometheusCollector::New ("node");
+        auto const counter = c->make_counter ("rpc", "requests");
+        auto const meter = c->make_meter ("warnings");
+
+        std::vector <std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back ([&]
+            {
+                for (int i = 0; i < 1000; ++i)
+                {
+                    ++counter;
+                    meter += 2;
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join ();
+
+        auto const text = c->render ();
+        expect (hasLine (text, "# TYPE node_rpc_requests_total counter"),
+            text);
+        expect (hasLine (text, "node_rpc_requests_total 4000"), text);
+        expect (hasLine (text, "# TYPE node_warnings_total counter"), text);
+        expect (hasLine (text, "node_warnings_total 8000"), text);
+
+        auto const named = c->make_counter ("bytes_total");
+        expect (hasLine (c->render (), "node_bytes_total 0"));
+    }
+
+    void testGauges ()
+    {
+        testcase ("gauges");
+
+        auto const c = PrometheusCollector::New ("node");
+        auto gauge = c->make_gauge ("peers");
+        gauge = 5;
+        gauge -= 10;
+        expect (hasLine (c->render (), "node_peers 0"));
+        gauge += 3;
+        expect (hasLine (c->render (), "node_peers 3"));
+    }
+
+    void testEvents ()
+    {
+        testcase ("events");
+
+        using namespace std::chrono;
+        auto const c = PrometheusCollector::New ("node");
+        auto const event = c->make_event ("rpc", "time");
+        event.notify (milliseconds (0));
+        event.notify (milliseconds (3));
+        event.notify (milliseconds (700));
+        event.notify (seconds (100));
+
+        auto const text = c->render ();
+        expect (hasLine (text, "# TYPE node_rpc_time histogram"), text);
+        expect (hasLine (text, "node_rpc_time_bucket{le=\"1\"} 1"), text);
+        expect (hasLine (text, "node_rpc_time_bucket{le=\"2\"} 1"), text);
+        expect (hasLine (text, "node_rpc_time_bucket{le=\"5\"} 2"), text);
+        expect (hasLine (text, "node_rpc_time_bucket{le=\"1000\"} 3"), text);
+        expect (hasLine (text, "node_rpc_time_bucket{le=\"60000\"} 3"), text);
+        expect (hasLine (text, "node_rpc_time_bucket{le=\"+Inf\"} 4"), text);
+        expect (hasLine (text, "node_rpc_time_sum 100703"), text);
+        expect (hasLine (text, "node_rpc_time_count 4"), text);
+    }
+
+    void testHooks ()
+    {
+        testcase ("hooks");
+
+        auto const c = PrometheusCollector::New ("node");
+        Gauge gauge = c->make_gauge ("polled");
+        Gauge late;
+        int calls = 0;
+        auto const hook = c->make_hook ([&]
+        {
+            gauge = ++calls;
+            if (calls == 2)
+                late = c->make_gauge ("late");
+        });
+
+        expect (hasLine (c->render (), "node_polled 1"));
+        auto const text = c->render ();
+        expect (hasLine (text, "node_polled 2"), text);
+        expect (hasLine (text, "node_late 0"), text);
+    }
+
+    void testHookChanges ()
+    {
+        testcase ("hooks changing metrics");
+
+        auto const c = PrometheusCollector::New ("node");
+        std::vector <Gauge> gauges;
+        Hook second;
+        int secondCalls = 0;
+
+        // Creates and destroys metrics, and the hook after it
+        auto const first = c->make_hook ([&]
+        {
+            gauges.clear ();
+            for (int i = 0; i < 20; ++i)
+                gauges.push_back (c->make_gauge ("g" + std::to_string (i)));
+            second = Hook ();
+        });
+        second = c->make_hook ([&] { ++secondCalls; });
+
+        auto text = c->render ();
+        expect (secondCalls == 0);
+        expect (hasLine (text, "node_g19 0"), text);
+
+        // A hook made by a hook runs from the next scrape
+        Hook made;
+        int madeCalls = 0;
+        auto const maker = c->make_hook ([&]
+        {
+            if (made.impl () == nullptr)
+                made = c->make_hook ([&] { ++madeCalls; });
+        });
+        c->render ();
+        expect (madeCalls == 0);
+        c->render ();
+        expect (madeCalls == 1);
+    }
+
+    void testMerge ()
+    {
+        testcase ("merge");
+
+        auto const c = PrometheusCollector::New ("node");
+        auto const g1 = c->make_gauge ("cache", "size");
+        {
+            auto const g2 = c->make_gauge ("cache.size");
+            g1.set (2);
+            g2.set (3);
+            auto const text = c->render ();
+            expect (hasLine (text, "node_cache_size 5"), text);
+            expect (text.find ("# TYPE node_cache_size") ==
+                text.rfind ("# TYPE node_cache_size"), text);
+        }
+        expect (hasLine (c->render (), "node_cache_size 2"));
+    }
+
+    void run ()
+    {
+        testNames ();
+        testCounters ();
+        testGauges ();
+        testEvents ();
+        testHooks ();
+        testHookChanges ();
+        testMerge ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(PrometheusCollector,insight,beast);
+
+}
+}
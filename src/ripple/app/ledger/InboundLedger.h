@@ -113,6 +113,10 @@ public:
         std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>& nodeHashes,
         TriggerReason reason);
 
+    void sendNodes (protocol::TMGetLedger& tmGL,
+        std::vector<SHAMapNodeID> const& nodeIDs, Peer::ptr const& peer,
+            TriggerReason reason);
+
     /** Return a Json::objectValue. */
     Json::Value getJson (int);
     void runData ();
@@ -30,15 +30,20 @@
 #include <ripple/app/main/Application.h>
 #include <ripple/app/misc/HashRouter.h>
 #include <ripple/app/misc/NetworkOPs.h>
+#include <ripple/app/misc/impl/AccountTxCursors.h>
+#include <ripple/app/misc/impl/AccountTxSchema.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
 #include <ripple/basics/contract.h>
 #include <ripple/basics/Log.h>
 #include <ripple/basics/StringUtilities.h>
+#include <ripple/basics/UnorderedContainers.h>
 #include <ripple/core/LoadFeeTrack.h>
 #include <ripple/core/Config.h>
 #include <ripple/core/DatabaseCon.h>
 #include <ripple/core/LoadFeeTrack.h>
 #include <ripple/core/JobQueue.h>
 #include <ripple/core/SociDB.h>
+#include <ripple/core/Trace.h>
 #include <ripple/json/to_string.h>
 #include <ripple/nodestore/Database.h>
 #include <ripple/protocol/digest.h>
@@ -104,7 +109,7 @@ public:
     sles_type::value_type
     dereference() const override
     {
-        auto const item = *iter_;
+        auto const& item = *iter_;
         SerialIter sit(item.slice());
         return std::make_shared<SLE const>(
             sit, item.key());
@@ -160,7 +165,7 @@ public:
     txs_type::value_type
     dereference() const override
     {
-        auto const item = *iter_;
+        auto const& item = *iter_;
         if (metadata_)
             return deserializeTxPlusMeta(item);
         return { deserializeTx(item), nullptr };
@@ -423,8 +428,8 @@ void Ledger::setAccepted (
 
 bool Ledger::addSLE (SLE const& sle)
 {
-    SHAMapItem item (sle.getIndex(), sle.getSerializer());
-    return stateMap_->addItem(item, false, false);
+    return stateMap_->addGiveItem(make_shamapitem(
+        sle.getIndex(), sle.getSerializer()), false, false);
 }
 
 //------------------------------------------------------------------------------
@@ -638,9 +643,8 @@ Ledger::rawInsert(std::shared_ptr<SLE> const& sle)
 {
     Serializer ss;
     sle->add(ss);
-    auto item = std::make_shared<
-        SHAMapItem const>(sle->key(),
-            std::move(ss));
+    auto item = make_shamapitem(sle->key(),
+        std::move(ss));
     // VFALCO NOTE addGiveItem should take ownership
     if (! stateMap_->addGiveItem(
             std::move(item), false, false))
@@ -652,9 +656,8 @@ Ledger::rawReplace(std::shared_ptr<SLE> const& sle)
 {
     Serializer ss;
     sle->add(ss);
-    auto item = std::make_shared<
-        SHAMapItem const>(sle->key(),
-            std::move(ss));
+    auto item = make_shamapitem(sle->key(),
+        std::move(ss));
     // VFALCO NOTE updateGiveItem should take ownership
     if (! stateMap_->updateGiveItem(
             std::move(item), false, false))
@@ -676,8 +679,7 @@ Ledger::rawTxInsert (uint256 const& key,
             metaData->getDataLength () + 16);
         s.addVL (txn->peekData ());
         s.addVL (metaData->peekData ());
-        auto item = std::make_shared<
-            SHAMapItem const> (key, std::move(s));
+        auto item = make_shamapitem(key, std::move(s));
         if (! txMap().addGiveItem
                 (std::move(item), true, true))
             LogicError("duplicate_tx: " + to_string(key));
@@ -685,8 +687,7 @@ Ledger::rawTxInsert (uint256 const& key,
     else
     {
         // low-level - just add to table
-        auto item = std::make_shared<
-            SHAMapItem const>(key, txn->peekData());
+        auto item = make_shamapitem(key, txn->slice());
         if (! txMap().addGiveItem(
                 std::move(item), true, false))
             LogicError("duplicate_tx: " + to_string(key));
@@ -933,6 +934,7 @@ void Ledger::updateSkipList ()
 static bool saveValidatedLedger (
     Application& app, std::shared_ptr<Ledger> const& ledger, bool current)
 {
+    RIPPLE_TRACE_LEDGER ("saveValidatedLedger", ledger->info().seq);
     auto j = app.journal ("Ledger");
 
      if (! app.pendingSaves().startWork (ledger->info().seq))
@@ -954,6 +956,13 @@ static bool saveValidatedLedger (
         "DELETE FROM AccountTransactions WHERE LedgerSeq = %u;");
     static boost::format deleteAcctTrans (
         "DELETE FROM AccountTransactions WHERE TransID = '%s';");
+    static boost::format deleteAcctTxs (
+        "DELETE FROM AccountTxs WHERE LedgerSeq = %u;");
+    // AccountTxs has no TransID index, find the ledger the
+    // transaction was previously saved in instead.
+    static boost::format deleteAcctTxsTrans (
+        "DELETE FROM AccountTxs WHERE TransID = '%s' AND LedgerSeq IN "
+        "(SELECT LedgerSeq FROM Transactions WHERE TransID = '%s');");
     static boost::format transExists (
         "SELECT Status FROM Transactions WHERE TransID = '%s';");
     static boost::format updateTx (
@@ -1032,16 +1041,26 @@ static bool saveValidatedLedger (
 
     try
     {
+    // The accounts whose account_tx walks gain rows
+    hash_set<AccountID> affected;
+
     if (app.getTxnDB ().getType () != DatabaseCon::Type::None)
     {
-        auto db = app.getTxnDB ().checkoutDb ();
+        auto const shard = app.getTxnDBShards ().writer (seq);
+        auto const start = std::chrono::steady_clock::now ();
+
+        auto& txnDB = shard->db ();
+        auto db = txnDB.checkoutDb ();
 
         // @TODO: need to check if batch improvement needed.
         //db->batchStart();
         soci::transaction tr(*db);
 
+        auto const writeLegacy = shard->schema ().writeLegacy ();
+
         *db << boost::str (deleteTrans1 % seq);
         *db << boost::str (deleteTrans2 % seq);
+        *db << boost::str (deleteAcctTxs % seq);
 
         std::string const ledgerSeq (std::to_string (seq));
 
@@ -1060,10 +1079,40 @@ static bool saveValidatedLedger (
             std::string const txnSeq (std::to_string (vt.second->getTxnSeq ()));
 
             *db << boost::str (deleteAcctTrans % transactionID);
+            *db << boost::str (deleteAcctTxsTrans % txnId % txnId);
 
             auto const& accts = vt.second->getAffected ();
+            affected.insert (accts.begin (), accts.end ());
 
             if (!accts.empty ())
+            {
+                // Every row carries the transaction so that account_tx
+                // never has to join against Transactions.
+                std::string const rowSuffix = "," + ledgerSeq + "," +
+                    txnSeq + ",'" + txnId + "','" + TXN_SQL_VALIDATED +
+                    "'," + sqlEscape (
+                        vt.second->getTxn ()->getSerializer ().peekData ()) +
+                    "," + vt.second->getEscMeta () + "," +
+                    std::to_string (vt.second->getTxnType ()) + ")";
+
+                std::string sql (accountTxsInsertReplaceHeader (
+                    txnDB.getType ()));
+                sql.reserve (sql.length () +
+                    (accts.size () * (rowSuffix.size () + 48)));
+
+                bool first = true;
+                for (auto const& account : accts)
+                {
+                    sql += first ? "(" : ", (";
+                    first = false;
+                    sql += sqlAccountID (account);
+                    sql += rowSuffix;
+                }
+                sql += ";";
+                *db << sql;
+            }
+
+            if (writeLegacy && !accts.empty ())
             {
                 std::string sql (
                     "INSERT INTO AccountTransactions "
@@ -1101,21 +1150,28 @@ static bool saveValidatedLedger (
                 }
                 *db << sql;
             }
-            else
+
+            if (accts.empty ())
                 JLOG (j.warning)
                     << "Transaction in ledger " << seq
                     << " affects no accounts";
 
             *db <<
-               (STTx::getMetaSQLInsertReplaceHeader (app.getTxnDB ().getType ()) +
+               (STTx::getMetaSQLInsertReplaceHeader (txnDB.getType ()) +
                 vt.second->getTxn ()->getMetaSQL (
                     seq, vt.second->getEscMeta (), ledger->info ().closeTime) + ";");
         }
 
         tr.commit ();
         //db->batchCommit();
+
+        shard->onWrite (std::chrono::duration_cast<
+            std::chrono::microseconds> (
+                std::chrono::steady_clock::now () - start));
     }
 
+    app.getAccountTxCursors ().onLedgerSaved (seq, affected);
+
 
     {
         auto db (app.getLedgerDB ().checkoutDb ());
@@ -1195,10 +1251,15 @@ bool pendSaveValidated (Application& app,
     }
 
     if (isSynchronous)
-        return saveValidatedLedger(app, ledger, isCurrent);
+    {
+        auto const result = saveValidatedLedger(app, ledger, isCurrent);
+        traceLedgerSaved (ledger->info().seq);
+        return result;
+    }
 
     auto job = [ledger, &app, isCurrent] (Job&) {
         saveValidatedLedger(app, ledger, isCurrent);
+        traceLedgerSaved (ledger->info().seq);
     };
 
     if (isCurrent)
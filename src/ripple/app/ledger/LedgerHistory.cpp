@@ -376,7 +376,7 @@ void LedgerHistory::handleMismatch (
         }
         else
         {
-            if ((*b)->peekData() != (*v)->peekData())
+            if ((*b)->slice() != (*v)->slice())
             {
                 // Same transaction with different metadata
                 log_metadata_difference(builtLedger, validLedger, (*b)->key(), j_);
@@ -466,4 +466,15 @@ void LedgerHistory::clearLedgerCachePrior (LedgerIndex seq)
     }
 }
 
+SHAMapResidentCounts LedgerHistory::getResidentCounts ()
+{
+    SHAMapResidentCounts counts;
+    for (auto const& ledger : m_ledgers_by_hash.getValues ())
+    {
+        ledger->stateMap ().countResident (counts);
+        ledger->txMap ().countResident (counts);
+    }
+    return counts;
+}
+
 } // ripple
@@ -98,6 +98,12 @@ public:
 
     void clearLedgerCachePrior (LedgerIndex seq);
 
+    /** Count the map nodes held in memory by the ledgers in the cache.
+        Ledgers share the nodes they have in common, and those are
+        counted once.
+    */
+    SHAMapResidentCounts getResidentCounts ();
+
 private:
 
     /** Log details in the case where we build one ledger but
@@ -158,6 +158,9 @@ public:
     virtual void sweep () = 0;
     virtual float getCacheHitRate () = 0;
 
+    /** Count the map nodes held in memory by the cached ledgers. */
+    virtual SHAMapResidentCounts getResidentCounts () = 0;
+
     virtual void checkAccept (Ledger::ref ledger) = 0;
     virtual void checkAccept (uint256 const& hash, std::uint32_t seq) = 0;
     virtual void consensusBuilt (Ledger::ref ledger, Json::Value consensus) = 0;
@@ -603,10 +603,6 @@ void InboundLedger::trigger (Peer::ptr const& peer, TriggerReason reason)
                     if (!nodeIDs.empty ())
                     {
                         tmGL.set_itype (protocol::liAS_NODE);
-                        for (auto const& id : nodeIDs)
-                        {
-                            * (tmGL.add_nodeids ()) = id.getRawString ();
-                        }
 
                         if (m_journal.trace) m_journal.trace <<
                             "Sending AS node " << nodeIDs.size () <<
@@ -614,7 +610,7 @@ void InboundLedger::trigger (Peer::ptr const& peer, TriggerReason reason)
                                     peer ? "selected peer" : "all peers");
                         if (nodeIDs.size () == 1 && m_journal.trace)
                             m_journal.trace << "AS node: " << nodeIDs[0];
-                        sendRequest (tmGL, peer);
+                        sendNodes (tmGL, nodeIDs, peer, reason);
                         return;
                     }
                     else
@@ -673,15 +669,11 @@ void InboundLedger::trigger (Peer::ptr const& peer, TriggerReason reason)
                 if (!nodeIDs.empty ())
                 {
                     tmGL.set_itype (protocol::liTX_NODE);
-                    for (auto const& id : nodeIDs)
-                    {
-                        * (tmGL.add_nodeids ()) = id.getRawString ();
-                    }
                     if (m_journal.trace) m_journal.trace <<
                         "Sending TX node " << nodeIDs.size () <<
                         " request to " << (
                             peer ? "selected peer" : "all peers");
-                    sendRequest (tmGL, peer);
+                    sendNodes (tmGL, nodeIDs, peer, reason);
                     return;
                 }
                 else
@@ -702,6 +694,26 @@ void InboundLedger::trigger (Peer::ptr const& peer, TriggerReason reason)
     }
 }
 
+/** Ask for nodes. Peers normally share the work by subtree, even when
+    one peer's reply triggered the request, since every node is now
+    marked as recently requested. Once we've timed out we ask everyone
+    for everything.
+*/
+void InboundLedger::sendNodes (protocol::TMGetLedger& tmGL,
+    std::vector<SHAMapNodeID> const& nodeIDs, Peer::ptr const& peer,
+        TriggerReason reason)
+{
+    if (reason != TriggerReason::trTimeout)
+    {
+        sendNodeRequest (tmGL, nodeIDs, peer);
+        return;
+    }
+
+    for (auto const& id : nodeIDs)
+        * (tmGL.add_nodeids ()) = id.getRawString ();
+    sendRequest (tmGL, peer);
+}
+
 void InboundLedger::filterNodes (std::vector<SHAMapNodeID>& nodeIDs,
     std::vector<uint256>& nodeHashes, TriggerReason reason)
 {
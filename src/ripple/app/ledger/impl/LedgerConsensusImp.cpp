@@ -44,6 +44,7 @@
 #include <ripple/core/JobQueue.h>
 #include <ripple/core/LoadFeeTrack.h>
 #include <ripple/core/TimeKeeper.h>
+#include <ripple/core/Trace.h>
 #include <ripple/json/to_string.h>
 #include <ripple/overlay/Overlay.h>
 #include <ripple/overlay/predicates.h>
@@ -258,6 +259,7 @@ LedgerConsensusImp::LedgerConsensusImp (
     assert (mPreviousMSeconds);
 
     inboundTransactions_.newRound (mPreviousLedger->info().seq);
+    traceLedgerOpened (mPreviousLedger->info().seq + 1);
 
     // Adapt close time resolution to recent network conditions
     mCloseResolution = getNextLedgerTimeResolution (
@@ -1141,6 +1143,7 @@ void LedgerConsensusImp::simulate ()
 
 void LedgerConsensusImp::accept (std::shared_ptr<SHAMap> set)
 {
+    RIPPLE_TRACE_LEDGER ("acceptLedger", mPreviousLedger->info().seq + 1);
     Json::Value consensusStatus;
 
     {
@@ -1205,6 +1208,7 @@ void LedgerConsensusImp::accept (std::shared_ptr<SHAMap> set)
         << " last closed ledger";
 
     {
+        RIPPLE_TRACE_LEDGER ("applyTransactions", newLCL->info().seq);
         OpenView accum(&*newLCL);
         assert(accum.closed());
         if (replay)
@@ -1440,14 +1444,14 @@ void LedgerConsensusImp::createDisputes (
             // transaction is only in first map
             assert (!pos.second.second);
             addDisputedTransaction (pos.first
-                , pos.second.first->peekData ());
+                , pos.second.first->slice ());
         }
         else if (pos.second.second)
         {
             // transaction is only in second map
             assert (!pos.second.first);
             addDisputedTransaction (pos.first
-                , pos.second.second->peekData ());
+                , pos.second.second->slice ());
         }
         else // No other disagreement over a transaction should be possible
             assert (false);
@@ -1457,7 +1461,7 @@ void LedgerConsensusImp::createDisputes (
 
 void LedgerConsensusImp::addDisputedTransaction (
     uint256 const& txID,
-    Blob const& tx)
+    Slice tx)
 {
     if (mDisputes.find (txID) != mDisputes.end ())
         return;
@@ -1496,7 +1500,7 @@ void LedgerConsensusImp::addDisputedTransaction (
     if (app_.getHashRouter ().setFlags (txID, SF_RELAYED))
     {
         protocol::TMTransaction msg;
-        msg.set_rawtransaction (& (tx.front ()), tx.size ());
+        msg.set_rawtransaction (tx.data (), tx.size ());
         msg.set_status (protocol::tsNEW);
         msg.set_receivetimestamp (
             app_.timeKeeper().now().time_since_epoch().count());
@@ -1613,8 +1617,8 @@ void LedgerConsensusImp::takeInitialPosition (
     {
         Serializer s (2048);
         tx.first->add(s);
-        initialSet->addItem (
-            SHAMapItem (tx.first->getTransactionID(), std::move (s)), true, false);
+        initialSet->addGiveItem (make_shamapitem (
+            tx.first->getTransactionID(), std::move (s)), true, false);
     }
 
     if ((app_.config().RUN_STANDALONE || (mProposing && mHaveCorrectLCL))
@@ -1765,8 +1769,8 @@ void LedgerConsensusImp::updateOurPositions ()
 
             if (it.second->getOurVote ()) // now a yes
             {
-                ourPosition->addItem (SHAMapItem (it.first
-                    , it.second->peekTransaction ()), true, false);
+                ourPosition->addGiveItem (make_shamapitem (it.first
+                    , it.second->peekTransaction ().slice ()), true, false);
                 //              addedTx.push_back(it.first);
             }
             else // now a no
@@ -1896,6 +1900,8 @@ void LedgerConsensusImp::closeLedger ()
 {
     checkOurValidation ();
     state_ = State::establish;
+    traceSpan ("open", TraceKind::ledger,
+        mPreviousLedger->info().seq + 1, mConsensusStartTime);
     mConsensusStartTime = std::chrono::steady_clock::now ();
     mCloseTime = app_.timeKeeper().closeTime().time_since_epoch().count();
     consensus_.setLastCloseTime (mCloseTime);
@@ -1957,6 +1963,9 @@ void LedgerConsensusImp::beginAccept (bool synchronous)
         return;
     }
 
+    traceSpan ("establish", TraceKind::ledger,
+        mPreviousLedger->info().seq + 1, mConsensusStartTime);
+
     consensus_.newLCL (
         mPeerPositions.size (), mCurrentMSeconds, mNewLedgerHash);
 
@@ -220,7 +220,7 @@ private:
       @param txID The ID of the disputed transaction
       @param tx   The data of the disputed transaction
     */
-    void addDisputedTransaction (uint256 const& txID, Blob const& tx);
+    void addDisputedTransaction (uint256 const& txID, Slice tx);
 
     /**
       Adjust the votes on all disputed transactions based
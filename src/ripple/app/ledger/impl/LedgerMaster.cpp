@@ -898,7 +898,14 @@ public:
 
             if (dividendState == DividendMaster::DivState_Done)
             {
-                // dividend has already finished or not started.
+                // dividend has already finished or not started, have its
+                // results ready for account_dividend.
+                if (dividendObj->isFieldPresent (sfDividendHash))
+                {
+                    app_.getDividendMaster ().buildAccountIndex (
+                        dividendObj->getFieldU32 (sfDividendLedger),
+                        dividendObj->getFieldH256 (sfDividendHash));
+                }
                 return;
             }
             
@@ -908,16 +915,18 @@ public:
                 return;
 
             DividendMaster& dm = app_.getDividendMaster();
-            if (app_.getJobQueue ().getJobCount (jtDIVIDEND) > 0)
+            // A suspended run counts as waiting, a resumed one as running
+            if (app_.getJobQueue ().getJobCountTotal (jtDIVIDEND) > 0)
             {
                 JLOG (m_journal.debug) << "Dividend job passed.";
                 return;
             }
-            app_.getJobQueue ().addJob (jtDIVIDEND,
-                    "DividendMaster::getMissingTxns", 
-                     std::bind (
-                        &DividendMaster::getMissingTxns,
-                        &dm));
+            app_.getJobQueue ().postCoro (jtDIVIDEND,
+                    "DividendMaster::getMissingTxns",
+                    [&dm] (std::shared_ptr<JobCoro>)
+                    {
+                        dm.getMissingTxns ();
+                    });
         }
     }
 
@@ -1264,9 +1273,10 @@ public:
                 }
             }
 
+            bool finished = true;
             try
             {
-                app_.getPathRequests().updateAll(
+                finished = app_.getPathRequests().updateAll(
                     lastLedger, job.getCancelCallback());
             }
             catch (SHAMapMissingNode&)
@@ -1288,6 +1298,17 @@ public:
                         InboundLedger::fcGENERIC);
                  }
             }
+
+            if (! finished)
+            { // A job with a deadline is waiting, finish in a new job
+                ScopedLockType ml (m_mutex);
+                if (lastLedger == mPathLedger)
+                    mPathLedger.reset ();
+                mPathFindNewRequest = true;
+                --mPathFindThread;
+                newPFWork ("pf:resume");
+                return;
+            }
         }
     }
 
@@ -1609,6 +1630,11 @@ public:
         return mLedgerHistory.getCacheHitRate ();
     }
 
+    SHAMapResidentCounts getResidentCounts () override
+    {
+        return mLedgerHistory.getResidentCounts ();
+    }
+
     beast::PropertyStream::Source& getPropertySource () override
     {
         return *mLedgerCleaner;
@@ -20,6 +20,7 @@
 #include <BeastConfig.h>
 #include <ripple/app/ledger/OpenLedger.h>
 #include <ripple/app/tx/apply.h>
+#include <ripple/core/Trace.h>
 #include <ripple/ledger/CachedView.h>
 #include <ripple/protocol/Feature.h>
 #include <boost/range/adaptor/transformed.hpp>
@@ -79,6 +80,7 @@ OpenLedger::accept(Application& app, Rules const& rules,
                 std::string const& suffix,
                     modify_type const& f)
 {
+    RIPPLE_TRACE_LEDGER ("openLedgerAccept", ledger->seq() + 1);
     JLOG(j_.trace) <<
         "accept ledger " << ledger->seq() << " " << suffix << " with " << retries.size () << " retries";
     auto next = create(rules, ledger);
@@ -43,11 +43,15 @@
 #include <ripple/app/misc/SHAMapStore.h>
 #include <ripple/app/misc/TxQ.h>
 #include <ripple/app/misc/Validations.h>
+#include <ripple/app/misc/impl/AccountTxCursors.h>
+#include <ripple/app/misc/impl/AccountTxSchema.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
 #include <ripple/app/paths/Pathfinder.h>
 #include <ripple/app/paths/PathRequests.h>
 #include <ripple/app/misc/UniqueNodeList.h>
 #include <ripple/app/tx/apply.h>
 #include <ripple/basics/contract.h>
+#include <ripple/basics/CountedObject.h>
 #include <ripple/basics/Log.h>
 #include <ripple/basics/ResolverAsio.h>
 #include <ripple/basics/Sustain.h>
@@ -78,6 +82,7 @@
 #include <boost/asio/signal_set.hpp>
 #include <boost/optional.hpp>
 #include <fstream>
+#include <map>
 
 namespace ripple {
 
@@ -114,7 +119,7 @@ public:
     AppFamily (Application& app, NodeStore::Database& db,
             CollectorManager& collectorManager)
         : app_ (app)
-        , treecache_ ("TreeNodeCache", 65536, 60, stopwatch(),
+        , treecache_ ("TreeNodeCache", 64 << 20, 60, stopwatch(),
             app.journal("TaggedCache"))
         , fullbelow_ ("full_below", stopwatch(),
             collectorManager.collector(),
@@ -292,6 +297,62 @@ private:
         }
     };
 
+    // Figures that get_counts reports, for the collector
+    struct Stats
+    {
+        template <class Handler>
+        Stats (Handler const& handler,
+                beast::insight::Collector::ptr const& collector_)
+            : collector (collector_)
+            , hook (collector->make_hook (handler))
+            , node_reads (collector->make_gauge ("node_store", "reads"))
+            , node_reads_hit (collector->make_gauge ("node_store", "reads_hit"))
+            , node_read_bytes (collector->make_gauge ("node_store", "read_bytes"))
+            , node_writes (collector->make_gauge ("node_store", "writes"))
+            , node_written_bytes (collector->make_gauge (
+                "node_store", "written_bytes"))
+            , node_write_load (collector->make_gauge ("node_store", "write_load"))
+            , node_hit_rate (collector->make_gauge ("node_store", "hit_rate"))
+            , node_cache_bytes (collector->make_gauge (
+                "node_store", "cache_bytes"))
+            , treenode_size (collector->make_gauge ("treenode_cache", "size"))
+            , treenode_bytes (collector->make_gauge ("treenode_cache", "bytes"))
+            , treenode_inner_hit_rate (collector->make_gauge (
+                "treenode_cache", "inner_hit_rate"))
+            , treenode_leaf_hit_rate (collector->make_gauge (
+                "treenode_cache", "leaf_hit_rate"))
+            , sle_hit_rate (collector->make_gauge ("sle_cache", "hit_rate"))
+            , local_fee (collector->make_gauge ("load_fee", "local"))
+            , remote_fee (collector->make_gauge ("load_fee", "remote"))
+            , cluster_fee (collector->make_gauge ("load_fee", "cluster"))
+            { }
+
+        beast::insight::Collector::ptr collector;
+        beast::insight::Hook hook;
+        beast::insight::Gauge node_reads;
+        beast::insight::Gauge node_reads_hit;
+        beast::insight::Gauge node_read_bytes;
+        beast::insight::Gauge node_writes;
+        beast::insight::Gauge node_written_bytes;
+        beast::insight::Gauge node_write_load;
+        beast::insight::Gauge node_hit_rate;
+        beast::insight::Gauge node_cache_bytes;
+        beast::insight::Gauge treenode_size;
+        beast::insight::Gauge treenode_bytes;
+        beast::insight::Gauge treenode_inner_hit_rate;
+        beast::insight::Gauge treenode_leaf_hit_rate;
+        beast::insight::Gauge sle_hit_rate;
+        beast::insight::Gauge local_fee;
+        beast::insight::Gauge remote_fee;
+        beast::insight::Gauge cluster_fee;
+
+        // Instances of each CountedObject type, added as types show up
+        std::map <std::string, beast::insight::Gauge> objects;
+
+        // Estimated memory of each CountedObject type
+        std::map <std::string, beast::insight::Gauge> object_bytes;
+    };
+
 public:
     std::unique_ptr<Config const> config_;
     std::unique_ptr<Logs> logs_;
@@ -315,6 +376,7 @@ public:
     std::unique_ptr <CollectorManager> m_collectorManager;
     detail::AppFamily family_;
     CachedSLEs cachedSLEs_;
+    AccountTxCursors accountTxCursors_;
     LocalCredentials m_localCredentials;
 
     std::unique_ptr <Resource::Manager> m_resourceManager;
@@ -343,6 +405,8 @@ public:
     beast::DeadlineTimer m_entropyTimer;
 
     std::unique_ptr <DatabaseCon> mTxnDB;
+    std::unique_ptr <AccountTxSchema> accountTxSchema_;
+    std::unique_ptr <TxnDBShards> txnDBShards_;
     std::unique_ptr <DatabaseCon> mLedgerDB;
     std::unique_ptr <DatabaseCon> mWalletDB;
     std::unique_ptr <Overlay> m_overlay;
@@ -355,6 +419,9 @@ public:
 
     io_latency_sampler m_io_latency_sampler;
 
+    // Must come last so the hook goes away before what it reads
+    Stats m_stats;
+
     //--------------------------------------------------------------------------
 
     static
@@ -406,6 +473,8 @@ public:
 
         , cachedSLEs_ (std::chrono::minutes(1), stopwatch())
 
+        , accountTxCursors_ (stopwatch(), std::chrono::minutes(5))
+
         , m_localCredentials (*this)
 
         , m_resourceManager (Resource::make_Manager (
@@ -448,7 +517,7 @@ public:
             }))
 
         , m_acceptedLedgerCache ("AcceptedLedger", 4, 600, stopwatch(),
-            logs_->journal("TaggedCache"))
+            logs_->journal("TaggedCache"), m_collectorManager->collector ())
 
         , m_networkOPs (make_NetworkOPs (*this, stopwatch(),
             config_->RUN_STANDALONE, config_->NETWORK_QUORUM, config_->START_VALID,
@@ -487,6 +556,9 @@ public:
 
         , m_io_latency_sampler (m_collectorManager->collector()->make_event ("ios_latency"),
             logs_->journal("Application"), std::chrono::milliseconds (100), get_io_service())
+
+        , m_stats (std::bind (&ApplicationImp::collect_metrics, this),
+            m_collectorManager->collector ())
     {
         add (m_resourceManager.get ());
 
@@ -602,6 +674,61 @@ public:
         m_networkOPs->mapComplete (setHash, set);
     }
 
+    void collect_metrics ()
+    {
+        auto hitRate = [](TreeNodeCache::Counts const& c)
+        {
+            auto const total = c.hits + c.misses;
+            return total ? (c.hits * 100) / total : 0;
+        };
+
+        m_stats.node_reads.set (m_nodeStore->getFetchTotalCount ());
+        m_stats.node_reads_hit.set (m_nodeStore->getFetchHitCount ());
+        m_stats.node_read_bytes.set (m_nodeStore->getFetchSize ());
+        m_stats.node_writes.set (m_nodeStore->getStoreCount ());
+        m_stats.node_written_bytes.set (m_nodeStore->getStoreSize ());
+        m_stats.node_write_load.set (std::max (
+            m_nodeStore->getWriteLoad (), 0));
+        m_stats.node_hit_rate.set (static_cast <
+            beast::insight::Gauge::value_type> (
+                m_nodeStore->getCacheHitRate ()));
+        m_stats.node_cache_bytes.set (m_nodeStore->getCacheBytes ());
+
+        auto const& treecache = family_.treecache ();
+        auto const stats = treecache.getStats ();
+        m_stats.treenode_size.set (treecache.getCacheSize ());
+        m_stats.treenode_bytes.set (treecache.getCacheBytes ());
+        m_stats.treenode_inner_hit_rate.set (hitRate (stats.inner));
+        m_stats.treenode_leaf_hit_rate.set (hitRate (stats.leaf));
+
+        m_stats.sle_hit_rate.set (static_cast <
+            beast::insight::Gauge::value_type> (cachedSLEs_.rate () * 100));
+
+        m_stats.local_fee.set (mFeeTrack->getLocalFee ());
+        m_stats.remote_fee.set (mFeeTrack->getRemoteFee ());
+        m_stats.cluster_fee.set (mFeeTrack->getClusterFee ());
+
+        for (auto const& count : CountedObjects::getInstance ().getCounts (0))
+        {
+            auto iter = m_stats.objects.find (count.first);
+            if (iter == m_stats.objects.end ())
+                iter = m_stats.objects.emplace (count.first,
+                    m_stats.collector->make_gauge (
+                        "objects", count.first)).first;
+            iter->second.set (count.second);
+        }
+
+        for (auto const& bytes : CountedObjects::getInstance ().getBytes (0))
+        {
+            auto iter = m_stats.object_bytes.find (bytes.first);
+            if (iter == m_stats.object_bytes.end ())
+                iter = m_stats.object_bytes.emplace (bytes.first,
+                    m_stats.collector->make_gauge (
+                        "object_bytes", bytes.first)).first;
+            iter->second.set (bytes.second);
+        }
+    }
+
     TransactionMaster& getMasterTransaction () override
     {
         return m_txMaster;
@@ -721,6 +848,20 @@ public:
         assert (mTxnDB.get() != nullptr);
         return *mTxnDB;
     }
+    AccountTxSchema& getAccountTxSchema () override
+    {
+        assert (accountTxSchema_.get() != nullptr);
+        return *accountTxSchema_;
+    }
+    TxnDBShards& getTxnDBShards () override
+    {
+        assert (txnDBShards_.get() != nullptr);
+        return *txnDBShards_;
+    }
+    AccountTxCursors& getAccountTxCursors () override
+    {
+        return accountTxCursors_;
+    }
     DatabaseCon& getLedgerDB () override
     {
         assert (mLedgerDB.get() != nullptr);
@@ -921,6 +1062,25 @@ public:
         m_sweepTimer.setExpiration (config_->getSize (siSweepInterval));
     }
 
+    void doAccountTxMigration ()
+    {
+        try
+        {
+            if (accountTxSchema_->migrate (accountTxMigrationBatch))
+                return;
+        }
+        catch (std::exception const& e)
+        {
+            // Readers stay on AccountTransactions, try again next start.
+            m_journal.error << "Account transaction migration failed: " <<
+                e.what ();
+            return;
+        }
+
+        m_jobQueue->addJob (jtDB_BATCH, "AccountTxMigrate",
+            [this] (Job&) { doAccountTxMigration (); });
+    }
+
 
 private:
     void addTxnSeqField();
@@ -986,9 +1146,31 @@ void ApplicationImp::setup()
     }
     mLedgerDB->setupCheckpointing (m_jobQueue.get(), logs());
 
+    accountTxSchema_ = std::make_unique <AccountTxSchema> (
+        getTxnDB (), logs_->journal ("AccountTxSchema"));
+    accountTxSchema_->setup ();
+
+    if (accountTxSchema_->writeLegacy ())
+        m_jobQueue->addJob (jtDB_BATCH, "AccountTxMigrate",
+            [this] (Job&) { doAccountTxMigration (); });
+
     if (!config_->RUN_STANDALONE)
         updateTables ();
 
+    {
+        // Standalone databases are usually temporary, so never shard them
+        std::uint32_t shardLedgers = 0;
+        if (! config_->RUN_STANDALONE)
+            get_if_exists (config_->section (SECTION_TX_DB),
+                "shard_ledgers", shardLedgers);
+
+        txnDBShards_ = std::make_unique <TxnDBShards> (
+            setup_DatabaseCon (*config_), getTxnDB (), *accountTxSchema_,
+                shardLedgers, config_->getSize (siTxnDBCache) * 1024,
+                    *m_jobQueue, logs ());
+        txnDBShards_->setup ();
+    }
+
     // trigger Setup signal
     if (!signals ().Setup (*this))
     {
@@ -1103,7 +1285,8 @@ void ApplicationImp::setup()
 
     m_nodeStore->tune (config_->getSize (siNodeCacheSize), config_->getSize (siNodeCacheAge));
     m_ledgerMaster->tune (config_->getSize (siLedgerSize), config_->getSize (siLedgerAge));
-    family().treecache().setTargetSize (config_->getSize (siTreeCacheSize));
+    family().treecache().setTargetBytes (
+        std::size_t (config_->getSize (siTreeCacheMB)) << 20);
     family().treecache().setTargetAge (config_->getSize (siTreeCacheAge));
 
     //----------------------------------------------------------------------
@@ -69,6 +69,9 @@ class Validations;
 class Cluster;
 
 class DatabaseCon;
+class AccountTxCursors;
+class AccountTxSchema;
+class TxnDBShards;
 class SHAMapStore;
 
 using NodeCache     = TaggedCache <uint256, Blob>;
@@ -140,6 +143,9 @@ public:
     virtual AccountIDCache const&   accountIDCache() const = 0;
     virtual OpenLedger&             openLedger() = 0;
     virtual DatabaseCon& getTxnDB () = 0;
+    virtual AccountTxSchema& getAccountTxSchema () = 0;
+    virtual TxnDBShards& getTxnDBShards () = 0;
+    virtual AccountTxCursors& getAccountTxCursors () = 0;
     virtual DatabaseCon& getLedgerDB () = 0;
 
     virtual std::chrono::milliseconds getIOLatency () = 0;
@@ -19,6 +19,7 @@
 
 #include <BeastConfig.h>
 #include <ripple/app/main/BasicApp.h>
+#include <ripple/core/Affinity.h>
 #include <beast/threads/Thread.h>
 
 BasicApp::BasicApp(std::size_t numberOfThreads)
@@ -31,6 +32,7 @@ BasicApp::BasicApp(std::size_t numberOfThreads)
                 beast::Thread::setCurrentThreadName(
                     std::string("io_service #") +
                         std::to_string(numberOfThreads));
+                ripple::pinCurrentThread(ripple::ThreadClass::io);
                 this->io_service_.run();
             });
 }
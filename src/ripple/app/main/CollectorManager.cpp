@@ -29,6 +29,7 @@ class CollectorManagerImp
 public:
     beast::Journal m_journal;
     beast::insight::Collector::ptr m_collector;
+    std::shared_ptr <beast::insight::PrometheusCollector> m_prometheus;
     std::unique_ptr <beast::insight::Groups> m_groups;
 
     CollectorManagerImp (Section const& params,
@@ -45,6 +46,12 @@ public:
 
             m_collector = beast::insight::StatsDCollector::New (address, prefix, journal);
         }
+        else if (server == "prometheus")
+        {
+            m_prometheus = beast::insight::PrometheusCollector::New (
+                get<std::string> (params, "prefix"));
+            m_collector = m_prometheus;
+        }
         else
         {
             m_collector = beast::insight::NullCollector::New ();
@@ -66,6 +73,13 @@ public:
     {
         return m_groups->get (name);
     }
+
+    boost::optional<std::string> scrape () override
+    {
+        if (! m_prometheus)
+            return boost::none;
+        return m_prometheus->render ();
+    }
 };
 
 //------------------------------------------------------------------------------
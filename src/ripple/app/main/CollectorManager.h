@@ -22,6 +22,7 @@
 
 #include <ripple/basics/BasicConfig.h>
 #include <beast/Insight.h>
+#include <boost/optional.hpp>
 
 namespace ripple {
 
@@ -36,6 +37,12 @@ public:
     virtual beast::insight::Collector::ptr const& collector () = 0;
     virtual beast::insight::Group::ptr const& group (
         std::string const& name) = 0;
+
+    /** Returns the metrics in the Prometheus text format.
+        Only a pull based collector has anything to return; with any
+        other server this returns nothing.
+    */
+    virtual boost::optional<std::string> scrape () = 0;
 };
 
 }
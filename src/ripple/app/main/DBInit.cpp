@@ -63,6 +63,35 @@ const char* TxnDBInit[] =
     "CREATE INDEX IF NOT EXISTS AcctLgrIndex ON               \
         AccountTransactions(LedgerSeq, Account, TransID);",
 
+    // Schema version 2 of the account transaction index. AccountID is the
+    // 20 byte account, and the transaction is stored alongside so paging
+    // needs no join. TransType is the numeric TxType. See AccountTxSchema.
+    "CREATE TABLE IF NOT EXISTS AccountTxs (                  \
+        AccountID   BLOB,                       \
+        LedgerSeq   BIGINT UNSIGNED,            \
+        TxnSeq      INTEGER,                    \
+        TransID     CHARACTER(64),              \
+        Status      CHARACTER(1),               \
+        RawTxn      BLOB,                       \
+        TxnMeta     BLOB,                       \
+        TransType   INTEGER                     \
+    );",
+    "CREATE UNIQUE INDEX IF NOT EXISTS AcctTxsIndex ON        \
+        AccountTxs(AccountID, LedgerSeq, TxnSeq);",
+    "CREATE INDEX IF NOT EXISTS AcctTxsTypeIndex ON           \
+        AccountTxs(AccountID, TransType, LedgerSeq, TxnSeq);",
+    "CREATE INDEX IF NOT EXISTS AcctTxsLgrIndex ON            \
+        AccountTxs(LedgerSeq);",
+
+    // Name: the table or index tracked
+    // Version: layout in use
+    // Progress: migration bookmark, meaning depends on Name
+    "CREATE TABLE IF NOT EXISTS SchemaVersion (               \
+        Name        CHARACTER(32) PRIMARY KEY,  \
+        Version     INTEGER,                    \
+        Progress    BIGINT UNSIGNED             \
+    );",
+
     "END TRANSACTION;"
     
 };
@@ -100,6 +129,29 @@ const char* TxnDBInitMySQL[] =
         AccountTransactions(Account, LedgerSeq, TxnSeq, TransID);",
     "CREATE INDEX AcctLgrIndex ON               \
         AccountTransactions(LedgerSeq, Account, TransID);",
+
+    "CREATE TABLE IF NOT EXISTS AccountTxs (             \
+        AccountID   VARBINARY(20),                      \
+        LedgerSeq   BIGINT UNSIGNED,                    \
+        TxnSeq      INTEGER,                            \
+        TransID     CHARACTER(64),                      \
+        Status      CHARACTER(1),                       \
+        RawTxn      LONGBLOB,                           \
+        TxnMeta     LONGBLOB,                           \
+        TransType   INTEGER                             \
+    );",
+    "CREATE UNIQUE INDEX AcctTxsIndex ON        \
+        AccountTxs(AccountID, LedgerSeq, TxnSeq);",
+    "CREATE INDEX AcctTxsTypeIndex ON           \
+        AccountTxs(AccountID, TransType, LedgerSeq, TxnSeq);",
+    "CREATE INDEX AcctTxsLgrIndex ON            \
+        AccountTxs(LedgerSeq);",
+
+    "CREATE TABLE IF NOT EXISTS SchemaVersion (         \
+        Name        CHARACTER(32) PRIMARY KEY,          \
+        Version     INTEGER,                            \
+        Progress    BIGINT UNSIGNED                     \
+    );",
     
     "COMMIT;"
 };
@@ -23,11 +23,14 @@
 #include <ripple/app/main/Application.h>
 #include <ripple/basics/CheckLibraryVersions.h>
 #include <ripple/basics/contract.h>
+#include <ripple/basics/CountedObject.h>
 #include <ripple/basics/StringUtilities.h>
 #include <ripple/basics/Sustain.h>
 #include <ripple/basics/ThreadName.h>
+#include <ripple/core/Affinity.h>
 #include <ripple/core/Config.h>
 #include <ripple/core/ConfigSections.h>
+#include <ripple/core/Trace.h>
 #include <ripple/crypto/RandomNumbers.h>
 #include <ripple/json/to_string.h>
 #include <ripple/net/RPCCall.h>
@@ -59,6 +62,12 @@ namespace po = boost::program_options;
 
 namespace ripple {
 
+// The memory taken by the members and strings of Json values
+struct JsonMemory
+{
+    static char const* getCountedObjectName () { return "Json::Value"; }
+};
+
 void setupServer (Application& app)
 {
 #ifdef RLIMIT_NOFILE
@@ -220,6 +229,8 @@ int run (int argc, char** argv)
     // Make sure that we have the right OpenSSL and Boost libraries.
     version::checkLibraryVersions();
 
+    Json::setMemoryHook (&CountedObject<JsonMemory>::countBytes);
+
 #ifdef USE_SHA512_ASM
     if (beast::hasAVX2())
     {
@@ -380,6 +391,13 @@ int run (int argc, char** argv)
     // config file, quiet flag.
     config->setup (configFile, bool (vm.count ("quiet")));
 
+    // Before any of the threads it places are started
+    setupAffinity (config->section (SECTION_AFFINITY),
+        deprecatedLogs().journal ("Affinity"));
+
+    setupTracing (config->section (SECTION_TRACING),
+        deprecatedLogs().journal ("Trace"));
+
     if (vm.count ("standalone"))
     {
         config->RUN_STANDALONE = true;
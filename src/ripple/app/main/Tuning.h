@@ -26,6 +26,9 @@ enum
 {
      fullBelowTargetSize = 524288
     ,fullBelowExpirationSeconds = 600
+
+    // Ledgers copied per AccountTxs migration job
+    ,accountTxMigrationBatch = 1000
 };
 
 }
@@ -288,7 +288,7 @@ public:
         #endif
 
             uint256 txID = trans.getTransactionID();
-            auto tItem = std::make_shared <SHAMapItem> (txID, s.peekData());
+            auto tItem = make_shamapitem (txID, s.slice ());
             initialPosition->addGiveItem (tItem, true, false);
         }
     }
@@ -21,6 +21,9 @@ public:
     //typedef std::vector<std::tuple<AccountID, uint64_t, uint64_t, uint64_t, uint64_t, uint32_t, uint64_t, uint64_t>> AccountsDividend;
     
     typedef std::map<AccountID, std::tuple<uint64_t, uint64_t, uint64_t, uint64_t, uint32_t, uint64_t, uint64_t>> AccountsDividend;
+
+    /// One account's result: <DivCoins, DivCoinsVBC, DivCoinsVBCRank, DivCoinsVBCSpd, VRank, VSpd, TSpd>
+    typedef AccountsDividend::mapped_type AccountDividend;
     
     virtual ~DividendMaster(){}
     
@@ -35,6 +38,20 @@ public:
     virtual bool launchDividend (const uint32_t ledgerIndex) = 0;
     
     virtual void getMissingTxns () = 0;
+
+    /// Look up an account's share of the dividend taken at ledgerIndex,
+    /// whose transaction map has root resultHash. Accounts which got
+    /// nothing get all zeros. A dividend not indexed yet is indexed in
+    /// a job.
+    /// @return false if that dividend's results are not available here.
+    virtual bool getAccountDividend (const uint32_t ledgerIndex,
+        uint256 const& resultHash, AccountID const& account,
+        AccountDividend& result) = 0;
+
+    /// Index every account's share of a finished dividend in a job, unless
+    /// it is indexed already or recently failed to be.
+    virtual void buildAccountIndex (const uint32_t ledgerIndex,
+        uint256 const& resultHash) = 0;
 };
 
 std::unique_ptr<DividendMaster>
@@ -9,13 +9,17 @@
 #include <boost/graph/depth_first_search.hpp>
 
 #include <beast/threads/RecursiveMutex.h>
+#include <mutex>
 
 #include <ripple/app/ledger/LedgerMaster.h>
 #include <ripple/app/main/Application.h>
 //#include <ripple/app/misc/DefaultMissingNodeHandler.h>
 #include <ripple/app/misc/DividendMaster.h>
 #include <ripple/app/misc/NetworkOPs.h>
+#include <ripple/app/misc/impl/DividendIndex.h>
 #include <ripple/basics/Log.h>
+#include <ripple/basics/UnorderedContainers.h>
+#include <ripple/core/JobQueue.h>
 #include <ripple/protocol/SystemParameters.h>
 #include <ripple/protocol/TxFlags.h>
 #include <ripple/json/to_string.h>
@@ -43,6 +47,7 @@ class DividendMasterImpl : public DividendMaster
 public:
     DividendMasterImpl (Application& app, beast::Journal journal)
         : app_ (app), m_journal (journal)
+        , m_accountIndex (stopwatch (), std::chrono::minutes (1))
     {
     }
 
@@ -276,7 +281,14 @@ public:
     
     void getMissingTxns() override;
 
+    bool getAccountDividend (const uint32_t ledgerIndex, uint256 const& resultHash,
+        AccountID const& account, AccountDividend& result) override;
+
+    void buildAccountIndex (const uint32_t ledgerIndex, uint256 const& resultHash) override;
+
 private:
+    void loadAccountDividends (const uint32_t ledgerIndex, uint256 const& resultHash);
+
     Application& app_;
     beast::Journal m_journal;
 
@@ -287,6 +299,10 @@ private:
     uint64_t m_dividendVRank;
     uint64_t m_dividendVSprd;
     int m_dividendState = DivType_Start;
+
+    /// Per-account results of the last dividend, so that account_dividend
+    /// does not have to search the transaction database.
+    DividendIndex m_accountIndex;
     
     class AccountData
     {
@@ -396,6 +412,15 @@ void DividendMasterImpl::getMissingTxns ()
     JLOG(journal.info) << "Dividend job, begin submit, dividend state " << getDividendState();
     while (shots > 0 && getDividendState() == DividendMaster::DivType_Start)
     {
+        // Give the thread to a job that must start soon, and carry on
+        // from here once it has
+        auto const coro = JobCoro::current ();
+        if (coro && app_.getJobQueue ().shouldYield ())
+        {
+            coro->post ();
+            coro->yield ();
+        }
+
         if (txnIter == fullDivMap->end ())
         {
             txnIter = fullDivMap->begin ();
@@ -725,7 +750,7 @@ bool DividendMasterImpl::dumpTransactionMap(const uint32_t ledgerIndex, const st
         uint256 txID = trans.getHash(HashPrefix::transactionID);
         Serializer s;
         trans.add (s);
-        auto tItem = std::make_shared<SHAMapItem> (txID, s.peekData ());
+        auto tItem = make_shamapitem (txID, s.slice ());
 
         if (!divUnsignedMap->addGiveItem (tItem, true, false))
         {
@@ -762,10 +787,72 @@ bool DividendMasterImpl::dumpTransactionMap(const uint32_t ledgerIndex, const st
         // flush full hashmap to nodestore
         divUnsignedMap->flushDirty (hotTRANSACTION_NODE, 0);
         setResultHash (divUnsignedMap->getHash ());
+
+        // we have the results already, no need to read them back later.
+        m_accountIndex.finishBuild (ledgerIndex, getResultHash ().as_uint256 (),
+            DividendIndex::Accounts (m_divResult.begin (), m_divResult.end ()));
     }
     return true;
 }
 
+bool DividendMasterImpl::getAccountDividend (const uint32_t ledgerIndex,
+    uint256 const& resultHash, AccountID const& account, AccountDividend& result)
+{
+    if (m_accountIndex.lookup (ledgerIndex, resultHash, account, result))
+        return true;
+
+    buildAccountIndex (ledgerIndex, resultHash);
+    return false;
+}
+
+void DividendMasterImpl::buildAccountIndex (const uint32_t ledgerIndex,
+    uint256 const& resultHash)
+{
+    if (!m_accountIndex.startBuild (ledgerIndex, resultHash))
+        return;
+
+    app_.getJobQueue ().addJob (jtDIVIDEND,
+        "DividendMaster::loadAccountDividends",
+        [this, ledgerIndex, resultHash] (Job&)
+        {
+            loadAccountDividends (ledgerIndex, resultHash);
+        });
+}
+
+// Rebuild the account index from the dividend transaction map in the node
+// store, after a restart or after a new dividend is done.
+void DividendMasterImpl::loadAccountDividends (const uint32_t ledgerIndex, uint256 const& resultHash)
+{
+    SHAMapHash fullHash (resultHash);
+    std::shared_ptr<SHAMap> fullDivMap = std::make_shared<SHAMap> (
+        SHAMapType::TRANSACTION,
+        resultHash,
+        app_.family ());
+
+    if (!fullDivMap->fetchRoot (fullHash, nullptr))
+    {
+        JLOG(m_journal.warning) << "Dividend map " << resultHash << " for ledger " << ledgerIndex << " not found.";
+        m_accountIndex.failBuild (ledgerIndex, resultHash);
+        return;
+    }
+
+    DividendIndex::Accounts accounts;
+    try
+    {
+        accounts = DividendIndex::load (*fullDivMap);
+    }
+    catch (std::exception const& e)
+    {
+        JLOG(m_journal.warning) << "Dividend map " << resultHash << " for ledger " << ledgerIndex << " incomplete: " << e.what ();
+        m_accountIndex.failBuild (ledgerIndex, resultHash);
+        return;
+    }
+
+    JLOG(m_journal.info) << "Loaded dividend results of " << accounts.size () << " accounts for ledger " << ledgerIndex;
+
+    m_accountIndex.finishBuild (ledgerIndex, resultHash, std::move (accounts));
+}
+
 std::unique_ptr<DividendMaster>
 make_DividendMaster(Application& app, beast::Journal journal)
 {
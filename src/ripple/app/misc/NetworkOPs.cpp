@@ -40,6 +40,7 @@
 #include <ripple/app/misc/TxQ.h>
 #include <ripple/app/misc/Validations.h>
 #include <ripple/app/misc/Transaction.h>
+#include <ripple/app/misc/impl/AccountTxCursors.h>
 #include <ripple/app/misc/impl/AccountTxPaging.h>
 #include <ripple/app/misc/UniqueNodeList.h>
 #include <ripple/app/tx/apply.h>
@@ -53,6 +54,7 @@
 #include <ripple/core/Config.h>
 #include <ripple/core/LoadFeeTrack.h>
 #include <ripple/core/TimeKeeper.h>
+#include <ripple/core/Trace.h>
 #include <ripple/crypto/RandomNumbers.h>
 #include <ripple/crypto/RFC1751.h>
 #include <ripple/json/to_string.h>
@@ -74,6 +76,7 @@
 #include <beast/utility/make_lock.h>
 #include <boost/optional.hpp>
 #include <condition_variable>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <tuple>
@@ -362,12 +365,16 @@ public:
         return m_localTX->size ();
     }
 
-    //Helper function to generate SQL query to get transactions.
-    std::string transactionsSQL (
-        std::string selection, AccountID const& account,
+    // Helper function to page by offset through an account's transactions.
+    void accountTxsAtOffset (
+        AccountID const& account,
         std::int32_t minLedger, std::int32_t maxLedger,
         bool descending, std::uint32_t offset, int limit,
-        bool binary, bool count, bool bUnlimited);
+        bool binary, bool bUnlimited,
+        std::function<void (std::uint32_t,
+                            std::string const&,
+                            Blob const&,
+                            Blob const&)> const& onTransaction);
 
     // Client information retrieval functions.
     using NetworkOPs::AccountTxs;
@@ -792,6 +799,7 @@ void NetworkOPsImp::submitTransaction (std::shared_ptr<STTx const> const& iTrans
 void NetworkOPsImp::processTransaction (std::shared_ptr<Transaction>& transaction,
         bool bUnlimited, bool bLocal, FailHard failType)
 {
+    RIPPLE_TRACE_TX ("processTransaction", transaction->getID ());
     auto ev = m_job_queue.getLoadEventAP (jtTXN_PROC, "ProcessTXN");
     auto const newFlags = app_.getHashRouter ().getFlags (transaction->getID ());
 
@@ -922,6 +930,7 @@ void NetworkOPsImp::apply (std::unique_lock<std::mutex>& batchLock)
             app_.openLedger().modify(
                 [&](OpenView& view, beast::Journal j)
             {
+                RIPPLE_TRACE_LEDGER ("applyBatch", view.info().seq);
                 bool changed = false;
                 for (TransactionStatus& e : transactions)
                 {
@@ -1688,88 +1697,48 @@ void NetworkOPsImp::setMode (OperatingMode om)
 }
 
 
-std::string
-NetworkOPsImp::transactionsSQL (
-    std::string selection, AccountID const& account,
+void
+NetworkOPsImp::accountTxsAtOffset (
+    AccountID const& account,
     std::int32_t minLedger, std::int32_t maxLedger, bool descending,
     std::uint32_t offset, int limit,
-    bool binary, bool count, bool bUnlimited)
+    bool binary, bool bUnlimited,
+    std::function<void (std::uint32_t,
+                        std::string const&,
+                        Blob const&,
+                        Blob const&)> const& onTransaction)
 {
     std::uint32_t NONBINARY_PAGE_LENGTH = 200;
     std::uint32_t BINARY_PAGE_LENGTH = 500;
+    std::uint32_t SEEK_STEP = 1000;
+
+    std::uint32_t const pageLength =
+        binary ? BINARY_PAGE_LENGTH : NONBINARY_PAGE_LENGTH;
 
     std::uint32_t numberOfResults;
 
-    if (count)
-    {
-        numberOfResults = 1000000000;
-    }
-    else if (limit < 0)
-    {
-        numberOfResults = binary ? BINARY_PAGE_LENGTH : NONBINARY_PAGE_LENGTH;
-    }
+    if (limit < 0)
+        numberOfResults = pageLength;
     else if (!bUnlimited)
-    {
         numberOfResults = std::min (
-            binary ? BINARY_PAGE_LENGTH : NONBINARY_PAGE_LENGTH,
-            static_cast<std::uint32_t> (limit));
-    }
+            pageLength, static_cast<std::uint32_t> (limit));
     else
-    {
         numberOfResults = limit;
-    }
-
-    std::string maxClause = "";
-    std::string minClause = "";
-
-    if (maxLedger != -1)
-    {
-        maxClause = boost::str (boost::format (
-            "AND AccountTransactions.LedgerSeq <= '%u'") % maxLedger);
-    }
 
-    if (minLedger != -1)
-    {
-        minClause = boost::str (boost::format (
-            "AND AccountTransactions.LedgerSeq >= '%u'") % minLedger);
-    }
+    if (numberOfResults == 0)
+        return;
 
-    std::string sql;
+    if (minLedger == -1)
+        minLedger = 0;
+    if (maxLedger == -1)
+        maxLedger = std::numeric_limits<std::int32_t>::max ();
 
-    if (count)
-        sql =
-            boost::str (boost::format (
-                "SELECT %s FROM AccountTransactions "
-                "WHERE Account = '%s' %s %s LIMIT %u, %u;")
-            % selection
-            % app_.accountIDCache().toBase58(account)
-            % maxClause
-            % minClause
-            % beast::lexicalCastThrow <std::string> (offset)
-            % beast::lexicalCastThrow <std::string> (numberOfResults)
-        );
-    else
-        sql =
-            boost::str (boost::format (
-                "SELECT %s FROM "
-                "AccountTransactions INNER JOIN Transactions "
-                "ON Transactions.TransID = AccountTransactions.TransID "
-                "WHERE Account = '%s' %s %s "
-                "ORDER BY AccountTransactions.LedgerSeq %s, "
-                "AccountTransactions.TxnSeq %s, AccountTransactions.TransID %s "
-                "LIMIT %u, %u;")
-                    % selection
-                    % app_.accountIDCache().toBase58(account)
-                    % maxClause
-                    % minClause
-                    % (descending ? "DESC" : "ASC")
-                    % (descending ? "DESC" : "ASC")
-                    % (descending ? "DESC" : "ASC")
-                    % beast::lexicalCastThrow <std::string> (offset)
-                    % beast::lexicalCastThrow <std::string> (numberOfResults)
-                   );
-    m_journal.trace << "txSQL query: " << sql;
-    return sql;
+    accountTxPageAtOffset (app_.getTxnDBShards (),
+        app_.getAccountTxCursors (), app_.accountIDCache (),
+            std::bind (saveLedgerAsync, std::ref (app_),
+                std::placeholders::_1), onTransaction, account,
+                    minLedger, maxLedger, descending, offset,
+                        numberOfResults, pageLength, SEEK_STEP);
 }
 
 NetworkOPs::AccountTxs NetworkOPsImp::getAccountTxs (
@@ -1780,79 +1749,20 @@ NetworkOPs::AccountTxs NetworkOPsImp::getAccountTxs (
     // can be called with no locks
     AccountTxs ret;
 
-    std::string sql = transactionsSQL (
-        "AccountTransactions.LedgerSeq,Status,RawTxn,TxnMeta", account,
-        minLedger, maxLedger, descending, offset, limit, false, false,
-        bUnlimited);
-
-    {
-        bool isMySQL = app_.getTxnDB ().getType () == DatabaseCon::Type::MySQL;
-        auto db = app_.getTxnDB ().checkoutDb ();
-
-        boost::optional<std::uint64_t> ledgerSeq;
-        boost::optional<std::string> status;
-        boost::optional<std::string> sociTxnStr, sociTxnMetaStr;
-        std::unique_ptr<soci::blob> sociTxnBlob (isMySQL ? nullptr : new soci::blob (*db)),
-            sociTxnMetaBlob (isMySQL ? nullptr : new soci::blob (*db));
-        soci::indicator rti, tmi;
-        Blob rawTxn, txnMeta;
-
-        soci::statement st =
-            isMySQL ?
-                (db->prepare << sql,
-                 soci::into(ledgerSeq),
-                 soci::into(status),
-                 soci::into(sociTxnStr, rti),
-                 soci::into(sociTxnMetaStr, tmi)):
-                (db->prepare << sql,
-                 soci::into(ledgerSeq),
-                 soci::into(status),
-                 soci::into(*sociTxnBlob, rti),
-                 soci::into(*sociTxnMetaBlob, tmi));
-
-        st.execute ();
-        while (st.fetch ())
-        {
-            if (soci::i_ok == rti)
-            {
-                if (isMySQL)
-                    rawTxn.assign (sociTxnStr->begin (), sociTxnStr->end ());
-                else
-                    convert (*sociTxnBlob, rawTxn);
-            }
-            else
-                rawTxn.clear ();
+    Application& app = app_;
 
-            if (soci::i_ok == tmi)
-            {
-                if (isMySQL)
-                    txnMeta.assign (sociTxnMetaStr->begin (), sociTxnMetaStr->end ());
-                else
-                    convert (*sociTxnMetaBlob, txnMeta);
-            }
-            else
-                txnMeta.clear ();
-
-            auto txn = Transaction::transactionFromSQL (
-                ledgerSeq, status, rawTxn, app_);
-
-            if (txnMeta.empty ())
-            { // Work around a bug that could leave the metadata missing
-                auto const seq = rangeCheckedCast<std::uint32_t>(
-                    ledgerSeq.value_or (0));
-                m_journal.warning << "Recovering ledger " << seq
-                                  << ", txn " << txn->getID();
-                Ledger::pointer ledger = m_ledgerMaster.getLedgerBySeq(seq);
-                if (ledger)
-                    pendSaveValidated(app_, ledger, false, false);
-            }
+    auto bound = [&ret, &app](
+        std::uint32_t ledger_index,
+        std::string const& status,
+        Blob const& rawTxn,
+        Blob const& rawMeta)
+    {
+        convertBlobsToTxResult (
+            ret, ledger_index, status, rawTxn, rawMeta, app);
+    };
 
-            if (txn)
-                ret.emplace_back (txn, std::make_shared<TxMeta> (
-                    txn->getID (), txn->getLedger (), txnMeta,
-                        app_.journal("TxMeta")));
-        }
-    }
+    accountTxsAtOffset (account, minLedger, maxLedger, descending,
+        offset, limit, false, bUnlimited, bound);
 
     return ret;
 }
@@ -1865,47 +1775,32 @@ std::vector<NetworkOPsImp::txnMetaLedgerType> NetworkOPsImp::getAccountTxsB (
     // can be called with no locks
     std::vector<txnMetaLedgerType> ret;
 
-    std::string sql = transactionsSQL (
-        "AccountTransactions.LedgerSeq,Status,RawTxn,TxnMeta", account,
-        minLedger, maxLedger, descending, offset, limit, true/*binary*/, false,
-        bUnlimited);
-
+    auto bound = [&ret](
+        std::uint32_t ledgerIndex,
+        std::string const& status,
+        Blob const& rawTxn,
+        Blob const& rawMeta)
     {
-        auto db = app_.getTxnDB ().checkoutDb ();
-
-        boost::optional<std::uint64_t> ledgerSeq;
-        boost::optional<std::string> status;
-        soci::blob sociTxnBlob (*db), sociTxnMetaBlob (*db);
-        soci::indicator rti, tmi;
-
-        soci::statement st =
-                (db->prepare << sql,
-                 soci::into(ledgerSeq),
-                 soci::into(status),
-                 soci::into(sociTxnBlob, rti),
-                 soci::into(sociTxnMetaBlob, tmi));
+        ret.emplace_back (strHex(rawTxn), strHex (rawMeta), ledgerIndex);
+    };
 
-        st.execute ();
-        while (st.fetch ())
-        {
-            Blob rawTxn;
-            if (soci::i_ok == rti)
-                convert (sociTxnBlob, rawTxn);
-            Blob txnMeta;
-            if (soci::i_ok == tmi)
-                convert (sociTxnMetaBlob, txnMeta);
-
-            auto const seq =
-                rangeCheckedCast<std::uint32_t>(ledgerSeq.value_or (0));
-
-            ret.emplace_back (
-                strHex (rawTxn), strHex (txnMeta), seq);
-        }
-    }
+    accountTxsAtOffset (account, minLedger, maxLedger, descending,
+        offset, limit, true/*binary*/, bUnlimited, bound);
 
     return ret;
 }
 
+// The type named by an account_tx tx_type filter, which the RPC layer
+// has already checked.
+static
+boost::optional<TxType>
+typeFilter (std::string const& txType)
+{
+    if (txType.empty ())
+        return boost::none;
+    return TxFormats::getInstance ().findTypeByName (txType);
+}
+
 NetworkOPsImp::AccountTxs
 NetworkOPsImp::getTxsAccount (
     AccountID const& account, std::int32_t minLedger,
@@ -1927,10 +1822,10 @@ NetworkOPsImp::getTxsAccount (
             ret, ledger_index, status, rawTxn, rawMeta, app);
     };
 
-    accountTxPage(app_.getTxnDB (), app_.accountIDCache(),
+    accountTxPage(app_.getTxnDBShards (), app_.accountIDCache(),
         std::bind(saveLedgerAsync, std::ref(app_),
-            std::placeholders::_1), bound, account, minLedger,
-                maxLedger, forward, token, limit, bUnlimited,
+            std::placeholders::_1), bound, account, typeFilter (txType),
+                minLedger, maxLedger, forward, token, limit, bUnlimited,
                     page_length);
 
     return ret;
@@ -1955,10 +1850,10 @@ NetworkOPsImp::getTxsAccountB (
         ret.emplace_back (strHex(rawTxn), strHex (rawMeta), ledgerIndex);
     };
 
-    accountTxPage(app_.getTxnDB (), app_.accountIDCache(),
+    accountTxPage(app_.getTxnDBShards (), app_.accountIDCache(),
         std::bind(saveLedgerAsync, std::ref(app_),
-            std::placeholders::_1), bound, account, minLedger,
-                maxLedger, forward, token, limit, bUnlimited,
+            std::placeholders::_1), bound, account, typeFilter (txType),
+                minLedger, maxLedger, forward, token, limit, bUnlimited,
                     page_length);
     return ret;
 }
@@ -23,6 +23,8 @@
 #include <ripple/app/ledger/LedgerMaster.h>
 #include <ripple/app/ledger/TransactionMaster.h>
 #include <ripple/app/main/Application.h>
+#include <ripple/app/misc/impl/AccountTxCursors.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
 #include <ripple/basics/contract.h>
 #include <ripple/core/ConfigSections.h>
 #include <boost/format.hpp>
@@ -273,7 +275,7 @@ SHAMapStoreImp::run()
     ledgerMaster_ = &app_.getLedgerMaster();
     fullBelowCache_ = &app_.family().fullbelow();
     treeNodeCache_ = &app_.family().treecache();
-    transactionDb_ = &app_.getTxnDB();
+    txnDBShards_ = &app_.getTxnDBShards();
     ledgerDb_ = &app_.getLedgerDB();
 
     if (setup_.advisoryDelete)
@@ -590,21 +592,37 @@ SHAMapStoreImp::clearPrior (LedgerIndex lastRotated)
     clearSql (*ledgerDb_, lastRotated,
         "SELECT MIN(LedgerSeq) FROM Ledgers;",
         "DELETE FROM Ledgers WHERE LedgerSeq < %u;");
-    return;
-    if (health())
-        return;
 
-    clearSql (*transactionDb_, lastRotated,
-        "SELECT MIN(LedgerSeq) FROM Transactions;",
-        "DELETE FROM Transactions WHERE LedgerSeq < %u;");
-    if (health())
-        return;
+    // Offset based account_tx pages resume from recorded cursors, which
+    // the deletes below shift.
+    auto& cursors = app_.getAccountTxCursors ();
+    cursors.onDeletePrior (lastRotated);
 
-    clearSql (*transactionDb_, lastRotated,
-        "SELECT MIN(LedgerSeq) FROM AccountTransactions;",
-        "DELETE FROM AccountTransactions WHERE LedgerSeq < %u;");
-    if (health())
-        return;
+    // Shards wholly before the delete point are removed outright, the
+    // rest are cleared like a single transaction database.
+    for (auto const& shard : txnDBShards_->dropPrior (lastRotated))
+    {
+        if (health())
+            break;
+
+        clearSql (shard->db(), lastRotated,
+            "SELECT MIN(LedgerSeq) FROM Transactions;",
+            "DELETE FROM Transactions WHERE LedgerSeq < %u;");
+        if (health())
+            break;
+
+        clearSql (shard->db(), lastRotated,
+            "SELECT MIN(LedgerSeq) FROM AccountTransactions;",
+            "DELETE FROM AccountTransactions WHERE LedgerSeq < %u;");
+        if (health())
+            break;
+
+        clearSql (shard->db(), lastRotated,
+            "SELECT MIN(LedgerSeq) FROM AccountTxs;",
+            "DELETE FROM AccountTxs WHERE LedgerSeq < %u;");
+    }
+
+    cursors.onDeletePrior (lastRotated);
 }
 
 SHAMapStoreImp::Health
@@ -33,6 +33,8 @@
 
 namespace ripple {
 
+class TxnDBShards;
+
 class SHAMapStoreImp : public SHAMapStore
 {
 private:
@@ -103,7 +105,7 @@ private:
     LedgerMaster* ledgerMaster_ = nullptr;
     FullBelowCache* fullBelowCache_ = nullptr;
     TreeNodeCache* treeNodeCache_ = nullptr;
-    DatabaseCon* transactionDb_ = nullptr;
+    TxnDBShards* txnDBShards_ = nullptr;
     DatabaseCon* ledgerDb_ = nullptr;
 
 public:
@@ -0,0 +1,188 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/app/misc/impl/AccountTxCursors.h>
+#include <ripple/protocol/digest.h>
+#include <beast/container/aged_container_utility.h>
+#include <algorithm>
+
+namespace ripple {
+
+// Bounds the memory used by a client walking a very long history.
+// The lowest offsets are the cheapest to recompute, so they go first.
+static std::size_t const maxCursorsPerRange = 4096;
+
+AccountTxCursors::AccountTxCursors (
+        Stopwatch& clock, std::chrono::seconds holdTime)
+    : ranges_ (clock)
+    , holdTime_ (holdTime)
+{
+}
+
+uint256
+AccountTxCursors::key (AccountID const& account,
+    std::uint32_t minLedger, std::uint32_t maxLedger, bool descending)
+{
+    return sha512Half (account, minLedger, maxLedger,
+        static_cast<std::uint8_t> (descending));
+}
+
+std::uint64_t
+AccountTxCursors::generation () const
+{
+    std::lock_guard <std::mutex> lock (mutex_);
+    return generation_;
+}
+
+boost::optional<std::pair<std::uint32_t, AccountTxCursors::Cursor>>
+AccountTxCursors::find (AccountID const& account,
+    std::uint32_t minLedger, std::uint32_t maxLedger, bool descending,
+    std::uint32_t offset)
+{
+    std::lock_guard <std::mutex> lock (mutex_);
+
+    auto iter = ranges_.find (key (account, minLedger, maxLedger, descending));
+    if (iter == ranges_.end ())
+        return boost::none;
+
+    ranges_.touch (iter);
+
+    auto const& cursors = iter->second.cursors;
+    auto it = cursors.upper_bound (offset);
+    if (it == cursors.begin ())
+        return boost::none;
+    --it;
+
+    return std::make_pair (it->first, it->second);
+}
+
+void
+AccountTxCursors::insert (AccountID const& account,
+    std::uint32_t minLedger, std::uint32_t maxLedger, bool descending,
+    std::uint32_t offset, Cursor const& cursor,
+    std::uint64_t generation)
+{
+    std::lock_guard <std::mutex> lock (mutex_);
+
+    if (generation != generation_)
+        return;
+
+    expire (ranges_, holdTime_);
+
+    auto const k = key (account, minLedger, maxLedger, descending);
+    auto iter = ranges_.find (k);
+    if (iter == ranges_.end ())
+        iter = ranges_.emplace (k,
+            Entry {account, minLedger, maxLedger, descending, {}}).first;
+    else
+        ranges_.touch (iter);
+
+    auto& cursors = iter->second.cursors;
+    cursors[offset] = cursor;
+    if (cursors.size () > maxCursorsPerRange)
+        cursors.erase (cursors.begin ());
+}
+
+void
+AccountTxCursors::onLedgerSaved (std::uint32_t seq,
+    hash_set<AccountID> const& accounts)
+{
+    std::lock_guard <std::mutex> lock (mutex_);
+
+    ++generation_;
+
+    // A cursor depends only on the rows before it in the walk, so a save
+    // affects the cursors at or past its ledger. Offsets grow with the
+    // walk, which makes those the tail of the map. The walks of other
+    // accounts, or of ranges without the ledger, are unchanged.
+    for (auto iter = ranges_.begin (); iter != ranges_.end ();)
+    {
+        auto& entry = iter->second;
+        if (seq < entry.minLedger || seq > entry.maxLedger ||
+            accounts.count (entry.account) == 0)
+        {
+            ++iter;
+            continue;
+        }
+
+        bool const descending = entry.descending;
+        auto& cursors = entry.cursors;
+        cursors.erase (std::find_if (cursors.begin (), cursors.end (),
+            [seq, descending](auto const& c)
+            {
+                return descending ?
+                    c.second.ledger <= seq : c.second.ledger >= seq;
+            }), cursors.end ());
+
+        if (cursors.empty ())
+            iter = ranges_.erase (iter);
+        else
+            ++iter;
+    }
+}
+
+void
+AccountTxCursors::onDeletePrior (std::uint32_t seq)
+{
+    std::lock_guard <std::mutex> lock (mutex_);
+
+    ++generation_;
+
+    // Deleted rows come first in an ascending walk, so every offset in it
+    // moves. A descending walk reaches them last, which only affects the
+    // cursors on or past them, the tail of the map.
+    for (auto iter = ranges_.begin (); iter != ranges_.end ();)
+    {
+        auto& entry = iter->second;
+        if (seq <= entry.minLedger)
+        {
+            ++iter;
+            continue;
+        }
+
+        auto& cursors = entry.cursors;
+        if (entry.descending)
+        {
+            cursors.erase (std::find_if (cursors.begin (), cursors.end (),
+                [seq](auto const& c)
+                {
+                    return c.second.ledger < seq;
+                }), cursors.end ());
+        }
+        else
+        {
+            cursors.clear ();
+        }
+
+        if (cursors.empty ())
+            iter = ranges_.erase (iter);
+        else
+            ++iter;
+    }
+}
+
+std::size_t
+AccountTxCursors::size () const
+{
+    std::lock_guard <std::mutex> lock (mutex_);
+    return ranges_.size ();
+}
+
+}
@@ -0,0 +1,133 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_APP_MISC_IMPL_ACCOUNTTXCURSORS_H_INCLUDED
+#define RIPPLE_APP_MISC_IMPL_ACCOUNTTXCURSORS_H_INCLUDED
+
+#include <ripple/basics/base_uint.h>
+#include <ripple/basics/chrono.h>
+#include <ripple/basics/UnorderedContainers.h>
+#include <ripple/protocol/AccountID.h>
+#include <beast/container/aged_unordered_map.h>
+#include <boost/optional.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace ripple {
+
+/** Remembers where offset based account_tx pages start.
+
+    The deprecated account_tx API addresses rows by offset. Every page
+    served records the (LedgerSeq, TxnSeq) key of the row which follows it,
+    so a later request for a deep offset resumes a keyset walk from the
+    nearest recorded key instead of making the database count every
+    earlier row again.
+
+    Cursors are kept per account, ledger range and direction. Saving a
+    ledger, or deleting old ledgers, drops the cursors whose offsets it
+    may have shifted, and a cursor computed while such a change was in
+    flight is never recorded.
+*/
+class AccountTxCursors
+{
+public:
+    struct Cursor
+    {
+        std::uint32_t ledger;
+        std::uint32_t seq;
+    };
+
+    AccountTxCursors (Stopwatch& clock, std::chrono::seconds holdTime);
+
+    AccountTxCursors (AccountTxCursors const&) = delete;
+    AccountTxCursors& operator= (AccountTxCursors const&) = delete;
+
+    /** A token to pass to insert, taken before reading the database. */
+    std::uint64_t
+    generation () const;
+
+    /** Find the cursor with the largest offset not after `offset`.
+
+        @return The offset of the cursor and the cursor, if any.
+    */
+    boost::optional<std::pair<std::uint32_t, Cursor>>
+    find (AccountID const& account,
+        std::uint32_t minLedger, std::uint32_t maxLedger, bool descending,
+        std::uint32_t offset);
+
+    /** Record the key of the row at `offset`.
+
+        Nothing is recorded if a ledger was saved since `generation`
+        was obtained.
+    */
+    void
+    insert (AccountID const& account,
+        std::uint32_t minLedger, std::uint32_t maxLedger, bool descending,
+        std::uint32_t offset, Cursor const& cursor,
+        std::uint64_t generation);
+
+    /** Forget the cursors which rows of ledger `seq` may have shifted.
+
+        Called after the ledger's transactions have been written. Only
+        the walks of `accounts`, the accounts the ledger's transactions
+        affected, gained rows.
+    */
+    void
+    onLedgerSaved (std::uint32_t seq, hash_set<AccountID> const& accounts);
+
+    /** Forget the cursors which deleting ledgers before `seq` may shift.
+
+        Online delete calls this before it removes any rows, so cursors
+        computed while it runs are not recorded, and again once it is
+        done, to drop those computed in between.
+    */
+    void
+    onDeletePrior (std::uint32_t seq);
+
+    std::size_t
+    size () const;
+
+private:
+    struct Entry
+    {
+        AccountID account;
+        std::uint32_t minLedger;
+        std::uint32_t maxLedger;
+        bool descending;
+        std::map<std::uint32_t, Cursor> cursors;
+    };
+
+    static
+    uint256
+    key (AccountID const& account,
+        std::uint32_t minLedger, std::uint32_t maxLedger, bool descending);
+
+    std::mutex mutable mutex_;
+    std::uint64_t generation_ = 0;
+    beast::aged_unordered_map<uint256, Entry, Stopwatch::clock_type,
+        hardened_hash<strong_hash>> ranges_;
+    std::chrono::seconds const holdTime_;
+};
+
+}
+
+#endif
@@ -26,6 +26,9 @@
 #include <ripple/protocol/Serializer.h>
 #include <ripple/protocol/types.h>
 #include <boost/format.hpp>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <memory>
 
 namespace ripple {
@@ -62,9 +65,128 @@ saveLedgerAsync (Application& app, std::uint32_t seq)
         pendSaveValidated(app, ledger, false, false);
 }
 
+// The WHERE conditions following the account, and the ordering, of a
+// page which starts at the marker (findLedger, findSeq) if there is one.
+// Filtering by type on the legacy index needs Transactions joined in.
+static
+std::string
+accountTxRange (
+    AccountTxIndex index,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    std::uint32_t findLedger,
+    std::uint32_t findSeq)
+{
+    char const* const t = (index == AccountTxIndex::binary) ?
+        "" : "AccountTransactions.";
+
+    std::string sql;
+
+    // The binary index has TransType right after the account, so a type
+    // filter is an equality on the index prefix rather than a scan.
+    if (txType && index == AccountTxIndex::binary)
+    {
+        sql = boost::str (boost::format ("TransType = %d AND ")
+            % static_cast<int> (*txType));
+    }
+    else if (txType)
+    {
+        sql = boost::str (boost::format ("Transactions.TransType = '%s' AND ")
+            % TxFormats::getInstance ().findByType (*txType)->getName ());
+    }
+
+    // SQL's BETWEEN uses a closed interval ([a,b]). Resuming from a marker
+    // is written as one range on LedgerSeq so the index can seek to it.
+
+    if (findLedger == 0)
+    {
+        sql += boost::str (boost::format (
+            R"(%1%LedgerSeq BETWEEN '%2%' AND '%3%')")
+            % t
+            % minLedger
+            % maxLedger);
+    }
+    else if (forward)
+    {
+        sql += boost::str (boost::format (
+            R"(%1%LedgerSeq BETWEEN '%2%' AND '%3%' AND
+            (%1%LedgerSeq > '%2%' OR %1%TxnSeq >= '%4%'))")
+            % t
+            % findLedger
+            % maxLedger
+            % findSeq);
+    }
+    else
+    {
+        sql += boost::str (boost::format (
+            R"(%1%LedgerSeq BETWEEN '%2%' AND '%3%' AND
+            (%1%LedgerSeq < '%3%' OR %1%TxnSeq <= '%4%'))")
+            % t
+            % minLedger
+            % findLedger
+            % findSeq);
+    }
+
+    sql += boost::str (boost::format (
+        R"(
+        ORDER BY %1%LedgerSeq %2%, %1%TxnSeq %2%)")
+        % t
+        % (forward ? "ASC" : "DESC"));
+
+    return sql;
+}
+
+// A query on the account index alone, selecting `columns` from the rows
+// of a page which starts at the marker (findLedger, findSeq).
+static
+std::string
+accountTxKeys (
+    AccountTxIndex index,
+    AccountIDCache const& idCache,
+    AccountID const& account,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    std::uint32_t findLedger,
+    std::uint32_t findSeq,
+    char const* columns)
+{
+    std::string sql;
+
+    if (index == AccountTxIndex::binary)
+    {
+        sql = boost::str (boost::format (
+            R"(SELECT %s FROM AccountTxs
+              WHERE AccountID = %s AND
+              )") % columns % sqlAccountID (account));
+    }
+    else if (txType)
+    {
+        sql = boost::str (boost::format (
+            R"(SELECT %s FROM AccountTransactions INNER JOIN Transactions
+              ON Transactions.TransID = AccountTransactions.TransID
+              WHERE AccountTransactions.Account = '%s' AND
+              )") % columns % idCache.toBase58 (account));
+    }
+    else
+    {
+        sql = boost::str (boost::format (
+            R"(SELECT %s FROM AccountTransactions
+              WHERE AccountTransactions.Account = '%s' AND
+              )") % columns % idCache.toBase58 (account));
+    }
+
+    return sql + accountTxRange (index, txType, minLedger, maxLedger,
+        forward, findLedger, findSeq);
+}
+
 void
 accountTxPage (
     DatabaseCon& connection,
+    AccountTxIndex index,
     AccountIDCache const& idCache,
     std::function<void (std::uint32_t)> const& onUnsavedLedger,
     std::function<void (std::uint32_t,
@@ -72,6 +194,7 @@ accountTxPage (
                         Blob const&,
                         Blob const&)> const& onTransaction,
     AccountID const& account,
+    boost::optional<TxType> const& txType,
     std::int32_t minLedger,
     std::int32_t maxLedger,
     bool forward,
@@ -116,86 +239,29 @@ accountTxPage (
     // we need to clear it in between.
     token = Json::nullValue;
 
-    static std::string const prefix (
+    bool const binary = index == AccountTxIndex::binary;
+
+    // The binary index covers (AccountID, LedgerSeq, TxnSeq) and each row
+    // carries its own copy of the transaction, so no join is needed.
+    static std::string const legacyPrefix (
         R"(SELECT AccountTransactions.LedgerSeq,AccountTransactions.TxnSeq,
           Status,RawTxn,TxnMeta
           FROM AccountTransactions INNER JOIN Transactions
           ON Transactions.TransID = AccountTransactions.TransID
           AND AccountTransactions.Account = '%s' WHERE
           )");
+    static std::string const binaryPrefix (
+        R"(SELECT LedgerSeq,TxnSeq,Status,RawTxn,TxnMeta
+          FROM AccountTxs WHERE AccountID = %s AND
+          )");
 
-    std::string sql;
+    std::string sql = boost::str (boost::format (
+        binary ? binaryPrefix : legacyPrefix)
+            % (binary ? sqlAccountID (account) : idCache.toBase58 (account)));
 
-    // SQL's BETWEEN uses a closed interval ([a,b])
-
-    if (forward && (findLedger == 0))
-    {
-        sql = boost::str (boost::format(
-            prefix +
-            (R"(AccountTransactions.LedgerSeq BETWEEN '%u' AND '%u'
-             ORDER BY AccountTransactions.LedgerSeq ASC,
-             AccountTransactions.TxnSeq ASC
-             LIMIT %u;)"))
-            % idCache.toBase58(account)
-            % minLedger
-            % maxLedger
-            % queryLimit);
-    }
-    else if (forward && (findLedger != 0))
-    {
-        sql = boost::str (boost::format(
-            prefix +
-            (R"(
-            AccountTransactions.LedgerSeq BETWEEN '%u' AND '%u' OR
-            ( AccountTransactions.LedgerSeq = '%u' AND
-              AccountTransactions.TxnSeq >= '%u' )
-            ORDER BY AccountTransactions.LedgerSeq ASC,
-            AccountTransactions.TxnSeq ASC
-            LIMIT %u;
-            )"))
-        % idCache.toBase58(account)
-        % (findLedger + 1)
-        % maxLedger
-        % findLedger
-        % findSeq
-        % queryLimit);
-    }
-    else if (!forward && (findLedger == 0))
-    {
-        sql = boost::str (boost::format(
-            prefix +
-            (R"(AccountTransactions.LedgerSeq BETWEEN '%u' AND '%u'
-             ORDER BY AccountTransactions.LedgerSeq DESC,
-             AccountTransactions.TxnSeq DESC
-             LIMIT %u;)"))
-            % idCache.toBase58(account)
-            % minLedger
-            % maxLedger
-            % queryLimit);
-    }
-    else if (!forward && (findLedger != 0))
-    {
-        sql = boost::str (boost::format(
-            prefix +
-            (R"(AccountTransactions.LedgerSeq BETWEEN '%u' AND '%u' OR
-             (AccountTransactions.LedgerSeq = '%u' AND
-              AccountTransactions.TxnSeq <= '%u')
-             ORDER BY AccountTransactions.LedgerSeq DESC,
-             AccountTransactions.TxnSeq DESC
-             LIMIT %u;)"))
-            % idCache.toBase58(account)
-            % minLedger
-            % (findLedger - 1)
-            % findLedger
-            % findSeq
-            % queryLimit);
-    }
-    else
-    {
-        assert (false);
-        // sql is empty
-        return;
-    }
+    sql += accountTxRange (index, txType, minLedger, maxLedger, forward,
+        findLedger, findSeq);
+    sql += boost::str (boost::format ("\n        LIMIT %u;") % queryLimit);
 
     {
         bool isMySQL = connection.getType () == DatabaseCon::Type::MySQL;
@@ -283,4 +349,322 @@ accountTxPage (
     return;
 }
 
+bool
+accountTxSeek (
+    DatabaseCon& connection,
+    AccountTxIndex index,
+    AccountIDCache const& idCache,
+    AccountID const& account,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    Json::Value& token,
+    std::uint32_t skip)
+{
+    std::uint32_t findLedger = 0, findSeq = 0;
+
+    if (token.isObject ())
+    {
+        if (!token.isMember(jss::ledger) || !token.isMember(jss::seq))
+            return false;
+        findLedger = token[jss::ledger].asUInt();
+        findSeq = token[jss::seq].asUInt();
+    }
+
+    token = Json::nullValue;
+
+    // Only the keys are selected, which the account index covers, so the
+    // rows skipped over are never read.
+    std::string sql = accountTxKeys (index, idCache, account, txType,
+        minLedger, maxLedger, forward, findLedger, findSeq,
+            (index == AccountTxIndex::binary) ? "LedgerSeq,TxnSeq" :
+                "AccountTransactions.LedgerSeq,AccountTransactions.TxnSeq");
+    sql += boost::str (boost::format (
+        "\n        LIMIT 1 OFFSET %u;") % skip);
+
+    boost::optional<std::uint64_t> ledgerSeq;
+    boost::optional<std::uint32_t> txnSeq;
+    {
+        auto db = connection.checkoutDb ();
+        *db << sql, soci::into (ledgerSeq), soci::into (txnSeq);
+    }
+
+    if (! ledgerSeq)
+        return false;
+
+    token = Json::objectValue;
+    token[jss::ledger] = rangeCheckedCast<std::uint32_t>(*ledgerSeq);
+    token[jss::seq] = txnSeq.value_or (0);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// The ledger a marker points at, zero if there is none.
+static
+std::uint32_t
+markerLedger (Json::Value const& token)
+{
+    try
+    {
+        if (token.isObject () && token.isMember (jss::ledger))
+            return token[jss::ledger].asUInt ();
+    }
+    catch (std::exception const&)
+    {
+    }
+    return 0;
+}
+
+// The range of ledgers a walk from the marker in `token` can reach.
+static
+std::pair<std::uint32_t, std::uint32_t>
+walkRange (
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    Json::Value const& token)
+{
+    std::uint32_t low = std::max (minLedger, 0);
+    std::uint32_t high = std::max (maxLedger, 0);
+
+    if (auto const marker = markerLedger (token))
+    {
+        if (forward)
+            low = std::max (low, marker);
+        else
+            high = std::min (high, marker);
+    }
+
+    return {low, high};
+}
+
+static
+std::chrono::microseconds
+elapsedSince (std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds> (
+        std::chrono::steady_clock::now () - start);
+}
+
+void
+accountTxPage (
+    TxnDBShards& shards,
+    AccountIDCache const& idCache,
+    std::function<void (std::uint32_t)> const& onUnsavedLedger,
+    std::function<void (std::uint32_t,
+                        std::string const&,
+                        Blob const&,
+                        Blob const&)> const& onTransaction,
+    AccountID const& account,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    Json::Value& token,
+    int limit,
+    bool bAdmin,
+    std::uint32_t page_length)
+{
+    std::uint32_t numberOfResults;
+
+    if (limit <= 0 || (limit > page_length && !bAdmin))
+        numberOfResults = page_length;
+    else
+        numberOfResults = limit;
+
+    auto const range = walkRange (minLedger, maxLedger, forward, token);
+
+    std::uint32_t found = 0;
+    auto counted = [&](
+        std::uint32_t ledgerIndex,
+        std::string const& status,
+        Blob const& rawTxn,
+        Blob const& rawMeta)
+    {
+        ++found;
+        onTransaction (ledgerIndex, status, rawTxn, rawMeta);
+    };
+
+    for (auto const& shard : shards.select (
+        range.first, range.second, forward))
+    {
+        auto const start = std::chrono::steady_clock::now ();
+
+        if (numberOfResults == 0)
+        {
+            // The page ended exactly where the previous shard did, so
+            // the marker is the first row of a later shard, if any.
+            bool const more = accountTxSeek (shard->db (),
+                shard->schema ().index (), idCache, account, txType,
+                    minLedger, maxLedger, forward, token, 0);
+            shard->onRead (elapsedSince (start));
+            if (more)
+                return;
+            continue;
+        }
+
+        found = 0;
+        accountTxPage (shard->db (), shard->schema ().index (), idCache,
+            onUnsavedLedger, counted, account, txType, minLedger,
+                maxLedger, forward, token, numberOfResults, true,
+                    page_length);
+        shard->onRead (elapsedSince (start));
+
+        // A marker means this shard had more rows than the page holds
+        if (! token.isNull ())
+            return;
+
+        numberOfResults -= std::min (found, numberOfResults);
+    }
+}
+
+// The number of rows in a page which starts at the marker in `token`.
+static
+std::uint64_t
+accountTxCount (
+    DatabaseCon& connection,
+    AccountTxIndex index,
+    AccountIDCache const& idCache,
+    AccountID const& account,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    Json::Value const& token)
+{
+    std::uint32_t findLedger = 0, findSeq = 0;
+
+    if (token.isObject ())
+    {
+        findLedger = token[jss::ledger].asUInt();
+        findSeq = token[jss::seq].asUInt();
+    }
+
+    std::string sql = accountTxKeys (index, idCache, account, txType,
+        minLedger, maxLedger, forward, findLedger, findSeq, "COUNT(*)");
+    sql += ";";
+
+    boost::optional<std::uint64_t> count;
+    {
+        auto db = connection.checkoutDb ();
+        *db << sql, soci::into (count);
+    }
+
+    return count.value_or (0);
+}
+
+bool
+accountTxSeek (
+    TxnDBShards& shards,
+    AccountIDCache const& idCache,
+    AccountID const& account,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    Json::Value& token,
+    std::uint32_t skip)
+{
+    auto const range = walkRange (minLedger, maxLedger, forward, token);
+    auto const selected = shards.select (range.first, range.second, forward);
+
+    for (std::size_t i = 0; i < selected.size (); ++i)
+    {
+        auto const& shard = selected[i];
+        auto const start = std::chrono::steady_clock::now ();
+
+        Json::Value from = token;
+        if (accountTxSeek (shard->db (), shard->schema ().index (),
+            idCache, account, txType, minLedger, maxLedger, forward,
+                token, skip))
+        {
+            shard->onRead (elapsedSince (start));
+            return true;
+        }
+
+        // Too few rows here: skip all of them and go on to the next shard
+        if (i + 1 < selected.size ())
+        {
+            auto const count = accountTxCount (shard->db (),
+                shard->schema ().index (), idCache, account, txType,
+                    minLedger, maxLedger, forward, from);
+            skip -= std::min<std::uint64_t> (count, skip);
+        }
+
+        shard->onRead (elapsedSince (start));
+    }
+
+    return false;
+}
+
+void
+accountTxPageAtOffset (
+    TxnDBShards& shards,
+    AccountTxCursors& cursors,
+    AccountIDCache const& idCache,
+    std::function<void (std::uint32_t)> const& onUnsavedLedger,
+    std::function<void (std::uint32_t,
+                        std::string const&,
+                        Blob const&,
+                        Blob const&)> const& onTransaction,
+    AccountID const& account,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool descending,
+    std::uint32_t offset,
+    std::uint32_t limit,
+    std::uint32_t pageLength,
+    std::uint32_t seekStep)
+{
+    assert (seekStep > 0);
+
+    auto const generation = cursors.generation ();
+    bool const forward = !descending;
+
+    Json::Value token;
+
+    if (offset != 0)
+    {
+        std::uint32_t found = 0;
+
+        if (auto const cursor = cursors.find (
+            account, minLedger, maxLedger, descending, offset))
+        {
+            found = cursor->first;
+            token = Json::objectValue;
+            token[jss::ledger] = cursor->second.ledger;
+            token[jss::seq] = cursor->second.seq;
+        }
+
+        // No query skips more than seekStep rows, and each step leaves a
+        // cursor, so a deeper request later starts from the last one.
+        while (found != offset)
+        {
+            auto const step = std::min (offset - found, seekStep);
+            if (! accountTxSeek (shards, idCache, account, boost::none,
+                    minLedger, maxLedger, forward, token, step))
+                return;
+            found += step;
+
+            cursors.insert (account, minLedger, maxLedger, descending,
+                found, {token[jss::ledger].asUInt (),
+                    token[jss::seq].asUInt ()}, generation);
+        }
+    }
+
+    accountTxPage (shards, idCache, onUnsavedLedger, onTransaction, account,
+        boost::none, minLedger, maxLedger, forward, token, limit, true,
+            pageLength);
+
+    // accountTxPage leaves a marker for the row after the page
+    if (token.isObject ())
+    {
+        cursors.insert (account, minLedger, maxLedger, descending,
+            offset + limit, {token[jss::ledger].asUInt (),
+                token[jss::seq].asUInt ()}, generation);
+    }
+}
+
 }
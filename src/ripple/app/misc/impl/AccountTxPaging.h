@@ -21,7 +21,12 @@
 #define RIPPLE_APP_MISC_IMPL_ACCOUNTTXPAGING_H_INCLUDED
 
 #include <ripple/core/DatabaseCon.h>
+#include <ripple/protocol/TxFormats.h>
 #include <ripple/app/misc/NetworkOPs.h>
+#include <ripple/app/misc/impl/AccountTxCursors.h>
+#include <ripple/app/misc/impl/AccountTxSchema.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
+#include <boost/optional.hpp>
 #include <cstdint>
 #include <string>
 #include <utility>
@@ -46,6 +51,7 @@ saveLedgerAsync (Application& app, std::uint32_t seq);
 void
 accountTxPage (
     DatabaseCon& database,
+    AccountTxIndex index,
     AccountIDCache const& idCache,
     std::function<void (std::uint32_t)> const& onUnsavedLedger,
     std::function<void (std::uint32_t,
@@ -53,6 +59,7 @@ accountTxPage (
                         Blob const&,
                         Blob const&)> const&,
     AccountID const& account,
+    boost::optional<TxType> const& txType,
     std::int32_t minLedger,
     std::int32_t maxLedger,
     bool forward,
@@ -61,6 +68,92 @@ accountTxPage (
     bool bAdmin,
     std::uint32_t pageLength);
 
+/** Find the key of the row `skip` rows into a page.
+
+    The page starts at the marker in `token`, or at the start of the
+    range if there is none, and only the account index is read. On
+    success `token` is set to a marker for the row found. If `txType`
+    is set only transactions of that type are counted.
+
+    @return `false` if the range has no such row.
+*/
+bool
+accountTxSeek (
+    DatabaseCon& database,
+    AccountTxIndex index,
+    AccountIDCache const& idCache,
+    AccountID const& account,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    Json::Value& token,
+    std::uint32_t skip);
+
+/** Page through an account's transactions in every shard.
+
+    Shards are read in the order of the walk, and no shard after the one
+    which fills the page is queried.
+*/
+void
+accountTxPage (
+    TxnDBShards& shards,
+    AccountIDCache const& idCache,
+    std::function<void (std::uint32_t)> const& onUnsavedLedger,
+    std::function<void (std::uint32_t,
+                        std::string const&,
+                        Blob const&,
+                        Blob const&)> const&,
+    AccountID const& account,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    Json::Value& token,
+    int limit,
+    bool bAdmin,
+    std::uint32_t pageLength);
+
+/** Page through an account's transactions from the row at `offset`.
+
+    The offset is turned into a keyset walk. The page starts at the key
+    `cursors` recorded for the nearest earlier offset, and only the rows
+    between that key and `offset` are counted, using the index, at most
+    `seekStep` at a time. The key reached by each step, and that of the
+    row after the page, are recorded.
+*/
+void
+accountTxPageAtOffset (
+    TxnDBShards& shards,
+    AccountTxCursors& cursors,
+    AccountIDCache const& idCache,
+    std::function<void (std::uint32_t)> const& onUnsavedLedger,
+    std::function<void (std::uint32_t,
+                        std::string const&,
+                        Blob const&,
+                        Blob const&)> const&,
+    AccountID const& account,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool descending,
+    std::uint32_t offset,
+    std::uint32_t limit,
+    std::uint32_t pageLength,
+    std::uint32_t seekStep);
+
+/** Find the key of the row `skip` rows into a page, in every shard. */
+bool
+accountTxSeek (
+    TxnDBShards& shards,
+    AccountIDCache const& idCache,
+    AccountID const& account,
+    boost::optional<TxType> const& txType,
+    std::int32_t minLedger,
+    std::int32_t maxLedger,
+    bool forward,
+    Json::Value& token,
+    std::uint32_t skip);
+
 }
 
 #endif
@@ -0,0 +1,254 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/app/misc/impl/AccountTxSchema.h>
+#include <ripple/basics/Log.h>
+#include <ripple/basics/StringUtilities.h>
+#include <ripple/core/SociDB.h>
+#include <ripple/protocol/TxFormats.h>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+namespace ripple {
+
+AccountTxSchema::AccountTxSchema (DatabaseCon& db, beast::Journal journal)
+    : db_ (db)
+    , journal_ (journal)
+    , index_ (AccountTxIndex::legacy)
+{
+}
+
+void
+AccountTxSchema::setVersion (soci::session& session,
+    AccountTxIndex index, std::uint64_t progress)
+{
+    static boost::format updateVersion (
+        "UPDATE SchemaVersion SET Version = %d, Progress = %u "
+        "WHERE Name = 'AccountTxs';");
+
+    session << boost::str (boost::format (updateVersion)
+        % static_cast<int> (index) % progress);
+    index_ = index;
+}
+
+// An SQL expression turning the type name stored in Transactions.TransType
+// into the TxType value AccountTxs stores, for rows migrated from the
+// legacy index.
+static
+std::string const&
+sqlTxTypeFromName ()
+{
+    static std::string const sql = []
+    {
+        std::string ret = "CASE Transactions.TransType";
+        for (int type = 0;
+            type <= std::numeric_limits<std::uint16_t>::max (); ++type)
+        {
+            if (auto const item = TxFormats::getInstance ().findByType (
+                    static_cast<TxType> (type)))
+            {
+                ret += " WHEN '" + item->getName () + "' THEN " +
+                    std::to_string (type);
+            }
+        }
+        return ret + " END";
+    }();
+    return sql;
+}
+
+void
+AccountTxSchema::setup ()
+{
+    if (db_.getType () == DatabaseCon::Type::None)
+    {
+        index_ = AccountTxIndex::binary;
+        return;
+    }
+
+    auto db = db_.checkoutDb ();
+
+    boost::optional<int> version;
+    *db << "SELECT Version FROM SchemaVersion WHERE Name = 'AccountTxs';",
+        soci::into (version);
+
+    if (! version)
+    {
+        // First start since AccountTxs was introduced. An empty legacy
+        // table means there is nothing to carry over.
+        boost::optional<std::uint64_t> maxSeq;
+        *db << "SELECT MAX(LedgerSeq) FROM AccountTransactions;",
+            soci::into (maxSeq);
+
+        auto const index = maxSeq ?
+            AccountTxIndex::legacy : AccountTxIndex::binary;
+
+        *db << boost::str (boost::format (
+            "INSERT INTO SchemaVersion (Name, Version, Progress) "
+            "VALUES ('AccountTxs', %d, %u);")
+                % static_cast<int> (index)
+                % (maxSeq ? *maxSeq + 1 : 0));
+
+        version = static_cast<int> (index);
+    }
+
+    if (*version >= static_cast<int> (AccountTxIndex::binary))
+    {
+        index_ = AccountTxIndex::binary;
+        return;
+    }
+
+    JLOG (journal_.warning) <<
+        "Account transactions will be migrated to AccountTxs";
+    index_ = AccountTxIndex::legacy;
+}
+
+bool
+AccountTxSchema::migrate (std::uint32_t ledgers)
+{
+    if (index () != AccountTxIndex::legacy)
+        return true;
+
+    auto db = db_.checkoutDb ();
+
+    std::uint64_t progress = 0;
+    {
+        boost::optional<std::uint64_t> p;
+        *db << "SELECT Progress FROM SchemaVersion WHERE Name = 'AccountTxs';",
+            soci::into (p);
+        progress = p.value_or (0);
+    }
+
+    std::uint64_t const first =
+        (progress > ledgers) ? (progress - ledgers) : 0;
+
+    // TransID, Account, LedgerSeq, TxnSeq
+    std::vector<std::tuple<std::string, std::string,
+        std::uint64_t, std::int64_t>> rows;
+    {
+        boost::optional<std::string> transID;
+        boost::optional<std::string> account;
+        boost::optional<std::uint64_t> ledgerSeq;
+        boost::optional<std::int64_t> txnSeq;
+
+        soci::statement st = (db->prepare << boost::str (boost::format (
+            "SELECT TransID, Account, LedgerSeq, TxnSeq "
+            "FROM AccountTransactions "
+            "WHERE LedgerSeq >= %u AND LedgerSeq < %u;") % first % progress),
+            soci::into (transID),
+            soci::into (account),
+            soci::into (ledgerSeq),
+            soci::into (txnSeq));
+
+        st.execute ();
+        while (st.fetch ())
+        {
+            rows.emplace_back (transID.value_or (""), account.value_or (""),
+                ledgerSeq.value_or (0), txnSeq.value_or (-1));
+        }
+    }
+
+    // The blobs are copied by the database itself, only the account
+    // has to be converted.
+    static boost::format copyRow (
+        "%s INTO AccountTxs (AccountID, LedgerSeq, TxnSeq, TransID, "
+        "Status, RawTxn, TxnMeta, TransType) "
+        "SELECT %s, %u, %d, TransID, Status, RawTxn, TxnMeta, %s "
+        "FROM Transactions WHERE TransID = '%s';");
+
+    // Rows written by saveValidatedLedger are at least as new as ours.
+    char const* const insertIgnore =
+        db_.getType () == DatabaseCon::Type::MySQL ?
+            "INSERT IGNORE" : "INSERT OR IGNORE";
+
+    soci::transaction tr (*db);
+
+    for (auto const& row : rows)
+    {
+        auto const account = parseBase58<AccountID> (std::get<1> (row));
+        if (! account)
+        {
+            JLOG (journal_.warning) << "Skipping unparseable account " <<
+                std::get<1> (row) << " of " << std::get<0> (row);
+            continue;
+        }
+
+        *db << boost::str (boost::format (copyRow)
+            % insertIgnore
+            % sqlAccountID (*account)
+            % std::get<2> (row)
+            % std::get<3> (row)
+            % sqlTxTypeFromName ()
+            % std::get<0> (row));
+    }
+
+    // Skip over any gap in the history so sparse databases finish quickly.
+    boost::optional<std::uint64_t> next;
+    *db << boost::str (boost::format (
+        "SELECT MAX(LedgerSeq) FROM AccountTransactions "
+        "WHERE LedgerSeq < %u;") % first), soci::into (next);
+
+    if (next)
+    {
+        setVersion (*db, AccountTxIndex::legacy, *next + 1);
+        tr.commit ();
+
+        JLOG (journal_.debug) << "Migrated " << rows.size () <<
+            " account transactions down to ledger " << first;
+        return false;
+    }
+
+    // Readers switch over with this commit, so nothing reads the legacy
+    // rows afterwards. A ledger saved while the switch happens may still
+    // leave a few behind; they are never read either.
+    *db << "DELETE FROM AccountTransactions;";
+    setVersion (*db, AccountTxIndex::binary, 0);
+    tr.commit ();
+
+    JLOG (journal_.warning) << "Account transaction migration complete";
+    return true;
+}
+
+std::string
+sqlAccountID (AccountID const& account)
+{
+    return "X'" + strHex (account.data (), account.size ()) + "'";
+}
+
+std::string const&
+accountTxsInsertReplaceHeader (DatabaseCon::Type dbType)
+{
+    if (dbType == DatabaseCon::Type::MySQL)
+    {
+        static std::string const sqlMySQL = "REPLACE INTO AccountTxs "
+            "(AccountID, LedgerSeq, TxnSeq, TransID, Status, RawTxn, TxnMeta,"
+            " TransType) VALUES ";
+        return sqlMySQL;
+    }
+
+    static std::string const sql = "INSERT OR REPLACE INTO AccountTxs "
+        "(AccountID, LedgerSeq, TxnSeq, TransID, Status, RawTxn, TxnMeta,"
+        " TransType) VALUES ";
+    return sql;
+}
+
+}
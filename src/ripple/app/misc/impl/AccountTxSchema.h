@@ -0,0 +1,111 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_APP_MISC_IMPL_ACCOUNTTXSCHEMA_H_INCLUDED
+#define RIPPLE_APP_MISC_IMPL_ACCOUNTTXSCHEMA_H_INCLUDED
+
+#include <ripple/core/DatabaseCon.h>
+#include <ripple/protocol/AccountID.h>
+#include <beast/utility/Journal.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace ripple {
+
+/** Layout of the per-account transaction index in the transaction database.
+
+    Version 1 keeps base58 account strings in AccountTransactions, and every
+    row returned has to be joined against Transactions to get at the blobs.
+
+    Version 2 keeps 20-byte binary account IDs in AccountTxs together with
+    the status, raw transaction and metadata, under a covering
+    (AccountID, LedgerSeq, TxnSeq) index. Paging walks the index and reads
+    the row it lands on without touching Transactions. A second
+    (AccountID, TransType, LedgerSeq, TxnSeq) index serves pages filtered
+    by transaction type.
+*/
+enum class AccountTxIndex
+{
+    legacy = 1,
+    binary = 2
+};
+
+/** Tracks the account transaction index version and migrates it online.
+
+    While the migration is running, readers keep using AccountTransactions
+    and writers fill both tables. Rows are copied from the newest ledger
+    down in small batches, so the server keeps serving requests. Once the
+    last batch is copied readers switch over, and the legacy table is
+    emptied in the same transaction.
+*/
+class AccountTxSchema
+{
+public:
+    AccountTxSchema (DatabaseCon& db, beast::Journal journal);
+
+    AccountTxSchema (AccountTxSchema const&) = delete;
+    AccountTxSchema& operator= (AccountTxSchema const&) = delete;
+
+    /** Load the persisted version, recording it on first use. */
+    void
+    setup ();
+
+    /** The index readers should use. */
+    AccountTxIndex
+    index () const
+    {
+        return index_.load ();
+    }
+
+    /** True if rows must still be written to AccountTransactions. */
+    bool
+    writeLegacy () const
+    {
+        return index () == AccountTxIndex::legacy;
+    }
+
+    /** Copy the rows of up to `ledgers` ledgers into AccountTxs.
+
+        @return `true` when the migration has finished.
+    */
+    bool
+    migrate (std::uint32_t ledgers);
+
+private:
+    void
+    setVersion (soci::session& session,
+        AccountTxIndex index, std::uint64_t progress);
+
+    DatabaseCon& db_;
+    beast::Journal journal_;
+    std::atomic<AccountTxIndex> index_;
+};
+
+/** The SQL literal for a binary account ID. */
+std::string
+sqlAccountID (AccountID const& account);
+
+/** The statement prefix which inserts or replaces AccountTxs rows. */
+std::string const&
+accountTxsInsertReplaceHeader (DatabaseCon::Type dbType);
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/app/misc/impl/DividendIndex.h>
+#include <ripple/protocol/STTx.h>
+
+namespace ripple {
+
+DividendIndex::DividendIndex (
+        Stopwatch& clock, std::chrono::seconds retryTime)
+    : clock_ (clock)
+    , retryTime_ (retryTime)
+{
+}
+
+bool
+DividendIndex::lookup (std::uint32_t ledger, uint256 const& hash,
+    AccountID const& account, AccountDividend& result) const
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    if (! indexed_ || *indexed_ != Dividend (ledger, hash))
+        return false;
+
+    auto const it = accounts_.find (account);
+    if (it != accounts_.end ())
+        result = it->second;
+    else
+        result = AccountDividend (0, 0, 0, 0, 0, 0, 0);
+    return true;
+}
+
+bool
+DividendIndex::startBuild (std::uint32_t ledger, uint256 const& hash)
+{
+    Dividend const dividend (ledger, hash);
+
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    if (indexed_ && *indexed_ == dividend)
+        return false;
+
+    if (attempt_ && attempt_->dividend == dividend &&
+        (attempt_->building ||
+            clock_.now () < attempt_->failed + retryTime_))
+        return false;
+
+    attempt_ = Attempt {dividend, true, {}};
+    return true;
+}
+
+void
+DividendIndex::finishBuild (std::uint32_t ledger, uint256 const& hash,
+    Accounts accounts)
+{
+    Dividend const dividend (ledger, hash);
+
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    accounts_.swap (accounts);
+    indexed_ = dividend;
+    if (attempt_ && attempt_->dividend == dividend)
+        attempt_ = boost::none;
+}
+
+void
+DividendIndex::failBuild (std::uint32_t ledger, uint256 const& hash)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    if (attempt_ && attempt_->dividend == Dividend (ledger, hash))
+    {
+        attempt_->building = false;
+        attempt_->failed = clock_.now ();
+    }
+}
+
+std::size_t
+DividendIndex::size () const
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    return accounts_.size ();
+}
+
+DividendIndex::Accounts
+DividendIndex::load (SHAMap const& map)
+{
+    Accounts accounts;
+
+    for (auto const& item : map)
+    {
+        auto sitTrans = SerialIter{item.data (), item.size ()};
+        STTx const trans (sitTrans);
+        accounts.emplace (std::piecewise_construct,
+            std::forward_as_tuple (trans.getAccountID (sfDestination)),
+            std::forward_as_tuple (trans.getFieldU64 (sfDividendCoins),
+                trans.getFieldU64 (sfDividendCoinsVBC),
+                trans.getFieldU64 (sfDividendCoinsVBCRank),
+                trans.getFieldU64 (sfDividendCoinsVBCSprd),
+                static_cast<std::uint32_t> (
+                    trans.getFieldU64 (sfDividendVRank)),
+                trans.getFieldU64 (sfDividendVSprd),
+                trans.getFieldU64 (sfDividendTSprd)));
+    }
+
+    return accounts;
+}
+
+}
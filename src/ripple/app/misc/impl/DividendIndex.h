@@ -0,0 +1,119 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_APP_MISC_IMPL_DIVIDENDINDEX_H_INCLUDED
+#define RIPPLE_APP_MISC_IMPL_DIVIDENDINDEX_H_INCLUDED
+
+#include <ripple/app/misc/DividendMaster.h>
+#include <ripple/basics/base_uint.h>
+#include <ripple/basics/chrono.h>
+#include <ripple/basics/UnorderedContainers.h>
+#include <ripple/protocol/AccountID.h>
+#include <ripple/shamap/SHAMap.h>
+#include <boost/optional.hpp>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace ripple {
+
+/** Every account's share of the last dividend, for account_dividend.
+
+    The index is read out of the dividend's transaction map in a job,
+    never by the lookup which finds it missing. While it is built, and
+    for a while after the map could not be read, lookups report the
+    dividend as unavailable instead of trying again.
+
+    Nothing is written besides the map itself: the index only lives in
+    memory, and is rebuilt from the map in the node store once a
+    validated ledger shows the dividend after a restart.
+*/
+class DividendIndex
+{
+public:
+    using AccountDividend = DividendMaster::AccountDividend;
+    using Accounts = hash_map<AccountID, AccountDividend>;
+
+    DividendIndex (Stopwatch& clock, std::chrono::seconds retryTime);
+
+    DividendIndex (DividendIndex const&) = delete;
+    DividendIndex& operator= (DividendIndex const&) = delete;
+
+    /** Look up an account's share of dividend `ledger` with map `hash`.
+
+        An account missing from an indexed dividend got all zeros.
+
+        @return `false` if that dividend is not indexed.
+    */
+    bool
+    lookup (std::uint32_t ledger, uint256 const& hash,
+        AccountID const& account, AccountDividend& result) const;
+
+    /** Claim the build of the index of dividend `ledger`.
+
+        @return `false` if it is indexed, being built, or failed to
+                build less than the retry time ago.
+    */
+    bool
+    startBuild (std::uint32_t ledger, uint256 const& hash);
+
+    /** Replace the index with a build claimed by startBuild. */
+    void
+    finishBuild (std::uint32_t ledger, uint256 const& hash,
+        Accounts accounts);
+
+    /** Record that a build claimed by startBuild failed. */
+    void
+    failBuild (std::uint32_t ledger, uint256 const& hash);
+
+    /** The number of accounts indexed. */
+    std::size_t
+    size () const;
+
+    /** Read every account's share out of a dividend transaction map.
+
+        Throws if the map is missing nodes.
+    */
+    static
+    Accounts
+    load (SHAMap const& map);
+
+private:
+    using Dividend = std::pair<std::uint32_t, uint256>;
+
+    struct Attempt
+    {
+        Dividend dividend;
+        bool building;
+        Stopwatch::time_point failed;
+    };
+
+    Stopwatch& clock_;
+    std::chrono::seconds const retryTime_;
+
+    std::mutex mutable mutex_;
+    boost::optional<Dividend> indexed_;
+    Accounts accounts_;
+    boost::optional<Attempt> attempt_;
+};
+
+}
+
+#endif
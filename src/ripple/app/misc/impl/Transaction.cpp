@@ -25,9 +25,12 @@
 #include <ripple/app/ledger/LedgerMaster.h>
 #include <ripple/app/main/Application.h>
 #include <ripple/app/misc/HashRouter.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
 #include <ripple/protocol/Feature.h>
 #include <ripple/protocol/JsonFields.h>
 #include <boost/optional.hpp>
+#include <chrono>
+#include <limits>
 
 namespace ripple {
 
@@ -127,10 +130,17 @@ Transaction::pointer Transaction::load(uint256 const& id, Application& app)
     boost::optional<std::uint64_t> ledgerSeq;
     boost::optional<std::string> status;
     Blob rawTxn;
+
+    // Recent transactions are the ones most often looked up
+    for (auto const& shard : app.getTxnDBShards ().select (
+        0, std::numeric_limits<std::uint32_t>::max (), false))
     {
-        bool isMySQL = app.getTxnDB ().getType () == DatabaseCon::Type::MySQL;
+        auto const start = std::chrono::steady_clock::now ();
+        auto& txnDB = shard->db ();
+
+        bool isMySQL = txnDB.getType () == DatabaseCon::Type::MySQL;
         
-        auto db = app.getTxnDB ().checkoutDb ();
+        auto db = txnDB.checkoutDb ();
         boost::optional<std::string> sociRawTxnStr;
         std::unique_ptr<soci::blob> sociRawTxnBlob (isMySQL ? nullptr : new soci::blob (*db));
         soci::indicator rti;
@@ -142,17 +152,26 @@ Transaction::pointer Transaction::load(uint256 const& id, Application& app)
             *db << sql, soci::into (ledgerSeq), soci::into (status),
                 soci::into (*sociRawTxnBlob, rti);
 
-        if (!db->got_data () || rti != soci::i_ok)
-            return {};
+        bool const found = db->got_data () && rti == soci::i_ok;
 
-        if (isMySQL)
-            rawTxn.assign (sociRawTxnStr->begin (), sociRawTxnStr->end ());
-        else
-            convert (*sociRawTxnBlob, rawTxn);
+        if (found)
+        {
+            if (isMySQL)
+                rawTxn.assign (sociRawTxnStr->begin (), sociRawTxnStr->end ());
+            else
+                convert (*sociRawTxnBlob, rawTxn);
+        }
+
+        shard->onRead (std::chrono::duration_cast<
+            std::chrono::microseconds> (
+                std::chrono::steady_clock::now () - start));
+
+        if (found)
+            return Transaction::transactionFromSQLValidated (
+                ledgerSeq, status, rawTxn, app);
     }
 
-    return Transaction::transactionFromSQLValidated (
-        ledgerSeq, status, rawTxn, app);
+    return {};
 }
 
 // options 1 to include the date of the transaction
@@ -0,0 +1,430 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/app/main/DBInit.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
+#include <ripple/core/SociDB.h>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+#include <boost/regex.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace ripple {
+
+// Cold shards are only read, so let SQLite map them rather than copy
+// pages through its own cache.
+static std::int64_t const coldShardMmapSize = 256 * 1024 * 1024;
+
+TxnDBShards::Shard::Shard (std::uint32_t first, std::uint32_t last,
+        DatabaseCon& db, AccountTxSchema& schema)
+    : first_ (first)
+    , last_ (last)
+    , db_ (db)
+    , schema_ (schema)
+{
+}
+
+TxnDBShards::Shard::Shard (std::uint32_t first, std::uint32_t last,
+        std::unique_ptr<DatabaseCon> db,
+        std::unique_ptr<AccountTxSchema> schema,
+        boost::filesystem::path path)
+    : first_ (first)
+    , last_ (last)
+    , ownedDb_ (std::move (db))
+    , ownedSchema_ (std::move (schema))
+    , db_ (*ownedDb_)
+    , schema_ (*ownedSchema_)
+    , path_ (std::move (path))
+{
+}
+
+TxnDBShards::Shard::~Shard ()
+{
+    if (! dropped_ || ! ownedDb_)
+        return;
+
+    // The connection must be closed before its files go away
+    ownedSchema_.reset ();
+    ownedDb_.reset ();
+
+    boost::system::error_code ec;
+    for (auto const suffix : {"", "-wal", "-shm"})
+        boost::filesystem::remove (path_.string () + suffix, ec);
+}
+
+void
+TxnDBShards::Shard::onRead (std::chrono::microseconds elapsed)
+{
+    ++reads_;
+    readTime_ += elapsed.count ();
+}
+
+void
+TxnDBShards::Shard::onWrite (std::chrono::microseconds elapsed)
+{
+    ++writes_;
+    writeTime_ += elapsed.count ();
+}
+
+Json::Value
+TxnDBShards::Shard::getJson () const
+{
+    Json::Value ret (Json::objectValue);
+
+    ret["first"] = first_;
+    ret["last"] = last_;
+    ret["read_only"] = readOnly_;
+
+    auto const reads = reads_.load ();
+    ret["reads"] = static_cast<Json::UInt> (reads);
+    if (reads != 0)
+        ret["avg_read_us"] = static_cast<Json::UInt> (readTime_ / reads);
+
+    auto const writes = writes_.load ();
+    ret["writes"] = static_cast<Json::UInt> (writes);
+    if (writes != 0)
+        ret["avg_write_us"] = static_cast<Json::UInt> (writeTime_ / writes);
+
+    // Readers and the writer all queue on the connection's lock
+    ret["lock_waits"] = static_cast<Json::UInt> (db_.lockWaits ());
+    ret["lock_wait_us"] = static_cast<Json::UInt> (
+        db_.lockWaitTime ().count ());
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+
+TxnDBShards::TxnDBShards (DatabaseCon::Setup const& setup,
+        DatabaseCon& base, AccountTxSchema& baseSchema,
+        std::uint32_t shardLedgers, int cacheKB,
+        JobQueue& jobQueue, Logs& logs)
+    : setup_ (setup)
+    , base_ (base)
+    , baseSchema_ (baseSchema)
+    , shardLedgers_ (shardLedgers)
+    , cacheKB_ (cacheKB)
+    , jobQueue_ (jobQueue)
+    , logs_ (logs)
+    , journal_ (logs.journal ("TxnDBShards"))
+{
+}
+
+void
+TxnDBShards::setup ()
+{
+    std::lock_guard <std::mutex> lock (mutex_);
+
+    if (base_.getType () != DatabaseCon::Type::Sqlite)
+        shardLedgers_ = 0;
+
+    std::uint64_t baseLimit = 0;
+
+    if (base_.getType () == DatabaseCon::Type::Sqlite)
+    {
+        auto db = base_.checkoutDb ();
+
+        boost::optional<std::uint32_t> stored;
+        boost::optional<std::uint64_t> limit;
+        *db << "SELECT Version, Progress FROM SchemaVersion "
+               "WHERE Name = 'TxnShards';",
+            soci::into (stored), soci::into (limit);
+
+        if (stored)
+        {
+            // Moving ledgers between files is not supported, so the
+            // size the database was created with always wins.
+            if (shardLedgers_ != *stored)
+            {
+                JLOG (journal_.warning) <<
+                    "Using the recorded shard size of " << *stored <<
+                    " ledgers instead of " << shardLedgers_;
+                shardLedgers_ = *stored;
+            }
+            baseLimit = limit.value_or (0);
+        }
+        else if (shardLedgers_ != 0)
+        {
+            boost::optional<std::uint64_t> maxSeq;
+            *db << "SELECT MAX(LedgerSeq) FROM Transactions;",
+                soci::into (maxSeq);
+
+            if (maxSeq)
+                baseLimit = (*maxSeq / shardLedgers_ + 1) * shardLedgers_;
+
+            *db << boost::str (boost::format (
+                "INSERT INTO SchemaVersion (Name, Version, Progress) "
+                "VALUES ('TxnShards', %u, %u);")
+                % shardLedgers_
+                % baseLimit);
+        }
+    }
+
+    if (shardLedgers_ == 0)
+    {
+        shards_.emplace (0, std::make_shared<Shard> (0,
+            std::numeric_limits<std::uint32_t>::max (),
+                base_, baseSchema_));
+        return;
+    }
+
+    if (baseLimit != 0)
+    {
+        shards_.emplace (0, std::make_shared<Shard> (0,
+            static_cast<std::uint32_t> (baseLimit - 1),
+                base_, baseSchema_));
+    }
+
+    std::vector<std::uint32_t> indexes;
+
+    namespace fs = boost::filesystem;
+    boost::system::error_code ec;
+    if (! setup_.dataDir.empty () && fs::is_directory (setup_.dataDir, ec))
+    {
+        static boost::regex const re ("transaction\\.([0-9]+)\\.db");
+
+        for (fs::directory_iterator it (setup_.dataDir, ec), end;
+            ! ec && it != end; it.increment (ec))
+        {
+            boost::smatch match;
+            auto const name = it->path ().filename ().string ();
+            if (! boost::regex_match (name, match, re))
+                continue;
+
+            auto const index = std::stoull (match[1]);
+            if (index * shardLedgers_ < baseLimit ||
+                index * shardLedgers_ >
+                    std::numeric_limits<std::uint32_t>::max ())
+            {
+                JLOG (journal_.warning) << "Ignoring " << name;
+                continue;
+            }
+            indexes.push_back (static_cast<std::uint32_t> (index));
+        }
+    }
+
+    std::sort (indexes.begin (), indexes.end ());
+
+    for (auto const index : indexes)
+        open (index, index != indexes.back ());
+
+    // transaction.db stays writable while its account index is migrated
+    if (! indexes.empty () && baseLimit != 0 && ! baseSchema_.writeLegacy ())
+        setReadOnly (*shards_.begin ()->second, true);
+
+    JLOG (journal_.info) << "Transactions sharded every " <<
+        shardLedgers_ << " ledgers, " << shards_.size () << " shards";
+}
+
+std::shared_ptr<TxnDBShards::Shard>
+TxnDBShards::open (std::uint32_t index, bool readOnly)
+{
+    auto const name = "transaction." + std::to_string (index) + ".db";
+    auto db = std::make_unique<DatabaseCon> (setup_,
+        name, TxnDBInit, TxnDBCount);
+
+    db->getSession () << boost::str (
+        boost::format ("PRAGMA cache_size=-%d;") % cacheKB_);
+    db->setupCheckpointing (&jobQueue_, logs_);
+
+    auto schema = std::make_unique<AccountTxSchema> (
+        *db, logs_.journal ("AccountTxSchema"));
+    schema->setup ();
+
+    std::uint64_t const first =
+        static_cast<std::uint64_t> (index) * shardLedgers_;
+    std::uint64_t const last = std::min<std::uint64_t> (
+        first + shardLedgers_ - 1,
+            std::numeric_limits<std::uint32_t>::max ());
+
+    auto shard = std::make_shared<Shard> (
+        static_cast<std::uint32_t> (first),
+            static_cast<std::uint32_t> (last),
+                std::move (db), std::move (schema),
+                    setup_.dataDir / name);
+
+    if (readOnly)
+        setReadOnly (*shard, true);
+
+    shards_[shard->first ()] = shard;
+    return shard;
+}
+
+void
+TxnDBShards::setReadOnly (Shard& shard, bool readOnly)
+{
+    auto db = shard.db ().checkoutDb ();
+
+    if (readOnly)
+    {
+        *db << "PRAGMA query_only=1;";
+        *db << boost::str (boost::format ("PRAGMA mmap_size=%d;")
+            % coldShardMmapSize);
+    }
+    else
+    {
+        *db << "PRAGMA mmap_size=0;";
+        *db << "PRAGMA query_only=0;";
+    }
+
+    shard.readOnly_ = readOnly;
+}
+
+std::shared_ptr<TxnDBShards::Shard>
+TxnDBShards::writer (std::uint32_t seq)
+{
+    std::lock_guard <std::mutex> lock (mutex_);
+
+    std::shared_ptr<Shard> shard;
+
+    auto iter = shards_.upper_bound (seq);
+    if (iter != shards_.begin () && seq <= std::prev (iter)->second->last ())
+    {
+        shard = std::prev (iter)->second;
+        if (shard->readOnly_)
+        {
+            JLOG (journal_.info) << "Reopening shard " <<
+                shard->first () << " to save ledger " << seq;
+            setReadOnly (*shard, false);
+        }
+    }
+    else
+    {
+        JLOG (journal_.info) << "Creating shard " << seq / shardLedgers_ <<
+            " for ledger " << seq;
+        shard = open (seq / shardLedgers_, false);
+    }
+
+    retire ();
+    return shard;
+}
+
+void
+TxnDBShards::retire ()
+{
+    if (shards_.size () < 2)
+        return;
+
+    // Only this map holds a shard nobody is using, and no one can take
+    // it from the map while the lock is held, so no save is in flight.
+    auto const newest = std::prev (shards_.end ());
+    for (auto iter = shards_.begin (); iter != newest; ++iter)
+    {
+        auto& shard = *iter->second;
+        if (shard.readOnly_ || iter->second.use_count () != 1)
+            continue;
+
+        // transaction.db stays writable while its account index is migrated
+        if (! shard.ownedDb_ && baseSchema_.writeLegacy ())
+            continue;
+
+        JLOG (journal_.debug) << "Retiring shard " << shard.first ();
+        setReadOnly (shard, true);
+    }
+}
+
+std::vector<std::shared_ptr<TxnDBShards::Shard>>
+TxnDBShards::select (std::uint32_t minLedger, std::uint32_t maxLedger,
+    bool forward) const
+{
+    std::vector<std::shared_ptr<Shard>> ret;
+
+    {
+        std::lock_guard <std::mutex> lock (mutex_);
+
+        auto iter = shards_.upper_bound (minLedger);
+        if (iter != shards_.begin ())
+            --iter;
+
+        for (; iter != shards_.end () && iter->first <= maxLedger; ++iter)
+        {
+            if (iter->second->last () >= minLedger)
+                ret.push_back (iter->second);
+        }
+    }
+
+    if (! forward)
+        std::reverse (ret.begin (), ret.end ());
+
+    return ret;
+}
+
+std::vector<std::shared_ptr<TxnDBShards::Shard>>
+TxnDBShards::dropPrior (std::uint32_t seq)
+{
+    std::vector<std::shared_ptr<Shard>> ret;
+
+    std::lock_guard <std::mutex> lock (mutex_);
+
+    for (auto iter = shards_.begin ();
+        iter != shards_.end () && iter->first < seq;)
+    {
+        auto const& shard = iter->second;
+        if (shard->last () < seq && shard->ownedDb_)
+        {
+            JLOG (journal_.info) << "Dropping shard " <<
+                shard->first () / shardLedgers_ << " before ledger " << seq;
+            shard->dropped_ = true;
+            iter = shards_.erase (iter);
+        }
+        else
+        {
+            // Pruning deletes rows, which a query only shard refuses
+            if (shard->readOnly_)
+            {
+                JLOG (journal_.info) << "Reopening shard " <<
+                    shard->first () << " to delete before ledger " << seq;
+                setReadOnly (*shard, false);
+            }
+            ret.push_back (shard);
+            ++iter;
+        }
+    }
+
+    return ret;
+}
+
+std::uint64_t
+TxnDBShards::getKBUsed () const
+{
+    std::uint64_t ret = 0;
+
+    for (auto const& shard : select (0,
+            std::numeric_limits<std::uint32_t>::max (), true))
+        ret += getKBUsedDB (shard->db ().getSession ());
+
+    return ret;
+}
+
+Json::Value
+TxnDBShards::getJson () const
+{
+    Json::Value ret (Json::arrayValue);
+
+    std::lock_guard <std::mutex> lock (mutex_);
+    for (auto const& shard : shards_)
+        ret.append (shard.second->getJson ());
+
+    return ret;
+}
+
+}
@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_APP_MISC_IMPL_TXNDBSHARDS_H_INCLUDED
+#define RIPPLE_APP_MISC_IMPL_TXNDBSHARDS_H_INCLUDED
+
+#include <ripple/app/misc/impl/AccountTxSchema.h>
+#include <ripple/basics/Log.h>
+#include <ripple/core/DatabaseCon.h>
+#include <ripple/core/JobQueue.h>
+#include <ripple/json/json_value.h>
+#include <beast/utility/Journal.h>
+#include <boost/filesystem/path.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** The transaction database, split into files by ledger range.
+
+    With `shard_ledgers` set in [transaction_db], ledger N is stored in
+    transaction.K.db where K is N / shard_ledgers. Anything already in
+    transaction.db when sharding was turned on stays there, and that file
+    covers every ledger below the first shard. The shard size is recorded
+    in transaction.db and can not be changed afterwards.
+
+    Each shard has its own connection and lock, so saving a ledger into
+    the newest shard does not hold up readers of older ones. Shards older
+    than the newest are opened query only and memory mapped; one is made
+    writable again only while an old ledger is saved into it or old rows
+    are deleted from it. Saving a ledger retires the writable shards
+    other than the newest once nothing else holds them, including the
+    previous newest when a new shard is created.
+
+    Without sharding there is a single shard, transaction.db, covering
+    every ledger.
+*/
+class TxnDBShards
+{
+public:
+    class Shard
+    {
+    public:
+        Shard (std::uint32_t first, std::uint32_t last,
+            DatabaseCon& db, AccountTxSchema& schema);
+
+        Shard (std::uint32_t first, std::uint32_t last,
+            std::unique_ptr<DatabaseCon> db,
+            std::unique_ptr<AccountTxSchema> schema,
+            boost::filesystem::path path);
+
+        /** Closes the shard, deleting its files if it was dropped. */
+        ~Shard ();
+
+        Shard (Shard const&) = delete;
+        Shard& operator= (Shard const&) = delete;
+
+        /** The first ledger stored in this shard. */
+        std::uint32_t
+        first () const
+        {
+            return first_;
+        }
+
+        /** The last ledger stored in this shard. */
+        std::uint32_t
+        last () const
+        {
+            return last_;
+        }
+
+        DatabaseCon&
+        db ()
+        {
+            return db_;
+        }
+
+        AccountTxSchema&
+        schema ()
+        {
+            return schema_;
+        }
+
+        /** Record the latency of a query run against this shard. */
+        void
+        onRead (std::chrono::microseconds elapsed);
+
+        /** Record the latency of a ledger saved into this shard. */
+        void
+        onWrite (std::chrono::microseconds elapsed);
+
+        Json::Value
+        getJson () const;
+
+    private:
+        friend class TxnDBShards;
+
+        std::uint32_t const first_;
+        std::uint32_t const last_;
+        std::unique_ptr<DatabaseCon> ownedDb_;
+        std::unique_ptr<AccountTxSchema> ownedSchema_;
+        DatabaseCon& db_;
+        AccountTxSchema& schema_;
+        boost::filesystem::path const path_;
+
+        // Guarded by TxnDBShards::mutex_
+        bool readOnly_ = false;
+        bool dropped_ = false;
+
+        std::atomic<std::uint64_t> reads_ {0};
+        std::atomic<std::uint64_t> readTime_ {0};
+        std::atomic<std::uint64_t> writes_ {0};
+        std::atomic<std::uint64_t> writeTime_ {0};
+    };
+
+    /** Create the shard set.
+
+        @param base The transaction.db connection.
+        @param baseSchema The account index of transaction.db.
+        @param shardLedgers Ledgers per shard, or zero to not shard.
+    */
+    TxnDBShards (DatabaseCon::Setup const& setup,
+        DatabaseCon& base, AccountTxSchema& baseSchema,
+        std::uint32_t shardLedgers, int cacheKB,
+        JobQueue& jobQueue, Logs& logs);
+
+    TxnDBShards (TxnDBShards const&) = delete;
+    TxnDBShards& operator= (TxnDBShards const&) = delete;
+
+    /** Open the existing shards. */
+    void
+    setup ();
+
+    /** True if transactions are split across several files. */
+    bool
+    sharded () const
+    {
+        return shardLedgers_ != 0;
+    }
+
+    /** The shard ledger `seq` is saved into, created if needed. */
+    std::shared_ptr<Shard>
+    writer (std::uint32_t seq);
+
+    /** The shards holding ledgers in [minLedger, maxLedger], in the
+        order a walk in the given direction visits them.
+    */
+    std::vector<std::shared_ptr<Shard>>
+    select (std::uint32_t minLedger, std::uint32_t maxLedger,
+        bool forward) const;
+
+    /** Remove the shards holding only ledgers before `seq`.
+
+        A removed shard's files are deleted once the last query using it
+        finishes. transaction.db is never removed. The shards returned
+        are made writable so their older rows can be deleted.
+
+        @return The remaining shards that hold ledgers before `seq`.
+    */
+    std::vector<std::shared_ptr<Shard>>
+    dropPrior (std::uint32_t seq);
+
+    /** The space used by every shard, in kilobytes. */
+    std::uint64_t
+    getKBUsed () const;
+
+    Json::Value
+    getJson () const;
+
+private:
+    std::shared_ptr<Shard>
+    open (std::uint32_t index, bool readOnly);
+
+    static
+    void
+    setReadOnly (Shard& shard, bool readOnly);
+
+    // Makes the shards before the newest which nothing else holds query
+    // only again. The caller holds mutex_.
+    void
+    retire ();
+
+    DatabaseCon::Setup const setup_;
+    DatabaseCon& base_;
+    AccountTxSchema& baseSchema_;
+    std::uint32_t shardLedgers_;
+    int const cacheKB_;
+    JobQueue& jobQueue_;
+    Logs& logs_;
+    beast::Journal journal_;
+
+    std::mutex mutable mutex_;
+
+    // Keyed by the first ledger of each shard
+    std::map<std::uint32_t, std::shared_ptr<Shard>> shards_;
+};
+
+}
+
+#endif
@@ -49,7 +49,7 @@ RippleLineCache::pointer PathRequests::getLineCache (
     return mLineCache;
 }
 
-void PathRequests::updateAll (std::shared_ptr <ReadView const> const& inLedger,
+bool PathRequests::updateAll (std::shared_ptr <ReadView const> const& inLedger,
                               Job::CancelCallback shouldCancel)
 {
     std::vector<PathRequest::wptr> requests;
@@ -78,6 +78,14 @@ void PathRequests::updateAll (std::shared_ptr <ReadView const> const& inLedger,
             if (shouldCancel())
                 break;
 
+            // Give the thread to a job that must start soon
+            if (app_.getJobQueue ().shouldYield ())
+            {
+                mJournal.debug << "updateAll yielding after " <<
+                    processed << " processed";
+                return false;
+            }
+
             bool remove = true;
             PathRequest::pointer pRequest = wRequest.lock ();
 
@@ -148,7 +156,7 @@ void PathRequests::updateAll (std::shared_ptr <ReadView const> const& inLedger,
         { // check if there are any new requests, otherwise we are done
             newRequests = app_.getLedgerMaster().isNewPathRequest();
             if (!newRequests) // We did a full pass and there are no new requests
-                return;
+                return true;
         }
 
         {
@@ -167,6 +175,7 @@ void PathRequests::updateAll (std::shared_ptr <ReadView const> const& inLedger,
 
     mJournal.debug << "updateAll complete " << processed << " process and " <<
         removed << " removed";
+    return true;
 }
 
 void PathRequests::insertPathRequest (PathRequest::pointer const& req)
@@ -42,7 +42,13 @@ public:
         mFull = collector->make_event ("pathfind_full");
     }
 
-    void updateAll (std::shared_ptr<ReadView const> const& ledger,
+    /** Update every path request against the ledger.
+
+        @return `false` if the update stopped early to let a waiting
+                job with a deadline run; the caller should post the rest
+                of the work as a new job.
+    */
+    bool updateAll (std::shared_ptr<ReadView const> const& ledger,
                     Job::CancelCallback shouldCancel);
 
     RippleLineCache::pointer getLineCache (
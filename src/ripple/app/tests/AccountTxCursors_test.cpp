@@ -0,0 +1,185 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012-2015 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/app/misc/impl/AccountTxCursors.h>
+#include <ripple/basics/chrono.h>
+#include <beast/unit_test/suite.h>
+
+namespace ripple {
+namespace test {
+
+class AccountTxCursors_test : public beast::unit_test::suite
+{
+    AccountID const alice_ {1};
+    AccountID const bob_ {2};
+
+    void
+    testFind()
+    {
+        TestStopwatch stopwatch;
+        AccountTxCursors cursors (stopwatch, std::chrono::seconds (2));
+
+        auto const gen = cursors.generation ();
+        cursors.insert (alice_, 10, 20, false, 200, {12, 3}, gen);
+        cursors.insert (alice_, 10, 20, false, 400, {15, 0}, gen);
+
+        expect (! cursors.find (alice_, 10, 20, false, 100));
+
+        auto c = cursors.find (alice_, 10, 20, false, 300);
+        expect (c && c->first == 200 &&
+            c->second.ledger == 12 && c->second.seq == 3);
+
+        c = cursors.find (alice_, 10, 20, false, 400);
+        expect (c && c->first == 400 && c->second.ledger == 15);
+
+        // Every key component selects a different walk
+        expect (! cursors.find (bob_, 10, 20, false, 300));
+        expect (! cursors.find (alice_, 10, 21, false, 300));
+        expect (! cursors.find (alice_, 10, 20, true, 300));
+    }
+
+    void
+    testGeneration()
+    {
+        TestStopwatch stopwatch;
+        AccountTxCursors cursors (stopwatch, std::chrono::seconds (2));
+
+        auto const gen = cursors.generation ();
+        cursors.onLedgerSaved (50, {bob_});
+
+        // Computed before the save finished, so it may be stale
+        cursors.insert (alice_, 10, 20, false, 200, {12, 3}, gen);
+        expect (! cursors.find (alice_, 10, 20, false, 200));
+
+        cursors.insert (alice_, 10, 20, false, 200, {12, 3},
+            cursors.generation ());
+        expect (!! cursors.find (alice_, 10, 20, false, 200));
+    }
+
+    void
+    testInvalidation()
+    {
+        TestStopwatch stopwatch;
+        AccountTxCursors cursors (stopwatch, std::chrono::seconds (2));
+
+        auto const gen = cursors.generation ();
+        cursors.insert (alice_, 10, 20, false, 100, {12, 0}, gen);
+        cursors.insert (alice_, 10, 20, false, 200, {16, 0}, gen);
+        cursors.insert (alice_, 10, 20, true, 100, {18, 0}, gen);
+        cursors.insert (alice_, 10, 20, true, 200, {14, 0}, gen);
+
+        // Outside the range
+        cursors.onLedgerSaved (21, {alice_});
+        expect (cursors.find (alice_, 10, 20, false, 200)->first == 200);
+        expect (cursors.find (alice_, 10, 20, true, 200)->first == 200);
+
+        // Only touches another account's walks
+        cursors.onLedgerSaved (15, {bob_});
+        expect (cursors.find (alice_, 10, 20, false, 200)->first == 200);
+        expect (cursors.find (alice_, 10, 20, true, 200)->first == 200);
+
+        // Shifts the rows which follow ledger 15 in either walk
+        cursors.onLedgerSaved (15, {alice_, bob_});
+        expect (cursors.find (alice_, 10, 20, false, 200)->first == 100);
+        expect (cursors.find (alice_, 10, 20, true, 200)->first == 100);
+
+        cursors.onLedgerSaved (10, {alice_});
+        expect (! cursors.find (alice_, 10, 20, false, 200));
+        expect (cursors.size () == 1);
+    }
+
+    void
+    testDeletePrior()
+    {
+        TestStopwatch stopwatch;
+        AccountTxCursors cursors (stopwatch, std::chrono::seconds (2));
+
+        auto const gen = cursors.generation ();
+        cursors.insert (alice_, 10, 20, false, 100, {12, 0}, gen);
+        cursors.insert (alice_, 10, 20, true, 100, {18, 0}, gen);
+        cursors.insert (alice_, 10, 20, true, 200, {11, 0}, gen);
+        cursors.insert (bob_, 15, 20, false, 100, {16, 0}, gen);
+
+        // Nothing deleted from either walk
+        cursors.onDeletePrior (10);
+        expect (cursors.size () == 3);
+
+        // Every ascending offset moves, descending ones only past ledger 12
+        cursors.onDeletePrior (12);
+        expect (! cursors.find (alice_, 10, 20, false, 100));
+        expect (cursors.find (alice_, 10, 20, true, 200)->first == 100);
+        expect (cursors.find (bob_, 15, 20, false, 100)->first == 100);
+
+        // Computed while the rows were being deleted
+        cursors.insert (alice_, 10, 20, false, 100, {13, 0}, gen);
+        expect (! cursors.find (alice_, 10, 20, false, 100));
+    }
+
+    void
+    testExpiration()
+    {
+        TestStopwatch stopwatch;
+        AccountTxCursors cursors (stopwatch, std::chrono::seconds (2));
+
+        cursors.insert (alice_, 10, 20, false, 100, {12, 0},
+            cursors.generation ());
+        ++stopwatch;
+        ++stopwatch;
+        ++stopwatch;
+        cursors.insert (bob_, 10, 20, false, 100, {12, 0},
+            cursors.generation ());
+        expect (! cursors.find (alice_, 10, 20, false, 100));
+        expect (cursors.size () == 1);
+    }
+
+    void
+    testLimit()
+    {
+        TestStopwatch stopwatch;
+        AccountTxCursors cursors (stopwatch, std::chrono::seconds (2));
+
+        auto const gen = cursors.generation ();
+        for (std::uint32_t i = 1; i <= 5000; ++i)
+            cursors.insert (alice_, 0, 100000, false, i * 10, {i, 0}, gen);
+
+        // The lowest offsets are dropped first
+        expect (! cursors.find (alice_, 0, 100000, false, 9040));
+        expect (cursors.find (alice_, 0, 100000, false, 9050)->first == 9050);
+        expect (cursors.find (alice_, 0, 100000, false, 90000)->first ==
+            50000);
+    }
+
+public:
+    void
+    run()
+    {
+        testFind();
+        testGeneration();
+        testInvalidation();
+        testDeletePrior();
+        testExpiration();
+        testLimit();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(AccountTxCursors, app, ripple)
+
+}
+}
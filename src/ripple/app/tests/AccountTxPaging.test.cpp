@@ -17,11 +17,22 @@
 */
 //==============================================================================
 #include <ripple/core/DatabaseCon.h>
+#include <ripple/app/main/DBInit.h>
+#include <ripple/app/misc/Transaction.h>
+#include <ripple/app/misc/impl/AccountTxCursors.h>
 #include <ripple/app/misc/impl/AccountTxPaging.h>
+#include <ripple/app/misc/impl/AccountTxSchema.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
+#include <ripple/basics/chrono.h>
+#include <ripple/protocol/JsonFields.h>
 #include <ripple/protocol/types.h>
 #include <ripple/test/jtx.h>
 #include <beast/unit_test/suite.h>
+#include <beast/module/core/diagnostic/UnitTestUtilities.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
 #include <cstdlib>
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -30,6 +41,7 @@ namespace ripple {
 struct AccountTxPaging_test : beast::unit_test::suite
 {
     std::unique_ptr<DatabaseCon> db_;
+    AccountTxIndex index_ = AccountTxIndex::legacy;
     std::unique_ptr<AccountIDCache> idCache_;
     NetworkOPs::AccountTxs txs_;
     AccountID account_;
@@ -60,6 +72,330 @@ struct AccountTxPaging_test : beast::unit_test::suite
             "rfu6L5p3azwPzQZsbTafuVk884N9YoKvVG");
 
         testAccountTxPaging();
+        testSeek ();
+
+        testMigration (data_path);
+    }
+
+    // Migrate a copy of the fixture and page through the binary index.
+    void
+    testMigration (std::string const& data_path)
+    {
+        beast::UnitTestUtilities::TempDirectory tempDir ("account_tx");
+        boost::filesystem::path const dir (
+            tempDir.getFullPathName ().toStdString ());
+        boost::filesystem::create_directories (dir);
+        boost::filesystem::copy_file (
+            boost::filesystem::path (data_path) / "account-tx-transactions.db",
+            dir / "account-tx-transactions.db");
+
+        DatabaseCon::Setup dbConf;
+        dbConf.dataDir = dir;
+
+        db_ = std::make_unique <DatabaseCon> (
+            dbConf, "account-tx-transactions.db", TxnDBInit, TxnDBCount);
+
+        AccountTxSchema schema (*db_, beast::Journal ());
+        schema.setup ();
+        expect (schema.index () == AccountTxIndex::legacy);
+        expect (schema.writeLegacy ());
+
+        // The fixture spans ledgers 3 to 6, force several batches
+        int batches = 0;
+        while (! schema.migrate (1))
+            ++batches;
+        expect (batches >= 2);
+        expect (schema.index () == AccountTxIndex::binary);
+        expect (! schema.writeLegacy ());
+
+        // The switch empties the legacy table
+        int legacyRows = -1;
+        *db_->checkoutDb () <<
+            "SELECT COUNT(*) FROM AccountTransactions;", soci::into (legacyRows);
+        expect (legacyRows == 0);
+
+        index_ = schema.index ();
+        testAccountTxPaging ();
+        testTypeFilter ();
+        testSeek ();
+        testOffset ();
+
+        // A restart keeps the binary index without touching the legacy
+        // table again, even if a late write left a row there
+        *db_->checkoutDb () << "INSERT INTO AccountTransactions "
+            "(TransID, Account, LedgerSeq, TxnSeq) VALUES "
+            "('00', 'rfu6L5p3azwPzQZsbTafuVk884N9YoKvVG', 6, 0);";
+        AccountTxSchema restarted (*db_, beast::Journal ());
+        restarted.setup ();
+        expect (restarted.index () == AccountTxIndex::binary);
+
+        *db_->checkoutDb () <<
+            "SELECT COUNT(*) FROM AccountTransactions;", soci::into (legacyRows);
+        expect (legacyRows == 1);
+
+        index_ = restarted.index ();
+        testAccountTxPaging ();
+        testPrune ();
+
+        db_.reset ();
+    }
+
+    // Every type seen unfiltered pages the same rows when filtered.
+    void
+    testTypeFilter ()
+    {
+        Json::Value token;
+        next (1000, true, token, 2, 20);
+
+        std::map<TxType, std::vector<std::pair<int, int>>> byType;
+        for (auto const& tx : txs_)
+        {
+            byType[tx.first->getSTransaction ()->getTxnType ()].emplace_back (
+                tx.second->getLgrSeq (), tx.second->getIndex ());
+        }
+        expect (! byType.empty ());
+
+        for (auto const& type : byType)
+        {
+            for (bool const forward : {true, false})
+            {
+                // One row per page so the markers are exercised
+                std::vector<std::pair<int, int>> found;
+                token = Json::nullValue;
+                int pages = 0;
+                do
+                {
+                    next (1, forward, token, 2, 20, type.first);
+                    for (auto const& tx : txs_)
+                    {
+                        found.emplace_back (
+                            tx.second->getLgrSeq (), tx.second->getIndex ());
+                    }
+                }
+                while (token.isObject () && ++pages < 100);
+
+                if (! forward)
+                    std::reverse (found.begin (), found.end ());
+                expect (found == type.second);
+            }
+        }
+
+        token = Json::nullValue;
+        expect (next (10, true, token, 2, 20, ttAMENDMENT) == 0);
+    }
+
+    using Rows = std::vector<std::pair<int, int>>;
+
+    Rows
+    rows () const
+    {
+        Rows ret;
+        for (auto const& tx : txs_)
+            ret.emplace_back (tx.second->getLgrSeq (), tx.second->getIndex ());
+        return ret;
+    }
+
+    // Every skip lands on the row a single long page has there.
+    void
+    testSeek ()
+    {
+        for (bool const forward : {true, false})
+        {
+            Json::Value token;
+            next (1000, forward, token, 2, 20);
+            auto const all = rows ();
+            expect (all.size () == 13);
+
+            for (std::uint32_t skip = 0; skip <= all.size (); ++skip)
+            {
+                token = Json::nullValue;
+                bool const found = accountTxSeek (*db_, index_, *idCache_,
+                    account_, boost::none, 2, 20, forward, token, skip);
+                expect (found == (skip < all.size ()));
+                if (found)
+                    checkToken (token, all[skip].first, all[skip].second);
+
+                // Counting starts at the marker, when there is one
+                token = Json::objectValue;
+                token[jss::ledger] = all[4].first;
+                token[jss::seq] = all[4].second;
+                bool const fromMarker = accountTxSeek (*db_, index_,
+                    *idCache_, account_, boost::none, 2, 20, forward,
+                        token, skip);
+                expect (fromMarker == (4 + skip < all.size ()));
+                if (fromMarker)
+                {
+                    checkToken (token,
+                        all[4 + skip].first, all[4 + skip].second);
+                }
+            }
+
+            // Outside the range
+            token = Json::nullValue;
+            expect (! accountTxSeek (*db_, index_, *idCache_, account_,
+                boost::none, 7, 20, forward, token, 0));
+        }
+    }
+
+    // The rows of an offset page of the walk over ledgers 2 to 20.
+    Rows
+    offsetPage (Application& app, TxnDBShards& shards,
+        AccountTxCursors& cursors, bool descend, std::uint32_t offset,
+        std::uint32_t limit, std::uint32_t seekStep)
+    {
+        txs_.clear ();
+        auto& txs = txs_;
+        accountTxPageAtOffset (shards, cursors, *idCache_,
+            [](std::uint32_t){},
+            [&txs, &app](
+                std::uint32_t ledger_index,
+                std::string const& status,
+                Blob const& rawTxn,
+                Blob const& rawMeta)
+            {
+                convertBlobsToTxResult (
+                    txs, ledger_index, status, rawTxn, rawMeta, app);
+            },
+            account_, 2, 20, descend, offset, limit, 200, seekStep);
+        return rows ();
+    }
+
+    static
+    Rows
+    slice (Rows const& all, std::uint32_t offset, std::uint32_t limit)
+    {
+        auto const first = std::min<std::size_t> (offset, all.size ());
+        auto const last = std::min<std::size_t> (offset + limit, all.size ());
+        return Rows (all.begin () + first, all.begin () + last);
+    }
+
+    // Offset pages hold the same rows as a single long page, whether
+    // they resume from a recorded cursor or seek from the start.
+    void
+    testOffset ()
+    {
+        Json::Value token;
+        next (1000, true, token, 2, 20);
+        auto const ascending = rows ();
+        token = Json::nullValue;
+        next (1000, false, token, 2, 20);
+        auto const descending = rows ();
+
+        test::jtx::Env env(*this);
+        Application& app = env.app();
+
+        AccountTxSchema schema (*db_, beast::Journal ());
+        schema.setup ();
+        TxnDBShards shards (DatabaseCon::Setup (), *db_, schema, 0, 1024,
+            app.getJobQueue (), app.logs ());
+        shards.setup ();
+
+        TestStopwatch stopwatch;
+
+        auto page = [&](AccountTxCursors& cursors, bool descend,
+            std::uint32_t offset, std::uint32_t limit)
+        {
+            return offsetPage (app, shards, cursors, descend, offset,
+                limit, 1000);
+        };
+
+        for (bool const descend : {false, true})
+        {
+            auto const& all = descend ? descending : ascending;
+
+            for (std::uint32_t const limit : {1, 2, 3, 5})
+            {
+                // Each page resumes from the cursor the last one recorded
+                AccountTxCursors cursors (stopwatch, std::chrono::seconds (60));
+                for (std::uint32_t offset = 0; offset < all.size ();
+                        offset += limit)
+                {
+                    expect (page (cursors, descend, offset, limit) ==
+                        slice (all, offset, limit));
+                }
+                expect (cursors.size () == 1);
+                expect (!! cursors.find (
+                    account_, 2, 20, descend, all.size () - 1));
+
+                // Another account's ledger leaves the cursors alone
+                cursors.onLedgerSaved (6, {AccountID (1)});
+                expect (cursors.size () == 1);
+
+                // And this account's drops the ones it shifted
+                cursors.onLedgerSaved (descend ? 6 : 3, {account_});
+                expect (cursors.size () == 0);
+                expect (page (cursors, descend, 7, limit) ==
+                    slice (all, 7, limit));
+            }
+
+            // Nothing recorded, so every row before the offset is skipped
+            for (std::uint32_t offset = 0; offset <= all.size (); ++offset)
+            {
+                AccountTxCursors cursors (stopwatch, std::chrono::seconds (60));
+                expect (page (cursors, descend, offset, 3) ==
+                    slice (all, offset, 3));
+            }
+
+            // A deep seek walks in steps and leaves a cursor at each
+            AccountTxCursors cursors (stopwatch, std::chrono::seconds (60));
+            expect (offsetPage (app, shards, cursors, descend, 11, 1, 4) ==
+                slice (all, 11, 1));
+            for (std::uint32_t const offset : {4, 8, 11, 12})
+            {
+                auto const c = cursors.find (
+                    account_, 2, 20, descend, offset);
+                expect (c && c->first == offset);
+            }
+            expect (cursors.find (account_, 2, 20, descend, 7)->first == 4);
+        }
+    }
+
+    // Online delete shifts every ascending offset and the descending ones
+    // past the deleted rows. The cursors it drops are recomputed from the
+    // rows that are left.
+    void
+    testPrune ()
+    {
+        test::jtx::Env env(*this);
+        Application& app = env.app();
+
+        AccountTxSchema schema (*db_, beast::Journal ());
+        schema.setup ();
+        TxnDBShards shards (DatabaseCon::Setup (), *db_, schema, 0, 1024,
+            app.getJobQueue (), app.logs ());
+        shards.setup ();
+
+        TestStopwatch stopwatch;
+        AccountTxCursors cursors (stopwatch, std::chrono::seconds (60));
+
+        for (bool const descend : {false, true})
+        {
+            for (std::uint32_t offset = 0; offset < 13; offset += 2)
+                offsetPage (app, shards, cursors, descend, offset, 2, 1000);
+        }
+        expect (cursors.size () == 2);
+
+        // As SHAMapStoreImp::clearPrior deletes ledgers 3 and 4
+        cursors.onDeletePrior (5);
+        *db_->checkoutDb () << "DELETE FROM AccountTxs WHERE LedgerSeq < 5;";
+        *db_->checkoutDb () <<
+            "DELETE FROM Transactions WHERE LedgerSeq < 5;";
+        cursors.onDeletePrior (5);
+        expect (cursors.size () == 1);
+
+        for (bool const descend : {false, true})
+        {
+            Json::Value token;
+            next (1000, ! descend, token, 2, 20);
+            auto const all = rows ();
+            expect (all.size () == 10);
+
+            for (std::uint32_t offset = 0; offset <= all.size (); ++offset)
+            {
+                expect (offsetPage (app, shards, cursors, descend, offset,
+                    2, 1000) == slice (all, offset, 2));
+            }
+        }
     }
 
     void
@@ -84,7 +420,8 @@ struct AccountTxPaging_test : beast::unit_test::suite
         bool forward,
         Json::Value& token,
         std::int32_t minLedger,
-        std::int32_t maxLedger)
+        std::int32_t maxLedger,
+        boost::optional<TxType> txType = boost::none)
     {
         txs_.clear();
 
@@ -105,8 +442,9 @@ struct AccountTxPaging_test : beast::unit_test::suite
                 txs, ledger_index, status, rawTxn, rawMeta, app);
         };
 
-        accountTxPage(*db_, *idCache_, [](std::uint32_t){}, bound, account_, minLedger,
-            maxLedger, forward, token, limit, admin, page_length);
+        accountTxPage(*db_, index_, *idCache_, [](std::uint32_t){}, bound, account_,
+            txType, minLedger, maxLedger, forward, token, limit, admin,
+            page_length);
 
         return txs_.size();
     }
@@ -0,0 +1,171 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/app/misc/impl/DividendIndex.h>
+#include <ripple/protocol/HashPrefix.h>
+#include <ripple/protocol/STTx.h>
+#include <ripple/protocol/TxFlags.h>
+#include <ripple/shamap/tests/common.h>
+#include <beast/unit_test/suite.h>
+
+namespace ripple {
+namespace test {
+
+class DividendIndex_test : public beast::unit_test::suite
+{
+    using AccountDividend = DividendIndex::AccountDividend;
+
+    AccountID const alice_ {1};
+    AccountID const bob_ {2};
+    AccountID const carol_ {3};
+    uint256 const hash_ {7};
+
+    // A dividend map as DividendMaster::dumpTransactionMap builds it
+    std::shared_ptr<SHAMap>
+    makeMap (Family& f, DividendIndex::Accounts const& accounts)
+    {
+        auto map = std::make_shared<SHAMap> (SHAMapType::TRANSACTION, f);
+
+        for (auto const& div : accounts)
+        {
+            STTx trans (ttDIVIDEND);
+            trans.setFieldU8 (sfDividendType, DividendMaster::DivType_Apply);
+            trans.setFieldU32 (sfDividendLedger, 100);
+            trans.setFieldU32 (sfFlags, tfFullyCanonicalSig);
+            trans.setAccountID (sfAccount, AccountID ());
+            trans.setAccountID (sfDestination, div.first);
+            trans.setFieldU64 (sfDividendCoins, std::get<0> (div.second));
+            trans.setFieldU64 (sfDividendCoinsVBC, std::get<1> (div.second));
+            trans.setFieldU64 (sfDividendCoinsVBCRank, std::get<2> (div.second));
+            trans.setFieldU64 (sfDividendCoinsVBCSprd, std::get<3> (div.second));
+            trans.setFieldU64 (sfDividendVRank, std::get<4> (div.second));
+            trans.setFieldU64 (sfDividendVSprd, std::get<5> (div.second));
+            trans.setFieldU64 (sfDividendTSprd, std::get<6> (div.second));
+
+            Serializer s;
+            trans.add (s);
+            map->addGiveItem (make_shamapitem (
+                trans.getHash (HashPrefix::transactionID), s.slice ()),
+                    true, false);
+        }
+
+        return map;
+    }
+
+    void
+    testLoad()
+    {
+        beast::Journal const j;
+        tests::TestFamily f (j);
+
+        DividendIndex::Accounts accounts;
+        accounts.emplace (alice_, AccountDividend (1, 2, 3, 4, 5, 6, 7));
+        accounts.emplace (bob_, AccountDividend (10, 20, 30, 40, 50, 60, 70));
+
+        auto const map = makeMap (f, accounts);
+        map->flushDirty (hotTRANSACTION_NODE, 0);
+
+        // Read back through the node store, as after a restart
+        auto const stored = std::make_shared<SHAMap> (
+            SHAMapType::TRANSACTION, map->getHash ().as_uint256 (), f);
+        expect (stored->fetchRoot (map->getHash (), nullptr));
+        expect (DividendIndex::load (*stored) == accounts);
+
+        expect (DividendIndex::load (*makeMap (f, {})).empty ());
+    }
+
+    void
+    testLookup()
+    {
+        TestStopwatch stopwatch;
+        DividendIndex index (stopwatch, std::chrono::seconds (60));
+
+        AccountDividend result;
+        expect (! index.lookup (100, hash_, alice_, result));
+
+        DividendIndex::Accounts accounts;
+        accounts.emplace (alice_, AccountDividend (1, 2, 3, 4, 5, 6, 7));
+        accounts.emplace (bob_, AccountDividend (10, 20, 30, 40, 50, 60, 70));
+        index.finishBuild (100, hash_, accounts);
+        expect (index.size () == 2);
+
+        expect (index.lookup (100, hash_, bob_, result));
+        expect (result == AccountDividend (10, 20, 30, 40, 50, 60, 70));
+
+        // Indexed, but got nothing
+        expect (index.lookup (100, hash_, carol_, result));
+        expect (result == AccountDividend (0, 0, 0, 0, 0, 0, 0));
+
+        // Some other dividend
+        expect (! index.lookup (101, hash_, alice_, result));
+        expect (! index.lookup (100, uint256 (8), alice_, result));
+
+        // The next dividend replaces this one
+        accounts.erase (bob_);
+        index.finishBuild (200, uint256 (8), accounts);
+        expect (index.size () == 1);
+        expect (! index.lookup (100, hash_, alice_, result));
+        expect (index.lookup (200, uint256 (8), bob_, result));
+        expect (result == AccountDividend (0, 0, 0, 0, 0, 0, 0));
+    }
+
+    void
+    testBuild()
+    {
+        TestStopwatch stopwatch;
+        DividendIndex index (stopwatch, std::chrono::seconds (2));
+
+        // Only one build at a time
+        expect (index.startBuild (100, hash_));
+        expect (! index.startBuild (100, hash_));
+
+        // A failure is not retried straight away
+        index.failBuild (100, hash_);
+        expect (! index.startBuild (100, hash_));
+        ++stopwatch;
+        expect (! index.startBuild (100, hash_));
+        ++stopwatch;
+        expect (index.startBuild (100, hash_));
+
+        // Unless it is for a different dividend
+        index.failBuild (100, hash_);
+        expect (index.startBuild (200, uint256 (8)));
+
+        index.finishBuild (200, uint256 (8), {});
+        expect (! index.startBuild (200, uint256 (8)));
+
+        AccountDividend result;
+        expect (index.lookup (200, uint256 (8), alice_, result));
+    }
+
+public:
+    void
+    run()
+    {
+        testLoad();
+        testLookup();
+        testBuild();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(DividendIndex, app, ripple)
+
+}
+}
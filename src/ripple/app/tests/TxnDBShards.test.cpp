@@ -0,0 +1,359 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+#include <ripple/core/DatabaseCon.h>
+#include <ripple/app/main/DBInit.h>
+#include <ripple/app/misc/Transaction.h>
+#include <ripple/app/misc/impl/AccountTxPaging.h>
+#include <ripple/app/misc/impl/AccountTxSchema.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
+#include <ripple/protocol/JsonFields.h>
+#include <ripple/protocol/types.h>
+#include <ripple/test/jtx.h>
+#include <beast/unit_test/suite.h>
+#include <beast/module/core/diagnostic/UnitTestUtilities.h>
+#include <boost/filesystem.hpp>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ripple {
+
+// The account_tx fixture copied into shards of two ledgers, checked
+// against the same rows in a single database.
+struct TxnDBShards_test : beast::unit_test::suite
+{
+    using Rows = std::vector<std::pair<std::uint32_t, std::uint32_t>>;
+
+    boost::filesystem::path dir_;
+    DatabaseCon::Setup dbConf_;
+    std::unique_ptr<DatabaseCon> reference_;
+    std::unique_ptr<AccountTxSchema> referenceSchema_;
+    std::unique_ptr<DatabaseCon> base_;
+    std::unique_ptr<AccountTxSchema> baseSchema_;
+    std::unique_ptr<TxnDBShards> shards_;
+    std::unique_ptr<AccountIDCache> idCache_;
+    AccountID account_;
+
+    void
+    run() override
+    {
+        std::string data_path;
+
+        if (auto const fixtures = std::getenv("TEST_FIXTURES"))
+            data_path = fixtures;
+
+        if (data_path.empty ())
+        {
+            fail("The 'TEST_FIXTURES' environment variable is empty.");
+            return;
+        }
+
+        test::jtx::Env env(*this);
+
+        beast::UnitTestUtilities::TempDirectory tempDir ("txn_db_shards");
+        dir_ = tempDir.getFullPathName ().toStdString ();
+        boost::filesystem::create_directories (dir_);
+        boost::filesystem::copy_file (
+            boost::filesystem::path (data_path) / "account-tx-transactions.db",
+            dir_ / "reference.db");
+
+        dbConf_.dataDir = dir_;
+        idCache_ = std::make_unique<AccountIDCache>(128000);
+        account_ = *parseBase58<AccountID>(
+            "rfu6L5p3azwPzQZsbTafuVk884N9YoKvVG");
+
+        reference_ = std::make_unique <DatabaseCon> (
+            dbConf_, "reference.db", TxnDBInit, TxnDBCount);
+        referenceSchema_ = std::make_unique<AccountTxSchema> (
+            *reference_, beast::Journal ());
+        referenceSchema_->setup ();
+        while (! referenceSchema_->migrate (100))
+            ;
+
+        open (env.app ());
+        testWrite ();
+        testPaging (env.app ());
+        testSeek ();
+
+        // Reopening finds the shards and only the newest takes writes
+        shards_.reset ();
+        open (env.app ());
+        testShards ();
+        testPaging (env.app ());
+
+        testDrop ();
+
+        shards_.reset ();
+        baseSchema_.reset ();
+        base_.reset ();
+        referenceSchema_.reset ();
+        reference_.reset ();
+    }
+
+    void
+    open (Application& app)
+    {
+        shards_.reset ();
+        baseSchema_.reset ();
+
+        base_ = std::make_unique <DatabaseCon> (
+            dbConf_, "transaction.db", TxnDBInit, TxnDBCount);
+        baseSchema_ = std::make_unique<AccountTxSchema> (
+            *base_, beast::Journal ());
+        baseSchema_->setup ();
+
+        shards_ = std::make_unique<TxnDBShards> (dbConf_, *base_,
+            *baseSchema_, 2, 1024, app.getJobQueue (), app.logs ());
+        shards_->setup ();
+    }
+
+    bool
+    exists (std::uint32_t index)
+    {
+        return boost::filesystem::exists (
+            dir_ / ("transaction." + std::to_string (index) + ".db"));
+    }
+
+    // Save the fixture ledger by ledger, as Ledger::saveValidatedLedger
+    // would, so the writes cross from one shard into the next.
+    void
+    testWrite ()
+    {
+        auto const source = (dir_ / "reference.db").string ();
+
+        for (std::uint32_t seq = 3; seq <= 6; ++seq)
+        {
+            auto const shard = shards_->writer (seq);
+            expect (shard->first () == seq / 2 * 2);
+            expect (shard->last () == seq / 2 * 2 + 1);
+
+            auto db = shard->db ().checkoutDb ();
+            *db << "ATTACH DATABASE '" + source + "' AS source;";
+            *db << "INSERT INTO Transactions SELECT * FROM "
+                "source.Transactions WHERE LedgerSeq = " +
+                    std::to_string (seq) + ";";
+            *db << "INSERT INTO AccountTxs SELECT * FROM "
+                "source.AccountTxs WHERE LedgerSeq = " +
+                    std::to_string (seq) + ";";
+            *db << "DETACH DATABASE source;";
+        }
+
+        expect (exists (1));
+        expect (exists (2));
+        expect (exists (3));
+        testShards ();
+
+        // Only the newest shard is still writable
+        expect (readOnly () == std::vector<bool> ({true, true, false}));
+
+        // Saving an old ledger reopens its shard while the save runs, and
+        // the next save retires it again
+        {
+            auto const shard = shards_->writer (4);
+            expect (readOnly () == std::vector<bool> ({true, false, false}));
+            shards_->writer (6);
+            expect (readOnly () == std::vector<bool> ({true, false, false}));
+        }
+        shards_->writer (6);
+        expect (readOnly () == std::vector<bool> ({true, true, false}));
+    }
+
+    // Whether each shard is query only, oldest first.
+    std::vector<bool>
+    readOnly ()
+    {
+        std::vector<bool> ret;
+        for (auto const& shard : shards_->getJson ())
+            ret.push_back (shard["read_only"].asBool ());
+        return ret;
+    }
+
+    void
+    testShards ()
+    {
+        auto const all = shards_->select (
+            0, std::numeric_limits<std::uint32_t>::max (), true);
+        expect (all.size () == 3);
+        if (all.size () != 3)
+            return;
+        expect (all[0]->first () == 2 && all[0]->last () == 3);
+        expect (all[1]->first () == 4 && all[1]->last () == 5);
+        expect (all[2]->first () == 6 && all[2]->last () == 7);
+
+        auto const middle = shards_->select (4, 5, false);
+        expect (middle.size () == 1 && middle[0] == all[1]);
+
+        auto const backward = shards_->select (3, 6, false);
+        expect (backward.size () == 3 && backward[0] == all[2] &&
+            backward[2] == all[0]);
+
+        expect (shards_->getKBUsed () > 0);
+    }
+
+    // One page, the rows as (ledger, transaction index) pairs.
+    template <class Database>
+    Rows
+    page (Database& database, Application& app, int limit, bool forward,
+        Json::Value& token, std::int32_t minLedger, std::int32_t maxLedger)
+    {
+        NetworkOPs::AccountTxs txs;
+
+        auto bound = [&txs, &app](
+            std::uint32_t ledger_index,
+            std::string const& status,
+            Blob const& rawTxn,
+            Blob const& rawMeta)
+        {
+            convertBlobsToTxResult (
+                txs, ledger_index, status, rawTxn, rawMeta, app);
+        };
+
+        pageFrom (database, bound, limit, forward, token, minLedger,
+            maxLedger);
+
+        Rows ret;
+        for (auto const& tx : txs)
+            ret.emplace_back (tx.second->getLgrSeq (), tx.second->getIndex ());
+        return ret;
+    }
+
+    template <class Callback>
+    void
+    pageFrom (DatabaseCon& database, Callback const& bound, int limit,
+        bool forward, Json::Value& token, std::int32_t minLedger,
+        std::int32_t maxLedger)
+    {
+        accountTxPage (database, referenceSchema_->index (), *idCache_,
+            [](std::uint32_t){}, bound, account_, boost::none,
+            minLedger, maxLedger, forward, token, limit, true, 200);
+    }
+
+    template <class Callback>
+    void
+    pageFrom (TxnDBShards& shards, Callback const& bound, int limit,
+        bool forward, Json::Value& token, std::int32_t minLedger,
+        std::int32_t maxLedger)
+    {
+        accountTxPage (shards, *idCache_,
+            [](std::uint32_t){}, bound, account_, boost::none,
+            minLedger, maxLedger, forward, token, limit, true, 200);
+    }
+
+    // Markers carry a walk from one shard into the next.
+    void
+    testPaging (Application& app)
+    {
+        std::vector<std::pair<std::int32_t, std::int32_t>> const ranges {
+            {2, 9}, {3, 6}, {4, 5}, {5, 6}, {3, 3}, {7, 9}};
+
+        for (auto const& range : ranges)
+        {
+            for (bool const forward : {true, false})
+            {
+                for (int const limit : {1, 2, 3, 5, 20})
+                {
+                    Json::Value expectToken;
+                    Json::Value token;
+                    int pages = 0;
+                    do
+                    {
+                        auto const expected = page (*reference_, app, limit,
+                            forward, expectToken, range.first, range.second);
+                        auto const found = page (*shards_, app, limit,
+                            forward, token, range.first, range.second);
+                        expect (found == expected);
+                        expect (token == expectToken);
+                    }
+                    while (expectToken.isObject () && ++pages < 100);
+                }
+            }
+        }
+    }
+
+    // Offsets count rows in every shard before the one they land in.
+    void
+    testSeek ()
+    {
+        for (bool const forward : {true, false})
+        {
+            for (std::uint32_t skip = 0; skip <= 14; ++skip)
+            {
+                Json::Value expectToken;
+                bool const expected = accountTxSeek (*reference_,
+                    referenceSchema_->index (), *idCache_, account_,
+                        boost::none, 2, 9, forward, expectToken, skip);
+                expect (expected == (skip < 13));
+
+                Json::Value token;
+                bool const found = accountTxSeek (*shards_, *idCache_,
+                    account_, boost::none, 2, 9, forward, token, skip);
+                expect (found == expected);
+                if (found && expected)
+                    expect (token == expectToken);
+
+                // And again from a marker part way through the walk
+                Json::Value markerToken;
+                markerToken[jss::ledger] = forward ? 4 : 6;
+                markerToken[jss::seq] = forward ? 10 : 5;
+                expectToken = markerToken;
+                token = markerToken;
+
+                bool const fromMarker = accountTxSeek (*reference_,
+                    referenceSchema_->index (), *idCache_, account_,
+                        boost::none, 2, 9, forward, expectToken, skip);
+                expect (accountTxSeek (*shards_, *idCache_, account_,
+                    boost::none, 2, 9, forward, token, skip) == fromMarker);
+                if (fromMarker)
+                    expect (token == expectToken);
+            }
+        }
+    }
+
+    // Online delete removes whole shards and prunes the one it splits.
+    void
+    testDrop ()
+    {
+        auto pruned = shards_->dropPrior (4);
+        expect (pruned.empty ());
+        expect (! exists (1));
+        expect (exists (2));
+
+        pruned = shards_->dropPrior (5);
+        expect (pruned.size () == 1 && pruned[0]->first () == 4);
+        expect (exists (2));
+
+        // A shard in use is kept until the query finishes
+        auto held = shards_->select (6, 7, true);
+        pruned = shards_->dropPrior (8);
+        expect (pruned.empty ());
+        expect (! exists (2));
+        expect (exists (3));
+        expect (shards_->select (
+            0, std::numeric_limits<std::uint32_t>::max (), true).empty ());
+
+        held.clear ();
+        expect (! exists (3));
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(TxnDBShards,app,ripple);
+
+}
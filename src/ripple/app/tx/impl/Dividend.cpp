@@ -247,7 +247,7 @@ bool Dividend::updateDividendMap ()
     stpTrans.add (s2);
     
     //auto tItem = std::make_shared<SHAMapItem> (mTxn.getSigningHash(), s2.peekData ());
-    auto tItem = std::make_shared<SHAMapItem> (stpTrans.getTransactionID(), s2.peekData ());
+    auto tItem = make_shamapitem (stpTrans.getTransactionID(), s2.slice ());
     if (!divValidMap->addGiveItem (std::move(tItem), true, false))
     {
         JLOG(ctx.j.warning) << "dividend failed, while adding item to valid map.";
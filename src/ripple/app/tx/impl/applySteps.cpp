@@ -36,6 +36,7 @@
 #include <ripple/app/tx/impl/ActiveAccount.h>
 #include <ripple/app/tx/impl/Dividend.h>
 #include <ripple/app/tx/impl/IssueAsset.h>
+#include <ripple/core/Trace.h>
 
 namespace ripple {
 
@@ -212,6 +213,7 @@ preflight(Application& app, Rules const& rules,
     STTx const& tx, ApplyFlags flags,
         beast::Journal j)
 {
+    RIPPLE_TRACE_TX ("preflight", tx.getTransactionID ());
     PreflightContext const pfctx(app, tx,
         rules, flags, j);
     try
@@ -230,6 +232,7 @@ PreclaimResult
 preclaim (PreflightResult const& preflightResult,
     Application& app, OpenView const& view)
 {
+    RIPPLE_TRACE_TX ("preclaim", preflightResult.tx.getTransactionID ());
     boost::optional<PreclaimContext const> ctx;
     if (preflightResult.rules != view.rules())
     {
@@ -274,6 +277,7 @@ std::pair<TER, bool>
 doApply(PreclaimResult const& preclaimResult,
     Application& app, OpenView& view)
 {
+    RIPPLE_TRACE_TX ("doApply", preclaimResult.tx.getTransactionID ());
     if (preclaimResult.view.seq() != view.seq())
     {
         // Logic error from the caller. Don't have enough
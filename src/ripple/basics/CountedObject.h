@@ -20,7 +20,11 @@
 #ifndef RIPPLE_BASICS_COUNTEDOBJECT_H_INCLUDED
 #define RIPPLE_BASICS_COUNTEDOBJECT_H_INCLUDED
 
+#include <array>
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -38,6 +42,17 @@ public:
 
     List getCounts (int minimumThreshold) const;
 
+    using ByteEntry = std::pair <std::string, std::uint64_t>;
+    using ByteList = std::vector <ByteEntry>;
+
+    /** Returns the estimated memory used by each type, in bytes.
+
+        The estimate is the size of each instance plus whatever heap
+        memory the type accounts for with CountedObject::countBytes.
+        Types using less than the threshold are left out.
+    */
+    ByteList getBytes (std::uint64_t minimumThreshold) const;
+
 public:
     /** Implementation for @ref CountedObject.
 
@@ -46,7 +61,7 @@ public:
     class CounterBase
     {
     public:
-        CounterBase ();
+        explicit CounterBase (std::size_t size = 0);
 
         virtual ~CounterBase ();
 
@@ -65,6 +80,22 @@ public:
             return m_count.load ();
         }
 
+        void addBytes (std::ptrdiff_t bytes) noexcept
+        {
+            m_bytes[stripe ()].value.fetch_add (
+                bytes, std::memory_order_relaxed);
+        }
+
+        std::uint64_t getBytes () const noexcept
+        {
+            // Instances and their heap memory are counted separately,
+            // so a concurrent update may briefly go out of step
+            auto bytes = static_cast<std::int64_t> (getCount () * m_size);
+            for (auto const& s : m_bytes)
+                bytes += s.value.load (std::memory_order_relaxed);
+            return bytes > 0 ? bytes : 0;
+        }
+
         CounterBase* getNext () const noexcept
         {
             return m_next;
@@ -75,8 +106,29 @@ public:
     private:
         virtual void checkPureVirtual () const = 0;
 
+        // Heap memory is counted from every thread allocating it, so each
+        // thread adds to its own stripe on its own cache line, and reads
+        // add up all of them
+        static std::size_t const stripeCount = 16;
+
+        struct Stripe
+        {
+            std::atomic <std::int64_t> value {0};
+            char pad [64 - sizeof (std::atomic <std::int64_t>)];
+        };
+
+        static std::size_t stripe () noexcept
+        {
+            static std::atomic <std::size_t> next (0);
+            static thread_local std::size_t const index =
+                next++ % stripeCount;
+            return index;
+        }
+
     protected:
         std::atomic <int> m_count;
+        std::array <Stripe, stripeCount> m_bytes;
+        std::size_t const m_size;
         CounterBase* m_next;
     };
 
@@ -117,11 +169,24 @@ public:
         getCounter ().decrement ();
     }
 
+    /** Account for heap memory held on behalf of the type.
+
+        Whatever an instance adds it must take away again before it
+        is destroyed, by passing the negated amount.
+    */
+    static void countBytes (std::ptrdiff_t bytes) noexcept
+    {
+        getCounter ().addBytes (bytes);
+    }
+
 private:
     class Counter : public CountedObjects::CounterBase
     {
     public:
-        Counter () { }
+        Counter ()
+            : CountedObjects::CounterBase (sizeof (Object))
+        {
+        }
 
         char const* getName () const
         {
@@ -139,6 +204,59 @@ private:
     }
 };
 
+//------------------------------------------------------------------------------
+
+/** Allocator that counts its memory against a CountedObject type.
+
+    For containers that a counted object owns and grows after it is
+    constructed, so that the count follows every reallocation.
+*/
+template <class T, class Object>
+class CountedAllocator
+{
+public:
+    using value_type = T;
+
+    template <class U>
+    struct rebind
+    {
+        using other = CountedAllocator <U, Object>;
+    };
+
+    CountedAllocator () = default;
+
+    template <class U>
+    CountedAllocator (CountedAllocator <U, Object> const&) noexcept
+    {
+    }
+
+    T* allocate (std::size_t n)
+    {
+        auto const p = std::allocator <T> ().allocate (n);
+        CountedObject <Object>::countBytes (n * sizeof (T));
+        return p;
+    }
+
+    void deallocate (T* p, std::size_t n) noexcept
+    {
+        CountedObject <Object>::countBytes (
+            -static_cast<std::ptrdiff_t> (n * sizeof (T)));
+        std::allocator <T> ().deallocate (p, n);
+    }
+
+    template <class U>
+    bool operator== (CountedAllocator <U, Object> const&) const noexcept
+    {
+        return true;
+    }
+
+    template <class U>
+    bool operator!= (CountedAllocator <U, Object> const&) const noexcept
+    {
+        return false;
+    }
+};
+
 } // ripple
 
 #endif
@@ -25,7 +25,10 @@
 #include <beast/chrono/abstract_clock.h>
 #include <beast/chrono/chrono_io.h>
 #include <beast/Insight.h>
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <shared_mutex>
 
 namespace ripple {
 
@@ -34,6 +37,11 @@ namespace ripple {
     The cache has a target size and an expiration time. When cached items become
     older than the maximum age they are eligible for removal during a
     call to @ref sweep.
+
+    The keys are split into shards selected by hash. Lookups and touches
+    share their shard's lock with each other and update the access time
+    atomically, so only inserts, erases and sweeps need it exclusively.
+    Sweeping visits one shard at a time.
 */
 // VFALCO TODO Figure out how to pass through the allocator
 template <
@@ -41,7 +49,7 @@ template <
     class Hash = hardened_hash <>,
     class KeyEqual = std::equal_to <Key>,
     //class Allocator = std::allocator <std::pair <Key const, Entry>>,
-    class Mutex = std::mutex
+    class Mutex = std::shared_timed_mutex
 >
 class KeyCache
 {
@@ -49,6 +57,9 @@ public:
     using key_type = Key;
     using clock_type = beast::abstract_clock <std::chrono::steady_clock>;
 
+    // Number of independently locked parts of the cache
+    static constexpr std::size_t shardCount = 16;
+
 private:
     struct Stats
     {
@@ -58,43 +69,59 @@ private:
             : hook (collector->make_hook (handler))
             , size (collector->make_gauge (prefix, "size"))
             , hit_rate (collector->make_gauge (prefix, "hit_rate"))
-            , hits (0)
-            , misses (0)
             { }
 
         beast::insight::Hook hook;
         beast::insight::Gauge size;
         beast::insight::Gauge hit_rate;
-
-        std::size_t hits;
-        std::size_t misses;
     };
 
     struct Entry
     {
         explicit Entry (clock_type::time_point const& last_access_)
-            : last_access (last_access_)
+            : last_access (last_access_.time_since_epoch ().count ())
+        {
+        }
+
+        clock_type::time_point access () const
         {
+            return clock_type::time_point (clock_type::duration (
+                last_access.load (std::memory_order_relaxed)));
         }
 
-        clock_type::time_point last_access;
+        void touch (clock_type::time_point const& now)
+        {
+            last_access.store (now.time_since_epoch ().count (),
+                std::memory_order_relaxed);
+        }
+
+        std::atomic <clock_type::rep> last_access;
     };
 
     using map_type = hardened_hash_map <key_type, Entry, Hash, KeyEqual>;
     using iterator = typename map_type::iterator;
     using lock_guard = std::lock_guard <Mutex>;
+    using shared_lock = std::shared_lock <Mutex>;
+
+    struct Shard
+    {
+        Mutex mutable mutex;
+        map_type map;
+        std::atomic <std::size_t> mutable hits {0};
+        std::atomic <std::size_t> mutable misses {0};
+    };
 
 public:
     using size_type = typename map_type::size_type;
 
 private:
-    Mutex mutable m_mutex;
-    map_type m_map;
+    Hash m_hash;
+    std::array <Shard, shardCount> m_shards;
     Stats mutable m_stats;
     clock_type& m_clock;
     std::string const m_name;
-    size_type m_target_size;
-    clock_type::duration m_target_age;
+    std::atomic <size_type> m_target_size;
+    std::atomic <clock_type::rep> m_target_age;
 
 public:
     /** Construct with the specified name.
@@ -111,7 +138,8 @@ public:
         , m_clock (clock)
         , m_name (name)
         , m_target_size (target_size)
-        , m_target_age (std::chrono::seconds (expiration_seconds))
+        , m_target_age (std::chrono::duration_cast <clock_type::duration> (
+            std::chrono::seconds (expiration_seconds)).count ())
     {
     }
 
@@ -124,7 +152,8 @@ public:
         , m_clock (clock)
         , m_name (name)
         , m_target_size (target_size)
-        , m_target_age (std::chrono::seconds (expiration_seconds))
+        , m_target_age (std::chrono::duration_cast <clock_type::duration> (
+            std::chrono::seconds (expiration_seconds)).count ())
     {
     }
 
@@ -145,27 +174,34 @@ public:
     /** Returns the number of items in the container. */
     size_type size () const
     {
-        lock_guard lock (m_mutex);
-        return m_map.size ();
+        size_type n = 0;
+        for (auto const& shard : m_shards)
+        {
+            shared_lock lock (shard.mutex);
+            n += shard.map.size ();
+        }
+        return n;
     }
 
     /** Empty the cache */
     void clear ()
     {
-        lock_guard lock (m_mutex);
-        m_map.clear ();
+        for (auto& shard : m_shards)
+        {
+            lock_guard lock (shard.mutex);
+            shard.map.clear ();
+        }
     }
 
     void setTargetSize (size_type s)
     {
-        lock_guard lock (m_mutex);
         m_target_size = s;
     }
 
     void setTargetAge (size_type s)
     {
-        lock_guard lock (m_mutex);
-        m_target_age = std::chrono::seconds (s);
+        m_target_age = std::chrono::duration_cast <clock_type::duration> (
+            std::chrono::seconds (s)).count ();
     }
 
     /** Returns `true` if the key was found.
@@ -174,14 +210,15 @@ public:
     template <class KeyComparable>
     bool exists (KeyComparable const& key) const
     {
-        lock_guard lock (m_mutex);
-        typename map_type::const_iterator const iter (m_map.find (key));
-        if (iter != m_map.end ())
+        Shard const& shard = shardFor (key);
+        shared_lock lock (shard.mutex);
+        typename map_type::const_iterator const iter (shard.map.find (key));
+        if (iter != shard.map.end ())
         {
-            ++m_stats.hits;
+            ++shard.hits;
             return true;
         }
-        ++m_stats.misses;
+        ++shard.misses;
         return false;
     }
 
@@ -191,14 +228,15 @@ public:
     */
     bool insert (Key const& key)
     {
-        lock_guard lock (m_mutex);
+        Shard& shard = shardFor (key);
         clock_type::time_point const now (m_clock.now ());
-        std::pair <iterator, bool> result (m_map.emplace (
+        lock_guard lock (shard.mutex);
+        std::pair <iterator, bool> result (shard.map.emplace (
             std::piecewise_construct, std::forward_as_tuple (key),
                 std::forward_as_tuple (now)));
         if (! result.second)
         {
-            result.first->second.last_access = now;
+            result.first->second.touch (now);
             return false;
         }
         return true;
@@ -210,15 +248,16 @@ public:
     template <class KeyComparable>
     bool touch_if_exists (KeyComparable const& key)
     {
-        lock_guard lock (m_mutex);
-        iterator const iter (m_map.find (key));
-        if (iter == m_map.end ())
+        Shard& shard = shardFor (key);
+        shared_lock lock (shard.mutex);
+        iterator const iter (shard.map.find (key));
+        if (iter == shard.map.end ())
         {
-            ++m_stats.misses;
+            ++shard.misses;
             return false;
         }
-        iter->second.last_access = m_clock.now ();
-        ++m_stats.hits;
+        iter->second.touch (m_clock.now ());
+        ++shard.hits;
         return true;
     }
 
@@ -228,13 +267,14 @@ public:
     */
     bool erase (key_type const& key)
     {
-        lock_guard lock (m_mutex);
-        if (m_map.erase (key) > 0)
+        Shard& shard = shardFor (key);
+        lock_guard lock (shard.mutex);
+        if (shard.map.erase (key) > 0)
         {
-            ++m_stats.hits;
+            ++shard.hits;
             return true;
         }
-        ++m_stats.misses;
+        ++shard.misses;
         return false;
     }
 
@@ -244,17 +284,18 @@ public:
         clock_type::time_point const now (m_clock.now ());
         clock_type::time_point when_expire;
 
-        lock_guard lock (m_mutex);
+        auto const size = this->size ();
+        auto const target_size = m_target_size.load ();
+        clock_type::duration const target_age (m_target_age.load ());
 
-        if (m_target_size == 0 ||
-            (m_map.size () <= m_target_size))
+        if (target_size == 0 || (size <= target_size))
         {
-            when_expire = now - m_target_age;
+            when_expire = now - target_age;
         }
         else
         {
             when_expire = now - clock_type::duration (
-                m_target_age.count() * m_target_size / m_map.size ());
+                target_age.count() * target_size / size);
 
             clock_type::duration const minimumAge (
                 std::chrono::seconds (1));
@@ -262,27 +303,43 @@ public:
                 when_expire = now - minimumAge;
         }
 
-        iterator it = m_map.begin ();
-
-        while (it != m_map.end ())
+        for (auto& shard : m_shards)
         {
-            if (it->second.last_access > now)
-            {
-                it->second.last_access = now;
-                ++it;
-            }
-            else if (it->second.last_access <= when_expire)
-            {
-                it = m_map.erase (it);
-            }
-            else
+            lock_guard lock (shard.mutex);
+
+            iterator it = shard.map.begin ();
+
+            while (it != shard.map.end ())
             {
-                ++it;
+                auto const last_access = it->second.access ();
+                if (last_access > now)
+                {
+                    it->second.touch (now);
+                    ++it;
+                }
+                else if (last_access <= when_expire)
+                {
+                    it = shard.map.erase (it);
+                }
+                else
+                {
+                    ++it;
+                }
             }
         }
     }
 
 private:
+    Shard& shardFor (key_type const& key)
+    {
+        return m_shards[m_hash (key) % shardCount];
+    }
+
+    Shard const& shardFor (key_type const& key) const
+    {
+        return m_shards[m_hash (key) % shardCount];
+    }
+
     void collect_metrics ()
     {
         m_stats.size.set (size ());
@@ -290,16 +347,25 @@ private:
         {
             beast::insight::Gauge::value_type hit_rate (0);
             {
-                lock_guard lock (m_mutex);
-                auto const total (m_stats.hits + m_stats.misses);
+                std::size_t hits = 0;
+                std::size_t misses = 0;
+                for (auto const& shard : m_shards)
+                {
+                    hits += shard.hits.load ();
+                    misses += shard.misses.load ();
+                }
+                auto const total (hits + misses);
                 if (total != 0)
-                    hit_rate = (m_stats.hits * 100) / total;
+                    hit_rate = (hits * 100) / total;
             }
             m_stats.hit_rate.set (hit_rate);
         }
     }
 };
 
+template <class Key, class Hash, class KeyEqual, class Mutex>
+constexpr std::size_t KeyCache <Key, Hash, KeyEqual, Mutex>::shardCount;
+
 }
 
 #endif
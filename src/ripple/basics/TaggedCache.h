@@ -25,6 +25,7 @@
 #include <beast/chrono/abstract_clock.h>
 #include <beast/chrono/chrono_io.h>
 #include <beast/Insight.h>
+#include <array>
 #include <functional>
 #include <mutex>
 #include <vector>
@@ -43,6 +44,10 @@ struct TaggedCacheLog;
     If it stays in memory even after it is ejected from the cache,
     the map will track it.
 
+    The map is split into shards selected by the hash of the key, each
+    with its own lock, so threads working on different keys rarely wait
+    for each other. Sweeping visits one shard at a time.
+
     @note Callers must not modify data objects that are stored in the cache
           unless they hold their own lock over all cache operations.
 */
@@ -69,6 +74,9 @@ public:
     using mapped_ptr = std::shared_ptr <mapped_type>;
     using clock_type = beast::abstract_clock <std::chrono::steady_clock>;
 
+    // Number of independently locked parts of the map
+    static constexpr std::size_t shardCount = 16;
+
 public:
     // VFALCO TODO Change expiration_seconds to clock_type::duration
     TaggedCache (std::string const& name, int size,
@@ -82,9 +90,6 @@ public:
         , m_name (name)
         , m_target_size (size)
         , m_target_age (std::chrono::seconds (expiration_seconds))
-        , m_cache_count (0)
-        , m_hits (0)
-        , m_misses (0)
     {
     }
 
@@ -97,17 +102,27 @@ public:
 
     int getTargetSize () const
     {
-        lock_guard lock (m_mutex);
+        std::lock_guard <std::mutex> lock (m_settings_mutex);
         return m_target_size;
     }
 
     void setTargetSize (int s)
     {
-        lock_guard lock (m_mutex);
-        m_target_size = s;
+        {
+            std::lock_guard <std::mutex> lock (m_settings_mutex);
+            m_target_size = s;
+        }
 
         if (s > 0)
-            m_cache.rehash (static_cast<std::size_t> ((s + (s >> 2)) / m_cache.max_load_factor () + 1));
+        {
+            auto const perShard = (s + (s >> 2)) / shardCount + 1;
+            for (auto& shard : m_shards)
+            {
+                lock_guard lock (shard.mutex);
+                shard.cache.rehash (static_cast<std::size_t> (
+                    perShard / shard.cache.max_load_factor () + 1));
+            }
+        }
 
         if (m_journal.debug) m_journal.debug <<
             m_name << " target size set to " << s;
@@ -115,13 +130,13 @@ public:
 
     clock_type::rep getTargetAge () const
     {
-        lock_guard lock (m_mutex);
+        std::lock_guard <std::mutex> lock (m_settings_mutex);
         return m_target_age.count();
     }
 
     void setTargetAge (clock_type::rep s)
     {
-        lock_guard lock (m_mutex);
+        std::lock_guard <std::mutex> lock (m_settings_mutex);
         m_target_age = std::chrono::seconds (s);
         if (m_journal.debug) m_journal.debug <<
             m_name << " target age set to " << m_target_age;
@@ -129,35 +144,80 @@ public:
 
     int getCacheSize () const
     {
-        lock_guard lock (m_mutex);
-        return m_cache_count;
+        int count = 0;
+        for (auto const& shard : m_shards)
+        {
+            lock_guard lock (shard.mutex);
+            count += shard.cache_count;
+        }
+        return count;
     }
 
     int getTrackSize () const
     {
-        lock_guard lock (m_mutex);
-        return m_cache.size ();
+        std::size_t size = 0;
+        for (auto const& shard : m_shards)
+        {
+            lock_guard lock (shard.mutex);
+            size += shard.cache.size ();
+        }
+        return size;
+    }
+
+    /** Returns an estimate of the memory the cache uses, in bytes.
+
+        This covers the map itself and the objects it keeps alive, but
+        not memory the objects own; counted object types report that
+        themselves.
+    */
+    std::size_t getCacheBytes () const
+    {
+        // A node holds the entry and the next pointer, and hashes
+        // are cached beside them
+        std::size_t const nodeBytes = sizeof (
+            typename cache_type::value_type) + 2 * sizeof (void*);
+
+        std::size_t bytes = 0;
+        for (auto const& shard : m_shards)
+        {
+            lock_guard lock (shard.mutex);
+            bytes += shard.cache.size () * nodeBytes +
+                shard.cache.bucket_count () * sizeof (void*) +
+                    shard.cache_count * sizeof (mapped_type);
+        }
+        return bytes;
     }
 
     float getHitRate ()
     {
-        lock_guard lock (m_mutex);
-        auto const total = static_cast<float> (m_hits + m_misses);
-        return m_hits * (100.0f / std::max (1.0f, total));
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        getStats (hits, misses);
+        auto const total = static_cast<float> (hits + misses);
+        return hits * (100.0f / std::max (1.0f, total));
     }
 
     void clearStats ()
     {
-        lock_guard lock (m_mutex);
-        m_hits = 0;
-        m_misses = 0;
+        for (auto& shard : m_shards)
+        {
+            lock_guard lock (shard.mutex);
+            shard.hits = 0;
+            shard.misses = 0;
+        }
     }
 
     void clear ()
     {
-        lock_guard lock (m_mutex);
-        m_cache.clear ();
-        m_cache_count = 0;
+        for (auto& shard : m_shards)
+        {
+            cache_type cleared;
+            {
+                lock_guard lock (shard.mutex);
+                cleared.swap (shard.cache);
+                shard.cache_count = 0;
+            }
+        }
     }
 
     void sweep ()
@@ -166,26 +226,21 @@ public:
         int mapRemovals = 0;
         int cc = 0;
 
-        // Keep references to all the stuff we sweep
-        // so that we can destroy them outside the lock.
-        //
-        std::vector <mapped_ptr> stuffToSweep;
+        clock_type::time_point const now (m_clock.now());
+        clock_type::time_point when_expire;
 
+        auto const trackSize = getTrackSize ();
         {
-            clock_type::time_point const now (m_clock.now());
-            clock_type::time_point when_expire;
-
-            lock_guard lock (m_mutex);
+            std::lock_guard <std::mutex> lock (m_settings_mutex);
 
-            if (m_target_size == 0 ||
-                (static_cast<int> (m_cache.size ()) <= m_target_size))
+            if (m_target_size == 0 || (trackSize <= m_target_size))
             {
                 when_expire = now - m_target_age;
             }
             else
             {
                 when_expire = now - clock_type::duration (
-                    m_target_age.count() * m_target_size / m_cache.size ());
+                    m_target_age.count() * m_target_size / trackSize);
 
                 clock_type::duration const minimumAge (
                     std::chrono::seconds (1));
@@ -193,72 +248,84 @@ public:
                     when_expire = now - minimumAge;
 
                 if (m_journal.trace) m_journal.trace <<
-                    m_name << " is growing fast " << m_cache.size () << " of " << m_target_size <<
+                    m_name << " is growing fast " << trackSize << " of " << m_target_size <<
                         " aging at " << (now - when_expire) << " of " << m_target_age;
             }
+        }
 
-            stuffToSweep.reserve (m_cache.size ());
-
-            cache_iterator cit = m_cache.begin ();
+        // Keep references to all the stuff we sweep from a shard
+        // so that we can destroy them outside its lock.
+        //
+        std::vector <mapped_ptr> stuffToSweep;
 
-            while (cit != m_cache.end ())
+        for (auto& shard : m_shards)
+        {
             {
-                if (cit->second.isWeak ())
+                lock_guard lock (shard.mutex);
+
+                cache_iterator cit = shard.cache.begin ();
+
+                while (cit != shard.cache.end ())
                 {
-                    // weak
-                    if (cit->second.isExpired ())
+                    if (cit->second.isWeak ())
                     {
-                        ++mapRemovals;
-                        cit = m_cache.erase (cit);
+                        // weak
+                        if (cit->second.isExpired ())
+                        {
+                            ++mapRemovals;
+                            cit = shard.cache.erase (cit);
+                        }
+                        else
+                        {
+                            ++cit;
+                        }
                     }
-                    else
+                    else if (cit->second.last_access <= when_expire)
                     {
-                        ++cit;
-                    }
-                }
-                else if (cit->second.last_access <= when_expire)
-                {
-                    // strong, expired
-                    --m_cache_count;
-                    ++cacheRemovals;
-                    if (cit->second.ptr.unique ())
-                    {
-                        stuffToSweep.push_back (cit->second.ptr);
-                        ++mapRemovals;
-                        cit = m_cache.erase (cit);
+                        // strong, expired
+                        --shard.cache_count;
+                        ++cacheRemovals;
+                        if (cit->second.ptr.unique ())
+                        {
+                            stuffToSweep.push_back (std::move (cit->second.ptr));
+                            ++mapRemovals;
+                            cit = shard.cache.erase (cit);
+                        }
+                        else
+                        {
+                            // remains weakly cached
+                            cit->second.ptr.reset ();
+                            ++cit;
+                        }
                     }
                     else
                     {
-                        // remains weakly cached
-                        cit->second.ptr.reset ();
+                        // strong, not expired
+                        ++cc;
                         ++cit;
                     }
                 }
-                else
-                {
-                    // strong, not expired
-                    ++cc;
-                    ++cit;
-                }
             }
+
+            // Decrement the reference count on each strong pointer
+            // outside the lock.
+            stuffToSweep.clear ();
         }
 
         if (m_journal.trace && (mapRemovals || cacheRemovals)) m_journal.trace <<
-            m_name << ": cache = " << m_cache.size () << "-" << cacheRemovals <<
+            m_name << ": cache = " << trackSize << "-" << cacheRemovals <<
                 ", map-=" << mapRemovals;
-
-        // At this point stuffToSweep will go out of scope outside the lock
-        // and decrement the reference count on each strong pointer.
     }
 
     bool del (const key_type& key, bool valid)
     {
         // Remove from cache, if !valid, remove from map too. Returns true if removed from cache
-        lock_guard lock (m_mutex);
+        Shard& shard = shardFor (key);
+        lock_guard lock (shard.mutex);
 
-        cache_iterator cit = m_cache.find (key);
+        cache_iterator cit = shard.cache.find (key);
 
-        if (cit == m_cache.end ())
+        if (cit == shard.cache.end ())
             return false;
 
         Entry& entry = cit->second;
@@ -267,13 +334,13 @@ public:
 
         if (entry.isCached ())
         {
-            --m_cache_count;
+            --shard.cache_count;
             entry.ptr.reset ();
             ret = true;
         }
 
         if (!valid || entry.isExpired ())
-            m_cache.erase (cit);
+            shard.cache.erase (cit);
 
         return ret;
     }
@@ -295,16 +362,17 @@ public:
     {
         // Return canonical value, store if needed, refresh in cache
         // Return values: true=we had the data already
-        lock_guard lock (m_mutex);
+        Shard& shard = shardFor (key);
+        lock_guard lock (shard.mutex);
 
-        cache_iterator cit = m_cache.find (key);
+        cache_iterator cit = shard.cache.find (key);
 
-        if (cit == m_cache.end ())
+        if (cit == shard.cache.end ())
         {
-            m_cache.emplace (std::piecewise_construct,
+            shard.cache.emplace (std::piecewise_construct,
                 std::forward_as_tuple(key),
                 std::forward_as_tuple(m_clock.now(), data));
-            ++m_cache_count;
+            ++shard.cache_count;
             return false;
         }
 
@@ -341,13 +409,13 @@ public:
                 data = cachedData;
             }
 
-            ++m_cache_count;
+            ++shard.cache_count;
             return true;
         }
 
         entry.ptr = data;
         entry.weak_ptr = data;
-        ++m_cache_count;
+        ++shard.cache_count;
 
         return false;
     }
@@ -355,13 +423,14 @@ public:
     std::shared_ptr<T> fetch (const key_type& key)
     {
         // fetch us a shared pointer to the stored data object
-        lock_guard lock (m_mutex);
+        Shard& shard = shardFor (key);
+        lock_guard lock (shard.mutex);
 
-        cache_iterator cit = m_cache.find (key);
+        cache_iterator cit = shard.cache.find (key);
 
-        if (cit == m_cache.end ())
+        if (cit == shard.cache.end ())
         {
-            ++m_misses;
+            ++shard.misses;
             return mapped_ptr ();
         }
 
@@ -370,7 +439,7 @@ public:
 
         if (entry.isCached ())
         {
-            ++m_hits;
+            ++shard.hits;
             return entry.ptr;
         }
 
@@ -379,12 +448,12 @@ public:
         if (entry.isCached ())
         {
             // independent of cache size, so not counted as a hit
-            ++m_cache_count;
+            ++shard.cache_count;
             return entry.ptr;
         }
 
-        m_cache.erase (cit);
-        ++m_misses;
+        shard.cache.erase (cit);
+        ++shard.misses;
         return mapped_ptr ();
     }
 
@@ -426,11 +495,12 @@ public:
         bool found = false;
 
         // If present, make current in cache
-        lock_guard lock (m_mutex);
+        Shard& shard = shardFor (key);
+        lock_guard lock (shard.mutex);
 
-        cache_iterator cit = m_cache.find (key);
+        cache_iterator cit = shard.cache.find (key);
 
-        if (cit != m_cache.end ())
+        if (cit != shard.cache.end ())
         {
             Entry& entry = cit->second;
 
@@ -442,7 +512,7 @@ public:
                 if (entry.isCached ())
                 {
                     // We just put the object back in cache
-                    ++m_cache_count;
+                    ++shard.cache_count;
                     entry.touch (m_clock.now());
                     found = true;
                 }
@@ -450,7 +520,7 @@ public:
                 {
                     // Couldn't get strong pointer,
                     // object fell out of the cache so remove the entry.
-                    m_cache.erase (cit);
+                    shard.cache.erase (cit);
                 }
             }
             else
@@ -468,6 +538,11 @@ public:
         return found;
     }
 
+    /** Returns a mutex callers may use to make a series of cache
+        operations, and changes to the objects they return, atomic with
+        respect to each other. The cache's own operations lock only the
+        shard holding the key and do not take this mutex.
+    */
     mutex_type& peekMutex ()
     {
         return m_mutex;
@@ -477,28 +552,59 @@ public:
     {
         std::vector <key_type> v;
 
+        for (auto& shard : m_shards)
         {
-            lock_guard lock (m_mutex);
-            v.reserve (m_cache.size());
-            for (auto const& _ : m_cache)
+            lock_guard lock (shard.mutex);
+            v.reserve (v.size () + shard.cache.size());
+            for (auto const& _ : shard.cache)
                 v.push_back (_.first);
         }
 
         return v;
     }
 
+    /** Returns the objects held or tracked, without counting as uses. */
+    std::vector <mapped_ptr> getValues ()
+    {
+        std::vector <mapped_ptr> v;
+
+        for (auto& shard : m_shards)
+        {
+            lock_guard lock (shard.mutex);
+            v.reserve (v.size () + shard.cache.size());
+            for (auto& _ : shard.cache)
+                if (auto ptr = _.second.lock ())
+                    v.push_back (std::move (ptr));
+        }
+
+        return v;
+    }
+
 private:
+    void getStats (std::uint64_t& hits, std::uint64_t& misses) const
+    {
+        for (auto const& shard : m_shards)
+        {
+            lock_guard lock (shard.mutex);
+            hits += shard.hits;
+            misses += shard.misses;
+        }
+    }
+
     void collect_metrics ()
     {
         m_stats.size.set (getCacheSize ());
+        m_stats.bytes.set (getCacheBytes ());
 
         {
             beast::insight::Gauge::value_type hit_rate (0);
             {
-                lock_guard lock (m_mutex);
-                auto const total (m_hits + m_misses);
+                std::uint64_t hits = 0;
+                std::uint64_t misses = 0;
+                getStats (hits, misses);
+                auto const total (hits + misses);
                 if (total != 0)
-                    hit_rate = (m_hits * 100) / total;
+                    hit_rate = (hits * 100) / total;
             }
             m_stats.hit_rate.set (hit_rate);
         }
@@ -513,11 +619,13 @@ private:
             : hook (collector->make_hook (handler))
             , size (collector->make_gauge (prefix, "size"))
             , hit_rate (collector->make_gauge (prefix, "hit_rate"))
+            , bytes (collector->make_gauge (prefix, "bytes"))
             { }
 
         beast::insight::Hook hook;
         beast::insight::Gauge size;
         beast::insight::Gauge hit_rate;
+        beast::insight::Gauge bytes;
     };
 
     class Entry
@@ -545,6 +653,22 @@ private:
     using cache_type = hardened_hash_map <key_type, Entry, Hash, KeyEqual>;
     using cache_iterator = typename cache_type::iterator;
 
+    struct Shard
+    {
+        mutex_type mutable mutex;
+
+        // Number of items cached
+        int cache_count = 0;
+        cache_type cache;  // Hold strong reference to recent objects
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+    };
+
+    Shard& shardFor (key_type const& key)
+    {
+        return m_shards[m_hash (key) % shardCount];
+    }
+
     beast::Journal m_journal;
     clock_type& m_clock;
     Stats m_stats;
@@ -554,19 +678,22 @@ private:
     // Used for logging
     std::string m_name;
 
+    // Protects the target size and age
+    std::mutex mutable m_settings_mutex;
+
     // Desired number of cache entries (0 = ignore)
     int m_target_size;
 
     // Desired maximum cache age
     clock_type::duration m_target_age;
 
-    // Number of items cached
-    int m_cache_count;
-    cache_type m_cache;  // Hold strong reference to recent objects
-    std::uint64_t m_hits;
-    std::uint64_t m_misses;
+    Hash m_hash;
+    std::array <Shard, shardCount> m_shards;
 };
 
+template <class Key, class T, class Hash, class KeyEqual, class Mutex>
+constexpr std::size_t TaggedCache <Key, T, Hash, KeyEqual, Mutex>::shardCount;
+
 }
 
 #endif
@@ -69,10 +69,28 @@ CountedObjects::List CountedObjects::getCounts (int minimumThreshold) const
     return counts;
 }
 
+CountedObjects::ByteList
+CountedObjects::getBytes (std::uint64_t minimumThreshold) const
+{
+    ByteList bytes;
+    bytes.reserve (m_count.load ());
+
+    for (auto counter = m_head.load (); counter != nullptr;
+        counter = counter->getNext ())
+    {
+        auto const used = counter->getBytes ();
+        if (used >= minimumThreshold)
+            bytes.emplace_back (counter->getName (), used);
+    }
+
+    return bytes;
+}
+
 //------------------------------------------------------------------------------
 
-CountedObjects::CounterBase::CounterBase ()
+CountedObjects::CounterBase::CounterBase (std::size_t size)
     : m_count (0)
+    , m_size (size)
 {
     // Insert ourselves at the front of the lock-free linked list
 
@@ -0,0 +1,132 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/basics/CountedObject.h>
+#include <beast/unit_test/suite.h>
+#include <algorithm>
+#include <vector>
+
+namespace ripple {
+
+class CountedObject_test : public beast::unit_test::suite
+{
+    class Sized : public CountedObject <Sized>
+    {
+    public:
+        static char const* getCountedObjectName ()
+        {
+            return "CountedObject_test::Sized";
+        }
+
+        explicit Sized (std::size_t payload)
+            : payload_ (payload)
+        {
+            countBytes (payload_);
+        }
+
+        ~Sized ()
+        {
+            countBytes (-static_cast<std::ptrdiff_t> (payload_));
+        }
+
+        Sized (Sized const&) = delete;
+
+        // Storage that is counted as it grows
+        std::vector <int, CountedAllocator <int, Sized>> v;
+
+    private:
+        std::size_t payload_;
+        char fill_[64];
+    };
+
+    template <class List>
+    typename List::value_type::second_type
+    find (List const& list, std::string const& name)
+    {
+        auto const iter = std::find_if (list.begin (), list.end (),
+            [&name](typename List::value_type const& e)
+            {
+                return e.first == name;
+            });
+        if (iter == list.end ())
+            return 0;
+        return iter->second;
+    }
+
+    int
+    count ()
+    {
+        return find (CountedObjects::getInstance ().getCounts (0),
+            Sized::getCountedObjectName ());
+    }
+
+    std::uint64_t
+    bytes ()
+    {
+        return find (CountedObjects::getInstance ().getBytes (0),
+            Sized::getCountedObjectName ());
+    }
+
+public:
+    void
+    run ()
+    {
+        testcase ("bytes");
+
+        expect (count () == 0);
+        expect (bytes () == 0);
+
+        {
+            Sized a (100);
+            expect (count () == 1);
+            expect (bytes () == sizeof (Sized) + 100);
+
+            {
+                Sized b (1000);
+                expect (count () == 2);
+                expect (bytes () == 2 * sizeof (Sized) + 1100);
+            }
+            expect (bytes () == sizeof (Sized) + 100);
+
+            // A threshold leaves out the types using less
+            expect (find (CountedObjects::getInstance ().getBytes (
+                sizeof (Sized) + 101), Sized::getCountedObjectName ()) == 0);
+            expect (find (CountedObjects::getInstance ().getBytes (
+                sizeof (Sized) + 100), Sized::getCountedObjectName ()) ==
+                    sizeof (Sized) + 100);
+
+            a.v.reserve (50);
+            expect (bytes () == sizeof (Sized) + 100 +
+                a.v.capacity () * sizeof (int));
+
+            a.v.clear ();
+            a.v.shrink_to_fit ();
+            expect (bytes () == sizeof (Sized) + 100 +
+                a.v.capacity () * sizeof (int));
+        }
+
+        expect (count () == 0);
+        expect (bytes () == 0);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(CountedObject,basics,ripple);
+
+} // ripple
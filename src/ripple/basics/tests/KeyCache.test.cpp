@@ -20,8 +20,11 @@
 #include <BeastConfig.h>
 #include <ripple/basics/chrono.h>
 #include <ripple/basics/KeyCache.h>
+#include <ripple/basics/base_uint.h>
 #include <beast/unit_test/suite.h>
 #include <beast/chrono/manual_clock.h>
+#include <chrono>
+#include <thread>
 
 namespace ripple {
 
@@ -89,9 +92,101 @@ public:
             c.sweep ();
             expect (c.size () < 3);
         }
+
+        // Touch keys from several threads while another inserts, then
+        // make sure only the keys left untouched expire.
+        {
+            Cache c ("test", clock, 0, 2);
+
+            int const keys = 1000;
+            for (int k = 0; k < keys; ++k)
+                expect (c.insert (std::to_string (k)));
+            ++clock;
+
+            std::vector <std::thread> workers;
+            for (int t = 0; t < 4; ++t)
+            {
+                workers.emplace_back ([&c, t, keys]
+                {
+                    for (int k = t; k < keys; k += 8)
+                        c.touch_if_exists (std::to_string (k));
+                });
+            }
+            workers.emplace_back ([&c, keys]
+            {
+                for (int k = keys; k < 2 * keys; ++k)
+                    c.insert (std::to_string (k));
+            });
+            for (auto& w : workers)
+                w.join ();
+            expect (c.size () == 2 * keys);
+
+            ++clock;
+            c.sweep ();
+            expect (c.size () == keys + keys / 2);
+            for (int k = 0; k < keys; ++k)
+                expect (c.exists (std::to_string (k)) == (k % 8 < 4));
+        }
     }
 };
 
 BEAST_DEFINE_TESTSUITE(KeyCache,common,ripple);
 
+//------------------------------------------------------------------------------
+
+// Time touching keys from several threads, as SHAMap sync does with
+// the full below cache
+class KeyCacheTiming_test : public beast::unit_test::suite
+{
+public:
+    void run ()
+    {
+        using namespace std::chrono;
+
+        TestStopwatch clock;
+        clock.set (0);
+
+        using Cache = KeyCache <uint256>;
+
+        int const keys = 100000;
+        int const operations = 4000000;
+
+        std::vector <uint256> key (keys);
+        for (int k = 0; k < keys; ++k)
+            key[k] = uint256 (k);
+
+        for (int threads : {1, 4, 16})
+        {
+            Cache c ("timing", clock, keys, 120);
+            for (int k = 0; k < keys; k += 2)
+                c.insert (key[k]);
+
+            auto const start = steady_clock::now ();
+            std::vector <std::thread> workers;
+            for (int t = 0; t < threads; ++t)
+            {
+                workers.emplace_back ([&c, &key, t, threads, keys, operations]
+                {
+                    std::size_t k = t * 7919;
+                    for (int i = t; i < operations; i += threads)
+                    {
+                        k = (k + 104729) % keys;
+                        c.touch_if_exists (key[k]);
+                    }
+                });
+            }
+            for (auto& w : workers)
+                w.join ();
+            auto const elapsed = duration_cast<milliseconds> (
+                steady_clock::now () - start);
+
+            expect (c.size () == keys / 2);
+            log << threads << " threads: " << operations << " touches in " <<
+                elapsed.count () << "ms";
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(KeyCacheTiming,common,ripple);
+
 }
@@ -20,8 +20,11 @@
 #include <BeastConfig.h>
 #include <ripple/basics/chrono.h>
 #include <ripple/basics/TaggedCache.h>
+#include <ripple/basics/base_uint.h>
 #include <beast/unit_test/suite.h>
 #include <beast/chrono/manual_clock.h>
+#include <chrono>
+#include <thread>
 
 namespace ripple {
 
@@ -144,9 +147,114 @@ public:
             expect (c.getCacheSize() == 0);
             expect (c.getTrackSize() == 0);
         }
+
+        // Canonicalize the same keys from several threads at once and
+        // make sure every thread ends up with the same objects.
+        {
+            int const keys = 1000;
+            int const threads = 4;
+
+            std::vector <std::vector <Cache::mapped_ptr>> seen (threads);
+            std::vector <std::thread> workers;
+            for (int t = 0; t < threads; ++t)
+            {
+                workers.emplace_back ([&c, &seen, t, keys]
+                {
+                    for (int k = 0; k < keys; ++k)
+                    {
+                        auto p = std::make_shared <Value> (std::to_string (k));
+                        c.canonicalize (k, p);
+                        seen[t].push_back (p);
+                    }
+                });
+            }
+            for (auto& w : workers)
+                w.join ();
+
+            expect (c.getCacheSize() == keys);
+            expect (c.getTrackSize() == keys);
+            for (int k = 0; k < keys; ++k)
+            {
+                auto const p = c.fetch (k);
+                for (int t = 0; t < threads; ++t)
+                    expect (seen[t][k] == p);
+            }
+
+            seen.clear ();
+            ++clock;
+            c.sweep ();
+            expect (c.getCacheSize() == 0);
+            expect (c.getTrackSize() == 0);
+        }
     }
 };
 
 BEAST_DEFINE_TESTSUITE(TaggedCache,common,ripple);
 
+//------------------------------------------------------------------------------
+
+// Time fetch and canonicalize on a shared cache from several threads
+class TaggedCacheTiming_test : public beast::unit_test::suite
+{
+public:
+    void run ()
+    {
+        using namespace std::chrono;
+
+        beast::Journal const j;
+        TestStopwatch clock;
+        clock.set (0);
+
+        using Cache = TaggedCache <uint256, int>;
+
+        int const keys = 100000;
+        int const operations = 2000000;
+
+        std::vector <uint256> key (keys);
+        for (int k = 0; k < keys; ++k)
+            key[k] = uint256 (k);
+
+        for (int threads : {1, 2, 4, 8, 16})
+        {
+            Cache c ("timing", keys, 60, clock, j);
+            for (int k = 0; k < keys; k += 2)
+                c.insert (key[k], k);
+
+            // Half fetches, a quarter of which miss, and half canonicalize
+            auto const start = steady_clock::now ();
+            std::vector <std::thread> workers;
+            for (int t = 0; t < threads; ++t)
+            {
+                workers.emplace_back ([&c, &key, t, threads, keys, operations]
+                {
+                    std::size_t k = t * 7919;
+                    for (int i = t; i < operations; i += threads)
+                    {
+                        k = (k + 104729) % keys;
+                        if (i & 1)
+                        {
+                            c.fetch (key[k]);
+                        }
+                        else
+                        {
+                            auto p = std::make_shared <int> (k);
+                            c.canonicalize (key[k], p);
+                        }
+                    }
+                });
+            }
+            for (auto& w : workers)
+                w.join ();
+            auto const elapsed = duration_cast<milliseconds> (
+                steady_clock::now () - start);
+
+            expect (c.getTrackSize () == keys);
+            log << threads << " threads: " << operations << " operations in " <<
+                elapsed.count () << "ms";
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(TaggedCacheTiming,common,ripple);
+
 }
@@ -0,0 +1,68 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_CORE_AFFINITY_H_INCLUDED
+#define RIPPLE_CORE_AFFINITY_H_INCLUDED
+
+#include <ripple/basics/BasicConfig.h>
+#include <beast/utility/Journal.h>
+#include <boost/optional.hpp>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** The groups of threads that the [affinity] section places. */
+enum class ThreadClass
+{
+    jobs,       // Job queue workers
+    io,         // Threads running the io_service
+    nodestore   // Node store read threads
+};
+
+/** Parse a list of CPUs such as "0-3,8,10-11".
+
+    @return The CPUs in ascending order, or none if the list is malformed.
+*/
+boost::optional<std::vector<unsigned>>
+parseCpuList (std::string const& list);
+
+/** Configure thread placement from the [affinity] section.
+
+    Must be called before any of the threads start. A malformed list, a
+    CPU the process may not run on, or an unknown thread class throws.
+*/
+void
+setupAffinity (Section const& section, beast::Journal journal);
+
+/** Restrict the calling thread to the CPUs configured for its class.
+
+    Memory the thread then allocates and touches first is placed on its
+    own NUMA node by the kernel.
+
+    @return `false` if nothing was configured for the class, the
+            platform cannot pin threads, or pinning failed. A failure is
+            logged with the thread class and its CPUs.
+*/
+bool
+pinCurrentThread (ThreadClass threads);
+
+} // ripple
+
+#endif
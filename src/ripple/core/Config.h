@@ -65,7 +65,7 @@ enum SizedItemName
     siSweepInterval,
     siNodeCacheSize,
     siNodeCacheAge,
-    siTreeCacheSize,
+    siTreeCacheMB,
     siTreeCacheAge,
     siSLECacheSize,
     siSLECacheAge,
@@ -32,6 +32,7 @@ struct ConfigSection
 };
 
 // VFALCO TODO Rename and replace these macros with variables.
+#define SECTION_AFFINITY                "affinity"
 #define SECTION_AMENDMENTS              "amendments"
 #define SECTION_CLUSTER_NODES           "cluster_nodes"
 #define SECTION_CONSENSUS               "consensus"
@@ -61,6 +62,7 @@ struct ConfigSection
 #define SECTION_SSL_VERIFY              "ssl_verify"
 #define SECTION_SSL_VERIFY_FILE         "ssl_verify_file"
 #define SECTION_SSL_VERIFY_DIR          "ssl_verify_dir"
+#define SECTION_TRACING                 "tracing"
 #define SECTION_TX_DB                   "transaction_db"
 #define SECTION_TX_DB_HBASE             "tx_db_hbase"
 #define SECTION_VALIDATORS_FILE         "validators_file"
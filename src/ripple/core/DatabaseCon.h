@@ -23,6 +23,9 @@
 #include <ripple/core/Config.h>
 #include <ripple/core/SociDB.h>
 #include <boost/filesystem/path.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <string>
 
@@ -46,6 +49,10 @@ public:
     LockedPointer (T* it, mutex& m) : it_ (it), lock_ (m)
     {
     }
+    LockedPointer (T* it, std::unique_lock<mutex>&& lock)
+        : it_ (it), lock_ (std::move (lock))
+    {
+    }
     LockedPointer (LockedPointer&& rhs) noexcept
         : it_ (rhs.it_), lock_ (std::move (rhs.lock_))
     {
@@ -109,7 +116,31 @@ public:
 
     LockedSociSession checkoutDb ()
     {
-        return LockedSociSession (&session_, lock_);
+        std::unique_lock<LockedSociSession::mutex> lock (
+            lock_, std::try_to_lock);
+        if (! lock.owns_lock ())
+        {
+            // Only contended checkouts pay for reading the clock
+            auto const start = std::chrono::steady_clock::now ();
+            lock.lock ();
+            ++lockWaits_;
+            lockWaitTime_ += std::chrono::duration_cast<
+                std::chrono::microseconds> (
+                    std::chrono::steady_clock::now () - start).count ();
+        }
+        return LockedSociSession (&session_, std::move (lock));
+    }
+
+    /** Number of checkouts which had to wait for another holder. */
+    std::uint64_t lockWaits () const
+    {
+        return lockWaits_;
+    }
+
+    /** Total time spent waiting in those checkouts. */
+    std::chrono::microseconds lockWaitTime () const
+    {
+        return std::chrono::microseconds (lockWaitTime_.load ());
     }
 
     void setupCheckpointing (JobQueue*, Logs&);
@@ -138,6 +169,8 @@ public:
 
 private:
     LockedSociSession::mutex lock_;
+    std::atomic<std::uint64_t> lockWaits_ {0};
+    std::atomic<std::uint64_t> lockWaitTime_ {0};
     std::mutex mutex_;
     bool isConnecting = false;
 
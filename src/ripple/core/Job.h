@@ -111,17 +111,26 @@ public:
          std::uint64_t index,
          LoadMonitor& lm,
          std::function <void (Job&)> const& job,
-         CancelCallback cancelCallback);
+         CancelCallback cancelCallback,
+         clock_type::duration deadline = clock_type::duration::zero ());
 
     //Job& operator= (Job const& other);
 
     JobType getType () const;
 
+    std::string const& getName () const;
+
     CancelCallback getCancelCallback () const;
 
     /** Returns the time when the job was queued. */
     clock_type::time_point const& queue_time () const;
 
+    /** Returns `true` if the job should start before deadline(). */
+    bool hasDeadline () const;
+
+    /** Returns the time by which the job should have started. */
+    clock_type::time_point deadline () const;
+
     /** Returns `true` if the running job should make a best-effort cancel. */
     bool shouldCancel () const;
 
@@ -144,6 +153,7 @@ private:
     LoadEvent::pointer          m_loadEvent;
     std::string                 mName;
     clock_type::time_point m_queue_time;
+    clock_type::duration m_deadline;
 };
 
 }
@@ -45,8 +45,14 @@ private:
     std::mutex mutex_;
     boost::coroutines::asymmetric_coroutine<void>::pull_type coro_;
     boost::coroutines::asymmetric_coroutine<void>::push_type* yield_;
+    int asyncReads_ = 0;
+
+    // Makes coro the one current() returns, and returns the previous one
+    static JobCoro* exchangeCurrent (JobCoro* coro);
 
 public:
+    class AsyncReads;
+
     // Private: Used in the implementation
     template <class F>
     JobCoro (detail::JobCoro_create_t, JobQueue&, JobType,
@@ -72,6 +78,49 @@ public:
         Undefined behavior if called consecutively without a corresponding yield.
     */
     void post ();
+
+    /** Returns the coroutine running on this thread, or `nullptr`. */
+    static JobCoro* current ();
+
+    /** Returns `true` if node store reads may suspend this coroutine.
+
+        @see AsyncReads
+    */
+    bool asyncReads () const
+    {
+        return asyncReads_ > 0;
+    }
+};
+
+/** Lets node store reads suspend a coroutine while this exists.
+
+    A SHAMap that has to go to the database then suspends the coroutine
+    until the read completes, rather than holding a job thread. No lock
+    may be held across such reads, since the coroutine may resume on
+    another thread.
+*/
+class JobCoro::AsyncReads
+{
+private:
+    std::shared_ptr<JobCoro> coro_;
+
+public:
+    /** @param coro The coroutine, which may be `nullptr`. */
+    explicit AsyncReads (std::shared_ptr<JobCoro> coro)
+        : coro_ (std::move (coro))
+    {
+        if (coro_)
+            ++coro_->asyncReads_;
+    }
+
+    AsyncReads (AsyncReads const&) = delete;
+    AsyncReads& operator= (AsyncReads const&) = delete;
+
+    ~AsyncReads ()
+    {
+        if (coro_)
+            --coro_->asyncReads_;
+    }
 };
 
 } // ripple
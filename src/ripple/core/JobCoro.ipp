@@ -46,19 +46,6 @@ JobCoro::yield () const
     (*yield_)();
 }
 
-inline
-void
-JobCoro::post ()
-{
-    // sp keeps 'this' alive
-    jq_.addJob(type_, name_,
-        [this, sp = shared_from_this()](Job&)
-        {
-            std::lock_guard<std::mutex> lock (mutex_);
-            coro_();
-        });
-}
-
 } // ripple
 
 #endif
@@ -29,7 +29,6 @@
 #include <beast/module/core/thread/Workers.h>
 #include <boost/function.hpp>
 #include <thread>
-#include <set>
 
 namespace ripple {
 
@@ -69,14 +68,34 @@ public:
     */
     int getJobCountGE (JobType t) const;
 
+    /** Returns `true` if a long running job should give up its thread.
+
+        That is when a job with a deadline is waiting and every thread
+        is busy. The caller may post the rest of its work as a new job,
+        or yield its coroutine after posting it, so the waiting job
+        runs first.
+    */
+    bool shouldYield () const;
+
     /** Shut down the job queue without completing pending jobs.
     */
     void shutdown ();
 
     /** Set the number of thread serving the job queue to precisely this number.
+
+        Unless in standalone mode, one more thread is kept for the job
+        types consensus waits on.
     */
     void setThreadCount (int c, bool const standaloneMode);
 
+    /** Set the number of threads that only run latency critical jobs.
+
+        Those jobs are still run by the other threads too, in priority
+        order; these threads just guarantee that long running jobs of
+        other types cannot hold them all up.
+    */
+    void setReservedThreadCount (int c);
+
     // VFALCO TODO Rename these to newLoadEventMeasurement or something similar
     //             since they create the object.
     LoadEvent::pointer getLoadEvent (JobType t, std::string const& name);
@@ -102,19 +121,51 @@ public:
 private:
     using JobDataMap = std::map <JobType, JobTypeData>;
 
+    // Runs tasks for the reserved threads
+    class ReservedCallback : public beast::Workers::Callback
+    {
+    public:
+        explicit ReservedCallback (JobQueue& jobQueue)
+            : m_jobQueue (jobQueue)
+        {
+        }
+
+        void processTask () override;
+
+    private:
+        JobQueue& m_jobQueue;
+    };
+
+    // Bit n is set if jobs of type n may run on the reserved threads
+    static std::uint64_t const reservedTypes;
+
     beast::Journal m_journal;
     mutable std::mutex m_mutex;
     std::uint64_t m_lastJob;
-    std::set <Job> m_jobSet;
     JobDataMap m_jobData;
     JobTypeData m_invalidJobData;
 
     std::map <std::thread::id, Job*> m_threadIds;
 
+    // The number of jobs waiting in all queues
+    int m_waitingCount;
+
+    // Bit n is set while jobs of type n are waiting and fewer
+    // than the limit for the type are running
+    std::uint64_t m_runnable;
+
     // The number of jobs currently in processTask()
     int m_processCount;
 
+    // The number of waiting jobs that have a deadline
+    int m_deadlineWaiting;
+
+    // The number of threads that only run reserved job types
+    int m_reservedThreads;
+
     beast::Workers m_workers;
+    ReservedCallback m_reservedCallback;
+    beast::Workers m_reservedWorkers;
     Job::CancelCallback m_cancelCallback;
 
     // Statistics tracking
@@ -134,11 +185,24 @@ private:
     // Signals the service stopped if the stopped condition is met.
     void checkStopped (std::lock_guard <std::mutex> const& lock);
 
+    // Returns `true` if jobs of this type also get a task on the
+    // reserved threads.
+    //
+    // Invariants:
+    //  The calling thread owns the JobLock
+    bool isReserved (JobType type) const;
+
+    // Updates the runnable bit for the type after its counts change.
+    //
+    // Invariants:
+    //  The calling thread owns the JobLock
+    void updateRunnable (JobTypeData& data);
+
     // Signals an added Job for processing.
     //
     // Pre-conditions:
     //  The JobType must be valid.
-    //  The Job must exist in mJobSet.
+    //  The Job must be at the back of the queue for its type.
     //  The Job must not have previously been queued.
     //
     // Post-conditions:
@@ -152,26 +216,28 @@ private:
     // Returns the next Job we should run now.
     //
     // RunnableJob:
-    //  A Job in the JobSet whose slots count for its type is greater than zero.
+    //  A queued Job whose slots count for its type is greater than zero.
     //
     // Pre-conditions:
-    //  mJobSet must not be empty.
-    //  mJobSet holds at least one RunnableJob
+    //  <none>
     //
     // Post-conditions:
-    //  job is a valid Job object.
-    //  job is removed from mJobQueue.
-    //  Waiting job count of its type is decremented
-    //  Running job count of its type is incremented
+    //  If a RunnableJob of a type in the types mask is queued:
+    //      job is the oldest Job of the highest priority such type.
+    //      job is removed from the queue for its type.
+    //      Waiting job count of its type is decremented
+    //      Running job count of its type is incremented
+    //      true is returned
+    //  Otherwise false is returned.
     //
     // Invariants:
     //  The calling thread owns the JobLock
-    void getNextJob (Job& job);
+    bool getNextJob (Job& job, std::uint64_t types);
 
     // Indicates that a running Job has completed its task.
     //
     // Pre-conditions:
-    //  Job must not exist in mJobSet.
+    //  Job must not be queued.
     //  The JobType must not be invalid.
     //
     // Post-conditions:
@@ -193,15 +259,18 @@ private:
     // Runs the next appropriate waiting Job.
     //
     // Pre-conditions:
-    //  A RunnableJob must exist in the JobSet
+    //  <none>
     //
     // Post-conditions:
-    //  The chosen RunnableJob will have Job::doJob() called.
+    //  The chosen RunnableJob, if any, will have Job::doJob() called.
     //
     // Invariants:
     //  <none>
     void processTask () override;
 
+    // Runs the next waiting Job of a type in the types mask, if any.
+    void runNextJob (std::uint64_t types);
+
     // Returns `true` if all jobs of this type should be skipped when
     // the JobQueue receives a stop notification. If the job type isn't
     // skipped, the Job will be called and the job must call Job::shouldCancel
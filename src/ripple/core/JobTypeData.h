@@ -21,12 +21,53 @@
 #define RIPPLE_CORE_JOBTYPEDATA_H_INCLUDED
 
 #include <ripple/basics/Log.h>
+#include <ripple/core/Job.h>
 #include <ripple/core/JobTypeInfo.h>
+#include <ripple/core/LatencyHistogram.h>
 #include <beast/insight/Collector.h>
+#include <deque>
 
 namespace ripple
 {
 
+/** Gauges reporting the spread of the durations recorded in a histogram
+    since the previous report, in microseconds.
+*/
+class LatencyGauges
+{
+private:
+    beast::insight::Gauge p50_;
+    beast::insight::Gauge p99_;
+    beast::insight::Gauge p999_;
+    beast::insight::Gauge max_;
+    LatencyHistogram::Snapshot last_;
+
+public:
+    LatencyGauges () = default;
+
+    LatencyGauges (beast::insight::Collector::ptr const& collector,
+            std::string const& prefix)
+        : p50_ (collector->make_gauge (prefix, "p50"))
+        , p99_ (collector->make_gauge (prefix, "p99"))
+        , p999_ (collector->make_gauge (prefix, "p999"))
+        , max_ (collector->make_gauge (prefix, "max"))
+    {
+    }
+
+    void update (LatencyHistogram const& histogram)
+    {
+        auto interval = histogram.snapshot ();
+        auto const now = interval;
+        interval -= last_;
+        last_ = now;
+
+        p50_ = interval.percentile (0.5).count ();
+        p99_ = interval.percentile (0.99).count ();
+        p999_ = interval.percentile (0.999).count ();
+        max_ = interval.max ().count ();
+    }
+};
+
 struct JobTypeData
 {
 private:
@@ -48,10 +89,24 @@ public:
     /* And the number we deferred executing because of job limits */
     int deferred;
 
+    /* The number that started after their deadline */
+    std::uint64_t deadlineMissed;
+
+    /* The jobs waiting, oldest first */
+    std::deque <Job> queue;
+
     /* Notification callbacks */
     beast::insight::Event dequeue;
     beast::insight::Event execute;
 
+    /* How long jobs waited in the queue and how long they ran */
+    LatencyHistogram queueTimes;
+    LatencyHistogram runTimes;
+
+    /* Percentiles of the above, reported to the collector */
+    LatencyGauges queueGauges;
+    LatencyGauges runGauges;
+
     JobTypeData (JobTypeInfo const& info_,
             beast::insight::Collector::ptr const& collector, Logs& logs) noexcept
         : m_load (logs.journal ("LoadMonitor"))
@@ -60,6 +115,7 @@ public:
         , waiting (0)
         , running (0)
         , deferred (0)
+        , deadlineMissed (0)
     {
         m_load.setTargetLatency (
             info.getAverageLatency (),
@@ -69,6 +125,8 @@ public:
         {
             dequeue = m_collector->make_event (info.name () + "_q");
             execute = m_collector->make_event (info.name ());
+            queueGauges = LatencyGauges (m_collector, info.name () + "_q");
+            runGauges = LatencyGauges (m_collector, info.name ());
         }
     }
 
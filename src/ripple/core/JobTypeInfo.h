@@ -20,6 +20,8 @@
 #ifndef RIPPLE_CORE_JOBTYPEINFO_H_INCLUDED
 #define RIPPLE_CORE_JOBTYPEINFO_H_INCLUDED
 
+#include <chrono>
+
 namespace ripple
 {
 
@@ -43,12 +45,16 @@ private:
     std::uint64_t const m_avgLatency;
     std::uint64_t const m_peakLatency;
 
+    /** How soon after being queued a job should start. 0 is none */
+    std::chrono::milliseconds const m_deadline;
+
 public:
     // Not default constructible
     JobTypeInfo () = delete;
 
     JobTypeInfo (JobType type, std::string name, int limit,
-            bool skip, bool special, std::uint64_t avgLatency, std::uint64_t peakLatency)
+            bool skip, bool special, std::uint64_t avgLatency, std::uint64_t peakLatency,
+            std::chrono::milliseconds deadline = std::chrono::milliseconds (0))
         : m_type (type)
         , m_name (name)
         , m_limit (limit)
@@ -56,6 +62,7 @@ public:
         , m_special (special)
         , m_avgLatency (avgLatency)
         , m_peakLatency (peakLatency)
+        , m_deadline (deadline)
     {
 
     }
@@ -94,6 +101,11 @@ public:
     {
         return m_peakLatency;
     }
+
+    std::chrono::milliseconds deadline () const
+    {
+        return m_deadline;
+    }
 };
 
 }
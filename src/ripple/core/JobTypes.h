@@ -38,6 +38,10 @@ public:
     {
         int maxLimit = std::numeric_limits <int>::max ();
 
+        // Consensus stalls when the jobs given a deadline wait behind
+        // long running client, path finding or database jobs
+        using std::chrono::milliseconds;
+
         // Make a fetch pack for a peer
         add (jtPACK,          "makeFetchPack",
             1,        true,   false, 0,     0);
@@ -92,7 +96,7 @@ public:
 
         // Advance validated/acquired ledgers
         add (jtADVANCE,       "advanceLedger",
-            maxLimit, true,   false, 0,     0);
+            maxLimit, true,   false, 0,     0,     milliseconds (1000));
 
         // Publish a fully-accepted ledger
         add (jtPUBLEDGER,     "publishNewLedger",
@@ -108,7 +112,7 @@ public:
 
         // A validation from a trusted source
         add (jtVALIDATION_t,  "trustedValidation",
-            maxLimit, true,   false, 500,  1500);
+            maxLimit, true,   false, 500,  1500,   milliseconds (500));
 
         // Process db batch commit
         add (jtDB_BATCH,      "dbBatch",
@@ -120,11 +124,11 @@ public:
 
         // Accept a consensus ledger
         add (jtACCEPT,        "acceptLedger",
-            maxLimit, false,  false, 0,     0);
+            maxLimit, false,  false, 0,     0,     milliseconds (500));
 
         // A proposal from a trusted source
         add (jtPROPOSAL_t,    "trustedProposal",
-            maxLimit, false,  false, 100,   500);
+            maxLimit, false,  false, 100,   500,   milliseconds (250));
         
         // Process dividend
         add (jtDIVIDEND,      "dividend",
@@ -140,7 +144,7 @@ public:
 
         // NetworkOPs net timer processing
         add (jtNETOP_TIMER,   "heartbeat",
-            1,        true,   false, 999,   999);
+            1,        true,   false, 999,   999,   milliseconds (1000));
 
         // An administrative operation
         add (jtADMIN,         "administration",
@@ -221,7 +225,8 @@ public:
 
 private:
     void add(JobType jt, std::string name, int limit,
-        bool skip, bool special, std::uint64_t avgLatency, std::uint64_t peakLatency)
+        bool skip, bool special, std::uint64_t avgLatency, std::uint64_t peakLatency,
+        std::chrono::milliseconds deadline = std::chrono::milliseconds (0))
     {
         assert (m_map.find (jt) == m_map.end ());
 
@@ -229,7 +234,7 @@ private:
             std::piecewise_construct,
             std::forward_as_tuple (jt),
             std::forward_as_tuple (jt, name, limit, skip, special,
-                avgLatency, peakLatency)));
+                avgLatency, peakLatency, deadline)));
 
         assert (result.second == true);
         (void) result.second;
@@ -0,0 +1,107 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_CORE_LATENCYHISTOGRAM_H_INCLUDED
+#define RIPPLE_CORE_LATENCYHISTOGRAM_H_INCLUDED
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace ripple {
+
+/** Counts durations in buckets of bounded relative width.
+
+    Durations are kept in microseconds. Buckets are exact below 32us and
+    no wider than 1/16 of their value above that, up to about 19 hours;
+    longer durations share the last bucket. Recording is lock free, so
+    any number of threads may record while others take snapshots.
+*/
+class LatencyHistogram
+{
+public:
+    using duration = std::chrono::microseconds;
+
+    static std::size_t const bucketCount = 528;
+
+    /** The counts of a histogram at one moment. */
+    class Snapshot
+    {
+    public:
+        Snapshot ();
+
+        /** Returns the number of durations recorded. */
+        std::uint64_t
+        count () const
+        {
+            return count_;
+        }
+
+        /** Returns the duration that the given fraction of those recorded
+            do not exceed, rounded up to the end of its bucket.
+        */
+        duration
+        percentile (double fraction) const;
+
+        /** Returns the longest duration recorded. */
+        duration
+        max () const;
+
+        /** Leaves only the durations recorded since the older snapshot. */
+        Snapshot&
+        operator-= (Snapshot const& older);
+
+    private:
+        friend class LatencyHistogram;
+
+        std::array <std::uint64_t, bucketCount> counts_;
+        std::uint64_t count_;
+        std::uint64_t max_;
+    };
+
+    LatencyHistogram ();
+
+    LatencyHistogram (LatencyHistogram const&) = delete;
+    LatencyHistogram& operator= (LatencyHistogram const&) = delete;
+
+    void
+    record (duration d);
+
+    Snapshot
+    snapshot () const;
+
+    /** Returns the bucket holding a number of microseconds. */
+    static
+    std::size_t
+    bucket (std::uint64_t us);
+
+    /** Returns the largest number of microseconds in a bucket. */
+    static
+    std::uint64_t
+    upperBound (std::size_t bucket);
+
+private:
+    std::array <std::atomic <std::uint64_t>, bucketCount> counts_;
+    std::atomic <std::uint64_t> max_;
+};
+
+} // ripple
+
+#endif
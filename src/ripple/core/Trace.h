@@ -0,0 +1,158 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_CORE_TRACE_H_INCLUDED
+#define RIPPLE_CORE_TRACE_H_INCLUDED
+
+#include <ripple/basics/BasicConfig.h>
+#include <ripple/basics/base_uint.h>
+#include <beast/utility/Journal.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace ripple {
+
+/*  Timing spans around transaction processing and ledger close.
+
+    A span records the name of a piece of work, the transaction or
+    ledger it was done for, and when it started and ended. Each thread
+    keeps its most recent spans in a ring buffer of its own, so recording
+    a span takes no lock another thread is likely to hold.
+
+    A ledger's timeline runs from the start of the consensus round that
+    builds it to the end of its save. Once it is saved, the spans in that
+    window are written to a file in Chrome's trace format (load it in
+    chrome://tracing) if the ledger is sampled or is one of the slowest
+    of the current hour.
+
+    Nothing is recorded unless the [tracing] section names a directory.
+    Building with RIPPLE_TRACING set to 0 removes the spans entirely.
+*/
+
+using TraceClock = std::chrono::steady_clock;
+
+/** What a span's id refers to. */
+enum class TraceKind : std::uint8_t
+{
+    ledger,     // The id is a ledger sequence
+    tx          // The id is the start of a transaction hash
+};
+
+namespace detail {
+extern std::atomic<bool> tracing;
+}
+
+/** Returns `true` if spans are being recorded. */
+inline
+bool
+tracingEnabled ()
+{
+#if RIPPLE_TRACING
+    return detail::tracing.load (std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
+
+/** Configure tracing from the [tracing] section.
+
+    Calling it again replaces the settings; a section without a path
+    turns tracing off. Throws if the directory cannot be created.
+*/
+void
+setupTracing (Section const& section, beast::Journal journal);
+
+/** Record a span that started at `start` and ends now. */
+void
+traceSpan (char const* name, TraceKind kind, std::uint64_t id,
+    TraceClock::time_point start);
+
+/** Returns the id a transaction's spans are recorded under. */
+std::uint64_t
+traceId (uint256 const& txID);
+
+/** Marks the start of the consensus round that builds a ledger. */
+void
+traceLedgerOpened (std::uint32_t seq);
+
+/** Marks a ledger as saved, and writes its timeline if it is kept. */
+void
+traceLedgerSaved (std::uint32_t seq);
+
+/** Records the lifetime of the object as a span.
+
+    The name must be a string literal, or otherwise outlive the
+    process, since only the pointer is kept.
+*/
+class TraceSpan
+{
+public:
+    TraceSpan (char const* name, TraceKind kind, std::uint64_t id)
+        : name_ (name)
+        , kind_ (kind)
+        , id_ (id)
+        , active_ (tracingEnabled ())
+    {
+        if (active_)
+            start_ = TraceClock::now ();
+    }
+
+    ~TraceSpan ()
+    {
+        if (active_)
+            traceSpan (name_, kind_, id_, start_);
+    }
+
+    TraceSpan (TraceSpan const&) = delete;
+    TraceSpan& operator= (TraceSpan const&) = delete;
+
+private:
+    char const* name_;
+    TraceKind kind_;
+    std::uint64_t id_;
+    bool active_;
+    TraceClock::time_point start_;
+};
+
+} // ripple
+
+#define RIPPLE_TRACE_CONCAT2(a, b) a##b
+#define RIPPLE_TRACE_CONCAT(a, b) RIPPLE_TRACE_CONCAT2(a, b)
+
+#if RIPPLE_TRACING
+
+/** Trace the rest of the enclosing scope as work on a ledger. */
+#define RIPPLE_TRACE_LEDGER(name, seq) \
+    ::ripple::TraceSpan const RIPPLE_TRACE_CONCAT(traceSpan_, __LINE__) ( \
+        name, ::ripple::TraceKind::ledger, seq)
+
+/** Trace the rest of the enclosing scope as work on a transaction. */
+#define RIPPLE_TRACE_TX(name, txID) \
+    ::ripple::TraceSpan const RIPPLE_TRACE_CONCAT(traceSpan_, __LINE__) ( \
+        name, ::ripple::TraceKind::tx, ::ripple::traceId (txID))
+
+#else
+
+#define RIPPLE_TRACE_LEDGER(name, seq) do { } while (false)
+#define RIPPLE_TRACE_TX(name, txID) do { } while (false)
+
+#endif
+
+#endif
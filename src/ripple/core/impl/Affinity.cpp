@@ -0,0 +1,177 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/core/Affinity.h>
+#include <ripple/basics/contract.h>
+#include <beast/module/core/text/LexicalCast.h>
+#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#if BEAST_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ripple {
+
+// Written once at startup, before the threads that read them exist
+static std::array<std::vector<unsigned>, 3> configuredCpus;
+static std::array<std::string, 3> configuredLists;
+static boost::optional<beast::Journal> affinityJournal;
+
+static
+char const*
+getName (ThreadClass threads)
+{
+    switch (threads)
+    {
+    case ThreadClass::jobs:      return "jobs";
+    case ThreadClass::io:        return "io";
+    case ThreadClass::nodestore: return "nodestore";
+    };
+    return "";
+}
+
+boost::optional<std::vector<unsigned>>
+parseCpuList (std::string const& list)
+{
+    std::vector<std::string> ranges;
+    boost::split (ranges, list, boost::is_any_of (","));
+
+    std::vector<unsigned> cpus;
+    for (auto range : ranges)
+    {
+        boost::trim (range);
+
+        std::vector<std::string> ends;
+        boost::split (ends, range, boost::is_any_of ("-"));
+        if (ends.size () > 2)
+            return boost::none;
+        for (auto& end : ends)
+            boost::trim (end);
+
+        unsigned first;
+        unsigned last;
+        if (! beast::lexicalCastChecked (first, ends.front ()) ||
+                ! beast::lexicalCastChecked (last, ends.back ()))
+            return boost::none;
+
+        if (first > last || last >= 1024)
+            return boost::none;
+
+        for (auto cpu = first; cpu <= last; ++cpu)
+            cpus.push_back (cpu);
+    }
+
+    std::sort (cpus.begin (), cpus.end ());
+    cpus.erase (std::unique (cpus.begin (), cpus.end ()), cpus.end ());
+    return cpus;
+}
+
+void
+setupAffinity (Section const& section, beast::Journal journal)
+{
+    for (auto const& entry : section)
+    {
+        auto const threads = [&entry]()
+        {
+            for (auto c : {ThreadClass::jobs, ThreadClass::io,
+                    ThreadClass::nodestore})
+            {
+                if (boost::iequals (entry.first, getName (c)))
+                    return c;
+            }
+            Throw<std::runtime_error> (
+                "Unknown thread class '" + entry.first + "' in [affinity]");
+            return ThreadClass::jobs;
+        }();
+
+        auto cpus = parseCpuList (entry.second);
+        if (! cpus)
+            Throw<std::runtime_error> ("Invalid CPU list '" + entry.second +
+                "' for " + entry.first + " in [affinity]");
+
+#if BEAST_LINUX
+        // The threads could never be placed on a CPU the process may not use
+        cpu_set_t available;
+        CPU_ZERO (&available);
+        if (sched_getaffinity (0, sizeof (available), &available) == 0)
+        {
+            for (auto const cpu : *cpus)
+            {
+                if (cpu >= CPU_SETSIZE || ! CPU_ISSET (cpu, &available))
+                    Throw<std::runtime_error> ("CPU " + std::to_string (cpu) +
+                        " for " + entry.first + " in [affinity] is not "
+                            "available to this process");
+            }
+        }
+#else
+        if (journal.warning) journal.warning <<
+            "Threads cannot be pinned on this platform, [affinity] " <<
+                entry.first << " is ignored";
+#endif
+
+        if (journal.info) journal.info <<
+            entry.first << " threads run on CPUs " << entry.second;
+
+        configuredCpus[static_cast<int> (threads)] = std::move (*cpus);
+        configuredLists[static_cast<int> (threads)] = entry.second;
+    }
+
+    affinityJournal.emplace (journal);
+}
+
+bool
+pinCurrentThread (ThreadClass threads)
+{
+    auto const& cpus = configuredCpus[static_cast<int> (threads)];
+    if (cpus.empty ())
+        return false;
+
+#if BEAST_LINUX
+    cpu_set_t set;
+    CPU_ZERO (&set);
+    for (auto const cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+            CPU_SET (cpu, &set);
+    }
+
+    auto const error = pthread_setaffinity_np (
+        pthread_self (), sizeof (set), &set);
+    if (error != 0)
+    {
+        if (affinityJournal && affinityJournal->warning)
+            affinityJournal->warning << "Unable to pin " <<
+                getName (threads) << " thread to CPUs " <<
+                    configuredLists[static_cast<int> (threads)] << ": " <<
+                        std::strerror (error);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // ripple
@@ -516,7 +516,7 @@ int Config::getSize (SizedItemName item) const
         { siNodeCacheSize,      {   16384,  32768,  131072, 262144,     524288  } },
         { siNodeCacheAge,       {   60,     90,     120,    900,        1800    } },
 
-        { siTreeCacheSize,      {   128000, 256000, 512000, 768000,     2048000 } },
+        { siTreeCacheMB,        {   64,     128,    256,    384,        1024    } },
         { siTreeCacheAge,       {   30,     60,     90,     120,        900     } },
 
         { siSLECacheSize,       {   4096,   8192,   16384,  65536,      131072  } },
@@ -25,12 +25,14 @@ namespace ripple {
 Job::Job ()
     : mType (jtINVALID)
     , mJobIndex (0)
+    , m_deadline (clock_type::duration::zero ())
 {
 }
 
 Job::Job (JobType type, std::uint64_t index)
     : mType (type)
     , mJobIndex (index)
+    , m_deadline (clock_type::duration::zero ())
 {
 }
 
@@ -39,13 +41,15 @@ Job::Job (JobType type,
           std::uint64_t index,
           LoadMonitor& lm,
           std::function <void (Job&)> const& job,
-          CancelCallback cancelCallback)
+          CancelCallback cancelCallback,
+          clock_type::duration deadline)
     : m_cancelCallback (cancelCallback)
     , mType (type)
     , mJobIndex (index)
     , mJob (job)
     , mName (name)
     , m_queue_time (clock_type::now ())
+    , m_deadline (deadline)
 {
     m_loadEvent = std::make_shared <LoadEvent> (std::ref (lm), name, false);
 }
@@ -55,6 +59,11 @@ JobType Job::getType () const
     return mType;
 }
 
+std::string const& Job::getName () const
+{
+    return mName;
+}
+
 Job::CancelCallback Job::getCancelCallback () const
 {
     bassert (m_cancelCallback);
@@ -66,6 +75,16 @@ Job::clock_type::time_point const& Job::queue_time () const
     return m_queue_time;
 }
 
+bool Job::hasDeadline () const
+{
+    return m_deadline != clock_type::duration::zero ();
+}
+
+Job::clock_type::time_point Job::deadline () const
+{
+    return m_queue_time + m_deadline;
+}
+
 bool Job::shouldCancel () const
 {
     if (m_cancelCallback)
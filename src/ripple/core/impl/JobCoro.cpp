@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/core/JobCoro.h>
+#include <ripple/core/JobQueue.h>
+
+namespace ripple {
+
+// These stay out of line: a coroutine may be resumed on another thread,
+// so the thread local must be looked up afresh on every call.
+static thread_local JobCoro* currentJobCoro = nullptr;
+
+void
+JobCoro::post ()
+{
+    // sp keeps 'this' alive
+    jq_.addJob(type_, name_,
+        [this, sp = shared_from_this()](Job&)
+        {
+            std::lock_guard<std::mutex> lock (mutex_);
+            auto const outer = exchangeCurrent (this);
+            coro_();
+            exchangeCurrent (outer);
+        });
+}
+
+JobCoro*
+JobCoro::exchangeCurrent (JobCoro* coro)
+{
+    auto const outer = currentJobCoro;
+    currentJobCoro = coro;
+    return outer;
+}
+
+JobCoro*
+JobCoro::current ()
+{
+    return currentJobCoro;
+}
+
+} // ripple
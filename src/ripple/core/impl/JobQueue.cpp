@@ -19,6 +19,7 @@
 
 #include <BeastConfig.h>
 #include <ripple/core/JobQueue.h>
+#include <ripple/core/Affinity.h>
 #include <ripple/core/JobTypes.h>
 #include <ripple/core/JobTypeInfo.h>
 #include <ripple/core/JobTypeData.h>
@@ -27,19 +28,53 @@
 #include <chrono>
 #include <memory>
 #include <mutex>
-#include <set>
 #include <thread>
 
 namespace ripple {
 
+static_assert (jtNS_WRITE < 64, "job types must fit in the runnable mask");
+
+// Job types with a deadline may also run on the reserved threads
+std::uint64_t const JobQueue::reservedTypes = []
+{
+    std::uint64_t types = 0;
+    for (auto const& x : getJobTypes ())
+    {
+        if (x.second.deadline () != std::chrono::milliseconds (0))
+            types |= std::uint64_t (1) << x.first;
+    }
+    return types;
+}();
+
+static
+Json::Value
+getLatencyJson (LatencyHistogram const& histogram)
+{
+    auto const s = histogram.snapshot ();
+
+    Json::Value ret (Json::objectValue);
+    ret["count"] = static_cast<Json::UInt> (s.count ());
+    ret["p50"] = static_cast<Json::UInt> (s.percentile (0.5).count ());
+    ret["p99"] = static_cast<Json::UInt> (s.percentile (0.99).count ());
+    ret["p999"] = static_cast<Json::UInt> (s.percentile (0.999).count ());
+    ret["max"] = static_cast<Json::UInt> (s.max ().count ());
+    return ret;
+}
+
 JobQueue::JobQueue (beast::insight::Collector::ptr const& collector,
     Stoppable& parent, beast::Journal journal, Logs& logs)
     : Stoppable ("JobQueue", parent)
     , m_journal (journal)
     , m_lastJob (0)
     , m_invalidJobData (getJobTypes ().getInvalid (), collector, logs)
+    , m_waitingCount (0)
+    , m_runnable (0)
     , m_processCount (0)
+    , m_deadlineWaiting (0)
+    , m_reservedThreads (0)
     , m_workers (*this, "JobQueue", 0)
+    , m_reservedCallback (*this)
+    , m_reservedWorkers (m_reservedCallback, "JobQueue reserved", 0)
     , m_cancelCallback (std::bind (&Stoppable::isStopping, this))
     , m_collector (collector)
 {
@@ -73,7 +108,17 @@ void
 JobQueue::collect ()
 {
     std::lock_guard <std::mutex> lock (m_mutex);
-    job_count = m_jobSet.size ();
+    job_count = m_waitingCount;
+
+    for (auto& x : m_jobData)
+    {
+        JobTypeData& data (x.second);
+        if (data.info.special ())
+            continue;
+
+        data.queueGauges.update (data.queueTimes);
+        data.runGauges.update (data.runTimes);
+    }
 }
 
 void
@@ -108,7 +153,7 @@ JobQueue::addJob (JobType type, std::string const& name,
         std::lock_guard <std::mutex> lock (m_mutex);
         assert (! isStopped() && (
             m_processCount>0 ||
-            ! m_jobSet.empty () ||
+            m_waitingCount > 0 ||
             ! areChildrenStopped()));
     }
 
@@ -125,10 +170,9 @@ JobQueue::addJob (JobType type, std::string const& name,
     {
         std::lock_guard <std::mutex> lock (m_mutex);
 
-        std::pair <std::set <Job>::iterator, bool> result (
-            m_jobSet.insert (Job (type, name, ++m_lastJob,
-                data.load (), func, m_cancelCallback)));
-        queueJob (*result.first, lock);
+        data.queue.emplace_back (type, name, ++m_lastJob,
+            data.load (), func, m_cancelCallback, data.info.deadline ());
+        queueJob (data.queue.back (), lock);
     }
 }
 
@@ -173,12 +217,25 @@ JobQueue::getJobCountGE (JobType t) const
     return ret;
 }
 
+bool
+JobQueue::shouldYield () const
+{
+    auto const threads = m_workers.getNumberOfThreads () +
+        m_reservedWorkers.getNumberOfThreads ();
+
+    std::lock_guard <std::mutex> lock (m_mutex);
+
+    // An idle thread already has a task for the waiting job
+    return m_deadlineWaiting > 0 && m_processCount >= threads;
+}
+
 void
 JobQueue::shutdown ()
 {
     m_journal.info <<  "Job queue shutting down";
 
     m_workers.pauseAllThreadsAndWait ();
+    m_reservedWorkers.pauseAllThreadsAndWait ();
 }
 
 void
@@ -198,6 +255,18 @@ JobQueue::setThreadCount (int c, bool const standaloneMode)
     }
 
     m_workers.setNumberOfThreads (c);
+    setReservedThreadCount (standaloneMode ? 0 : 1);
+}
+
+void
+JobQueue::setReservedThreadCount (int c)
+{
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+        m_reservedThreads = c;
+    }
+
+    m_reservedWorkers.setNumberOfThreads (c);
 }
 
 LoadEvent::pointer
@@ -254,6 +323,7 @@ JobQueue::getJson (int c)
     Json::Value ret (Json::objectValue);
 
     ret["threads"] = m_workers.getNumberOfThreads ();
+    ret["reserved_threads"] = m_reservedWorkers.getNumberOfThreads ();
 
     Json::Value priorities = Json::arrayValue;
 
@@ -272,9 +342,10 @@ JobQueue::getJson (int c)
 
         int waiting (data.waiting);
         int running (data.running);
+        bool const ran (data.runTimes.snapshot ().count () != 0);
 
         if ((stats.count != 0) || (waiting != 0) ||
-            (stats.latencyPeak != 0) || (running != 0))
+            (stats.latencyPeak != 0) || (running != 0) || ran)
         {
             Json::Value& pri = priorities.append (Json::objectValue);
 
@@ -297,6 +368,17 @@ JobQueue::getJson (int c)
 
             if (running != 0)
                 pri["in_progress"] = running;
+
+            if (data.deadlineMissed != 0)
+                pri["deadline_missed"] = static_cast<Json::UInt> (
+                    data.deadlineMissed);
+
+            // Microseconds spent waiting and running, since startup
+            if (ran)
+            {
+                pri["queue_us"] = getLatencyJson (data.queueTimes);
+                pri["run_us"] = getLatencyJson (data.runTimes);
+            }
         }
     }
 
@@ -342,24 +424,47 @@ JobQueue::checkStopped (std::lock_guard <std::mutex> const& lock)
     if (isStopping() &&
         areChildrenStopped() &&
         (m_processCount == 0) &&
-        m_jobSet.empty())
+        (m_waitingCount == 0))
     {
         stopped();
     }
 }
 
+bool
+JobQueue::isReserved (JobType type) const
+{
+    return m_reservedThreads > 0 &&
+        (reservedTypes & (std::uint64_t (1) << type)) != 0;
+}
+
+void
+JobQueue::updateRunnable (JobTypeData& data)
+{
+    auto const bit = std::uint64_t (1) << data.type ();
+
+    if (data.waiting > 0 && data.running < data.info.limit ())
+        m_runnable |= bit;
+    else
+        m_runnable &= ~bit;
+}
+
 void
 JobQueue::queueJob (Job const& job, std::lock_guard <std::mutex> const& lock)
 {
     JobType const type (job.getType ());
     assert (type != jtINVALID);
-    assert (m_jobSet.find (job) != m_jobSet.end ());
 
     JobTypeData& data (getJobTypeData (type));
+    assert (&data.queue.back () == &job);
 
     if (data.waiting + data.running < getJobLimit (type))
     {
         m_workers.addTask ();
+
+        // Whichever thread gets to the job first runs it, the
+        // other finds nothing to do
+        if (isReserved (type))
+            m_reservedWorkers.addTask ();
     }
     else
     {
@@ -368,42 +473,49 @@ JobQueue::queueJob (Job const& job, std::lock_guard <std::mutex> const& lock)
         ++data.deferred;
     }
     ++data.waiting;
+    ++m_waitingCount;
+    if (job.hasDeadline ())
+        ++m_deadlineWaiting;
+    updateRunnable (data);
 }
 
-void
-JobQueue::getNextJob (Job& job)
+bool
+JobQueue::getNextJob (Job& job, std::uint64_t types)
 {
-    assert (! m_jobSet.empty ());
+    auto const runnable = m_runnable & types;
+    if (runnable == 0)
+        return false;
 
-    std::set <Job>::const_iterator iter;
-    for (iter = m_jobSet.begin (); iter != m_jobSet.end (); ++iter)
-    {
-        JobTypeData& data (getJobTypeData (iter->getType ()));
+    // Later job types have higher priority, so take the highest
+    // type whose jobs may run now, regardless of how many jobs
+    // of other types are held back by their limits.
+    int type = 63;
+    while ((runnable & (std::uint64_t (1) << type)) == 0)
+        --type;
 
-        assert (data.running <= getJobLimit (data.type ()));
+    JobTypeData& data (getJobTypeData (static_cast <JobType> (type)));
 
-        // Run this job if we're running below the limit.
-        if (data.running < getJobLimit (data.type ()))
-        {
-            assert (data.waiting > 0);
-            break;
-        }
-    }
-
-    assert (iter != m_jobSet.end ());
-
-    JobType const type = iter->getType ();
-    JobTypeData& data (getJobTypeData (type));
+    assert (data.type () != jtINVALID);
+    assert (data.running < getJobLimit (data.type ()));
+    assert (data.waiting > 0 && ! data.queue.empty ());
 
-    assert (type != jtINVALID);
-
-    job = *iter;
-    m_jobSet.erase (iter);
+    job = std::move (data.queue.front ());
+    data.queue.pop_front ();
 
     m_threadIds[std::this_thread::get_id()] = &job;
 
+    if (job.hasDeadline ())
+    {
+        --m_deadlineWaiting;
+        if (Job::clock_type::now () > job.deadline ())
+            ++data.deadlineMissed;
+    }
+
     --data.waiting;
+    --m_waitingCount;
     ++data.running;
+    updateRunnable (data);
+    return true;
 }
 
 void
@@ -411,7 +523,6 @@ JobQueue::finishJob (Job const& job)
 {
     JobType const type = job.getType ();
 
-    assert (m_jobSet.find (job) == m_jobSet.end ());
     assert (type != jtINVALID);
 
     JobTypeData& data (getJobTypeData (type));
@@ -423,6 +534,9 @@ JobQueue::finishJob (Job const& job)
 
         --data.deferred;
         m_workers.addTask ();
+
+        if (isReserved (type))
+            m_reservedWorkers.addTask ();
     }
 
     if (! m_threadIds.erase (std::this_thread::get_id()))
@@ -430,36 +544,69 @@ JobQueue::finishJob (Job const& job)
         assert (false);
     }
     --data.running;
+    updateRunnable (data);
 }
 
 template <class Rep, class Period>
 void JobQueue::on_dequeue (JobType type,
     std::chrono::duration <Rep, Period> const& value)
 {
+    JobTypeData& data (getJobTypeData (type));
+    data.queueTimes.record (
+        std::chrono::duration_cast <std::chrono::microseconds> (value));
+
     auto const ms (ceil <std::chrono::milliseconds> (value));
 
     if (ms.count() >= 10)
-        getJobTypeData (type).dequeue.notify (ms);
+        data.dequeue.notify (ms);
 }
 
 template <class Rep, class Period>
 void JobQueue::on_execute (JobType type,
     std::chrono::duration <Rep, Period> const& value)
 {
+    JobTypeData& data (getJobTypeData (type));
+    data.runTimes.record (
+        std::chrono::duration_cast <std::chrono::microseconds> (value));
+
     auto const ms (ceil <std::chrono::milliseconds> (value));
 
     if (ms.count() >= 10)
-        getJobTypeData (type).execute.notify (ms);
+        data.execute.notify (ms);
 }
 
 void
 JobQueue::processTask ()
 {
+    runNextJob (~std::uint64_t (0));
+}
+
+void
+JobQueue::ReservedCallback::processTask ()
+{
+    m_jobQueue.runNextJob (reservedTypes);
+}
+
+void
+JobQueue::runNextJob (std::uint64_t types)
+{
+    // Workers start their threads themselves, so they are placed here
+    static thread_local bool placed = false;
+    if (! placed)
+    {
+        pinCurrentThread (ThreadClass::jobs);
+        placed = true;
+    }
+
     Job job;
 
     {
         std::lock_guard <std::mutex> lock (m_mutex);
-        getNextJob (job);
+
+        // A job of a reserved type gets a task on both sets of
+        // threads, so it may already have been taken
+        if (! getNextJob (job, types))
+            return;
         ++m_processCount;
     }
 
@@ -471,14 +618,27 @@ JobQueue::processTask ()
     if (!isStopping() || !data.info.skip ())
     {
         beast::Thread::setCurrentThreadName (data.name ());
-        m_journal.trace << "Doing " << data.name () << " job";
+        m_journal.trace << "Doing " << data.name () << " job '" <<
+            job.getName () << "'";
 
         Job::clock_type::time_point const start_time (
             Job::clock_type::now());
+        auto const waited = start_time - job.queue_time ();
 
-        on_dequeue (job.getType (), start_time - job.queue_time ());
+        on_dequeue (job.getType (), waited);
         job.doJob ();
-        on_execute (job.getType (), Job::clock_type::now() - start_time);
+        auto const ran = Job::clock_type::now() - start_time;
+        on_execute (job.getType (), ran);
+
+        if (ran >= std::chrono::milliseconds (100) && m_journal.debug)
+        {
+            using namespace std::chrono;
+            m_journal.debug << "Slow " << data.name () << " job '" <<
+                job.getName () << "' ran " <<
+                    duration_cast <milliseconds> (ran).count () <<
+                " ms after waiting " <<
+                    duration_cast <milliseconds> (waited).count () << " ms";
+        }
     }
     else
     {
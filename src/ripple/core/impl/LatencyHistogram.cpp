@@ -0,0 +1,162 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/core/LatencyHistogram.h>
+#include <algorithm>
+#include <cmath>
+
+namespace ripple {
+
+// Values below 2^linearBits have a bucket each. Above that, each power
+// of two is split into 2^(linearBits - 1) buckets.
+static int const linearBits = 5;
+static std::uint64_t const linearCount = std::uint64_t (1) << linearBits;
+static std::uint64_t const halfCount = linearCount / 2;
+
+// Index of the highest set bit of a non-zero value
+static
+int
+highestBit (std::uint64_t v)
+{
+    int e = 0;
+    for (int s = 32; s > 0; s >>= 1)
+    {
+        if (v >> (e + s))
+            e += s;
+    }
+    return e;
+}
+
+std::size_t
+LatencyHistogram::bucket (std::uint64_t us)
+{
+    if (us < linearCount)
+        return static_cast <std::size_t> (us);
+
+    int const e = highestBit (us);
+    int const shift = e - (linearBits - 1);
+    auto const index = linearCount + (e - linearBits) * halfCount +
+        ((us >> shift) - halfCount);
+    return static_cast <std::size_t> (
+        std::min <std::uint64_t> (index, bucketCount - 1));
+}
+
+std::uint64_t
+LatencyHistogram::upperBound (std::size_t bucket)
+{
+    if (bucket < linearCount)
+        return bucket;
+
+    auto const e = (bucket - linearCount) / halfCount + linearBits;
+    auto const sub = (bucket - linearCount) % halfCount + halfCount;
+    auto const shift = e - (linearBits - 1);
+    return ((sub + 1) << shift) - 1;
+}
+
+//------------------------------------------------------------------------------
+
+LatencyHistogram::Snapshot::Snapshot ()
+    : count_ (0)
+    , max_ (0)
+{
+    counts_.fill (0);
+}
+
+LatencyHistogram::duration
+LatencyHistogram::Snapshot::percentile (double fraction) const
+{
+    if (count_ == 0)
+        return duration (0);
+
+    auto const rank = std::max <std::uint64_t> (1, static_cast <std::uint64_t> (
+        std::ceil (fraction * count_)));
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucketCount; ++i)
+    {
+        seen += counts_[i];
+        if (seen >= rank)
+            return duration (std::min (upperBound (i), max_));
+    }
+    return duration (max_);
+}
+
+LatencyHistogram::duration
+LatencyHistogram::Snapshot::max () const
+{
+    return duration (max_);
+}
+
+LatencyHistogram::Snapshot&
+LatencyHistogram::Snapshot::operator-= (Snapshot const& older)
+{
+    count_ = 0;
+    std::size_t highest = 0;
+    for (std::size_t i = 0; i < bucketCount; ++i)
+    {
+        counts_[i] -= std::min (counts_[i], older.counts_[i]);
+        count_ += counts_[i];
+        if (counts_[i] != 0)
+            highest = i;
+    }
+
+    // The exact longest is only known since the start, so bound it
+    // by the highest bucket still in use.
+    max_ = (count_ == 0) ? 0 : std::min (max_, upperBound (highest));
+    return *this;
+}
+
+//------------------------------------------------------------------------------
+
+LatencyHistogram::LatencyHistogram ()
+    : max_ (0)
+{
+    for (auto& c : counts_)
+        c.store (0, std::memory_order_relaxed);
+}
+
+void
+LatencyHistogram::record (duration d)
+{
+    auto const us = static_cast <std::uint64_t> (
+        std::max <duration::rep> (d.count (), 0));
+
+    counts_[bucket (us)].fetch_add (1, std::memory_order_relaxed);
+
+    auto max = max_.load (std::memory_order_relaxed);
+    while (us > max && ! max_.compare_exchange_weak (
+            max, us, std::memory_order_relaxed))
+        ;
+}
+
+LatencyHistogram::Snapshot
+LatencyHistogram::snapshot () const
+{
+    Snapshot s;
+    for (std::size_t i = 0; i < bucketCount; ++i)
+    {
+        s.counts_[i] = counts_[i].load (std::memory_order_relaxed);
+        s.count_ += s.counts_[i];
+    }
+    s.max_ = max_.load (std::memory_order_relaxed);
+    return s;
+}
+
+} // ripple
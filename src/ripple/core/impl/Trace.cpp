@@ -0,0 +1,442 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/core/Trace.h>
+#include <ripple/basics/contract.h>
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace ripple {
+
+namespace detail {
+
+std::atomic<bool> tracing (false);
+
+struct TraceEvent
+{
+    char const* name;
+    TraceKind kind;
+    std::uint64_t id;
+    TraceClock::time_point start;
+    TraceClock::duration duration;
+};
+
+// The spans one thread ran most recently
+class TraceBuffer
+{
+public:
+    explicit
+    TraceBuffer (unsigned thread)
+        : thread_ (thread)
+    {
+    }
+
+    unsigned
+    thread () const
+    {
+        return thread_;
+    }
+
+    void
+    add (TraceEvent const& event)
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        events_[next_++ % events_.size ()] = event;
+    }
+
+    // Appends the spans that overlap the window
+    void
+    copy (TraceClock::time_point from, TraceClock::time_point to,
+        std::vector<std::pair<unsigned, TraceEvent>>& out) const
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        auto const count = std::min (next_, events_.size ());
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto const& e = events_[i];
+            if (e.start < to && e.start + e.duration > from)
+                out.emplace_back (thread_, e);
+        }
+    }
+
+private:
+    // Only contended while a timeline is being written
+    std::mutex mutable mutex_;
+    unsigned const thread_;
+    std::size_t next_ = 0;
+    std::array<TraceEvent, 4096> events_;
+};
+
+class Tracer
+{
+public:
+    static
+    Tracer&
+    getInstance ()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    void
+    setup (Section const& section, beast::Journal journal);
+
+    TraceBuffer&
+    buffer ();
+
+    void
+    ledgerOpened (std::uint32_t seq);
+
+    void
+    ledgerSaved (std::uint32_t seq);
+
+private:
+    // Gives a thread's buffer back when the thread exits
+    struct Holder
+    {
+        std::shared_ptr<TraceBuffer> buffer;
+
+        ~Holder ()
+        {
+            if (buffer)
+                getInstance ().release (std::move (buffer));
+        }
+    };
+
+    // A file to write, decided under the lock and written outside it
+    struct Timeline
+    {
+        boost::filesystem::path file;
+        std::uint32_t seq;
+        TraceClock::time_point from;
+        TraceClock::time_point to;
+    };
+
+    void
+    release (std::shared_ptr<TraceBuffer> buffer);
+
+    boost::filesystem::path
+    slowFile (std::uint32_t seq) const
+    {
+        return path_ / ("slow-ledger-" + std::to_string (seq) + ".json");
+    }
+
+    void
+    write (Timeline const& timeline,
+        std::vector<std::pair<unsigned, TraceEvent>> const& events,
+            beast::Journal journal);
+
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers_;
+    // Buffers of threads which exited, for new threads to use
+    std::vector<std::shared_ptr<TraceBuffer>> idle_;
+    boost::optional<beast::Journal> journal_;
+    boost::filesystem::path path_;
+    std::uint32_t sample_ = 0;
+    std::size_t slowest_ = 0;
+
+    // Start of the consensus round for each ledger not yet saved
+    std::map<std::uint32_t, TraceClock::time_point> opened_;
+
+    // The slowest ledgers of the current hour, fastest first
+    std::vector<std::pair<TraceClock::duration, std::uint32_t>> slow_;
+    std::chrono::hours::rep hour_ = 0;
+
+    // Files are written and removed in the order they were decided on,
+    // so a slow ledger's file is not removed before it is written
+    std::mutex fileMutex_;
+    std::condition_variable fileCond_;
+    std::uint64_t nextTicket_ = 0;
+    std::uint64_t doneTicket_ = 0;
+};
+
+void
+Tracer::setup (Section const& section, beast::Journal journal)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    journal_.emplace (journal);
+    path_ = get<std::string> (section, "path");
+    sample_ = get<std::uint32_t> (section, "sample", 0);
+    slowest_ = get<std::size_t> (section, "slowest", 5);
+    opened_.clear ();
+    slow_.clear ();
+
+    if (path_.empty ())
+    {
+        tracing = false;
+        return;
+    }
+
+#if RIPPLE_TRACING
+    boost::system::error_code ec;
+    boost::filesystem::create_directories (path_, ec);
+    if (ec)
+        Throw<std::runtime_error> ("Unable to create trace directory " +
+            path_.string () + ": " + ec.message ());
+
+    JLOG (journal_->info) <<
+        "Writing ledger timelines to " << path_.string () <<
+        ", sampling 1 in " << sample_ << " and the slowest " <<
+        slowest_ << " each hour";
+    tracing = true;
+#else
+    JLOG (journal_->warning) <<
+        "Tracing was not compiled in, [tracing] is ignored";
+#endif
+}
+
+TraceBuffer&
+Tracer::buffer ()
+{
+    static thread_local Holder holder;
+
+    if (! holder.buffer)
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        if (! idle_.empty ())
+        {
+            // Its spans stay, so a timeline still being written has them
+            holder.buffer = std::move (idle_.back ());
+            idle_.pop_back ();
+        }
+        else
+        {
+            holder.buffer = std::make_shared<TraceBuffer> (
+                buffers_.size () + 1);
+            buffers_.push_back (holder.buffer);
+        }
+    }
+    return *holder.buffer;
+}
+
+void
+Tracer::release (std::shared_ptr<TraceBuffer> buffer)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    idle_.push_back (std::move (buffer));
+}
+
+void
+Tracer::ledgerOpened (std::uint32_t seq)
+{
+    auto const now = TraceClock::now ();
+    std::lock_guard<std::mutex> lock (mutex_);
+    opened_.emplace (seq, now);
+}
+
+void
+Tracer::ledgerSaved (std::uint32_t seq)
+{
+    auto const now = TraceClock::now ();
+
+    std::vector<Timeline> timelines;
+    boost::optional<boost::filesystem::path> stale;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    boost::optional<beast::Journal> journal;
+    std::uint64_t ticket;
+
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+
+        auto const iter = opened_.find (seq);
+        if (iter == opened_.end ())
+            return;
+        auto const start = iter->second;
+        opened_.erase (iter);
+
+        // Saves can finish out of order, but not by this much
+        opened_.erase (opened_.begin (),
+            opened_.lower_bound (seq - std::min (seq, 256u)));
+
+        if (sample_ != 0 && (seq % sample_) == 0)
+            timelines.push_back ({path_ / ("ledger-" +
+                std::to_string (seq) + ".json"), seq, start, now});
+
+        if (slowest_ != 0)
+        {
+            auto const hour = std::chrono::duration_cast<
+                std::chrono::hours> (std::chrono::system_clock::now ()
+                    .time_since_epoch ()).count ();
+            if (hour != hour_)
+            {
+                // Last hour's files stay as its record
+                hour_ = hour;
+                slow_.clear ();
+            }
+
+            auto const elapsed = now - start;
+            if (slow_.size () < slowest_ || elapsed > slow_.front ().first)
+            {
+                if (slow_.size () >= slowest_)
+                {
+                    stale = slowFile (slow_.front ().second);
+                    slow_.erase (slow_.begin ());
+                }
+
+                timelines.push_back ({slowFile (seq), seq, start, now});
+                auto const entry = std::make_pair (elapsed, seq);
+                slow_.insert (std::upper_bound (
+                    slow_.begin (), slow_.end (), entry), entry);
+            }
+        }
+
+        if (timelines.empty ())
+            return;
+
+        buffers = buffers_;
+        journal.emplace (*journal_);
+        ticket = nextTicket_++;
+    }
+
+    // Each buffer is only locked while its spans are copied
+    std::vector<std::pair<unsigned, TraceEvent>> events;
+    auto const& window = timelines.front ();
+    for (auto const& buffer : buffers)
+        buffer->copy (window.from, window.to, events);
+
+    std::sort (events.begin (), events.end (),
+        [](std::pair<unsigned, TraceEvent> const& a,
+            std::pair<unsigned, TraceEvent> const& b)
+        {
+            return a.second.start < b.second.start;
+        });
+
+    std::unique_lock<std::mutex> lock (fileMutex_);
+    fileCond_.wait (lock, [this, ticket] { return doneTicket_ == ticket; });
+
+    if (stale)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove (*stale, ec);
+    }
+    for (auto const& timeline : timelines)
+        write (timeline, events, *journal);
+
+    ++doneTicket_;
+    fileCond_.notify_all ();
+}
+
+void
+Tracer::write (Timeline const& timeline,
+    std::vector<std::pair<unsigned, TraceEvent>> const& events,
+        beast::Journal journal)
+{
+    std::ofstream out (timeline.file.string ());
+    if (! out)
+    {
+        JLOG (journal.warning) <<
+            "Unable to write trace " << timeline.file.string ();
+        return;
+    }
+
+    auto const from = timeline.from;
+
+    // Times are in microseconds from the start of the window
+    auto micros = [](TraceClock::duration d)
+    {
+        return std::chrono::duration<double, std::micro> (d).count ();
+    };
+
+    out << std::fixed << std::setprecision (3);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (auto const& event : events)
+    {
+        auto const& e = event.second;
+        if (! first)
+            out << ",";
+        first = false;
+
+        out << "\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1" <<
+            ",\"tid\":" << event.first <<
+            ",\"ts\":" << micros (e.start - from) <<
+            ",\"dur\":" << micros (e.duration);
+        if (e.kind == TraceKind::ledger)
+        {
+            out << ",\"cat\":\"ledger\",\"args\":{\"ledger\":" << e.id << "}}";
+        }
+        else
+        {
+            out << ",\"cat\":\"tx\",\"args\":{\"tx\":\"" << std::hex <<
+                std::uppercase << std::setw (16) << std::setfill ('0') <<
+                    e.id << std::dec << "\"}}";
+        }
+    }
+    out << "\n],\"otherData\":{\"ledger\":" << timeline.seq <<
+        ",\"duration_us\":" << micros (timeline.to - from) << "}}\n";
+}
+
+} // detail
+
+//------------------------------------------------------------------------------
+
+void
+setupTracing (Section const& section, beast::Journal journal)
+{
+    detail::Tracer::getInstance ().setup (section, journal);
+}
+
+void
+traceSpan (char const* name, TraceKind kind, std::uint64_t id,
+    TraceClock::time_point start)
+{
+    if (! tracingEnabled ())
+        return;
+
+    auto const now = TraceClock::now ();
+    detail::Tracer::getInstance ().buffer ().add (
+        { name, kind, id, start, now - start });
+}
+
+std::uint64_t
+traceId (uint256 const& txID)
+{
+    std::uint64_t id = 0;
+    for (auto iter = txID.begin (); iter != txID.begin () + 8; ++iter)
+        id = (id << 8) | *iter;
+    return id;
+}
+
+void
+traceLedgerOpened (std::uint32_t seq)
+{
+    if (tracingEnabled ())
+        detail::Tracer::getInstance ().ledgerOpened (seq);
+}
+
+void
+traceLedgerSaved (std::uint32_t seq)
+{
+    if (tracingEnabled ())
+        detail::Tracer::getInstance ().ledgerSaved (seq);
+}
+
+} // ripple
@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/core/Affinity.h>
+#include <beast/Config.h>
+#include <beast/unit_test/suite.h>
+
+namespace ripple {
+
+class Affinity_test : public beast::unit_test::suite
+{
+    void
+    testParse ()
+    {
+        testcase ("parse");
+
+        using list = std::vector<unsigned>;
+
+        expect (parseCpuList ("3") == list {3});
+        expect (parseCpuList ("0-3") == list {0, 1, 2, 3});
+        expect (parseCpuList ("8, 0-2,10 - 11") == list {0, 1, 2, 8, 10, 11});
+        expect (parseCpuList ("1-2,2-3") == list {1, 2, 3});
+
+        for (auto const bad : {"", "a", "1-", "-1", "3-1", "1-2-3",
+                "1,,2", "2x", "4096"})
+        {
+            expect (! parseCpuList (bad), bad);
+        }
+    }
+
+    void
+    testSection ()
+    {
+        testcase ("section");
+
+        auto throws = [](std::string const& line)
+        {
+            Section section ("affinity");
+            section.append (line);
+            try
+            {
+                setupAffinity (section, beast::Journal ());
+            }
+            catch (std::runtime_error const&)
+            {
+                return true;
+            }
+            return false;
+        };
+
+        expect (throws ("peers=0-1"));
+        expect (throws ("jobs=1-0"));
+        expect (throws ("io=x"));
+#if BEAST_LINUX
+        // Valid, but no process here may use it
+        expect (throws ("nodestore=1023"));
+#endif
+    }
+
+public:
+    void
+    run ()
+    {
+        testParse ();
+        testSection ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(Affinity,core,ripple);
+
+} // ripple
@@ -0,0 +1,459 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/core/JobQueue.h>
+#include <ripple/basics/Log.h>
+#include <beast/insight/NullCollector.h>
+#include <beast/threads/Stoppable.h>
+#include <beast/unit_test/suite.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ripple {
+namespace test {
+
+// Counts finished jobs and lets a thread wait for a number of them
+class JobCounter
+{
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    int count_ = 0;
+
+public:
+    void
+    finish ()
+    {
+        std::lock_guard <std::mutex> lock (mutex_);
+        ++count_;
+        cond_.notify_all ();
+    }
+
+    bool
+    wait (int count, std::chrono::seconds timeout = std::chrono::seconds (10))
+    {
+        std::unique_lock <std::mutex> lock (mutex_);
+        return cond_.wait_for (lock, timeout,
+            [this, count] { return count_ >= count; });
+    }
+};
+
+class JobQueue_test : public beast::unit_test::suite
+{
+    Logs logs_;
+    beast::RootStoppable root_ {"test"};
+
+    std::unique_ptr <JobQueue>
+    makeQueue (int threads, int reserved = 0)
+    {
+        logs_.severity (beast::Journal::kError);
+        auto jq = std::make_unique <JobQueue> (
+            beast::insight::NullCollector::New (), root_,
+                logs_.journal ("JobQueue"), logs_);
+        jq->setThreadCount (threads, false);
+        jq->setReservedThreadCount (reserved);
+        return jq;
+    }
+
+    void
+    testPriority ()
+    {
+        testcase ("priority");
+
+        auto jq = makeQueue (1);
+
+        // Hold the only thread while the other jobs are queued
+        JobCounter started;
+        JobCounter release;
+        jq->addJob (jtADMIN, "block",
+            [&](Job&)
+            {
+                started.finish ();
+                release.wait (1);
+            });
+        expect (started.wait (1));
+
+        std::mutex mutex;
+        std::vector <std::pair <JobType, int>> order;
+        JobCounter done;
+
+        std::vector <std::pair <JobType, int>> const jobs {
+            {jtCLIENT, 0}, {jtTXN_DATA, 0}, {jtLEDGER_DATA, 0},
+            {jtCLIENT, 1}, {jtPROPOSAL_t, 0}, {jtTXN_DATA, 1},
+            {jtLEDGER_DATA, 1}, {jtPROPOSAL_t, 1}, {jtCLIENT, 2}};
+        for (auto const& j : jobs)
+        {
+            jq->addJob (j.first, "test",
+                [&, j](Job&)
+                {
+                    {
+                        std::lock_guard <std::mutex> lock (mutex);
+                        order.push_back (j);
+                    }
+                    done.finish ();
+                });
+        }
+        expect (jq->getJobCount (jtCLIENT) == 3);
+        expect (jq->getJobCountGE (jtTXN_DATA) == 4);
+
+        release.finish ();
+        expect (done.wait (jobs.size ()));
+
+        // Highest priority first, in the order queued within a type
+        std::vector <std::pair <JobType, int>> const expected {
+            {jtPROPOSAL_t, 0}, {jtPROPOSAL_t, 1}, {jtTXN_DATA, 0},
+            {jtTXN_DATA, 1}, {jtCLIENT, 0}, {jtCLIENT, 1},
+            {jtCLIENT, 2}, {jtLEDGER_DATA, 0}, {jtLEDGER_DATA, 1}};
+        expect (order == expected);
+
+        // Each type reports how long its jobs waited and ran
+        auto const json = jq->getJson ();
+        int reported = 0;
+        for (auto const& pri : json["job_types"])
+        {
+            if (pri["job_type"] == "clientCommand")
+            {
+                ++reported;
+                expect (pri["queue_us"]["count"] == 3);
+                expect (pri["run_us"]["count"] == 3);
+                expect (pri["queue_us"]["max"].asUInt () >=
+                    pri["queue_us"]["p50"].asUInt ());
+            }
+        }
+        expect (reported == 1);
+
+        jq->shutdown ();
+    }
+
+    void
+    testLimit ()
+    {
+        testcase ("limit");
+
+        auto jq = makeQueue (4);
+
+        int const count = 20;
+        std::atomic <int> running {0};
+        std::atomic <int> peak {0};
+        std::atomic <int> limitedDone {0};
+        std::atomic <int> overtaken {0};
+        JobCounter done;
+
+        // jtTXN_DATA may only run one at a time; the jobs behind
+        // it must still be dispatched to the other threads.
+        for (int i = 0; i < count; ++i)
+        {
+            jq->addJob (jtTXN_DATA, "limited",
+                [&](Job&)
+                {
+                    auto const now = ++running;
+                    if (now > peak)
+                        peak = now;
+                    std::this_thread::sleep_for (std::chrono::milliseconds (2));
+                    --running;
+                    ++limitedDone;
+                    done.finish ();
+                });
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            jq->addJob (jtCLIENT, "unlimited",
+                [&](Job&)
+                {
+                    if (limitedDone < count)
+                        ++overtaken;
+                    done.finish ();
+                });
+        }
+
+        expect (done.wait (2 * count));
+        expect (peak == 1);
+        expect (overtaken > 0);
+
+        jq->shutdown ();
+    }
+
+    void
+    testReserved ()
+    {
+        testcase ("reserved");
+
+        auto jq = makeQueue (2, 1);
+        expect (jq->getJson ()["reserved_threads"] == 1);
+
+        // Hold every general thread with a long running job
+        JobCounter started;
+        JobCounter release;
+        for (int i = 0; i < 2; ++i)
+            jq->addJob (jtCLIENT, "block",
+                [&](Job&)
+                {
+                    started.finish ();
+                    release.wait (1);
+                });
+        expect (started.wait (2));
+
+        JobCounter done;
+        jq->addJob (jtLEDGER_DATA, "other",
+            [&](Job&) { done.finish (); });
+
+        // A proposal still runs, on the reserved thread
+        JobCounter proposal;
+        jq->addJob (jtPROPOSAL_t, "proposal",
+            [&](Job&)
+            {
+                proposal.finish ();
+                done.finish ();
+            });
+        expect (proposal.wait (1));
+
+        // Other job types never run there
+        expect (jq->getJobCount (jtLEDGER_DATA) == 1);
+
+        release.finish ();
+        expect (done.wait (2));
+
+        jq->shutdown ();
+    }
+
+    void
+    testDeadline ()
+    {
+        testcase ("deadline");
+
+        using namespace std::chrono;
+
+        auto jq = makeQueue (1);
+
+        JobCounter started;
+        JobCounter release;
+        jq->addJob (jtCLIENT, "block",
+            [&](Job&)
+            {
+                started.finish ();
+                release.wait (1);
+            });
+        expect (started.wait (1));
+        expect (! jq->shouldYield ());
+
+        // Only a waiting job with a deadline asks the thread back
+        JobCounter done;
+        jq->addJob (jtLEDGER_DATA, "other",
+            [&](Job&) { done.finish (); });
+        expect (! jq->shouldYield ());
+
+        jq->addJob (jtPROPOSAL_t, "proposal",
+            [&](Job&) { done.finish (); });
+        expect (jq->shouldYield ());
+
+        // Started too late, and reported as such
+        std::this_thread::sleep_for (milliseconds (300));
+        release.finish ();
+        expect (done.wait (2));
+        expect (! jq->shouldYield ());
+
+        auto const json = jq->getJson ();
+        int reported = 0;
+        for (auto const& pri : json["job_types"])
+        {
+            if (pri["job_type"] == "trustedProposal")
+            {
+                ++reported;
+                expect (pri["deadline_missed"] == 1);
+            }
+            else
+            {
+                expect (! pri.isMember ("deadline_missed"));
+            }
+        }
+        expect (reported == 1);
+
+        jq->shutdown ();
+
+        // An idle reserved thread takes it without anyone yielding
+        jq = makeQueue (1, 1);
+        JobCounter held;
+        JobCounter unblock;
+        jq->addJob (jtCLIENT, "block",
+            [&](Job&)
+            {
+                held.finish ();
+                unblock.wait (1);
+            });
+        expect (held.wait (1));
+
+        JobCounter proposal;
+        jq->addJob (jtPROPOSAL_t, "proposal",
+            [&](Job&) { proposal.finish (); });
+        expect (! jq->shouldYield ());
+        expect (proposal.wait (1));
+
+        unblock.finish ();
+        jq->shutdown ();
+    }
+
+public:
+    void
+    run ()
+    {
+        testPriority ();
+        testLimit ();
+        testReserved ();
+        testDeadline ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(JobQueue,core,ripple);
+
+//------------------------------------------------------------------------------
+
+// Time draining a queue of jobs, with and without a flood of jobs
+// ahead of them that are held back by their type's limit, and measure
+// how long proposals wait while long jobs occupy every thread
+class JobQueueTiming_test : public beast::unit_test::suite
+{
+    Logs logs_;
+    beast::RootStoppable root_ {"test"};
+
+    std::chrono::milliseconds
+    drain (int threads, int limited, int unlimited)
+    {
+        using namespace std::chrono;
+
+        // Queued jobs wait long enough for the load monitor to warn
+        logs_.severity (beast::Journal::kError);
+        JobQueue jq (beast::insight::NullCollector::New (), root_,
+            logs_.journal ("JobQueue"), logs_);
+        jq.setThreadCount (threads, false);
+
+        // Queue everything before any of it can run
+        JobCounter started;
+        JobCounter release;
+        for (int i = 0; i < threads; ++i)
+            jq.addJob (jtADMIN, "block",
+                [&](Job&)
+                {
+                    started.finish ();
+                    release.wait (1);
+                });
+        expect (started.wait (threads));
+
+        JobCounter done;
+        for (int i = 0; i < limited; ++i)
+            jq.addJob (jtTXN_DATA, "limited",
+                [&done](Job&)
+                {
+                    std::this_thread::sleep_for (microseconds (100));
+                    done.finish ();
+                });
+        for (int i = 0; i < unlimited; ++i)
+            jq.addJob (jtCLIENT, "unlimited",
+                [&done](Job&) { done.finish (); });
+
+        auto const start = steady_clock::now ();
+        release.finish ();
+        expect (done.wait (limited + unlimited, seconds (600)));
+        auto const elapsed = duration_cast<milliseconds> (
+            steady_clock::now () - start);
+
+        jq.shutdown ();
+        return elapsed;
+    }
+
+    // Returns the longest time a proposal waited to run
+    std::chrono::microseconds
+    proposalDelay (int threads, int reserved)
+    {
+        using namespace std::chrono;
+
+        logs_.severity (beast::Journal::kError);
+        JobQueue jq (beast::insight::NullCollector::New (), root_,
+            logs_.journal ("JobQueue"), logs_);
+        jq.setThreadCount (threads, false);
+        jq.setReservedThreadCount (reserved);
+
+        int const slow = 20 * threads;
+        int const proposals = 40;
+
+        JobCounter done;
+        for (int i = 0; i < slow; ++i)
+            jq.addJob (jtCLIENT, "slow",
+                [&done](Job&)
+                {
+                    std::this_thread::sleep_for (milliseconds (50));
+                    done.finish ();
+                });
+
+        std::mutex mutex;
+        microseconds worst {0};
+        for (int i = 0; i < proposals; ++i)
+        {
+            auto const queued = steady_clock::now ();
+            jq.addJob (jtPROPOSAL_t, "proposal",
+                [&, queued](Job&)
+                {
+                    auto const waited = duration_cast<microseconds> (
+                        steady_clock::now () - queued);
+                    {
+                        std::lock_guard <std::mutex> lock (mutex);
+                        worst = std::max (worst, waited);
+                    }
+                    done.finish ();
+                });
+            std::this_thread::sleep_for (milliseconds (20));
+        }
+
+        expect (done.wait (slow + proposals, seconds (600)));
+        jq.shutdown ();
+        return worst;
+    }
+
+public:
+    void
+    run ()
+    {
+        for (int reserved : {0, 1})
+        {
+            log << "2 threads busy with 50ms jobs, " << reserved <<
+                " reserved: proposals waited up to " <<
+                    proposalDelay (2, reserved).count () << "us";
+        }
+
+        int const limited = 5000;
+        int const unlimited = 20000;
+
+        for (int threads : {1, 4})
+        {
+            log << threads << " threads: " << unlimited <<
+                " jobs in " << drain (threads, 0, unlimited).count () <<
+                    "ms, with " << limited << " limited jobs in " <<
+                        drain (threads, limited, unlimited).count () << "ms";
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(JobQueueTiming,core,ripple);
+
+} // test
+} // ripple
@@ -0,0 +1,139 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/core/LatencyHistogram.h>
+#include <beast/unit_test/suite.h>
+#include <thread>
+#include <vector>
+
+namespace ripple {
+
+class LatencyHistogram_test : public beast::unit_test::suite
+{
+    using us = std::chrono::microseconds;
+
+    void
+    testBuckets ()
+    {
+        testcase ("buckets");
+
+        // Every value falls within its bucket, and buckets are no
+        // wider than 1/16 of their values.
+        std::size_t last = 0;
+        for (std::uint64_t v = 0; v < 1000000; v += 1 + v / 100)
+        {
+            auto const b = LatencyHistogram::bucket (v);
+            expect (b >= last);
+            expect (v <= LatencyHistogram::upperBound (b));
+            if (b > 0)
+                expect (v > LatencyHistogram::upperBound (b - 1));
+            expect (LatencyHistogram::upperBound (b) - v <= v / 16,
+                std::to_string (v));
+            last = b;
+        }
+        for (std::uint64_t v = 0; v < 32; ++v)
+            expect (LatencyHistogram::upperBound (
+                LatencyHistogram::bucket (v)) == v);
+
+        // Very long durations share the last bucket
+        expect (LatencyHistogram::bucket (std::uint64_t (1) << 40) ==
+            LatencyHistogram::bucketCount - 1);
+    }
+
+    void
+    testPercentiles ()
+    {
+        testcase ("percentiles");
+
+        LatencyHistogram h;
+        expect (h.snapshot ().count () == 0);
+        expect (h.snapshot ().percentile (0.99) == us (0));
+
+        // 1..1000us, once each
+        for (int i = 1; i <= 1000; ++i)
+            h.record (us (i));
+
+        auto const s = h.snapshot ();
+        expect (s.count () == 1000);
+        expect (s.max () == us (1000));
+
+        auto near = [](us d, int value)
+        {
+            return d.count () >= value && d.count () <= value + value / 16;
+        };
+        expect (near (s.percentile (0.5), 500));
+        expect (near (s.percentile (0.99), 990));
+        expect (near (s.percentile (0.999), 999));
+        expect (s.percentile (1.0) == us (1000));
+
+        // An interval only counts what was recorded since its start
+        for (int i = 0; i < 100; ++i)
+            h.record (us (5000));
+        auto interval = h.snapshot ();
+        interval -= s;
+        expect (interval.count () == 100);
+        expect (near (interval.percentile (0.5), 5000));
+        expect (near (interval.max (), 5000));
+
+        auto empty = h.snapshot ();
+        empty -= h.snapshot ();
+        expect (empty.count () == 0);
+        expect (empty.max () == us (0));
+    }
+
+    void
+    testThreads ()
+    {
+        testcase ("threads");
+
+        LatencyHistogram h;
+        int const threads = 4;
+        int const count = 100000;
+
+        std::vector <std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back ([&h, t, count]
+            {
+                for (int i = 0; i < count; ++i)
+                    h.record (us (i % 1000 + t));
+            });
+        }
+        for (auto& w : workers)
+            w.join ();
+
+        auto const s = h.snapshot ();
+        expect (s.count () == threads * count);
+        expect (s.max () == us (999 + threads - 1));
+    }
+
+public:
+    void
+    run ()
+    {
+        testBuckets ();
+        testPercentiles ();
+        testThreads ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(LatencyHistogram,core,ripple);
+
+} // ripple
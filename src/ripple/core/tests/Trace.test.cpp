@@ -0,0 +1,196 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#include <BeastConfig.h>
+#include <ripple/core/Trace.h>
+#include <beast/unit_test/suite.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <thread>
+
+namespace ripple {
+
+class Trace_test : public beast::unit_test::suite
+{
+    boost::filesystem::path dir_;
+
+    void
+    setup (std::string const& sample, std::string const& slowest)
+    {
+        Section section ("tracing");
+        section.append ("path=" + dir_.string ());
+        section.append ("sample=" + sample);
+        section.append ("slowest=" + slowest);
+        setupTracing (section, beast::Journal ());
+    }
+
+    std::string
+    read (std::string const& name)
+    {
+        std::ifstream in ((dir_ / name).string ());
+        return std::string (std::istreambuf_iterator<char> (in),
+            std::istreambuf_iterator<char> ());
+    }
+
+    bool
+    exists (std::string const& name)
+    {
+        return boost::filesystem::exists (dir_ / name);
+    }
+
+    void
+    testTimeline ()
+    {
+        testcase ("timeline");
+
+        setup ("2", "0");
+        expect (tracingEnabled ());
+
+        uint256 txID;
+        txID.SetHex ("0123456789ABCDEF"
+            "000000000000000000000000000000000000000000000000");
+        expect (traceId (txID) == 0x0123456789ABCDEFull);
+
+        {
+            RIPPLE_TRACE_LEDGER ("beforeOpen", 10);
+        }
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+
+        traceLedgerOpened (10);
+        {
+            RIPPLE_TRACE_LEDGER ("acceptLedger", 10);
+            std::thread ([&txID]
+            {
+                RIPPLE_TRACE_TX ("preflight", txID);
+            }).join ();
+        }
+        traceLedgerSaved (10);
+
+        expect (exists ("ledger-10.json"));
+        auto const text = read ("ledger-10.json");
+        expect (text.find ("\"name\":\"acceptLedger\"") != std::string::npos);
+        expect (text.find ("\"ledger\":10}") != std::string::npos);
+        expect (text.find ("\"name\":\"preflight\"") != std::string::npos);
+        expect (text.find ("\"tx\":\"0123456789ABCDEF\"") != std::string::npos);
+        expect (text.find ("beforeOpen") == std::string::npos);
+
+        // Only sampled ledgers are written
+        traceLedgerOpened (11);
+        traceLedgerSaved (11);
+        expect (! exists ("ledger-11.json"));
+
+        // As are only ledgers whose round was seen
+        traceLedgerSaved (12);
+        expect (! exists ("ledger-12.json"));
+    }
+
+    void
+    testSlowest ()
+    {
+        testcase ("slowest");
+
+        setup ("0", "2");
+
+        auto ledger = [](std::uint32_t seq, int ms)
+        {
+            traceLedgerOpened (seq);
+            std::this_thread::sleep_for (std::chrono::milliseconds (ms));
+            traceLedgerSaved (seq);
+        };
+
+        ledger (20, 10);
+        ledger (21, 60);
+        ledger (22, 1);
+        ledger (23, 30);
+
+        expect (! exists ("slow-ledger-20.json"));
+        expect (exists ("slow-ledger-21.json"));
+        expect (! exists ("slow-ledger-22.json"));
+        expect (exists ("slow-ledger-23.json"));
+        expect (! exists ("ledger-21.json"));
+    }
+
+    void
+    testThreads ()
+    {
+        testcase ("threads");
+
+        setup ("1", "0");
+
+        // Each thread that exits gives its buffer to the next
+        traceLedgerOpened (40);
+        for (int i = 0; i < 20; ++i)
+        {
+            std::thread ([]
+            {
+                RIPPLE_TRACE_LEDGER ("worker", 40);
+            }).join ();
+        }
+        traceLedgerSaved (40);
+
+        auto const text = read ("ledger-40.json");
+        std::set<std::string> threads;
+        std::size_t spans = 0;
+        for (auto pos = text.find ("\"worker\""); pos != std::string::npos;
+            pos = text.find ("\"worker\"", pos + 1))
+        {
+            ++spans;
+            auto const tid = text.find ("\"tid\":", pos);
+            threads.insert (text.substr (tid, text.find (',', tid) - tid));
+        }
+        expect (spans == 20, std::to_string (spans));
+        expect (threads.size () == 1, std::to_string (threads.size ()));
+    }
+
+    void
+    testDisabled ()
+    {
+        testcase ("disabled");
+
+        setupTracing (Section ("tracing"), beast::Journal ());
+        expect (! tracingEnabled ());
+
+        traceLedgerOpened (30);
+        traceLedgerSaved (30);
+        expect (! exists ("slow-ledger-30.json"));
+    }
+
+public:
+    void
+    run ()
+    {
+        dir_ = boost::filesystem::temp_directory_path () /
+            boost::filesystem::unique_path ();
+
+        testTimeline ();
+        testSlowest ();
+        testThreads ();
+        testDisabled ();
+
+        boost::system::error_code ec;
+        boost::filesystem::remove_all (dir_, ec);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(Trace,core,ripple);
+
+} // ripple
@@ -23,6 +23,7 @@
 #include <ripple/json/to_string.h>
 #include <ripple/json/json_writer.h>
 #include <beast/module/core/text/LexicalCast.h>
+#include <atomic>
 
 namespace Json {
 
@@ -31,6 +32,19 @@ const Int Value::minInt = Int ( ~ (UInt (-1) / 2) );
 const Int Value::maxInt = Int ( UInt (-1) / 2 );
 const UInt Value::maxUInt = UInt (-1);
 
+static std::atomic<MemoryHook> memoryHook ( nullptr );
+
+MemoryHook setMemoryHook ( MemoryHook hook )
+{
+    return memoryHook.exchange ( hook );
+}
+
+void detail::countMemory ( std::ptrdiff_t bytes ) noexcept
+{
+    if ( auto const hook = memoryHook.load ( std::memory_order_relaxed ) )
+        hook ( bytes );
+}
+
 ValueAllocator::~ValueAllocator ()
 {
 }
@@ -52,6 +66,8 @@ public:
         releaseStringValue ( memberName );
     }
 
+    // Each string is preceded by its length, so that releasing it can
+    // tell the memory hook without measuring it again
     virtual char* duplicateStringValue ( const char* value,
                                          unsigned int length = unknown )
     {
@@ -62,16 +78,30 @@ public:
         if ( length == unknown )
             length = (unsigned int)strlen (value);
 
-        char* newString = static_cast<char*> ( malloc ( length + 1 ) );
+        auto const size = sizeof ( length ) + length + 1;
+        char* block = static_cast<char*> ( malloc ( size ) );
+        memcpy ( block, &length, sizeof ( length ) );
+
+        char* newString = block + sizeof ( length );
         memcpy ( newString, value, length );
         newString[length] = 0;
+
+        detail::countMemory ( size );
         return newString;
     }
 
     virtual void releaseStringValue ( char* value )
     {
         if ( value )
-            free ( value );
+        {
+            unsigned int length;
+            char* block = value - sizeof ( length );
+            memcpy ( &length, block, sizeof ( length ) );
+
+            detail::countMemory (
+                - static_cast<std::ptrdiff_t> ( sizeof ( length ) + length + 1 ) );
+            free ( block );
+        }
     }
 };
 
@@ -22,8 +22,10 @@
 
 #include <ripple/json/json_forwards.h>
 #include <beast/strings/String.h>
+#include <cstddef>
 #include <functional>
 #include <map>
+#include <memory>
 #include <vector>
 
 /** \brief JSON (JavaScript Object Notation).
@@ -45,6 +47,76 @@ enum ValueType
     objectValue    ///< object value (collection of name/value pairs).
 };
 
+/** \brief Function told about the memory taken by members and strings.
+ *
+ * It is called with the bytes taken, and with the bytes given back negated.
+ * Values themselves are not counted, which keeps the cost off the many
+ * temporaries.
+ */
+using MemoryHook = void (*) ( std::ptrdiff_t bytes );
+
+/** \brief Set the function told about the memory values take.
+ *
+ * Set it before any values are made, so that the memory given back was
+ * counted when it was taken.
+ * \return The function which was set before.
+ */
+MemoryHook setMemoryHook ( MemoryHook hook );
+
+namespace detail
+{
+
+void countMemory ( std::ptrdiff_t bytes ) noexcept;
+
+/** \brief Allocator for members, which tells the memory hook.
+ */
+template <class T>
+class MemberAllocator
+{
+public:
+    using value_type = T;
+
+    template <class U>
+    struct rebind
+    {
+        using other = MemberAllocator <U>;
+    };
+
+    MemberAllocator () = default;
+
+    template <class U>
+    MemberAllocator ( MemberAllocator <U> const& ) noexcept
+    {
+    }
+
+    T* allocate ( std::size_t n )
+    {
+        auto const p = std::allocator <T> ().allocate ( n );
+        countMemory ( n * sizeof ( T ) );
+        return p;
+    }
+
+    void deallocate ( T* p, std::size_t n ) noexcept
+    {
+        countMemory ( - static_cast<std::ptrdiff_t> ( n * sizeof ( T ) ) );
+        std::allocator <T> ().deallocate ( p, n );
+    }
+
+    template <class U>
+    bool operator== ( MemberAllocator <U> const& ) const noexcept
+    {
+        return true;
+    }
+
+    template <class U>
+    bool operator!= ( MemberAllocator <U> const& ) const noexcept
+    {
+        return false;
+    }
+};
+
+} // detail
+
 enum CommentPlacement
 {
     commentBefore = 0,        ///< a comment placed on the line before a value
@@ -192,7 +264,8 @@ private:
     };
 
 public:
-    using ObjectValues = std::map<CZString, Value>;
+    using ObjectValues = std::map<CZString, Value, std::less<CZString>,
+        detail::MemberAllocator<std::pair<CZString const, Value>>>;
 
 public:
     /** \brief Create a default Value of the given type.
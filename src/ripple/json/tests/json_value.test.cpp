@@ -22,6 +22,7 @@
 #include <ripple/json/json_reader.h>
 #include <beast/unit_test/suite.h>
 #include <beast/utility/type_name.h>
+#include <atomic>
 
 namespace ripple {
 
@@ -217,6 +218,49 @@ struct json_value_test : beast::unit_test::suite
         testGreaterThan ("big");
     }
 
+    static std::atomic<std::ptrdiff_t>& memory ()
+    {
+        static std::atomic<std::ptrdiff_t> bytes (0);
+        return bytes;
+    }
+
+    static void countMemory (std::ptrdiff_t bytes)
+    {
+        memory () += bytes;
+    }
+
+    void test_memory ()
+    {
+        auto const previous = Json::setMemoryHook (&countMemory);
+
+        {
+            Json::Value s ("hello");
+            expect (memory () == sizeof (unsigned int) + 6);
+
+            // Strings with embedded nulls are counted in full
+            char const text[] = "a\0b";
+            Json::Value n (text, text + 3);
+            expect (memory () == 2 * sizeof (unsigned int) + 10);
+        }
+        expect (memory () == 0);
+
+        {
+            Json::Value object (Json::objectValue);
+            object["name"] = "value";
+            object["list"].append (1);
+            object["list"].append ("two");
+            expect (memory () > 0);
+
+            Json::Value copy (object);
+            auto const both = memory ().load ();
+            copy.clear ();
+            expect (memory () < both);
+        }
+        expect (memory () == 0);
+
+        expect (Json::setMemoryHook (previous) == &countMemory);
+    }
+
     void run ()
     {
         test_bool ();
@@ -225,6 +269,7 @@ struct json_value_test : beast::unit_test::suite
         test_copy ();
         test_move ();
         test_comparisons ();
+        test_memory ();
     }
 };
 
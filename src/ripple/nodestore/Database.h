@@ -23,6 +23,7 @@
 #include <ripple/nodestore/NodeObject.h>
 #include <ripple/nodestore/Backend.h>
 #include <ripple/basics/TaggedCache.h>
+#include <functional>
 
 namespace ripple {
 namespace NodeStore {
@@ -84,6 +85,25 @@ public:
     */
     virtual bool asyncFetch (uint256 const& hash, std::shared_ptr<NodeObject>& object) = 0;
 
+    /** Called with the result of a read, from the thread that performed it. */
+    using FetchCallback = std::function <void(std::shared_ptr<NodeObject> const&)>;
+
+    /** Fetch an object, calling back when I/O completes.
+        Like the other asyncFetch, `true` is returned and `object` is set if
+        no I/O is required. Otherwise the read is scheduled, `false` is
+        returned, `object` is left untouched and the callback is called
+        with the object, or `nullptr`, once the read completes. The callback
+        may run before this returns.
+
+        @note This can be called concurrently.
+        @param hash The key of the object to retrieve
+        @param object The object retrieved, if no I/O was required
+        @param callback Called with the object if I/O was required
+        @return Whether the operation completed
+    */
+    virtual bool asyncFetch (uint256 const& hash,
+        std::shared_ptr<NodeObject>& object, FetchCallback callback) = 0;
+
     /** Wait for all currently pending async reads to complete.
     */
     virtual void waitReads () = 0;
@@ -109,6 +129,16 @@ public:
                         Blob&& data,
                         uint256 const& hash) = 0;
 
+    /** Store a group of objects.
+
+        The objects are cached together and handed to the backend the
+        same way store() hands them, so backends which write in the
+        background keep doing so.
+
+        @param batch The objects to store.
+    */
+    virtual void storeBatch (Batch const& batch) = 0;
+
     /** Visit every object in the database
         This is usually called during import.
 
@@ -129,6 +159,9 @@ public:
     /** Get the positive cache hits to total attempts ratio. */
     virtual float getCacheHitRate () = 0;
 
+    /** Get the estimated memory used by the positive cache, in bytes. */
+    virtual std::size_t getCacheBytes () const = 0;
+
     /** Set the maximum number of entries and maximum cache age for both caches.
 
         @param size Number of cache entries (0 = ignore)
@@ -74,6 +74,11 @@ public:
                 uint256 const& hash,
                 PrivateAccess);
 
+    ~NodeObject ();
+
+    NodeObject (NodeObject const&) = delete;
+    NodeObject& operator= (NodeObject const&) = delete;
+
     /** Create an object from fields.
 
         The caller's variable is modified during this call. The
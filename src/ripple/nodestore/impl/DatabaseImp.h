@@ -29,6 +29,7 @@
 #include <ripple/protocol/digest.h>
 #include <ripple/basics/Slice.h>
 #include <ripple/basics/TaggedCache.h>
+#include <ripple/core/Affinity.h>
 #include <beast/threads/Thread.h>
 #include <chrono>
 #include <condition_variable>
@@ -60,6 +61,7 @@ private:
     std::set <uint256>        m_readSet;        // set of reads to do
     std::multimap<std::thread::id, std::set<uint256>> m_readSetBusy;
     std::map<std::thread::id, std::list<std::set<uint256>>> m_readSetWait;
+    std::map<uint256, std::vector<FetchCallback>> m_readCallbacks;
     uint256                   m_readLast;       // last hash read
     std::vector <std::thread> m_readThreads;
     bool                      m_readShut;
@@ -148,6 +150,48 @@ public:
         return false;
     }
 
+    bool asyncFetch (uint256 const& hash, std::shared_ptr<NodeObject>& object,
+        FetchCallback callback) override
+    {
+        auto cached = m_cache.fetch (hash);
+        if (cached || m_negCache.touch_if_exists (hash))
+        {
+            object = std::move (cached);
+            return true;
+        }
+
+        // With no read threads nothing would call back
+        if (m_readThreads.empty ())
+        {
+            object = fetch (hash);
+            return true;
+        }
+
+        std::unique_lock <std::mutex> lock (m_readLock);
+
+        // A read is already scheduled for the earlier callbacks
+        auto& callbacks = m_readCallbacks[hash];
+        callbacks.push_back (std::move (callback));
+        if (callbacks.size () > 1)
+            return false;
+
+        if (m_backend && m_backend->canFetchBatch ())
+        {
+            // Filed under no thread, so that waitReads ignores it
+            auto& readSetList = m_readSetWait[std::thread::id ()];
+            if (readSetList.empty () || readSetList.back ().size () >= m_backend->fetchBatchLimit ())
+                readSetList.push_back ({});
+            readSetList.back ().insert (hash);
+            m_readCondVar.notify_one ();
+        }
+        else if (m_readSet.insert (hash).second)
+        {
+            m_readCondVar.notify_one ();
+        }
+
+        return false;
+    }
+
     void waitReads() override
     {
         {
@@ -397,6 +441,34 @@ public:
         m_negCache.erase (hash);
     }
 
+    void storeBatch (Batch const& batch) override
+    {
+        storeBatchInternal (batch, *m_backend.get());
+    }
+
+    void storeBatchInternal (Batch const& batch, Backend& backend)
+    {
+        for (auto object : batch)
+        {
+            #if RIPPLE_VERIFY_NODEOBJECT_KEYS
+            assert (object->getHash () == sha512Hash(makeSlice(object->getData ())));
+            #endif
+
+            m_cache.canonicalize (object->getHash (), object, true);
+            m_storeSize += object->getData().size();
+
+            // Backends with a BatchWriter queue the object and write it
+            // asynchronously, the same as store() does, so a flush never
+            // waits on the disk.
+            backend.store (object);
+        }
+
+        m_storeCount += batch.size ();
+
+        for (auto const& object : batch)
+            m_negCache.erase (object->getHash ());
+    }
+
     //------------------------------------------------------------------------------
 
     float getCacheHitRate () override
@@ -404,6 +476,11 @@ public:
         return m_cache.getHitRate ();
     }
 
+    std::size_t getCacheBytes () const override
+    {
+        return m_cache.getCacheBytes ();
+    }
+
     void tune (int size, int age) override
     {
         m_cache.setTargetSize (size);
@@ -425,16 +502,35 @@ public:
 
     //------------------------------------------------------------------------------
 
+    // Hand a completed read to the callbacks waiting on it
+    void callBack (uint256 const& hash, std::shared_ptr<NodeObject> const& object)
+    {
+        std::vector<FetchCallback> callbacks;
+        {
+            std::unique_lock <std::mutex> lock (m_readLock);
+            auto const it = m_readCallbacks.find (hash);
+            if (it == m_readCallbacks.end ())
+                return;
+            callbacks = std::move (it->second);
+            m_readCallbacks.erase (it);
+        }
+
+        for (auto const& callback : callbacks)
+            callback (object);
+    }
+
     // Entry point for async read threads
     void threadEntry ()
     {
         beast::Thread::setCurrentThreadName ("prefetch");
+        pinCurrentThread (ThreadClass::nodestore);
 
         if (m_backend && m_backend->canFetchBatch ())
         {
             while (1)
             {
                 std::multimap<std::thread::id, std::set<uint256>>::iterator itBusy;
+                std::vector<uint256> waited;
 
                 {
                     std::unique_lock<std::mutex> lock (m_readLock);
@@ -455,10 +551,26 @@ public:
                     itWait->second.pop_front ();
                     if (itWait->second.empty ())
                         m_readSetWait.erase (itWait);
+
+                    if (! m_readCallbacks.empty ())
+                    {
+                        for (auto const& hash : itBusy->second)
+                            if (m_readCallbacks.count (hash) != 0)
+                                waited.push_back (hash);
+                    }
                 }
 
                 doTimedFetch (itBusy->second);
 
+                // What the batch read is in the cache now
+                for (auto const& hash : waited)
+                {
+                    auto object = m_cache.fetch (hash);
+                    if (! object && ! m_negCache.touch_if_exists (hash))
+                        object = doTimedFetch (hash, true);
+                    callBack (hash, object);
+                }
+
                 {
                     std::unique_lock<std::mutex> lock (m_readLock);
                     m_readSetBusy.erase (itBusy);
@@ -502,7 +614,7 @@ public:
             }
 
             // Perform the read
-            doTimedFetch (hash, true);
+            callBack (hash, doTimedFetch (hash, true));
          }
      }
 
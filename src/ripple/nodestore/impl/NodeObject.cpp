@@ -34,6 +34,12 @@ NodeObject::NodeObject (
     , mHash (hash)
 {
     mData = std::move (data);
+    countBytes (mData.capacity ());
+}
+
+NodeObject::~NodeObject ()
+{
+    countBytes (-static_cast<std::ptrdiff_t> (mData.capacity ()));
 }
 
 std::shared_ptr<NodeObject>
@@ -24,6 +24,7 @@
 #include <ripple/basics/Log.h>
 #include <ripple/core/Job.h>
 #include <ripple/overlay/Peer.h>
+#include <ripple/shamap/SHAMapNodeID.h>
 #include <beast/chrono/abstract_clock.h>
 #include <beast/utility/Journal.h>
 #include <boost/asio/deadline_timer.hpp>
@@ -150,6 +151,15 @@ protected:
 
     void sendRequest (const protocol::TMGetLedger& message, Peer::ptr const& peer);
 
+    /** Request nodes, sharing them among the peers in the set.
+
+        Each peer is sent a run of neighbouring keys, so the peers work
+        on different subtrees. The peer passed in, if any, is given a
+        share even when it is not in the set.
+    */
+    void sendNodeRequest (const protocol::TMGetLedger& message,
+        std::vector<SHAMapNodeID> const& nodeIDs, Peer::ptr const& peer);
+
     void setTimer ();
 
     std::size_t getPeerCount () const;
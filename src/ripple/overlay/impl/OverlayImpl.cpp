@@ -19,6 +19,7 @@
 
 #include <BeastConfig.h>
 #include <ripple/app/misc/HashRouter.h>
+#include <ripple/app/main/CollectorManager.h>
 #include <ripple/core/DatabaseCon.h>
 #include <ripple/basics/contract.h>
 #include <ripple/basics/Log.h>
@@ -150,6 +151,8 @@ OverlayImpl::OverlayImpl (
     , m_resolver (resolver)
     , next_id_(1)
     , timer_count_(0)
+    , m_stats (std::bind (&OverlayImpl::collect_metrics, this),
+        app_.getCollectorManager ().collector ())
 {
     beast::PropertyStream::Source::add (m_peerFinder.get());
 }
@@ -618,6 +621,24 @@ OverlayImpl::onWrite (beast::PropertyStream::Map& stream)
     }
 }
 
+void
+OverlayImpl::collect_metrics()
+{
+    m_stats.peers.set (size());
+
+    for (auto const& i : m_traffic.getCounts())
+    {
+        auto iter = m_stats.traffic.find (i.first);
+        if (iter == m_stats.traffic.end())
+            iter = m_stats.traffic.emplace (i.first, TrafficGauges (
+                "traffic." + i.first, m_stats.collector)).first;
+        iter->second.bytesIn.set (i.second.bytesIn.load());
+        iter->second.bytesOut.set (i.second.bytesOut.load());
+        iter->second.messagesIn.set (i.second.messagesIn.load());
+        iter->second.messagesOut.set (i.second.messagesOut.load());
+    }
+}
+
 //------------------------------------------------------------------------------
 /** A peer has connected successfully
     This is called after the peer handshake has been completed and during
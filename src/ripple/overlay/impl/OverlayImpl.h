@@ -41,6 +41,7 @@
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -98,6 +99,41 @@ private:
         on_timer (error_code ec);
     };
 
+    // Totals for one category of traffic, for the collector
+    struct TrafficGauges
+    {
+        TrafficGauges (std::string const& prefix,
+                beast::insight::Collector::ptr const& collector)
+            : bytesIn (collector->make_gauge (prefix, "bytes_in"))
+            , bytesOut (collector->make_gauge (prefix, "bytes_out"))
+            , messagesIn (collector->make_gauge (prefix, "messages_in"))
+            , messagesOut (collector->make_gauge (prefix, "messages_out"))
+            { }
+
+        beast::insight::Gauge bytesIn;
+        beast::insight::Gauge bytesOut;
+        beast::insight::Gauge messagesIn;
+        beast::insight::Gauge messagesOut;
+    };
+
+    struct Stats
+    {
+        template <class Handler>
+        Stats (Handler const& handler,
+                beast::insight::Collector::ptr const& collector_)
+            : collector (collector_)
+            , hook (collector->make_hook (handler))
+            , peers (collector->make_gauge ("overlay", "peers"))
+            { }
+
+        beast::insight::Collector::ptr collector;
+        beast::insight::Hook hook;
+        beast::insight::Gauge peers;
+
+        // Added as categories see their first message
+        std::map <std::string, TrafficGauges> traffic;
+    };
+
     Application& app_;
     boost::asio::io_service& io_service_;
     boost::optional<boost::asio::io_service::work> work_;
@@ -121,6 +157,7 @@ private:
     std::atomic <Peer::id_t> next_id_;
     ManifestCache manifestCache_;
     int timer_count_;
+    Stats m_stats;
 
     //--------------------------------------------------------------------------
 
@@ -329,6 +366,9 @@ private:
     void
     onWrite (beast::PropertyStream::Map& stream) override;
 
+    void
+    collect_metrics();
+
     //--------------------------------------------------------------------------
 
     void
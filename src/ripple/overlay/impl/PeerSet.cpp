@@ -23,6 +23,8 @@
 #include <ripple/core/JobQueue.h>
 #include <ripple/overlay/Overlay.h>
 #include <beast/asio/placeholders.h>
+#include <algorithm>
+#include <tuple>
 
 namespace ripple {
 
@@ -177,6 +179,62 @@ void PeerSet::sendRequest (const protocol::TMGetLedger& tmGL)
     }
 }
 
+void PeerSet::sendNodeRequest (const protocol::TMGetLedger& tmGL,
+    std::vector<SHAMapNodeID> const& nodeIDs, Peer::ptr const& peer)
+{
+    ScopedLockType sl (mLock);
+
+    auto request = [&tmGL](std::vector<SHAMapNodeID>::const_iterator first,
+        std::vector<SHAMapNodeID>::const_iterator last)
+    {
+        protocol::TMGetLedger msg (tmGL);
+        for (; first != last; ++first)
+            *msg.add_nodeids () = first->getRawString ();
+        return std::make_shared<Message> (msg, protocol::mtGET_LEDGER);
+    };
+
+    std::vector<Peer::ptr> peers;
+    peers.reserve (mPeers.size () + 1);
+    for (auto const& p : mPeers)
+    {
+        if (auto iPeer = app_.overlay ().findPeerByShortID (p.first))
+            peers.push_back (std::move (iPeer));
+    }
+
+    // The peer that triggered the request may not have joined the set
+    if (peer && std::none_of (peers.begin (), peers.end (),
+        [&peer](Peer::ptr const& p)
+        {
+            return p->id () == peer->id ();
+        }))
+    {
+        peers.push_back (peer);
+    }
+
+    if (peers.empty () || nodeIDs.empty ())
+        return;
+
+    // The caller has already marked every node as requested, so each
+    // peer gets a share whichever peer prompted the request. Shares are
+    // runs of neighbouring keys, which keeps every peer busy however few
+    // branches the nodes fall under.
+    std::vector<SHAMapNodeID> sorted (nodeIDs);
+    std::sort (sorted.begin (), sorted.end (),
+        [](SHAMapNodeID const& a, SHAMapNodeID const& b)
+        {
+            return std::make_tuple (a.getNodeID (), a.getDepth ()) <
+                std::make_tuple (b.getNodeID (), b.getDepth ());
+        });
+
+    auto const count = std::min (peers.size (), sorted.size ());
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        peers[i]->send (request (
+            sorted.begin () + (sorted.size () * i) / count,
+            sorted.begin () + (sorted.size () * (i + 1)) / count));
+    }
+}
+
 std::size_t PeerSet::getPeerCount () const
 {
     std::size_t ret (0);
@@ -34,6 +34,7 @@ namespace jss {
 */
 // VFALCO What are these nonsense in/out comments?
 
+JSS ( AL_cache_bytes );             // out: GetCounts
 JSS ( AL_hit_rate );                // out: GetCounts
 JSS ( Account );                    // in: TransactionSign; field.
 JSS ( Amount );                     // in: TransactionSign; field.
@@ -265,6 +266,7 @@ JSS ( no_ripple );                  // out: AccountLines
 JSS ( no_ripple_peer );             // out: AccountLines
 JSS ( node );                       // in: UnlAdd, UnlDelete
 JSS ( node_binary );                // out: LedgerEntry
+JSS ( node_cache_bytes );           // out: GetCounts
 JSS ( node_hit_rate );              // out: GetCounts
 JSS ( node_read_bytes );            // out: GetCounts
 JSS ( node_reads_hit );             // out: GetCounts
@@ -272,6 +274,7 @@ JSS ( node_reads_total );           // out: GetCounts
 JSS ( node_writes );                // out: GetCounts
 JSS ( node_written_bytes );         // out: GetCounts
 JSS ( nodes );                      // out: PathState
+JSS ( object_bytes );               // out: GetCounts
 JSS ( obligations );                // out: GatewayBalances
 JSS ( offer );                      // in: LedgerEntry
 JSS ( offers );                     // out: NetworkOPs, AccountOffers, Subscribe
@@ -322,6 +325,12 @@ JSS ( reserve_base );               // out: NetworkOPs
 JSS ( reserve_base_xrp );           // out: NetworkOPs
 JSS ( reserve_inc );                // out: NetworkOPs
 JSS ( reserve_inc_xrp );            // out: NetworkOPs
+JSS ( resident );                   // in: GetCounts
+JSS ( resident_inner_nodes );       // out: GetCounts
+JSS ( resident_leaf_nodes );        // out: GetCounts
+JSS ( resident_ledger_maps );       // out: GetCounts
+JSS ( resident_node_bytes );        // out: GetCounts
+JSS ( resident_shared_links );      // out: GetCounts
 JSS ( response );                   // websocket
 JSS ( result );                     // RPC
 JSS ( ripple_lines );               // out: NetworkOPs
@@ -355,6 +364,7 @@ JSS ( state_now );                  // in: Subscribe
 JSS ( states );
 JSS ( status );                     // error
 JSS ( stop );                       // in: LedgerCleaner
+JSS ( stream );                     // in: LedgerData
 JSS ( streams );                    // in: Subscribe, Unsubscribe
 JSS ( strict );                     // in: AccountCurrencies, AccountInfo
 JSS ( sub_index );                  // in: LedgerEntry
@@ -382,10 +392,17 @@ JSS ( transaction_hash );           // out: LedgerProposal, LedgerToJson
 JSS ( transactions );               // out: LedgerToJson,
                                     // in: AccountTx*, Unsubscribe
 JSS ( transitions );                // out: NetworkOPs
+JSS ( treenode_cache_bytes );       // out: GetCounts
 JSS ( treenode_cache_size );        // out: GetCounts
+JSS ( treenode_depth_hit_rate );    // out: GetCounts
+JSS ( treenode_inner_bytes );       // out: GetCounts
+JSS ( treenode_inner_hit_rate );    // out: GetCounts
+JSS ( treenode_leaf_bytes );        // out: GetCounts
+JSS ( treenode_leaf_hit_rate );     // out: GetCounts
 JSS ( treenode_track_size );        // out: GetCounts
 JSS ( tx );                         // out: STTx, AccountTx*
 JSS ( tx_blob );                    // in/out: Submit,
+JSS ( tx_cache_bytes );             // out: GetCounts
                                     // in: TransactionSign, AccountTx*
 JSS ( tx_hash );                    // in: TransactionEntry
 JSS ( tx_json );                    // in/out: TransactionSign
@@ -393,6 +410,7 @@ JSS ( tx_json );                    // in/out: TransactionSign
 JSS ( tx_signing_hash );            // out: TransactionSign
 JSS ( tx_unsigned );                // out: TransactionSign
 JSS ( txn_count );                  // out: NetworkOPs
+JSS ( txn_db_shards );              // out: GetCounts
 JSS ( txs );                        // out: TxHistory
 JSS ( type );                       // in: AccountObjects
                                     // out: NetworkOPs
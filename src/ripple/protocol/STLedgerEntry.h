@@ -130,11 +130,48 @@ private:
     */
     void setSLEType ();
 
+    // The field storage of the entry as it was built, counted again
+    // as STLedgerEntry memory so it can be told apart from other objects
+    class FieldBytes
+    {
+    public:
+        FieldBytes () = default;
+
+        FieldBytes (FieldBytes const& other)
+            : bytes_ (other.bytes_)
+        {
+            CountedObject <STLedgerEntry>::countBytes (bytes_);
+        }
+
+        FieldBytes& operator= (FieldBytes const& other)
+        {
+            set (other.bytes_);
+            return *this;
+        }
+
+        ~FieldBytes ()
+        {
+            CountedObject <STLedgerEntry>::countBytes (
+                -static_cast<std::ptrdiff_t> (bytes_));
+        }
+
+        void set (std::size_t bytes)
+        {
+            CountedObject <STLedgerEntry>::countBytes (
+                static_cast<std::ptrdiff_t> (bytes) - bytes_);
+            bytes_ = static_cast<std::uint32_t> (bytes);
+        }
+
+    private:
+        std::uint32_t bytes_ = 0;
+    };
+
 private:
     uint256 key_;
     LedgerEntryType type_;
     LedgerFormats::Item const*  mFormat;
     bool mMutable;
+    FieldBytes fieldBytes_;
 };
 
 using SLE = STLedgerEntry;
@@ -289,7 +289,9 @@ private:
         }
     };
 
-    using list_type = std::vector<detail::STVar>;
+    // Field storage is counted as STObject memory
+    using list_type = std::vector<detail::STVar,
+        CountedAllocator<detail::STVar, STObject>>;
 
     list_type v_;
     SOTemplate const* mType;
@@ -557,6 +559,12 @@ public:
 
     bool hasMatchingEntry (const STBase&);
 
+    /** Returns the memory used to store the fields, in bytes. */
+    std::size_t getFieldBytes () const
+    {
+        return v_.capacity () * sizeof (detail::STVar);
+    }
+
     bool operator== (const STObject & o) const;
     bool operator!= (const STObject & o) const
     {
@@ -21,6 +21,7 @@
 #define RIPPLE_PROTOCOL_DIGEST_H_INCLUDED
 
 #include <ripple/basics/base_uint.h>
+#include <ripple/basics/Slice.h>
 #include <beast/crypto/ripemd.h>
 #include <beast/crypto/sha2.h>
 #include <beast/hash/endian.h>
@@ -291,6 +292,31 @@ sha512Half_s (Args const&... args)
         sha512_half_hasher_s::result_type>(h);
 }
 
+/** Computes the SHA512-Half of several independent messages.
+
+    digests[i] is set to the SHA512-Half of messages[i]. On processors
+    with AVX2 or AVX-512 up to eight messages are hashed at once, one
+    in each lane of the vector registers.
+*/
+void
+sha512Half_batch (Slice const* messages,
+    uint256* digests, std::size_t count);
+
+namespace detail {
+
+// The number of messages sha512Half_batch hashes at once on this
+// processor: 1, 4 or 8.
+int
+sha512Half_lanes ();
+
+// As sha512Half_batch, using a particular number of lanes. The
+// processor must support it.
+void
+sha512Half_batch (Slice const* messages,
+    uint256* digests, std::size_t count, int lanes);
+
+} // detail
+
 } // ripple
 
 #endif
@@ -41,6 +41,7 @@ STLedgerEntry::STLedgerEntry (Keylet const& k)
     set (mFormat->elements);
     setFieldU16 (sfLedgerEntryType,
         static_cast <std::uint16_t> (mFormat->getType ()));
+    fieldBytes_.set (getFieldBytes ());
 }
 
 STLedgerEntry::STLedgerEntry (
@@ -83,6 +84,7 @@ void STLedgerEntry::setSLEType ()
         WriteLog (lsWARNING, SerializedLedger) << getJson (0);
         Throw<std::runtime_error> ("ledger entry not valid for type");
     }
+    fieldBytes_.set (getFieldBytes ());
 }
 
 std::string STLedgerEntry::getFullText () const
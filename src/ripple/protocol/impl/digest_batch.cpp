@@ -0,0 +1,415 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/protocol/digest.h>
+#include <cassert>
+#include <cstring>
+
+// The vector kernels are compiled for their instruction set one function
+// at a time, so the rest of the program still runs on any x86-64.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RIPPLE_SHA512_SIMD 1
+#include <immintrin.h>
+#define RIPPLE_TARGET_AVX2 __attribute__((target("avx2")))
+#define RIPPLE_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define RIPPLE_SHA512_SIMD 0
+#endif
+
+namespace ripple {
+namespace detail {
+
+static std::uint64_t const sha512_iv[8] =
+{
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static std::uint64_t const sha512_k[80] =
+{
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+    0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+    0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+    0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+    0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+    0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+    0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+    0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+    0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+    0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+    0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+    0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+    0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+    0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+    0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+    0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+    0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+// The chaining values of each lane, stored word by word across the lanes
+// so that a single vector load picks up the same word of every lane, and
+// the block each lane hashes next.
+template <int Lanes>
+struct sha512_block
+{
+    alignas(64) std::uint64_t h[8][Lanes];
+    std::uint8_t const* data[Lanes];
+};
+
+// What idle lanes hash
+static std::uint8_t const sha512_zero[128] = {};
+
+#if RIPPLE_SHA512_SIMD
+
+template <int N>
+RIPPLE_TARGET_AVX2
+static inline
+__m256i
+sha512_rotr (__m256i x)
+{
+    return _mm256_or_si256 (
+        _mm256_srli_epi64 (x, N), _mm256_slli_epi64 (x, 64 - N));
+}
+
+RIPPLE_TARGET_AVX2
+static inline
+__m256i
+sha512_xor (__m256i a, __m256i b, __m256i c)
+{
+    return _mm256_xor_si256 (_mm256_xor_si256 (a, b), c);
+}
+
+RIPPLE_TARGET_AVX2
+static
+void
+sha512_compress_avx2 (sha512_block<4>& b)
+{
+    __m256i w[16];
+    __m256i s[8];
+
+    // Gather word i of every lane, from big endian
+    auto const data = _mm256_loadu_si256 (
+        reinterpret_cast<__m256i const*>(b.data));
+    auto const swap = _mm256_setr_epi8 (
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    for (int i = 0; i < 16; ++i)
+        w[i] = _mm256_shuffle_epi8 (_mm256_i64gather_epi64 (
+            static_cast<long long const*>(nullptr), _mm256_add_epi64 (
+                data, _mm256_set1_epi64x (8 * i)), 1), swap);
+    for (int i = 0; i < 8; ++i)
+        s[i] = _mm256_load_si256 (
+            reinterpret_cast<__m256i const*>(b.h[i]));
+
+    __m256i v0 = s[0], v1 = s[1], v2 = s[2], v3 = s[3];
+    __m256i v4 = s[4], v5 = s[5], v6 = s[6], v7 = s[7];
+
+    for (int t = 0; t < 80; ++t)
+    {
+        if (t >= 16)
+        {
+            auto const w15 = w[(t - 15) & 15];
+            auto const w2 = w[(t - 2) & 15];
+            auto const s0 = sha512_xor (sha512_rotr<1> (w15),
+                sha512_rotr<8> (w15), _mm256_srli_epi64 (w15, 7));
+            auto const s1 = sha512_xor (sha512_rotr<19> (w2),
+                sha512_rotr<61> (w2), _mm256_srli_epi64 (w2, 6));
+            w[t & 15] = _mm256_add_epi64 (
+                _mm256_add_epi64 (w[t & 15], s0),
+                _mm256_add_epi64 (w[(t - 7) & 15], s1));
+        }
+
+        auto const e1 = sha512_xor (sha512_rotr<14> (v4),
+            sha512_rotr<18> (v4), sha512_rotr<41> (v4));
+        auto const ch = _mm256_xor_si256 (_mm256_and_si256 (v4, v5),
+            _mm256_andnot_si256 (v4, v6));
+        auto const t1 = _mm256_add_epi64 (
+            _mm256_add_epi64 (v7, e1),
+            _mm256_add_epi64 (ch, _mm256_add_epi64 (w[t & 15],
+                _mm256_set1_epi64x (sha512_k[t]))));
+
+        auto const e0 = sha512_xor (sha512_rotr<28> (v0),
+            sha512_rotr<34> (v0), sha512_rotr<39> (v0));
+        auto const maj = _mm256_or_si256 (_mm256_and_si256 (v0, v1),
+            _mm256_and_si256 (v2, _mm256_or_si256 (v0, v1)));
+        auto const t2 = _mm256_add_epi64 (e0, maj);
+
+        v7 = v6; v6 = v5; v5 = v4;
+        v4 = _mm256_add_epi64 (v3, t1);
+        v3 = v2; v2 = v1; v1 = v0;
+        v0 = _mm256_add_epi64 (t1, t2);
+    }
+
+    __m256i const v[8] = { v0, v1, v2, v3, v4, v5, v6, v7 };
+    for (int i = 0; i < 8; ++i)
+        _mm256_store_si256 (reinterpret_cast<__m256i*>(b.h[i]),
+            _mm256_add_epi64 (s[i], v[i]));
+}
+
+RIPPLE_TARGET_AVX512
+static
+void
+sha512_compress_avx512 (sha512_block<8>& b)
+{
+    __m512i w[16];
+    __m512i s[8];
+
+    // Gather word i of every lane, from big endian
+    auto const data = _mm512_loadu_si512 (b.data);
+    auto const swap = _mm512_broadcast_i32x4 (_mm_setr_epi8 (
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+    for (int i = 0; i < 16; ++i)
+        w[i] = _mm512_shuffle_epi8 (_mm512_i64gather_epi64 (
+            _mm512_add_epi64 (data, _mm512_set1_epi64 (8 * i)),
+                nullptr, 1), swap);
+    for (int i = 0; i < 8; ++i)
+        s[i] = _mm512_load_si512 (b.h[i]);
+
+    __m512i v0 = s[0], v1 = s[1], v2 = s[2], v3 = s[3];
+    __m512i v4 = s[4], v5 = s[5], v6 = s[6], v7 = s[7];
+
+    // 0x96 is a ^ b ^ c, 0xca is a ? b : c and 0xe8 is the majority
+    for (int t = 0; t < 80; ++t)
+    {
+        if (t >= 16)
+        {
+            auto const w15 = w[(t - 15) & 15];
+            auto const w2 = w[(t - 2) & 15];
+            auto const s0 = _mm512_ternarylogic_epi64 (
+                _mm512_ror_epi64 (w15, 1), _mm512_ror_epi64 (w15, 8),
+                    _mm512_srli_epi64 (w15, 7), 0x96);
+            auto const s1 = _mm512_ternarylogic_epi64 (
+                _mm512_ror_epi64 (w2, 19), _mm512_ror_epi64 (w2, 61),
+                    _mm512_srli_epi64 (w2, 6), 0x96);
+            w[t & 15] = _mm512_add_epi64 (
+                _mm512_add_epi64 (w[t & 15], s0),
+                _mm512_add_epi64 (w[(t - 7) & 15], s1));
+        }
+
+        auto const e1 = _mm512_ternarylogic_epi64 (
+            _mm512_ror_epi64 (v4, 14), _mm512_ror_epi64 (v4, 18),
+                _mm512_ror_epi64 (v4, 41), 0x96);
+        auto const ch = _mm512_ternarylogic_epi64 (v4, v5, v6, 0xca);
+        auto const t1 = _mm512_add_epi64 (
+            _mm512_add_epi64 (v7, e1),
+            _mm512_add_epi64 (ch, _mm512_add_epi64 (w[t & 15],
+                _mm512_set1_epi64 (sha512_k[t]))));
+
+        auto const e0 = _mm512_ternarylogic_epi64 (
+            _mm512_ror_epi64 (v0, 28), _mm512_ror_epi64 (v0, 34),
+                _mm512_ror_epi64 (v0, 39), 0x96);
+        auto const maj = _mm512_ternarylogic_epi64 (v0, v1, v2, 0xe8);
+        auto const t2 = _mm512_add_epi64 (e0, maj);
+
+        v7 = v6; v6 = v5; v5 = v4;
+        v4 = _mm512_add_epi64 (v3, t1);
+        v3 = v2; v2 = v1; v1 = v0;
+        v0 = _mm512_add_epi64 (t1, t2);
+    }
+
+    __m512i const v[8] = { v0, v1, v2, v3, v4, v5, v6, v7 };
+    for (int i = 0; i < 8; ++i)
+        _mm512_store_si512 (b.h[i], _mm512_add_epi64 (s[i], v[i]));
+}
+
+#endif
+
+// Feed the messages through the lanes a block at a time. A lane which
+// finishes its message starts on the next one, so messages of different
+// lengths keep every lane busy until the last few.
+template <int Lanes, void (*Compress)(sha512_block<Lanes>&)>
+static
+void
+sha512Half_multi (Slice const* messages,
+    uint256* digests, std::size_t count)
+{
+    struct Lane
+    {
+        std::size_t message;        // count when the lane is idle
+        std::uint8_t const* data;
+        std::size_t full;           // blocks read from the message itself
+        std::size_t blocks;
+        std::size_t block;
+        std::uint8_t tail[256];     // the padded end of the message
+    };
+
+    sha512_block<Lanes> b;
+    Lane lanes[Lanes];
+    std::size_t next = 0;
+    int active = 0;
+
+    auto start = [&](int l)
+    {
+        auto& lane = lanes[l];
+        if (next == count)
+        {
+            lane.message = count;
+            b.data[l] = sha512_zero;
+            return;
+        }
+
+        auto const size = messages[next].size ();
+        auto const rest = size % 128;
+        lane.message = next;
+        lane.data = messages[next].data ();
+        lane.full = size / 128;
+        lane.blocks = lane.full + ((rest + 17 > 128) ? 2 : 1);
+        lane.block = 0;
+        ++next;
+
+        // The message ends with 0x80, zeros and its length in bits
+        auto const tail = (lane.blocks - lane.full) * 128;
+        std::memset (lane.tail, 0, tail);
+        if (rest != 0)
+            std::memcpy (lane.tail, lane.data + lane.full * 128, rest);
+        lane.tail[rest] = 0x80;
+        for (int i = 0; i < 8; ++i)
+            lane.tail[tail - 1 - i] =
+                static_cast<std::uint8_t>((size << 3) >> (8 * i));
+        lane.tail[tail - 9] = static_cast<std::uint8_t>(size >> 61);
+
+        for (int i = 0; i < 8; ++i)
+            b.h[i][l] = sha512_iv[i];
+        ++active;
+    };
+
+    for (int l = 0; l < Lanes; ++l)
+        start (l);
+
+    while (active != 0)
+    {
+        for (int l = 0; l < Lanes; ++l)
+        {
+            auto const& lane = lanes[l];
+            if (lane.message != count)
+                b.data[l] = (lane.block < lane.full) ?
+                    lane.data + lane.block * 128 :
+                    lane.tail + (lane.block - lane.full) * 128;
+        }
+
+        Compress (b);
+
+        for (int l = 0; l < Lanes; ++l)
+        {
+            auto& lane = lanes[l];
+            if (lane.message == count || ++lane.block != lane.blocks)
+                continue;
+
+            // The half digest is the first four words
+            auto d = digests[lane.message].begin ();
+            for (int i = 0; i < 4; ++i)
+            {
+                for (int j = 0; j < 8; ++j)
+                    *d++ = static_cast<std::uint8_t>(
+                        b.h[i][l] >> (56 - 8 * j));
+            }
+            --active;
+            start (l);
+        }
+    }
+}
+
+static
+void
+sha512Half_scalar (Slice const* messages,
+    uint256* digests, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        sha512_half_hasher h;
+        h (messages[i].data (), messages[i].size ());
+        digests[i] = static_cast<sha512_half_hasher::result_type>(h);
+    }
+}
+
+int
+sha512Half_lanes ()
+{
+#if RIPPLE_SHA512_SIMD
+    static int const lanes = []
+    {
+        __builtin_cpu_init ();
+        if (__builtin_cpu_supports ("avx512f") &&
+                __builtin_cpu_supports ("avx512bw"))
+            return 8;
+        if (__builtin_cpu_supports ("avx2"))
+            return 4;
+        return 1;
+    }();
+    return lanes;
+#else
+    return 1;
+#endif
+}
+
+void
+sha512Half_batch (Slice const* messages,
+    uint256* digests, std::size_t count, int lanes)
+{
+    assert (lanes <= sha512Half_lanes ());
+
+    switch (lanes)
+    {
+#if RIPPLE_SHA512_SIMD
+    case 8:
+        sha512Half_multi<8, sha512_compress_avx512> (
+            messages, digests, count);
+        break;
+
+    case 4:
+        sha512Half_multi<4, sha512_compress_avx2> (
+            messages, digests, count);
+        break;
+#endif
+
+    default:
+        sha512Half_scalar (messages, digests, count);
+        break;
+    }
+}
+
+} // detail
+
+void
+sha512Half_batch (Slice const* messages,
+    uint256* digests, std::size_t count)
+{
+    auto const lanes = detail::sha512Half_lanes ();
+
+    // Lanes without a message cost as much as lanes with one
+    if (count * 2 <= static_cast<std::size_t> (lanes))
+        detail::sha512Half_batch (messages, digests, count, 1);
+    else
+        detail::sha512Half_batch (messages, digests, count, lanes);
+}
+
+} // ripple
@@ -150,14 +150,95 @@ public:
         pass ();
     }
 
+    // Messages the size of a SHAMap inner node
+    void testSHA512HalfBatch ()
+    {
+        testcase ("SHA512Half batch");
+
+        using namespace std::chrono;
+
+        std::vector<std::uint8_t> data (516 * 100000);
+        beast::xor_shift_engine g(19207813);
+        beast::rngfill (data.data (), data.size (), g);
+
+        std::vector<Slice> messages;
+        for (std::size_t i = 0; i < data.size (); i += 516)
+            messages.emplace_back (&data[i], 516);
+        std::vector<uint256> digests (messages.size ());
+
+        for (int lanes : {1, 4, 8})
+        {
+            if (lanes > detail::sha512Half_lanes ())
+                continue;
+
+            auto const start = high_resolution_clock::now ();
+            detail::sha512Half_batch (messages.data (),
+                digests.data (), messages.size (), lanes);
+            auto const d = duration_cast<milliseconds>(
+                high_resolution_clock::now () - start);
+
+            log << "    " << lanes << " lanes: " << d.count () << "ms";
+        }
+        pass ();
+    }
+
     void run ()
     {
         testSHA512 ();
         testSHA256 ();
         testRIPEMD160 ();
+        testSHA512HalfBatch ();
     }
 };
 
 BEAST_DEFINE_TESTSUITE_MANUAL(digest,ripple_data,ripple);
 
+//------------------------------------------------------------------------------
+
+class sha512Half_batch_test : public beast::unit_test::suite
+{
+public:
+    void run ()
+    {
+        // Every length up to a few blocks, so that the padding falls
+        // at each place in the last block or spills into another one.
+        std::vector<std::uint8_t> data (600);
+        beast::xor_shift_engine g(19207813);
+        beast::rngfill (data.data (), data.size (), g);
+
+        std::vector<Slice> messages;
+        std::vector<uint256> expected;
+        for (std::size_t size = 0; size <= data.size (); ++size)
+        {
+            messages.emplace_back (data.data (), size);
+            expected.push_back (sha512Half (messages.back ()));
+        }
+
+        for (int lanes : {1, 4, 8})
+        {
+            if (lanes > detail::sha512Half_lanes ())
+                continue;
+
+            testcase ("lanes " + std::to_string (lanes));
+
+            // Fewer messages than lanes, and more
+            for (std::size_t count : {std::size_t(1), std::size_t(3),
+                std::size_t(9), messages.size ()})
+            {
+                std::vector<uint256> digests (count);
+                detail::sha512Half_batch (messages.data (),
+                    digests.data (), count, lanes);
+                expect (std::equal (digests.begin (), digests.end (),
+                    expected.begin ()));
+            }
+        }
+
+        std::vector<uint256> digests (messages.size ());
+        sha512Half_batch (messages.data (), digests.data (), digests.size ());
+        expect (digests == expected);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(sha512Half_batch,ripple_data,ripple);
+
 } // ripple
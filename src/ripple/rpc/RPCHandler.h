@@ -24,6 +24,8 @@
 #include <ripple/net/InfoSub.h>
 #include <ripple/rpc/Context.h>
 #include <ripple/rpc/Status.h>
+#include <ripple/server/Writer.h>
+#include <memory>
 
 namespace ripple {
 namespace RPC {
@@ -36,6 +38,13 @@ Status doCommand (RPC::Context&, Json::Value&);
 /** Execute an RPC command and store the results in an std::string. */
 void executeRPC (RPC::Context&, std::string&);
 
+/** Execute an RPC command whose reply is streamed to an HTTP client.
+
+    Returns nullptr if the request is not for a stream, or with the
+    error stored in the Json::Value if the stream could not be started.
+*/
+std::shared_ptr<HTTP::Writer> streamCommand (RPC::Context&, Json::Value&);
+
 Role roleRequired (std::string const& method );
 
 } // RPC
@@ -47,30 +47,34 @@ Json::Value doAccountDividend (RPC::Context& context)
 
     std::uint32_t baseLedgerSeq = 0;
     auto dividendSLE = ledger->read (keylet::dividend ());
-    if (dividendSLE)
+    if (dividendSLE && dividendSLE->isFieldPresent (sfDividendHash))
     {
         if (dividendSLE->getFieldU8 (sfDividendState) != DividendMaster::DivState_Done)
         {
             return RPC::make_error (rpcNOT_READY, "Dividend in progress");
         }
-        Json::Value resumeToken;
         baseLedgerSeq = dividendSLE->getFieldU32 (sfDividendLedger);
-        auto txns = context.netOps.getTxsAccount (
-            accountID, baseLedgerSeq, ledger->info ().seq, false, resumeToken, 1,
-            context.role == Role::ADMIN, "Dividend");
-        if (!txns.empty ())
+
+        // Dividend transactions are not indexed by account, so the
+        // results are only known once the dividend map has been read.
+        DividendMaster::AccountDividend div;
+        if (! context.app.getDividendMaster ().getAccountDividend (
+            baseLedgerSeq, dividendSLE->getFieldH256 (sfDividendHash),
+            accountID, div))
         {
-            auto& txn = txns.begin ()->first->getSTransaction ();
-            result["DividendCoins"] = to_string (txn->getFieldU64 (sfDividendCoins));
-            result["DividendCoinsVBC"] = to_string (txn->getFieldU64 (sfDividendCoinsVBC));
-            result["DividendCoinsVBCRank"] = to_string (txn->getFieldU64 (sfDividendCoinsVBCRank));
-            result["DividendCoinsVBCSprd"] = to_string (txn->getFieldU64 (sfDividendCoinsVBCSprd));
-            result["DividendTSprd"] = to_string (txn->getFieldU64 (sfDividendTSprd));
-            result["DividendVRank"] = to_string (txn->getFieldU64 (sfDividendVRank));
-            result["DividendVSprd"] = to_string (txn->getFieldU64 (sfDividendVSprd));
-            result["DividendLedger"] = to_string (txn->getFieldU32 (sfDividendLedger));
-            return result;
+            return RPC::make_error (rpcNOT_READY,
+                "Dividend results are being loaded");
         }
+
+        result["DividendCoins"] = to_string (std::get<0> (div));
+        result["DividendCoinsVBC"] = to_string (std::get<1> (div));
+        result["DividendCoinsVBCRank"] = to_string (std::get<2> (div));
+        result["DividendCoinsVBCSprd"] = to_string (std::get<3> (div));
+        result["DividendTSprd"] = to_string (std::get<6> (div));
+        result["DividendVRank"] = to_string (std::get<4> (div));
+        result["DividendVSprd"] = to_string (std::get<5> (div));
+        result["DividendLedger"] = to_string (baseLedgerSeq);
+        return result;
     }
 
     result["DividendCoins"] = "0";
@@ -143,6 +143,10 @@ Json::Value doAccountLines (RPC::Context& context)
     if (auto err = readLimitField(limit, RPC::Tuning::accountLines, context))
         return *err;
 
+    // Walking the directory of a cold ledger may wait on the database.
+    // Nothing below takes a lock, so let the reads suspend the request.
+    JobCoro::AsyncReads const reads (context.jobCoro);
+
     Json::Value& jsonLines (result[jss::lines] = Json::arrayValue);
     VisitData visitData = {{}, accountID, hasPeer, raPeerAccount};
     unsigned int reserve (limit);
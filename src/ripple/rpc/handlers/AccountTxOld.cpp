@@ -71,9 +71,6 @@ Json::Value doAccountTxOld (RPC::Context& context)
     if (! raAccount)
         return rpcError (rpcACT_MALFORMED);
 
-    if (offset > 3000)
-        return rpcError (rpcATX_DEPRECATED);
-
     context.loadType = Resource::feeHighBurdenRPC;
 
     // DEPRECATED
@@ -21,8 +21,12 @@
 #include <ripple/app/ledger/AcceptedLedger.h>
 #include <ripple/app/ledger/InboundLedgers.h>
 #include <ripple/app/ledger/LedgerMaster.h>
+#include <ripple/app/ledger/TransactionMaster.h>
 #include <ripple/app/main/Application.h>
 #include <ripple/app/misc/NetworkOPs.h>
+#include <ripple/app/misc/Transaction.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
+#include <ripple/basics/CountedObject.h>
 #include <ripple/basics/UptimeTimer.h>
 #include <ripple/core/DatabaseCon.h>
 #include <ripple/json/json_value.h>
@@ -32,6 +36,8 @@
 #include <ripple/protocol/ErrorCodes.h>
 #include <ripple/protocol/JsonFields.h>
 #include <ripple/rpc/Context.h>
+#include <algorithm>
+#include <limits>
 
 namespace ripple {
 
@@ -57,8 +63,18 @@ void textTime (
         text += "s";
 }
 
+// Byte counts past what fits are reported as the largest that does
+static
+Json::UInt
+byteCount (std::uint64_t bytes)
+{
+    return static_cast<Json::UInt> (std::min<std::uint64_t> (
+        bytes, std::numeric_limits<Json::UInt>::max ()));
+}
+
 // {
 //   min_count: <number>  // optional, defaults to 10
+//   resident: <bool>     // optional, count the nodes of cached ledgers
 // }
 Json::Value doGetCounts (RPC::Context& context)
 {
@@ -76,6 +92,13 @@ Json::Value doGetCounts (RPC::Context& context)
         ret [it.first] = it.second;
     }
 
+    {
+        // Estimated memory of each counted type
+        Json::Value& bytes = (ret[jss::object_bytes] = Json::objectValue);
+        for (auto const& it : CountedObjects::getInstance ().getBytes (1))
+            bytes[it.first] = byteCount (it.second);
+    }
+
     int dbKB = getKBUsedAll (context.app.getLedgerDB ().getSession ());
 
     if (dbKB > 0)
@@ -86,11 +109,14 @@ Json::Value doGetCounts (RPC::Context& context)
     if (dbKB > 0)
         ret[jss::dbKBLedger] = dbKB;
 
-    dbKB = getKBUsedDB (context.app.getTxnDB ().getSession ());
+    dbKB = static_cast<int> (context.app.getTxnDBShards ().getKBUsed ());
 
     if (dbKB > 0)
         ret[jss::dbKBTransaction] = dbKB;
 
+    if (context.app.getTxnDBShards ().sharded ())
+        ret[jss::txn_db_shards] = context.app.getTxnDBShards ().getJson ();
+
     {
         std::size_t c = context.app.getOPs().getLocalTxCount ();
         if (c > 0)
@@ -106,10 +132,54 @@ Json::Value doGetCounts (RPC::Context& context)
     ret[jss::ledger_hit_rate] = context.app.getLedgerMaster ().getCacheHitRate ();
     ret[jss::AL_hit_rate] = context.app.getAcceptedLedgerCache ().getHitRate ();
 
+    ret[jss::node_cache_bytes] = byteCount (
+        context.app.getNodeStore ().getCacheBytes ());
+    ret[jss::AL_cache_bytes] = byteCount (
+        context.app.getAcceptedLedgerCache ().getCacheBytes ());
+    ret[jss::tx_cache_bytes] = byteCount (
+        context.app.getMasterTransaction ().getCache ().getCacheBytes ());
+
     ret[jss::fullbelow_size] = static_cast<int>(context.app.family().fullbelow().size());
     ret[jss::treenode_cache_size] = context.app.family().treecache().getCacheSize();
     ret[jss::treenode_track_size] = context.app.family().treecache().getTrackSize();
 
+    {
+        auto const& treecache = context.app.family().treecache();
+        auto const stats = treecache.getStats ();
+        auto hitRate = [](TreeNodeCache::Counts const& c)
+        {
+            auto const total = c.hits + c.misses;
+            return total ? (c.hits * 100.0) / total : 0.0;
+        };
+
+        ret[jss::treenode_cache_bytes] = static_cast<Json::UInt> (
+            treecache.getCacheBytes ());
+        ret[jss::treenode_inner_bytes] = static_cast<Json::UInt> (
+            stats.innerBytes);
+        ret[jss::treenode_leaf_bytes] = static_cast<Json::UInt> (
+            stats.leafBytes);
+        ret[jss::treenode_inner_hit_rate] = hitRate (stats.inner);
+        ret[jss::treenode_leaf_hit_rate] = hitRate (stats.leaf);
+
+        Json::Value& depths = (ret[jss::treenode_depth_hit_rate] =
+            Json::arrayValue);
+        for (auto const& depth : stats.depths)
+            depths.append (hitRate (depth));
+    }
+
+    // Walks every node the cached ledgers hold, so only when asked
+    if (context.params[jss::resident].asBool ())
+    {
+        auto const counts = context.app.getLedgerMaster ().getResidentCounts ();
+        ret[jss::resident_ledger_maps] = static_cast<Json::UInt> (counts.maps);
+        ret[jss::resident_inner_nodes] = static_cast<Json::UInt> (counts.inner);
+        ret[jss::resident_leaf_nodes] = static_cast<Json::UInt> (counts.leaf);
+        ret[jss::resident_node_bytes] = static_cast<Json::UInt> (
+            counts.innerBytes + counts.leafBytes);
+        ret[jss::resident_shared_links] = static_cast<Json::UInt> (
+            counts.shared);
+    }
+
     std::string uptime;
     int s = UptimeTimer::getInstance ().getElapsedSeconds ();
     ret[jss::uptime] = s;
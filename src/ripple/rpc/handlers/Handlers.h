@@ -21,6 +21,8 @@
 #define RIPPLE_RPC_HANDLERS_HANDLERS_H_INCLUDED
 
 #include <ripple/rpc/handlers/LedgerHandler.h>
+#include <ripple/server/Writer.h>
+#include <memory>
 
 namespace ripple {
 
@@ -95,6 +97,10 @@ Json::Value doWalletSeed            (RPC::Context&);
 Json::Value doWalletUnlock          (RPC::Context&);
 Json::Value doWalletVerify          (RPC::Context&);
 
+// These write their reply straight to an HTTP client. On an error
+// they return nullptr and leave the error in the Json::Value.
+std::shared_ptr<HTTP::Writer> streamLedgerData (RPC::Context&, Json::Value&);
+
 } // ripple
 
 #endif
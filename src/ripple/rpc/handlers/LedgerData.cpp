@@ -18,17 +18,35 @@
 //==============================================================================
 
 #include <BeastConfig.h>
+#include <ripple/app/ledger/Ledger.h>
 #include <ripple/app/ledger/LedgerToJson.h>
+#include <ripple/app/main/Application.h>
+#include <ripple/core/JobQueue.h>
 #include <ripple/ledger/ReadView.h>
+#include <ripple/net/RPCErr.h>
 #include <ripple/protocol/ErrorCodes.h>
 #include <ripple/protocol/JsonFields.h>
+#include <ripple/rpc/impl/LedgerStateWriter.h>
 #include <ripple/rpc/impl/LookupLedger.h>
 #include <ripple/rpc/impl/Tuning.h>
 #include <ripple/rpc/Context.h>
 #include <ripple/server/Role.h>
+#include <limits>
 
 namespace ripple {
 
+// Returns false if the marker is present but not a key
+static
+bool
+getMarker (Json::Value const& params, ReadView::key_type& key)
+{
+    if (! params.isMember (jss::marker))
+        return true;
+
+    Json::Value const& jMarker = params[jss::marker];
+    return jMarker.isString () && key.SetHex (jMarker.asString ());
+}
+
 // Get state nodes from a ledger
 //   Inputs:
 //     limit:        integer, maximum number of entries
@@ -48,13 +66,9 @@ Json::Value doLedgerData (RPC::Context& context)
     if (!lpLedger)
         return jvResult;
 
-    boost::optional<ReadView::key_type> key = ReadView::key_type();
-    if (params.isMember (jss::marker))
-    {
-        Json::Value const& jMarker = params[jss::marker];
-        if (! (jMarker.isString () && key->SetHex (jMarker.asString ())))
-            return RPC::expected_field_error (jss::marker, "valid");
-    }
+    ReadView::key_type key;
+    if (! getMarker (params, key))
+        return RPC::expected_field_error (jss::marker, "valid");
 
     bool isBinary = params[jss::binary].asBool();
 
@@ -77,10 +91,13 @@ Json::Value doLedgerData (RPC::Context& context)
 
     Json::Value& nodes = jvResult[jss::state];
 
+    // Suspend the request, not its thread, while state is read from disk
+    JobCoro::AsyncReads const reads (context.jobCoro);
+
     auto e = lpLedger->sles.end();
-    for (auto i = lpLedger->sles.upper_bound(*key); i != e; ++i)
+    for (auto i = lpLedger->sles.upper_bound(key); i != e; ++i)
     {
-        auto sle = lpLedger->read(keylet::unchecked((*i)->key()));
+        auto const& sle = *i;
         if (limit-- <= 0)
         {
             // Stop processing before the current key.
@@ -105,4 +122,75 @@ Json::Value doLedgerData (RPC::Context& context)
     return jvResult;
 }
 
+// Stream state nodes from a ledger
+//   Inputs:
+//     limit:        integer, maximum number of entries
+//     marker:       opaque, resume point
+//   Outputs:
+//     A chunked HTTP reply holding each state node's key, size and binary
+//     data in key order. The Ledger-Hash and Ledger-Index headers identify
+//     the ledger. To resume an interrupted reply, pass the last key received
+//     as the marker along with the ledger_hash.
+std::shared_ptr<HTTP::Writer>
+streamLedgerData (RPC::Context& context, Json::Value& result)
+{
+    if (! isUnlimited (context.role))
+    {
+        result = rpcError (rpcNO_PERMISSION);
+        return {};
+    }
+
+    std::shared_ptr<ReadView const> view;
+    auto const& params = context.params;
+
+    result = RPC::lookupLedger (view, context);
+    if (! view)
+        return {};
+
+    // Only a closed ledger has an immutable map to hold
+    auto const ledger = std::dynamic_pointer_cast<Ledger const> (view);
+    if (! ledger || view->info().open)
+    {
+        result = RPC::make_param_error ("Streaming needs a closed ledger.");
+        return {};
+    }
+
+    ReadView::key_type key;
+    if (! getMarker (params, key))
+    {
+        result = RPC::expected_field_error (jss::marker, "valid");
+        return {};
+    }
+
+    auto limit = std::numeric_limits<std::size_t>::max ();
+    if (params.isMember (jss::limit))
+    {
+        Json::Value const& jLimit = params[jss::limit];
+        if (! jLimit.isIntegral () || jLimit.asInt () < 0)
+        {
+            result = RPC::expected_field_error (jss::limit, "unsigned integer");
+            return {};
+        }
+
+        limit = jLimit.asUInt ();
+    }
+
+    beast::http::message m;
+    m.request (false);
+    m.status (200);
+    m.reason ("OK");
+    m.headers.append ("Ledger-Hash", to_string (ledger->info().hash));
+    m.headers.append ("Ledger-Index", std::to_string (ledger->info().seq));
+
+    auto& jobQueue = context.app.getJobQueue ();
+    return std::make_shared<RPC::LedgerStateWriter> (std::move (m),
+        std::shared_ptr<SHAMap const> (ledger, &ledger->stateMap ()),
+            key, limit,
+        [&jobQueue](std::function<void(void)> f)
+        {
+            jobQueue.addJob (jtCLIENT, "RPC-Stream",
+                [f](Job&) { f (); });
+        });
+}
+
 } // ripple
@@ -20,6 +20,7 @@
 #include <BeastConfig.h>
 #include <ripple/app/main/Application.h>
 #include <ripple/app/misc/Transaction.h>
+#include <ripple/app/misc/impl/TxnDBShards.h>
 #include <ripple/core/DatabaseCon.h>
 #include <ripple/core/SociDB.h>
 #include <ripple/net/RPCErr.h>
@@ -29,6 +30,8 @@
 #include <ripple/rpc/Context.h>
 #include <ripple/server/Role.h>
 #include <boost/format.hpp>
+#include <chrono>
+#include <limits>
 
 namespace ripple {
 
@@ -53,16 +56,39 @@ Json::Value doTxHistory (RPC::Context& context)
 
     obj[jss::index] = startIndex;
 
-    std::string sql =
-        boost::str (boost::format (
-            "SELECT LedgerSeq, Status, RawTxn "
-            "FROM Transactions ORDER BY LedgerSeq desc LIMIT %u,20;")
-                    % startIndex);
+    // Shards are walked newest first, the offset carrying over into the
+    // next shard once a shard's rows are used up.
+    std::uint64_t skip = startIndex;
+    std::uint64_t want = 20;
 
+    for (auto const& shard : context.app.getTxnDBShards ().select (
+        0, std::numeric_limits<std::uint32_t>::max (), false))
     {
-        bool isMySQL = context.app.getTxnDB ().getType () == DatabaseCon::Type::MySQL;
-        
-        auto db = context.app.getTxnDB ().checkoutDb ();
+        if (want == 0)
+            break;
+
+        auto const start = std::chrono::steady_clock::now ();
+        bool isMySQL = shard->db ().getType () == DatabaseCon::Type::MySQL;
+
+        auto db = shard->db ().checkoutDb ();
+
+        if (skip != 0)
+        {
+            boost::optional<std::uint64_t> rows;
+            *db << "SELECT COUNT(*) FROM Transactions;", soci::into (rows);
+            if (rows.value_or (0) <= skip)
+            {
+                skip -= rows.value_or (0);
+                continue;
+            }
+        }
+
+        std::string sql =
+            boost::str (boost::format (
+                "SELECT LedgerSeq, Status, RawTxn "
+                "FROM Transactions ORDER BY LedgerSeq desc LIMIT %u,%u;")
+                        % skip % want);
+        skip = 0;
 
         boost::optional<std::uint64_t> ledgerSeq;
         boost::optional<std::string> status;
@@ -84,6 +110,8 @@ Json::Value doTxHistory (RPC::Context& context)
         st.execute ();
         while (st.fetch ())
         {
+            --want;
+
             if (soci::i_ok == rti)
             {
                 if (isMySQL)
@@ -98,6 +126,9 @@ Json::Value doTxHistory (RPC::Context& context)
                     ledgerSeq, status, rawTxn, context.app))
                 txs.append (trans->getJson (0));
         }
+
+        shard->onRead (std::chrono::duration_cast<std::chrono::microseconds> (
+            std::chrono::steady_clock::now () - start));
     }
 
     obj[jss::txs] = txs;
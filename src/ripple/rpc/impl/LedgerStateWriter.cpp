@@ -0,0 +1,169 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#include <BeastConfig.h>
+#include <ripple/rpc/impl/LedgerStateWriter.h>
+#include <beast/asio/streambuf.h>
+#include <cstdio>
+
+namespace ripple {
+namespace RPC {
+
+// The size of a chunk is written ahead of its data as fixed width
+// hex, so room can be left for it before the size is known.
+static std::size_t const chunkSizeDigits = 8;
+
+LedgerStateWriter::LedgerStateWriter (beast::http::message&& message,
+    std::shared_ptr<SHAMap const> map, uint256 const& marker,
+        std::size_t limit, Schedule schedule, std::size_t chunkSize)
+    : map_ (std::move (map))
+    , iter_ (map_->upper_bound (marker))
+    , end_ (map_->end ())
+    , limit_ (limit)
+    , schedule_ (std::move (schedule))
+    , chunkSize_ (chunkSize)
+{
+    message.headers.erase ("Content-Length");
+    message.headers.erase ("Transfer-Encoding");
+    message.headers.append ("Transfer-Encoding", "chunked");
+    message.headers.erase ("Content-Type");
+    message.headers.append ("Content-Type", "application/octet-stream");
+    message.headers.erase ("Connection");
+    message.headers.append ("Connection", "close");
+
+    beast::asio::streambuf head;
+    write (head, message);
+    for (auto const& b : head.data ())
+        buffer_.append (boost::asio::buffer_cast<char const*> (b),
+            boost::asio::buffer_size (b));
+}
+
+bool
+LedgerStateWriter::complete()
+{
+    return done_ && pos_ == buffer_.size ();
+}
+
+void
+LedgerStateWriter::consume (std::size_t bytes)
+{
+    pos_ += bytes;
+}
+
+bool
+LedgerStateWriter::prepare (std::size_t bytes,
+    std::function<void(void)> resume)
+{
+    if (pos_ < buffer_.size () || done_)
+        return true;
+
+    if (! schedule_)
+    {
+        fill ();
+        return true;
+    }
+
+    // Reading the map can go to the database, so keep it
+    // off the thread that services the connections.
+    schedule_ ([this, resume]()
+        {
+            fill ();
+            resume ();
+        });
+    return false;
+}
+
+std::vector<boost::asio::const_buffer>
+LedgerStateWriter::data()
+{
+    return { boost::asio::const_buffer (
+        buffer_.data () + pos_, buffer_.size () - pos_) };
+}
+
+void
+LedgerStateWriter::fill()
+{
+    buffer_.assign (chunkSizeDigits, '0');
+    buffer_.append ("\r\n");
+    pos_ = 0;
+
+    auto const start = buffer_.size ();
+    bool failed = false;
+
+    try
+    {
+        while (iter_ != end_ && limit_ > 0 &&
+            buffer_.size () - start < chunkSize_)
+        {
+            auto const& item = *iter_;
+            auto const& key = item.key ();
+            std::uint32_t const size = item.size ();
+            char const prefix[] = {
+                static_cast<char> (size >> 24),
+                static_cast<char> (size >> 16),
+                static_cast<char> (size >> 8),
+                static_cast<char> (size) };
+
+            buffer_.append (
+                reinterpret_cast<char const*> (key.data ()), key.size ());
+            buffer_.append (prefix, sizeof (prefix));
+            buffer_.append (
+                static_cast<char const*> (item.data ()), item.size ());
+
+            --limit_;
+            ++iter_;
+        }
+    }
+    catch (std::exception const&)
+    {
+        // Nothing tells the client but the missing last chunk
+        failed = true;
+    }
+
+    auto const size = buffer_.size () - start;
+    if (size == 0)
+    {
+        buffer_.clear ();
+    }
+    else
+    {
+        char digits[chunkSizeDigits + 1];
+        std::snprintf (digits, sizeof (digits), "%08zx", size);
+        buffer_.replace (0, chunkSizeDigits, digits, chunkSizeDigits);
+        buffer_.append ("\r\n");
+    }
+
+    if (! failed && (iter_ == end_ || limit_ == 0))
+    {
+        buffer_.append ("0\r\n\r\n");
+        done_ = true;
+    }
+
+    if (failed || done_)
+    {
+        // Let go of the snapshot as soon as the last entry is out
+        done_ = true;
+        iter_ = end_ = SHAMap::const_iterator ();
+        map_.reset ();
+    }
+}
+
+} // RPC
+} // ripple
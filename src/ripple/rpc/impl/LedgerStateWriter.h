@@ -0,0 +1,100 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#ifndef RIPPLE_RPC_LEDGERSTATEWRITER_H_INCLUDED
+#define RIPPLE_RPC_LEDGERSTATEWRITER_H_INCLUDED
+
+#include <ripple/rpc/impl/Tuning.h>
+#include <ripple/server/Writer.h>
+#include <ripple/shamap/SHAMap.h>
+#include <beast/http/message.h>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace ripple {
+namespace RPC {
+
+/** Writer that streams the entries of a state map in key order.
+
+    The body of the reply is chunk encoded. Each entry is sent as its 32
+    byte key, the size of its data as a 4 byte big-endian integer, and then
+    the data itself. Entries are gathered only as the client drains what was
+    sent before, and the map is held until the reply is complete, so every
+    entry comes from the same snapshot however slowly the client reads.
+
+    The connection is closed after the reply. If the map cannot be read to
+    the end, the reply stops without its last chunk so the client can tell.
+*/
+class LedgerStateWriter : public HTTP::Writer
+{
+public:
+    /** Runs a function off the I/O thread. */
+    using Schedule = std::function <void (std::function <void (void)>)>;
+
+    /** Create the writer.
+
+        @param message The response headers. Framing headers are added.
+        @param map The state map to send. It must be immutable.
+        @param marker Only entries with keys above the marker are sent.
+        @param limit The largest number of entries to send.
+        @param schedule If set, used to gather each chunk of entries.
+    */
+    LedgerStateWriter (beast::http::message&& message,
+        std::shared_ptr<SHAMap const> map, uint256 const& marker,
+            std::size_t limit, Schedule schedule = {},
+                std::size_t chunkSize = Tuning::streamChunkSize);
+
+    bool
+    complete() override;
+
+    void
+    consume (std::size_t bytes) override;
+
+    bool
+    prepare (std::size_t bytes,
+        std::function<void(void)> resume) override;
+
+    std::vector<boost::asio::const_buffer>
+    data() override;
+
+private:
+    void
+    fill();
+
+    std::shared_ptr<SHAMap const> map_;
+    SHAMap::const_iterator iter_;
+    SHAMap::const_iterator end_;
+    std::size_t limit_;
+    Schedule schedule_;
+    std::size_t chunkSize_;
+
+    // Bytes ready to send, starting at pos_
+    std::string buffer_;
+    std::size_t pos_ = 0;
+
+    // The last chunk is in the buffer
+    bool done_ = false;
+};
+
+} // RPC
+} // ripple
+
+#endif
@@ -35,6 +35,7 @@
 #include <ripple/net/RPCErr.h>
 #include <ripple/protocol/JsonFields.h>
 #include <ripple/resource/Fees.h>
+#include <ripple/rpc/handlers/Handlers.h>
 #include <ripple/server/Role.h>
 #include <ripple/resource/Fees.h>
 
@@ -287,6 +288,34 @@ void executeRPC (
     }
 }
 
+std::shared_ptr<HTTP::Writer> streamCommand (
+    RPC::Context& context, Json::Value& result)
+{
+    if (! context.params[jss::stream].asBool ())
+        return {};
+
+    boost::optional <Handler const&> handler;
+    if (auto error = fillHandler (context, handler))
+    {
+        inject_error (error, result);
+        return {};
+    }
+
+    std::shared_ptr<HTTP::Writer> writer;
+    if (handler->name_ == std::string ("ledger_data"))
+    {
+        callMethod (context,
+            [&writer](Context& c, Json::Value& r)
+            {
+                writer = streamLedgerData (c, r);
+                return Status ();
+            },
+            handler->name_, result);
+    }
+
+    return writer;
+}
+
 Role roleRequired (std::string const& method)
 {
     auto handler = RPC::getHandler(method);
@@ -66,6 +66,9 @@ inline int pageLength(bool isBinary)
     return isBinary ? binaryPageLength : jsonPageLength;
 }
 
+/** Bytes of ledger entries gathered at a time by a streamed LedgerData. */
+static int const streamChunkSize = 64 * 1024;
+
 } // Tuning
 /** @} */
 
@@ -0,0 +1,294 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#include <BeastConfig.h>
+#include <ripple/rpc/impl/LedgerStateWriter.h>
+#include <ripple/rpc/impl/Tuning.h>
+#include <ripple/shamap/tests/common.h>
+#include <ripple/basics/StringUtilities.h>
+#include <ripple/protocol/digest.h>
+#include <beast/unit_test/suite.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace ripple {
+namespace RPC {
+
+namespace {
+
+// Build an immutable state map of entries sized like typical ledger entries
+std::shared_ptr<SHAMap const>
+makeStateMap (tests::TestFamily& f, std::uint32_t count)
+{
+    auto map = std::make_shared<SHAMap> (SHAMapType::STATE, f);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        Serializer s;
+        for (int k = (i % 3 == 0) ? 50 : 34; k > 0; --k)
+            s.add32 (i + k);
+        map->addGiveItem (make_shamapitem (
+            sha512Half (i), std::move (s)), false, false);
+    }
+    map->getHash ();
+    map->setImmutable ();
+    return map;
+}
+
+// Pull a reply from a writer the way the server does, taking at most
+// `hint` bytes at a time, and return the bytes sent.
+std::string
+drain (HTTP::Writer& writer, std::size_t hint)
+{
+    std::string out;
+
+    for (;;)
+    {
+        // A schedule given to the writer runs the work right away,
+        // so the data is ready when the writer is asked again.
+        if (! writer.prepare (hint, [] { }))
+            continue;
+
+        std::size_t taken = 0;
+        for (auto const& b : writer.data ())
+        {
+            auto const n = std::min (hint - taken,
+                boost::asio::buffer_size (b));
+            out.append (boost::asio::buffer_cast<char const*> (b), n);
+            taken += n;
+        }
+        writer.consume (taken);
+        if (writer.complete ())
+            return out;
+    }
+}
+
+} // namespace
+
+class LedgerStateWriter_test : public beast::unit_test::suite
+{
+    struct Reply
+    {
+        std::string head;
+        std::vector<std::pair<uint256, Blob>> entries;
+        bool ended = false;
+    };
+
+    // Undo the chunking and split the body into entries
+    Reply
+    parse (std::string const& s)
+    {
+        Reply reply;
+        auto pos = s.find ("\r\n\r\n");
+        if (! expect (pos != std::string::npos, "no headers"))
+            return reply;
+        reply.head = s.substr (0, pos + 2);
+        pos += 4;
+
+        std::string body;
+        while (pos < s.size ())
+        {
+            auto const eol = s.find ("\r\n", pos);
+            if (! expect (eol != std::string::npos, "bad chunk"))
+                return reply;
+            auto const size = std::strtoul (
+                s.substr (pos, eol - pos).c_str (), nullptr, 16);
+            pos = eol + 2;
+            if (size == 0)
+            {
+                reply.ended = expect (s.substr (pos) == "\r\n", "bad end");
+                break;
+            }
+            body.append (s, pos, size);
+            pos += size + 2;
+        }
+
+        auto p = reinterpret_cast<std::uint8_t const*> (body.data ());
+        auto const end = p + body.size ();
+        while (p < end)
+        {
+            if (! expect (end - p >= 36, "short entry"))
+                break;
+            uint256 key;
+            std::memcpy (key.data (), p, key.size ());
+            p += key.size ();
+            std::size_t const size = (std::size_t (p[0]) << 24) |
+                (p[1] << 16) | (p[2] << 8) | p[3];
+            p += 4;
+            if (! expect (std::size_t (end - p) >= size, "short data"))
+                break;
+            reply.entries.emplace_back (key, Blob (p, p + size));
+            p += size;
+        }
+        return reply;
+    }
+
+    std::vector<std::pair<uint256, Blob>>
+    expected (SHAMap const& map, uint256 const& marker, std::size_t limit)
+    {
+        std::vector<std::pair<uint256, Blob>> result;
+        for (auto iter = map.upper_bound (marker);
+            iter != map.end () && result.size () < limit; ++iter)
+        {
+            auto const s = iter->slice ();
+            result.emplace_back (iter->key (), Blob (s.data (), s.data () + s.size ()));
+        }
+        return result;
+    }
+
+    void
+    check (std::shared_ptr<SHAMap const> const& map, uint256 const& marker,
+        std::size_t limit, LedgerStateWriter::Schedule schedule,
+            std::size_t chunkSize, std::size_t hint)
+    {
+        beast::http::message m;
+        m.request (false);
+        m.status (200);
+        m.reason ("OK");
+        m.headers.append ("Ledger-Index", "7");
+        LedgerStateWriter writer (std::move (m), map, marker, limit,
+            std::move (schedule), chunkSize);
+
+        auto const reply = parse (drain (writer, hint));
+        expect (reply.head.find ("HTTP/1.1 200 OK\r\n") == 0);
+        expect (reply.head.find ("Ledger-Index: 7\r\n") != std::string::npos);
+        expect (reply.head.find ("Transfer-Encoding: chunked\r\n") !=
+            std::string::npos);
+        expect (reply.ended, "not ended");
+        expect (reply.entries == expected (*map, marker, limit));
+    }
+
+public:
+    void
+    run()
+    {
+        beast::Journal const j;
+        tests::TestFamily f (j);
+        auto const map = makeStateMap (f, 3000);
+        auto const all = std::numeric_limits<std::size_t>::max ();
+
+        std::vector<uint256> keys;
+        for (auto const& item : *map)
+            keys.push_back (item.key ());
+
+        testcase ("whole map");
+        check (map, uint256 (), all, {}, Tuning::streamChunkSize, 4096);
+        check (map, uint256 (), all, {}, 1, 4096);
+        check (map, uint256 (), all, {}, 10000, 7);
+
+        testcase ("marker and limit");
+        check (map, keys[1234], all, {}, 10000, 4096);
+        check (map, keys[1234], 100, {}, 10000, 4096);
+        check (map, uint256 (), 0, {}, 10000, 4096);
+        check (map, keys.back (), all, {}, 10000, 4096);
+
+        testcase ("scheduled");
+        {
+            std::size_t scheduled = 0;
+            check (map, uint256 (), all,
+                [&scheduled](std::function<void(void)> f)
+                {
+                    ++scheduled;
+                    f ();
+                }, 10000, 4096);
+            expect (scheduled > 1);
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(LedgerStateWriter,rpc,ripple);
+
+//------------------------------------------------------------------------------
+
+// Compare streaming a large state map against paging through it
+// with a marker and hex encoding each entry, as ledger_data does.
+// The entry count may be given as the argument.
+class LedgerStateWriterTiming_test : public beast::unit_test::suite
+{
+public:
+    void
+    run()
+    {
+        using namespace std::chrono;
+
+        std::uint32_t count = 1000000;
+        if (! arg ().empty ())
+            count = std::stoul (arg ());
+
+        beast::Journal const j;
+        tests::TestFamily f (j);
+        auto const map = makeStateMap (f, count);
+
+        std::size_t bytes = 0;
+        for (auto const& item : *map)
+            bytes += item.size ();
+        auto const megabytes = bytes / double (1 << 20);
+
+        auto const rate = [megabytes](steady_clock::duration d)
+        {
+            return megabytes / duration_cast<duration<double>> (d).count ();
+        };
+
+        {
+            auto const start = steady_clock::now ();
+            std::size_t pages = 0;
+            std::size_t sent = 0;
+            uint256 marker;
+            for (bool more = true; more; ++pages)
+            {
+                std::string page;
+                auto iter = map->upper_bound (marker);
+                for (int n = 0; n < Tuning::binaryPageLength &&
+                    iter != map->end (); ++n, ++iter)
+                {
+                    auto const data = iter->slice ();
+                    page += strHex (data.data (), data.size ());
+                    page += to_string (iter->key ());
+                    marker = iter->key ();
+                }
+                more = iter != map->end ();
+                sent += page.size ();
+            }
+            auto const elapsed = steady_clock::now () - start;
+            expect (sent > 2 * bytes);
+            log << "paged: " << pages << " pages, " << sent << " bytes, " <<
+                rate (elapsed) << " MB/s";
+        }
+
+        {
+            auto const start = steady_clock::now ();
+            LedgerStateWriter writer (beast::http::message (), map,
+                uint256 (), std::numeric_limits<std::size_t>::max ());
+            auto const sent = drain (writer, 4096).size ();
+            auto const elapsed = steady_clock::now () - start;
+            expect (sent > bytes + 36 * count);
+            log << "streamed: " << sent << " bytes, " <<
+                rate (elapsed) << " MB/s";
+        }
+
+        log << count << " entries, " << megabytes << " MB of entry data";
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(LedgerStateWriterTiming,rpc,ripple);
+
+} // RPC
+} // ripple
@@ -25,6 +25,9 @@
 
 namespace ripple {
 
+/** Returns the Date header line for a reply. */
+std::string getHTTPHeaderTimestamp ();
+
 void HTTPReply (
     int nStatus, std::string const& strMsg, Json::Output const&, beast::Journal j);
 
@@ -22,6 +22,7 @@
 #include <ripple/app/misc/NetworkOPs.h>
 #include <ripple/json/json_reader.h>
 #include <ripple/server/JsonWriter.h>
+#include <ripple/server/Role.h>
 #include <ripple/server/make_ServerHandler.h>
 #include <ripple/server/impl/JSONRPCUtil.h>
 #include <ripple/server/impl/ServerHandlerImp.h>
@@ -66,6 +67,7 @@ ServerHandlerImp::ServerHandlerImp (Application& app, Stoppable& parent,
     , m_server (HTTP::make_Server(
         *this, io_service, app_.journal("Server")))
     , m_jobQueue (jobQueue)
+    , m_collectorManager (cm)
 {
     auto const& group (cm.group ("rpc"));
     rpc_requests_ = group->make_counter ("requests");
@@ -211,10 +213,21 @@ ServerHandlerImp::processSession (std::shared_ptr<HTTP::Session> const& session,
         auto status = m_networkOPs.getOperatingMode () < NetworkOPs::omSYNCING ? 503 : 200;
         HTTPReply (status, m_networkOPs.strOperatingMode (), makeOutput (*session), rpcJ);
     }
-    else
-    processRequest (session->port(), to_string (session->body()),
-        session->remoteAddress().at_port (0), makeOutput (*session), jobCoro,
-        session->forwarded_for(), session->user());
+    else if (session->request ().method () == beast::http::method_t::http_get &&
+        session->request ().url () == "/metrics")
+    {
+        processMetrics (*session);
+    }
+    else if (auto writer = processRequest (session->port(),
+        to_string (session->body()), session->remoteAddress().at_port (0),
+            makeOutput (*session), jobCoro, session->forwarded_for(),
+                session->user()))
+    {
+        // The Writer ends the reply. A stream that fails part way
+        // can only be noticed by the connection closing early.
+        session->write (writer, false);
+        return;
+    }
 
     if (session->request().keep_alive())
         session->complete();
@@ -222,7 +235,7 @@ ServerHandlerImp::processSession (std::shared_ptr<HTTP::Session> const& session,
         session->close (true);
 }
 
-void
+std::shared_ptr<HTTP::Writer>
 ServerHandlerImp::processRequest (HTTP::Port const& port,
     std::string const& request, beast::IP::Endpoint const& remoteIPAddress,
         Output&& output, std::shared_ptr<JobCoro> jobCoro,
@@ -241,7 +254,7 @@ ServerHandlerImp::processRequest (HTTP::Port const& port,
             ! jsonRPC.isObject ())
         {
             HTTPReply (400, "Unable to parse request", output, rpcJ);
-            return;
+            return {};
         }
     }
 
@@ -254,12 +267,12 @@ ServerHandlerImp::processRequest (HTTP::Port const& port,
 
     if (! method) {
         HTTPReply (400, "Null method", output, rpcJ);
-        return;
+        return {};
     }
 
     if (!method.isString ()) {
         HTTPReply (400, "method is not string", output, rpcJ);
-        return;
+        return {};
     }
 
     /* ---------------------------------------------------------------------- */
@@ -300,14 +313,14 @@ ServerHandlerImp::processRequest (HTTP::Port const& port,
     if (usage.disconnect ())
     {
         HTTPReply (503, "Server is overloaded", output, rpcJ);
-        return;
+        return {};
     }
 
     std::string strMethod = method.asString ();
     if (strMethod.empty())
     {
         HTTPReply (400, "method is empty", output, rpcJ);
-        return;
+        return {};
     }
 
     // Extract request parameters from the request Json as `params`.
@@ -324,7 +337,7 @@ ServerHandlerImp::processRequest (HTTP::Port const& port,
     else if (!params.isArray () || params.size() != 1)
     {
         HTTPReply (400, "params unparseable", output, rpcJ);
-        return;
+        return {};
     }
     else
     {
@@ -332,7 +345,7 @@ ServerHandlerImp::processRequest (HTTP::Port const& port,
         if (!params.isObject())
         {
             HTTPReply (400, "params unparseable", output, rpcJ);
-            return;
+            return {};
         }
     }
 
@@ -344,7 +357,7 @@ ServerHandlerImp::processRequest (HTTP::Port const& port,
         // FIXME Needs implementing
         // XXX This needs rate limiting to prevent brute forcing password.
         HTTPReply (403, "Forbidden", output, rpcJ);
-        return;
+        return {};
     }
 
     Resource::Charge loadType = Resource::feeReferenceRPC;
@@ -362,7 +375,18 @@ ServerHandlerImp::processRequest (HTTP::Port const& port,
         app_.getLedgerMaster(), role, jobCoro, InfoSub::pointer(),
         {user, forwardedFor}};
     Json::Value result;
-    RPC::doCommand (context, result);
+    if (auto writer = RPC::streamCommand (context, result))
+    {
+        rpc_time_.notify (static_cast <beast::insight::Event::value_type> (
+            std::chrono::duration_cast <std::chrono::milliseconds> (
+                std::chrono::high_resolution_clock::now () - start)));
+        ++rpc_requests_;
+        usage.charge (loadType);
+        return writer;
+    }
+
+    if (result.isNull ())
+        RPC::doCommand (context, result);
 
     // Always report "status".  On an error report the request as received.
     if (result.isMember (jss::error))
@@ -402,6 +426,40 @@ ServerHandlerImp::processRequest (HTTP::Port const& port,
     }
 
     HTTPReply (200, response, output, rpcJ);
+    return {};
+}
+
+void
+ServerHandlerImp::processMetrics (HTTP::Session& session)
+{
+    auto rpcJ = app_.journal ("RPC");
+    auto output = makeOutput (session);
+
+    // A scraper cannot send admin credentials, so this
+    // only lets in the addresses listed as admin.
+    if (requestRole (Role::ADMIN, session.port (), Json::objectValue,
+            session.remoteAddress ().at_port (0), session.user ()) != Role::ADMIN)
+    {
+        HTTPReply (403, "Forbidden", output, rpcJ);
+        return;
+    }
+
+    auto const text = m_collectorManager.scrape ();
+    if (! text)
+    {
+        HTTPReply (404, "Not Found", output, rpcJ);
+        return;
+    }
+
+    output ("HTTP/1.1 200 OK\r\n");
+    output (getHTTPHeaderTimestamp ());
+    output ("Connection: Keep-Alive\r\n"
+            "Content-Length: ");
+    output (std::to_string (text->size ()));
+    output ("\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "\r\n");
+    output (*text);
 }
 
 //------------------------------------------------------------------------------
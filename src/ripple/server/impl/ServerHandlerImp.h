@@ -43,6 +43,7 @@ private:
     std::unique_ptr<HTTP::Server> m_server;
     Setup setup_;
     JobQueue& m_jobQueue;
+    CollectorManager& m_collectorManager;
     beast::insight::Counter rpc_requests_;
     beast::insight::Event rpc_size_;
     beast::insight::Event rpc_time_;
@@ -111,12 +112,17 @@ private:
     processSession (std::shared_ptr<HTTP::Session> const&,
         std::shared_ptr<JobCoro> jobCoro);
 
-    void
+    // Returns a Writer if the reply is to be streamed to the session
+    std::shared_ptr<HTTP::Writer>
     processRequest (HTTP::Port const& port, std::string const& request,
         beast::IP::Endpoint const& remoteIPAddress, Output&&,
         std::shared_ptr<JobCoro> jobCoro,
         std::string forwardedFor, std::string user);
 
+    // Replies with the collected metrics, for admin connections only
+    void
+    processMetrics (HTTP::Session& session);
+
     //
     // PropertyStream
     //
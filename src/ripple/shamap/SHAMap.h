@@ -36,8 +36,11 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_lock_guard.hpp>
 #include <boost/thread/shared_mutex.hpp>
+#include <algorithm>
 #include <cassert>
+#include <mutex>
 #include <stack>
+#include <tuple>
 #include <vector>
 
 namespace ripple {
@@ -54,6 +57,24 @@ enum class SHAMapState
 /** Function object which handles missing nodes. */
 using MissingNodeHandler = std::function <void (std::uint32_t refNum)>;
 
+/** Nodes held in memory by one or more maps.
+    A node shared by several maps, or several parents, is counted once.
+*/
+struct SHAMapResidentCounts
+{
+    std::size_t maps = 0;
+    std::size_t inner = 0;
+    std::size_t leaf = 0;
+    std::size_t innerBytes = 0;
+    std::size_t leafBytes = 0;
+
+    // Links to a node counted already, each of which saved
+    // a copy of that node and everything below it
+    std::size_t shared = 0;
+
+    hash_set <SHAMapAbstractNode const*> seen;
+};
+
 /** A SHAMap is both a radix tree with a fan-out of 16 and a Merkle tree.
 
     A radix tree is a tree with two properties:
@@ -90,12 +111,30 @@ private:
     SHAMapState                     state_;
     SHAMapType                      type_;
     bool                            backed_ = true; // Map is backed by the database
+    int                             flushThreads_ = defaultThreads ();
+    int                             compareThreads_ = defaultThreads ();
+    int                             syncThreads_ = defaultThreads ();
+    int                             readAhead_ = defaultReadAhead;
+
+    // Where the last search for missing nodes left off
+    std::vector<SHAMapNodeID>       syncFrontier_;
+    std::mutex                      syncFrontierLock_;
+
+    // Sibling subtrees read ahead of a walk that has to go to the database
+    static int const                defaultReadAhead = 4;
 
 public:
     using DeltaItem = std::pair<std::shared_ptr<SHAMapItem const>,
                                 std::shared_ptr<SHAMapItem const>>;
     using Delta     = std::map<uint256, DeltaItem>;
 
+    /** Receives each item which differs between two maps: the version in
+        this map and the one in the other, either of which may be null.
+    */
+    using DeltaCallback = std::function<void (
+        std::shared_ptr<SHAMapItem const> const& ours,
+        std::shared_ptr<SHAMapItem const> const& other)>;
+
     ~SHAMap ();
     SHAMap(SHAMap const&) = delete;
     SHAMap& operator=(SHAMap const&) = delete;
@@ -141,7 +180,6 @@ public:
     bool hasItem (uint256 const& id) const;
     bool delItem (uint256 const& id);
     bool addItem (SHAMapItem const& i, bool isTransaction, bool hasMeta);
-    bool addItem (SHAMapItem&& i, bool isTransaction, bool hasMeta);
     SHAMapHash getHash () const;
 
     // save a copy if you have a temporary anyway
@@ -176,7 +214,19 @@ public:
         visitLeaves(
             std::function<void(std::shared_ptr<SHAMapItem const> const&)> const&) const;
 
+    /** Add the nodes of this map which are in memory to the counts.
+        Nothing is read from the database.
+    */
+    void countResident (SHAMapResidentCounts& counts) const;
+
     // comparison/sync functions
+
+    /** Find up to max nodes which are part of this map but not available
+        locally. A search which runs out of room saves where it stopped,
+        along with the nodes it returned, and the next search starts from
+        there rather than from the root. The saved subtrees are disjoint,
+        so they are searched on several threads when there are many.
+    */
     void getMissingNodes (std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>& hashes, int max,
                           SHAMapSyncFilter * filter);
 
@@ -206,7 +256,41 @@ public:
     bool compare (SHAMap const& otherMap,
                   Delta& differences, int maxCount) const;
 
+    /** Compare with another map, passing each difference to a callback
+        rather than collecting them. Calls are serialized, but when the
+        maps differ widely they come from several threads and in no
+        particular order.
+    */
+    bool compare (SHAMap const& otherMap,
+                  DeltaCallback const& onDifference, int maxCount) const;
+
     int flushDirty (NodeObjectType t, std::uint32_t seq);
+
+    /** Set how many threads flushDirty may use to hash and write a large
+        set of modified nodes. With one, all the work is done on the
+        calling thread.
+    */
+    void setFlushThreads (int threads);
+
+    /** Set how many sibling subtrees iteration and visitNodes read ahead.
+        When a walk finds it has to fetch the node below a branch, it also
+        starts fetching the nodes below the next non-empty branches, so
+        they are in the node store's cache by the time it gets to them.
+        Zero turns this off.
+    */
+    void setReadAhead (int branches);
+
+    /** Set how many threads compare and visitDifferences may use when the
+        maps differ in many subtrees. With one, all the work is done on the
+        calling thread.
+    */
+    void setCompareThreads (int threads);
+
+    /** Set how many threads getMissingNodes may use to search the
+        subtrees where the previous search left off. With one, all the
+        work is done on the calling thread.
+    */
+    void setSyncThreads (int threads);
     void walkMap (std::vector<SHAMapMissingNode>& missingNodes, int maxMissing) const;
     bool deepCompare (SHAMap & other) const;
 
@@ -224,23 +308,32 @@ public:
 private:
     using SharedPtrNodeStack =
         std::stack<std::pair<std::shared_ptr<SHAMapAbstractNode>, SHAMapNodeID>>;
-    using DeltaRef = std::pair<std::shared_ptr<SHAMapItem const> const&,
-                               std::shared_ptr<SHAMapItem const> const&>;
+    class DeltaSink;
+    using ComparePair = std::pair<SHAMapAbstractNode*, SHAMapAbstractNode*>;
+    using VisitEntry = std::pair<SHAMapInnerNode*, SHAMapNodeID>;
+    struct MissingNodes;
+    // An inner node to search for missing nodes, and its one branch to
+    // search or -1 for all of them
+    using SyncStart = std::tuple<SHAMapInnerNode*, SHAMapNodeID, int>;
 
     int unshare ();
 
      // tree node cache operations
-    std::shared_ptr<SHAMapAbstractNode> getCache (SHAMapHash const& hash) const;
+    std::shared_ptr<SHAMapAbstractNode> getCache (SHAMapHash const& hash,
+                                                  int depth = -1) const;
     void canonicalize (SHAMapHash const& hash, std::shared_ptr<SHAMapAbstractNode>&) const;
 
     // database operations
     std::shared_ptr<SHAMapAbstractNode> fetchNodeFromDB (SHAMapHash const& hash) const;
-    std::shared_ptr<SHAMapAbstractNode> fetchNodeNT (SHAMapHash const& hash) const;
+    std::shared_ptr<NodeObject> fetchObject (uint256 const& hash) const;
+    std::shared_ptr<SHAMapAbstractNode> fetchNodeNT (SHAMapHash const& hash,
+                                                     int depth = -1) const;
     std::shared_ptr<SHAMapAbstractNode> fetchNodeNT (
         SHAMapNodeID const& id,
         SHAMapHash const& hash,
         SHAMapSyncFilter *filter) const;
-    std::shared_ptr<SHAMapAbstractNode> fetchNode (SHAMapHash const& hash) const;
+    std::shared_ptr<SHAMapAbstractNode> fetchNode (SHAMapHash const& hash,
+                                                   int depth = -1) const;
     std::shared_ptr<SHAMapAbstractNode> checkFilter(SHAMapHash const& hash,
         SHAMapNodeID const& id, SHAMapSyncFilter* filter) const;
 
@@ -268,7 +361,8 @@ private:
     /** write and canonicalize modified node */
     std::shared_ptr<SHAMapAbstractNode>
         writeNode(NodeObjectType t, std::uint32_t seq,
-                  std::shared_ptr<SHAMapAbstractNode> node) const;
+                  std::shared_ptr<SHAMapAbstractNode> node,
+                  NodeStore::Batch& batch) const;
 
     SHAMapTreeNode* firstBelow (SHAMapAbstractNode*, NodeStack& stack) const;
 
@@ -292,6 +386,9 @@ private:
     std::shared_ptr<SHAMapAbstractNode>
         descendNoStore (std::shared_ptr<SHAMapInnerNode> const&, int branch) const;
 
+    // Called before a walk descends
+    void readAhead (SHAMapInnerNode* parent, int branch) const;
+
     /** If there is only one leaf below this node, get its contents */
     std::shared_ptr<SHAMapItem const> const& onlyBelow (SHAMapAbstractNode*) const;
 
@@ -302,8 +399,23 @@ private:
     SHAMapItem const* peekNextItem(uint256 const& id, NodeStack& stack) const;
     bool walkBranch (SHAMapAbstractNode* node,
                      std::shared_ptr<SHAMapItem const> const& otherMapItem,
-                     bool isFirstMap, Delta & differences, int & maxCount) const;
+                     bool isFirstMap, DeltaSink& sink) const;
+    bool compareSubTree (SHAMap const& otherMap, ComparePair start, int depth,
+                         DeltaSink& sink, std::vector<ComparePair>* forks) const;
+    bool visitSubTree (SHAMap* have, VisitEntry start,
+                       std::function<bool (SHAMapAbstractNode&)> const& func,
+                       std::vector<VisitEntry>* forks) const;
+    bool gmnWalk (std::vector<SyncStart> const& starts, MissingNodes& mn);
+    void gmnResume (std::vector<SHAMapNodeID> frontier, MissingNodes& mn);
+    void runParallel (int threadLimit, std::size_t count,
+                      std::function<void (std::size_t)> const& work) const;
     int walkSubTree (bool doWrite, NodeObjectType t, std::uint32_t seq);
+    int walkSubTree (std::shared_ptr<SHAMapInnerNode>& node, bool doWrite,
+                     NodeObjectType t, std::uint32_t seq,
+                     NodeStore::Batch& batch) const;
+    int walkSubTreesParallel (bool doWrite, NodeObjectType t, std::uint32_t seq);
+
+    static int defaultThreads ();
 };
 
 inline
@@ -313,6 +425,34 @@ SHAMap::setLedgerSeq (std::uint32_t lseq)
     ledgerSeq_ = lseq;
 }
 
+inline
+void
+SHAMap::setFlushThreads (int threads)
+{
+    flushThreads_ = std::max (threads, 1);
+}
+
+inline
+void
+SHAMap::setCompareThreads (int threads)
+{
+    compareThreads_ = std::max (threads, 1);
+}
+
+inline
+void
+SHAMap::setSyncThreads (int threads)
+{
+    syncThreads_ = std::max (threads, 1);
+}
+
+inline
+void
+SHAMap::setReadAhead (int branches)
+{
+    readAhead_ = std::max (branches, 0);
+}
+
 inline
 void
 SHAMap::setImmutable ()
@@ -22,59 +22,93 @@
 
 #include <ripple/basics/base_uint.h>
 #include <ripple/basics/Blob.h>
+#include <ripple/basics/CountedObject.h>
 #include <ripple/basics/Slice.h>
 #include <ripple/protocol/Serializer.h>
 #include <beast/utility/Journal.h>
 
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 
 namespace ripple {
 
 // an item stored in a SHAMap
+//
+// Items are created with make_shamapitem. Most ledger entries are only a
+// few hundred bytes, so the data of a small item lives in the same heap
+// block as the item and its reference count; larger items own a separate
+// buffer.
 class SHAMapItem
     : public CountedObject <SHAMapItem>
 {
 private:
-    uint256    tag_;
-    Blob       data_;
+    uint256             tag_;
+    std::uint8_t const* data_;
+    std::size_t         size_;
+
+protected:
+    SHAMapItem (uint256 const& tag, std::uint8_t const* data, std::size_t size);
 
 public:
     static char const* getCountedObjectName () { return "SHAMapItem"; }
-    SHAMapItem (uint256 const& tag, Blob const & data);
-    SHAMapItem (uint256 const& tag, Serializer const& s);
-    SHAMapItem (uint256 const& tag, Serializer&& s);
+
+    SHAMapItem (SHAMapItem const&) = delete;
+    SHAMapItem& operator= (SHAMapItem const&) = delete;
 
     Slice slice() const;
 
     uint256 const& key() const;
 
-    Blob const& peekData() const;
-
     std::size_t size() const;
     void const* data() const;
 };
 
+// The largest item whose data is stored inline
+std::size_t const maxInlineSHAMapItem = 256;
+
+std::shared_ptr<SHAMapItem const>
+make_shamapitem (uint256 const& tag, Slice data);
+
+std::shared_ptr<SHAMapItem const>
+make_shamapitem (uint256 const& tag, Blob const& data);
+
+std::shared_ptr<SHAMapItem const>
+make_shamapitem (uint256 const& tag, Blob&& data);
+
+std::shared_ptr<SHAMapItem const>
+make_shamapitem (uint256 const& tag, Serializer&& s);
+
 //------------------------------------------------------------------------------
 
+inline
+SHAMapItem::SHAMapItem (uint256 const& tag,
+        std::uint8_t const* data, std::size_t size)
+    : tag_ (tag)
+    , data_ (data)
+    , size_ (size)
+{
+}
+
 inline
 Slice
 SHAMapItem::slice() const
 {
-    return {data_.data(), data_.size()};
+    return {data_, size_};
 }
 
 inline
 std::size_t
 SHAMapItem::size() const
 {
-    return data_.size();
+    return size_;
 }
 
 inline
 void const*
 SHAMapItem::data() const
 {
-    return data_.data();
+    return data_;
 }
 
 inline
@@ -84,13 +118,6 @@ SHAMapItem::key() const
     return tag_;
 }
 
-inline
-Blob const&
-SHAMapItem::peekData() const
-{
-    return data_;
-}
-
 } // ripple
 
 #endif
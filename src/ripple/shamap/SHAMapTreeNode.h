@@ -25,10 +25,12 @@
 #include <ripple/basics/TaggedCache.h>
 #include <beast/utility/Journal.h>
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 namespace ripple {
 
@@ -121,6 +123,12 @@ public:
     virtual std::string getString (SHAMapNodeID const&) const;
     virtual std::shared_ptr<SHAMapAbstractNode> clone(std::uint32_t seq) const = 0;
 
+    // Append the message this node's hash is the SHA512-Half of
+    virtual void addHashInput (Blob&) const = 0;
+
+    // Update the hashes of several nodes, hashing them as one batch
+    static void updateHashes (std::vector<SHAMapAbstractNode*> const& nodes);
+
     static std::shared_ptr<SHAMapAbstractNode>
         make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat format,
              SHAMapHash const& hash, bool hashValid, beast::Journal j);
@@ -135,12 +143,34 @@ class SHAMapInnerNode
     : public SHAMapAbstractNode
     , public CountedObject <SHAMapInnerNode>
 {
-    SHAMapHash                      mHashes[16];
-    std::shared_ptr<SHAMapAbstractNode> mChildren[16];
-    int                             mIsBranch = 0;
+    struct Branch
+    {
+        SHAMapHash                          hash;
+        std::shared_ptr<SHAMapAbstractNode> child;
+    };
+
+    // Only populated branches have a slot. While there are few of them
+    // slot i holds the i'th populated branch; once more than half are
+    // populated there are 16 slots and slot m holds branch m.
+    std::unique_ptr<Branch[]>       mBranches;
+    std::uint16_t                   mIsBranch = 0;
+    std::uint8_t                    mCapacity = 0;
+    std::atomic<std::uint8_t>       mDepth {0};
     std::uint32_t                   mFullBelowGen = 0;
 
     static std::mutex               childLock;
+
+    static int countBranches (std::uint32_t isBranch);
+    static int capacityFor (int branches);
+    static int slot (std::uint16_t isBranch, int capacity, int m);
+    int slot (int m) const;
+    void reshape (std::uint16_t isBranch);
+    void setHashes (SHAMapHash const (&hashes)[16]);
+    void setChildDepth (SHAMapAbstractNode& child) const;
+
+    template <class Hasher>
+    void hashAppend (Hasher& h) const;
+
 public:
     static char const* getCountedObjectName () { return "SHAMapInnerNode"; }
     SHAMapInnerNode(std::uint32_t seq = 0);
@@ -149,6 +179,11 @@ public:
     bool isEmpty () const;
     bool isEmptyBranch (int m) const;
     int getBranchCount () const;
+    std::size_t getBranchBytes () const;
+
+    // Where this node was last hooked up in a tree, which is only a hint:
+    // the same node may be found at other depths in other trees.
+    int getDepth () const;
     SHAMapHash const& getChildHash (int m) const;
 
     void setChild(int m, std::shared_ptr<SHAMapAbstractNode> const& child);
@@ -164,6 +199,8 @@ public:
 
     bool updateHash () override;
     void updateHashDeep();
+    void updateChildHashes();
+    void addHashInput (Blob&) const override;
     void addRaw (Serializer&, SHANodeFormat format) const override;
     std::string getString (SHAMapNodeID const&) const override;
 
@@ -181,6 +218,9 @@ class SHAMapTreeNode
 private:
     std::shared_ptr<SHAMapItem const> mItem;
 
+    template <class Hasher>
+    void hashAppend (Hasher& h) const;
+
 public:
     static char const* getCountedObjectName () { return "SHAMapTreeNode"; }
     SHAMapTreeNode (const SHAMapTreeNode&) = delete;
@@ -206,6 +246,7 @@ public:  // public only to SHAMap
 
     std::string getString (SHAMapNodeID const&) const override;
     bool updateHash () override;
+    void addHashInput (Blob&) const override;
 };
 
 // SHAMapAbstractNode
@@ -299,12 +340,68 @@ SHAMapInnerNode::isEmptyBranch (int m) const
     return (mIsBranch & (1 << m)) == 0;
 }
 
+inline
+int
+SHAMapInnerNode::countBranches (std::uint32_t v)
+{
+    v = v - ((v >> 1) & 0x5555);
+    v = (v & 0x3333) + ((v >> 2) & 0x3333);
+    v = (v + (v >> 4)) & 0x0f0f;
+    return (v + (v >> 8)) & 0x1f;
+}
+
+inline
+int
+SHAMapInnerNode::capacityFor (int branches)
+{
+    return branches == 0 ? 0 :
+           branches <= 2 ? 2 :
+           branches <= 4 ? 4 :
+           branches <= 8 ? 8 : 16;
+}
+
+inline
+int
+SHAMapInnerNode::slot (std::uint16_t isBranch, int capacity, int m)
+{
+    if (capacity == 16)
+        return m;
+
+    // The populated branches below m come first
+    return countBranches (isBranch & ((1u << m) - 1));
+}
+
+inline
+int
+SHAMapInnerNode::slot (int m) const
+{
+    return slot (mIsBranch, mCapacity, m);
+}
+
+// Heap storage held for the populated branches
+inline
+std::size_t
+SHAMapInnerNode::getBranchBytes () const
+{
+    return mCapacity * sizeof (Branch);
+}
+
+inline
+int
+SHAMapInnerNode::getDepth () const
+{
+    return mDepth.load (std::memory_order_relaxed);
+}
+
 inline
 SHAMapHash const&
 SHAMapInnerNode::getChildHash (int m) const
 {
     assert ((m >= 0) && (m < 16) && (getType() == tnINNER));
-    return mHashes[m];
+    static SHAMapHash const zero;
+    if (isEmptyBranch (m))
+        return zero;
+    return mBranches[slot (m)].hash;
 }
 
 inline
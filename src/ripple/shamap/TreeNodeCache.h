@@ -20,13 +20,281 @@
 #ifndef RIPPLE_SHAMAP_TREENODECACHE_H_INCLUDED
 #define RIPPLE_SHAMAP_TREENODECACHE_H_INCLUDED
 
-#include <ripple/basics/TaggedCache.h>
+#include <ripple/basics/base_uint.h>
+#include <ripple/basics/hardened_hash.h>
+#include <ripple/basics/UnorderedContainers.h>
+#include <beast/chrono/abstract_clock.h>
+#include <beast/utility/Journal.h>
+#include <boost/intrusive/list.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace ripple {
 
 class SHAMapAbstractNode;
 
-using TreeNodeCache = TaggedCache <uint256, SHAMapAbstractNode>;
+/** Cache of the SHAMap nodes recently used, by hash.
+
+    The cache holds nodes up to a budget in bytes. Like TaggedCache it also
+    tracks nodes it has let go of which are still in use, so that everyone
+    asking for a hash gets the same node.
+
+    Which nodes are kept is decided by W-TinyLFU: new nodes go through a
+    small window, and leaving it they only displace the least recently used
+    node of the main cache if they have been asked for more often. This
+    keeps nodes used over and over, such as the inner nodes near the
+    root, from being pushed out by a walk over many nodes used only once.
+*/
+class TreeNodeCache
+{
+public:
+    using key_type = uint256;
+    using mapped_type = SHAMapAbstractNode;
+    using mapped_ptr = std::shared_ptr <mapped_type>;
+    using weak_mapped_ptr = std::weak_ptr <mapped_type>;
+    using clock_type = beast::abstract_clock <std::chrono::steady_clock>;
+
+    /** Lookups which found a node, and lookups which did not. */
+    struct Counts
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+    };
+
+    /** How well the cache is doing for each kind of node and each depth.
+        The kind of node a lookup was for is only known once it is found,
+        so for inner and leaf nodes the misses are the nodes which were
+        added to the cache.
+    */
+    struct Stats
+    {
+        Counts inner;
+        Counts leaf;
+        std::size_t innerBytes = 0;
+        std::size_t leafBytes = 0;
+        std::vector <Counts> depths;
+    };
+
+    // Lookups deeper than this are counted with it
+    static int const maxTrackedDepth = 15;
+
+    TreeNodeCache (std::string const& name, std::size_t targetBytes,
+        clock_type::rep expiration_seconds, clock_type& clock,
+            beast::Journal journal);
+
+    TreeNodeCache (TreeNodeCache const&) = delete;
+    TreeNodeCache& operator= (TreeNodeCache const&) = delete;
+
+    clock_type& clock ()
+    {
+        return m_clock;
+    }
+
+    std::size_t getTargetBytes () const;
+    void setTargetBytes (std::size_t bytes);
+
+    clock_type::rep getTargetAge () const;
+    void setTargetAge (clock_type::rep s);
+
+    /** Number of nodes held by the cache. */
+    int getCacheSize () const;
+
+    /** Number of nodes held or tracked by the cache. */
+    int getTrackSize () const;
+
+    /** Memory used by the nodes held by the cache. */
+    std::size_t getCacheBytes () const;
+
+    float getHitRate () const;
+    Stats getStats () const;
+    void clearStats ();
+
+    void clear ();
+
+    /** Let go of nodes not used for longer than the target age, and stop
+        tracking nodes nobody uses any more.
+    */
+    void sweep ();
+
+    /** Return the node with this hash, if it is known.
+        @param depth The depth the node is wanted at, if known, for the
+                     statistics.
+    */
+    mapped_ptr fetch (key_type const& key, int depth = -1);
+
+    /** Return `true` if the node with this hash is known.
+        Unlike fetch, this leaves the statistics, the frequency sketch
+        and the node's place in the cache untouched.
+    */
+    bool contains (key_type const& key) const;
+
+    /** Replace aliased objects with originals.
+        Works like TaggedCache::canonicalize.
+        @return `true` If the key already existed.
+    */
+    bool canonicalize (key_type const& key, mapped_ptr& data,
+        bool replace = false);
+
+    std::vector <key_type> getKeys () const;
+
+    /** Memory used by a node and what it owns, as the budget counts it. */
+    static std::size_t nodeBytes (mapped_type const& node);
+
+private:
+    enum class Segment : std::uint8_t
+    {
+        none,       // only tracked
+        window,     // recently added
+        probation,  // in the main cache, used once there
+        protect     // in the main cache, used again
+    };
+
+    using Hook = boost::intrusive::list_member_hook <>;
+
+    struct Entry
+    {
+        mapped_ptr ptr;
+        weak_mapped_ptr weak_ptr;
+        clock_type::time_point last_access;
+        key_type const* key = nullptr;
+        std::uint32_t bytes = 0;
+        Segment segment = Segment::none;
+        Hook hook;
+
+        Entry (clock_type::time_point const& last_access_,
+                mapped_ptr const& ptr_)
+            : ptr (ptr_)
+            , weak_ptr (ptr_)
+            , last_access (last_access_)
+        {
+        }
+
+        bool isCached () const { return ptr != nullptr; }
+        bool isExpired () const { return weak_ptr.expired (); }
+    };
+
+    // Least recently used at the front
+    using List = boost::intrusive::list <Entry,
+        boost::intrusive::member_hook <Entry, Hook, &Entry::hook>,
+            boost::intrusive::constant_time_size <false>>;
+
+    using cache_type = hardened_hash_map <key_type, Entry>;
+    using cache_iterator = typename cache_type::iterator;
+
+    // Estimates how often each key was asked for recently, in four bits.
+    // A key's first use only marks it in the doorkeeper, so keys used once
+    // never reach the counters.
+    class Sketch
+    {
+    public:
+        void resize (std::size_t entries);
+        void increment (key_type const& key);
+        int estimate (key_type const& key) const;
+        void clear ();
+
+    private:
+        std::vector <std::uint8_t> table_;
+        std::vector <bool> doorkeeper_;
+        std::size_t mask_ = 0;
+        std::size_t additions_ = 0;
+        std::size_t sampleSize_ = 0;
+
+        template <class Function>
+        void forEachCounter (key_type const& key, Function f) const;
+        std::size_t doorkeeperBit (key_type const& key, int i) const;
+        void age ();
+    };
+
+    // The cache is split by key into shards, each a cache of its own with
+    // its share of the budget, so that threads looking up different nodes
+    // rarely wait on each other.
+    class Shard
+    {
+    public:
+        void setTargetBytes (std::size_t bytes);
+
+        int getCacheSize () const;
+        std::size_t getTrackSize () const;
+        std::size_t getCacheBytes () const;
+
+        // Adds this shard's statistics to the totals
+        void addStats (Stats& stats, Counts& total) const;
+        void clearStats ();
+
+        void clear ();
+        void sweep (clock_type::time_point const& when_expire,
+            int& cacheRemovals, int& mapRemovals, std::size_t& tracked);
+
+        mapped_ptr fetch (key_type const& key, int depth,
+            clock_type::time_point const& now);
+        bool contains (key_type const& key) const;
+        bool canonicalize (key_type const& key, mapped_ptr& data,
+            bool replace, clock_type::time_point const& now);
+
+        void getKeys (std::vector <key_type>& keys) const;
+
+    private:
+        void insert (cache_iterator cit);
+        void touch (Entry& entry, clock_type::time_point const& now);
+        void unlink (Entry& entry);
+        void release (cache_iterator cit,
+            std::vector <mapped_ptr>& stuffToSweep);
+        void evict (std::vector <mapped_ptr>& stuffToSweep);
+        void record (Entry const& entry, int depth);
+        void recordMiss (int depth);
+
+        List& list (Segment segment);
+        std::size_t& bytes (Segment segment);
+
+        std::mutex mutable m_mutex;
+
+        std::size_t m_target_bytes = 0;
+
+        cache_type m_cache;
+        Sketch m_sketch;
+
+        List m_window;
+        List m_probation;
+        List m_protected;
+        std::size_t m_window_bytes = 0;
+        std::size_t m_probation_bytes = 0;
+        std::size_t m_protected_bytes = 0;
+        int m_cache_count = 0;
+
+        Counts m_inner;
+        Counts m_leaf;
+        std::size_t m_inner_bytes = 0;
+        std::size_t m_leaf_bytes = 0;
+        std::array <Counts, maxTrackedDepth + 1> m_depths;
+        std::uint64_t m_hits = 0;
+        std::uint64_t m_misses = 0;
+    };
+
+    static int const shardCount = 16;
+
+    Shard& shard (key_type const& key);
+    Shard const& shard (key_type const& key) const;
+
+    // Memory a node held in the cache takes, as the budget counts it
+    static std::uint32_t entryBytes (cache_type::value_type const& v);
+
+    beast::Journal m_journal;
+    clock_type& m_clock;
+
+    // Used for logging
+    std::string m_name;
+
+    std::atomic <std::size_t> m_target_bytes;
+    std::atomic <clock_type::rep> m_target_age;
+
+    std::array <Shard, shardCount> m_shards;
+};
 
 } // ripple
 
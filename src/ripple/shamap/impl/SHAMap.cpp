@@ -19,11 +19,26 @@
 
 #include <BeastConfig.h>
 #include <ripple/basics/contract.h>
+#include <ripple/core/JobCoro.h>
 #include <ripple/shamap/SHAMap.h>
 #include <beast/unit_test/suite.h>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 namespace ripple {
 
+// Modified nodes are written to the node store in groups of this many
+static std::size_t const flushBatchSize = 256;
+
+// Flushing is split across threads once this many subtrees two levels
+// below the root were modified, out of at most 256.
+static std::size_t const parallelFlushMinTasks = 64;
+
+// Default for the threads used to flush and compare large maps
+static int const maxThreads = 8;
+
 SHAMap::SHAMap (
     SHAMapType t,
     Family& f,
@@ -70,6 +85,10 @@ SHAMap::snapShot (bool isMutable) const
 
     newMap.seq_ = seq_ + 1;
     newMap.root_ = root_;
+    newMap.flushThreads_ = flushThreads_;
+    newMap.compareThreads_ = compareThreads_;
+    newMap.syncThreads_ = syncThreads_;
+    newMap.readAhead_ = readAhead_;
 
     if ((state_ != SHAMapState::Immutable) || !isMutable)
     {
@@ -171,7 +190,7 @@ SHAMap::fetchNodeFromDB (SHAMapHash const& hash) const
 
     if (backed_)
     {
-        std::shared_ptr<NodeObject> obj = f_.db().fetch (hash.as_uint256());
+        std::shared_ptr<NodeObject> obj = fetchObject (hash.as_uint256());
         if (obj)
         {
             try
@@ -198,6 +217,31 @@ SHAMap::fetchNodeFromDB (SHAMapHash const& hash) const
     return node;
 }
 
+// A coroutine that allows it is suspended while the database is read,
+// freeing its job thread, and resumed by the thread doing the read.
+std::shared_ptr<NodeObject>
+SHAMap::fetchObject (uint256 const& hash) const
+{
+    auto const coro = JobCoro::current ();
+    if (coro == nullptr || ! coro->asyncReads ())
+        return f_.db().fetch (hash);
+
+    std::shared_ptr<NodeObject> obj;
+    if (f_.db().asyncFetch (hash, obj,
+        [&obj, sp = coro->shared_from_this ()](
+            std::shared_ptr<NodeObject> const& result)
+        {
+            obj = result;
+            sp->post ();
+        }))
+    {
+        return obj;
+    }
+
+    coro->yield ();
+    return obj;
+}
+
 // See if a sync filter has a node
 std::shared_ptr<SHAMapAbstractNode>
 SHAMap::checkFilter(SHAMapHash const& hash, SHAMapNodeID const& id,
@@ -226,18 +270,16 @@ std::shared_ptr<SHAMapAbstractNode> SHAMap::fetchNodeNT(
     SHAMapHash const& hash,
     SHAMapSyncFilter* filter) const
 {
-    std::shared_ptr<SHAMapAbstractNode> node = getCache (hash);
+    std::shared_ptr<SHAMapAbstractNode> node = getCache (hash, id.getDepth ());
     if (node)
         return node;
 
     if (backed_)
     {
+        // Already canonicalized
         node = fetchNodeFromDB (hash);
         if (node)
-        {
-            canonicalize (hash, node);
             return node;
-        }
     }
 
     if (filter)
@@ -246,9 +288,9 @@ std::shared_ptr<SHAMapAbstractNode> SHAMap::fetchNodeNT(
     return node;
 }
 
-std::shared_ptr<SHAMapAbstractNode> SHAMap::fetchNodeNT (SHAMapHash const& hash) const
+std::shared_ptr<SHAMapAbstractNode> SHAMap::fetchNodeNT (SHAMapHash const& hash, int depth) const
 {
-    auto node = getCache (hash);
+    auto node = getCache (hash, depth);
 
     if (!node && backed_)
         node = fetchNodeFromDB (hash);
@@ -257,9 +299,9 @@ std::shared_ptr<SHAMapAbstractNode> SHAMap::fetchNodeNT (SHAMapHash const& hash)
 }
 
 // Throw if the node is missing
-std::shared_ptr<SHAMapAbstractNode> SHAMap::fetchNode (SHAMapHash const& hash) const
+std::shared_ptr<SHAMapAbstractNode> SHAMap::fetchNode (SHAMapHash const& hash, int depth) const
 {
-    auto node = fetchNodeNT (hash);
+    auto node = fetchNodeNT (hash, depth);
 
     if (!node)
         Throw<SHAMapMissingNode> (type_, hash);
@@ -294,7 +336,8 @@ SHAMapAbstractNode* SHAMap::descend (SHAMapInnerNode* parent, int branch) const
     if (ret || !backed_)
         return ret;
 
-    std::shared_ptr<SHAMapAbstractNode> node = fetchNodeNT (parent->getChildHash (branch));
+    std::shared_ptr<SHAMapAbstractNode> node = fetchNodeNT (
+        parent->getChildHash (branch), parent->getDepth () + 1);
     if (!node)
         return nullptr;
 
@@ -309,7 +352,7 @@ SHAMap::descend (std::shared_ptr<SHAMapInnerNode> const& parent, int branch) con
     if (node || !backed_)
         return node;
 
-    node = fetchNode (parent->getChildHash (branch));
+    node = fetchNode (parent->getChildHash (branch), parent->getDepth () + 1);
     if (!node)
         return nullptr;
 
@@ -324,7 +367,7 @@ SHAMap::descendNoStore (std::shared_ptr<SHAMapInnerNode> const& parent, int bran
 {
     std::shared_ptr<SHAMapAbstractNode> ret = parent->getChild (branch);
     if (!ret && backed_)
-        ret = fetchNode (parent->getChildHash (branch));
+        ret = fetchNode (parent->getChildHash (branch), parent->getDepth () + 1);
     return ret;
 }
 
@@ -366,7 +409,7 @@ SHAMap::descendAsync (SHAMapInnerNode* parent, int branch,
 
     auto const& hash = parent->getChildHash (branch);
 
-    std::shared_ptr<SHAMapAbstractNode> ptr = getCache (hash);
+    std::shared_ptr<SHAMapAbstractNode> ptr = getCache (hash, childID.getDepth ());
     if (!ptr)
     {
         if (filter)
@@ -397,6 +440,38 @@ SHAMap::descendAsync (SHAMapInnerNode* parent, int branch,
     return ptr.get ();
 }
 
+// If the node below this branch is not at hand, the walk is about to
+// wait on the database. Start reading the next few siblings as well.
+void
+SHAMap::readAhead (SHAMapInnerNode* parent, int branch) const
+{
+    auto& cache = f_.treecache ();
+
+    // Only peek at the cache: these lookups are not uses of the nodes
+    if (readAhead_ == 0 || !backed_ || parent->getChildPointer (branch) ||
+            cache.contains (parent->getChildHash (branch).as_uint256 ()))
+        return;
+
+    int count = 0;
+    for (int i = branch + 1; (i < 16) && (count < readAhead_); ++i)
+    {
+        if (parent->isEmptyBranch (i))
+            continue;
+        ++count;
+
+        if (parent->getChildPointer (i))
+            continue;
+
+        auto const& hash = parent->getChildHash (i);
+        if (cache.contains (hash.as_uint256 ()))
+            continue;
+
+        // The node store keeps what it reads in its cache
+        std::shared_ptr<NodeObject> object;
+        f_.db().asyncFetch (hash.as_uint256 (), object);
+    }
+}
+
 template <class Node>
 std::shared_ptr<Node>
 SHAMap::unshareNode (std::shared_ptr<Node> node, SHAMapNodeID const& nodeID)
@@ -431,6 +506,7 @@ SHAMap::firstBelow(SHAMapAbstractNode* node, NodeStack& stack) const
         {
             if (!inner->isEmptyBranch(i))
             {
+                readAhead(inner, i);
                 node = descendThrow(inner, i);
                 assert(!stack.empty());
                 stack.push({node, stack.top().second.getChildNodeID(i)});
@@ -526,6 +602,7 @@ SHAMap::peekNextItem(uint256 const& id, NodeStack& stack) const
         {
             if (!inner->isEmptyBranch(i))
             {
+                readAhead(inner, i);
                 node = descendThrow(inner, i);
                 nodeID = nodeID.getChildNodeID(i);
                 stack.push({node, nodeID});
@@ -799,14 +876,7 @@ SHAMap::addGiveItem (std::shared_ptr<SHAMapItem const> const& item,
 
 bool SHAMap::addItem (const SHAMapItem& i, bool isTransaction, bool hasMetaData)
 {
-    return addGiveItem(std::make_shared<SHAMapItem const>(i), isTransaction, hasMetaData);
-}
-
-bool
-SHAMap::addItem(SHAMapItem&& i, bool isTransaction, bool hasMetaData)
-{
-    return addGiveItem(std::make_shared<SHAMapItem const>(std::move(i)),
-                                                          isTransaction, hasMetaData);
+    return addGiveItem(make_shamapitem(i.key(), i.slice()), isTransaction, hasMetaData);
 }
 
 SHAMapHash
@@ -906,7 +976,8 @@ bool SHAMap::fetchRoot (SHAMapHash const& hash, SHAMapSyncFilter* filter)
 // a mutable snapshot of a mutable SHAMap.
 std::shared_ptr<SHAMapAbstractNode>
 SHAMap::writeNode (
-    NodeObjectType t, std::uint32_t seq, std::shared_ptr<SHAMapAbstractNode> node) const
+    NodeObjectType t, std::uint32_t seq, std::shared_ptr<SHAMapAbstractNode> node,
+    NodeStore::Batch& batch) const
 {
     // Node is ours, so we can just make it shareable
     assert (node->getSeq() == seq_);
@@ -917,8 +988,14 @@ SHAMap::writeNode (
 
     Serializer s;
     node->addRaw (s, snfPREFIX);
-    f_.db().store (t,
-        std::move (s.modData ()), node->getNodeHash ().as_uint256());
+    batch.push_back (NodeObject::createObject (t,
+        std::move (s.modData ()), node->getNodeHash ().as_uint256()));
+
+    if (batch.size () >= flushBatchSize)
+    {
+        f_.db().storeBatch (batch);
+        batch.clear ();
+    }
     return node;
 }
 
@@ -954,113 +1031,210 @@ int SHAMap::flushDirty (NodeObjectType t, std::uint32_t seq)
     return walkSubTree (true, t, seq);
 }
 
+int SHAMap::defaultThreads ()
+{
+    static int const threads = std::max (1, std::min (
+        static_cast<int> (std::thread::hardware_concurrency ()),
+            maxThreads));
+    return threads;
+}
+
 int
 SHAMap::walkSubTree (bool doWrite, NodeObjectType t, std::uint32_t seq)
 {
     int flushed = 0;
-    Serializer s;
 
     if (!root_ || (root_->getSeq() == 0))
         return flushed;
 
+    NodeStore::Batch batch;
+
     if (root_->isLeaf())
     { // special case -- root_ is leaf
         root_ = preFlushNode (std::move(root_));
         if (doWrite && backed_)
-            root_ = writeNode(t, seq, std::move(root_));
+        {
+            root_ = writeNode(t, seq, std::move(root_), batch);
+            f_.db().storeBatch (batch);
+        }
         return 1;
     }
     auto node = std::static_pointer_cast<SHAMapInnerNode>(root_);
     if (node->isEmpty())
         return flushed;
 
-    // Stack of {parent,index,child} pointers representing
-    // inner nodes we are in the process of flushing
-    using StackEntry = std::pair <std::shared_ptr<SHAMapInnerNode>, int>;
-    std::stack <StackEntry, std::vector<StackEntry>> stack;
+    root_ = preFlushNode(std::move(node));
+
+    // Only written nodes become shared, which is what keeps the serial
+    // pass out of the subtrees the threads already did.
+    if (flushThreads_ > 1 && doWrite && backed_)
+        flushed += walkSubTreesParallel (doWrite, t, seq);
+
+    // Whatever the threads left: the nodes near the root
+    node = std::static_pointer_cast<SHAMapInnerNode>(std::move(root_));
+    flushed += walkSubTree (node, doWrite, t, seq, batch);
+
+    if (!batch.empty ())
+        f_.db().storeBatch (batch);
+
+    // Last inner node is the new root_
+    root_ = std::move (node);
 
-    node = preFlushNode(std::move(node));
+    return flushed;
+}
 
-    int pos = 0;
+// Flush the subtrees two levels below the root, which can not share any
+// modified node, on up to flushThreads_ threads. Each finished subtree is
+// hooked back to its parent, so the serial pass that follows stops there.
+int
+SHAMap::walkSubTreesParallel (bool doWrite, NodeObjectType t, std::uint32_t seq)
+{
+    struct Task
+    {
+        std::shared_ptr<SHAMapInnerNode> parent;
+        int branch;
+        std::shared_ptr<SHAMapInnerNode> node;
+    };
 
-    // We can't flush an inner node until we flush its children
-    while (1)
+    // Returns the modified inner node on this branch, made ours
+    auto dirtyInner = [this](SHAMapInnerNode& parent, int branch)
     {
-        while (pos < 16)
+        std::shared_ptr<SHAMapInnerNode> ret;
+        if (parent.isEmptyBranch (branch))
+            return ret;
+        auto child = parent.getChild (branch);
+        if (!child || (child->getSeq() == 0) || !child->isInner ())
+            return ret;
+        ret = preFlushNode (std::static_pointer_cast<SHAMapInnerNode>(
+            std::move (child)));
+        parent.shareChild (branch, ret);
+        return ret;
+    };
+
+    auto const root = std::static_pointer_cast<SHAMapInnerNode>(root_);
+    std::vector<Task> tasks;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        auto const inner = dirtyInner (*root, i);
+        if (!inner)
+            continue;
+        for (int j = 0; j < 16; ++j)
         {
-            if (node->isEmptyBranch (pos))
-            {
-                ++pos;
-            }
-            else
-            {
-                // No need to do I/O. If the node isn't linked,
-                // it can't need to be flushed
-                int branch = pos;
-                auto child = node->getChild(pos++);
+            if (auto child = dirtyInner (*inner, j))
+                tasks.push_back ({inner, j, std::move (child)});
+        }
+    }
 
-                if (child && (child->getSeq() != 0))
-                {
-                    // This is a node that needs to be flushed
+    // Not worth starting threads for
+    if (tasks.size () < parallelFlushMinTasks)
+        return 0;
 
-                    if (child->isInner ())
-                    {
-                        // save our place and work on this node
-                        child = preFlushNode(std::move(child));
+    // Each thread keeps one batch for all the subtrees it takes
+    std::atomic<std::size_t> next (0);
+    std::atomic<int> flushed (0);
 
-                        stack.emplace (std::move (node), branch);
+    runParallel (flushThreads_, std::min<std::size_t> (
+        flushThreads_, tasks.size ()), [&](std::size_t)
+        {
+            NodeStore::Batch batch;
+            for (auto i = next++; i < tasks.size (); i = next++)
+                flushed += walkSubTree (tasks[i].node, doWrite, t, seq, batch);
 
-                        node = std::static_pointer_cast<SHAMapInnerNode>(std::move(child));
-                        pos = 0;
-                    }
-                    else
-                    {
-                        // flush this leaf
-                        ++flushed;
+            if (!batch.empty ())
+                f_.db().storeBatch (batch);
+        });
 
-                        child = preFlushNode(std::move(child));
+    for (auto& task : tasks)
+        task.parent->shareChild (task.branch, task.node);
 
-                        assert (node->getSeq() == seq_);
-                        child->updateHash();
+    return flushed;
+}
 
-                        if (doWrite && backed_)
-                            child = writeNode(t, seq, std::move(child));
+// Flush the modified nodes below an inner node which is already ours,
+// replacing it with the shareable version.
+//
+// A node's hash needs the hashes of its children, but not those of any
+// other node, so the modified nodes are gathered by depth and each depth
+// is hashed as one batch, deepest first.
+int
+SHAMap::walkSubTree (std::shared_ptr<SHAMapInnerNode>& node, bool doWrite,
+    NodeObjectType t, std::uint32_t seq, NodeStore::Batch& batch) const
+{
+    // A node that needs to be flushed and where it hangs from
+    struct Dirty
+    {
+        SHAMapInnerNode* parent;
+        int branch;
+        std::shared_ptr<SHAMapAbstractNode> node;
+    };
 
-                        node->shareChild (branch, child);
-                    }
-                }
+    // No need to do I/O. If a node isn't linked,
+    // it can't need to be flushed
+    std::vector<std::vector<Dirty>> levels (1);
+    levels[0].push_back ({nullptr, 0, node});
+
+    for (std::size_t depth = 0; !levels[depth].empty (); ++depth)
+    {
+        levels.emplace_back ();
+        auto& below = levels[depth + 1];
+
+        for (auto const& dirty : levels[depth])
+        {
+            if (!dirty.node->isInner ())
+                continue;
+
+            auto const inner =
+                static_cast<SHAMapInnerNode*>(dirty.node.get ());
+            assert (inner->getSeq() == seq_);
+
+            for (int branch = 0; branch < 16; ++branch)
+            {
+                if (inner->isEmptyBranch (branch))
+                    continue;
+
+                auto child = inner->getChild (branch);
+                if (child && (child->getSeq() != 0))
+                    below.push_back ({inner, branch,
+                        preFlushNode (std::move (child))});
             }
         }
+    }
 
-        // update the hash of this inner node
-        node->updateHashDeep();
-
-        // This inner node can now be shared
-        if (doWrite && backed_)
-            node = std::static_pointer_cast<SHAMapInnerNode>(writeNode(t, seq,
-                                                                       std::move(node)));
+    int flushed = 0;
+    std::vector<SHAMapAbstractNode*> nodes;
 
-        ++flushed;
+    for (auto depth = levels.size (); depth-- != 0;)
+    {
+        auto& level = levels[depth];
 
-        if (stack.empty ())
-           break;
+        nodes.clear ();
+        for (auto const& dirty : level)
+        {
+            // The children below are done
+            if (dirty.node->isInner ())
+                static_cast<SHAMapInnerNode&>(
+                    *dirty.node).updateChildHashes ();
+            nodes.push_back (dirty.node.get ());
+        }
+        SHAMapAbstractNode::updateHashes (nodes);
 
-        auto parent = std::move (stack.top().first);
-        pos = stack.top().second;
-        stack.pop();
+        for (auto& dirty : level)
+        {
+            // This node can now be shared
+            if (doWrite && backed_)
+                dirty.node = writeNode (t, seq, std::move (dirty.node), batch);
 
-        // Hook this inner node to its parent
-        assert (parent->getSeq() == seq_);
-        parent->shareChild (pos, node);
+            // Hook it to its parent
+            if (dirty.parent)
+                dirty.parent->shareChild (dirty.branch, dirty.node);
+            else
+                node = std::static_pointer_cast<SHAMapInnerNode>(dirty.node);
+        }
 
-        // Continue with parent's next child, if any
-        node = std::move (parent);
-        ++pos;
+        flushed += level.size ();
     }
 
-    // Last inner node is the new root_
-    root_ = std::move (node);
-
     return flushed;
 }
 
@@ -1110,9 +1284,9 @@ void SHAMap::dump (bool hash) const
         leafCount << " resident leaves";
 }
 
-std::shared_ptr<SHAMapAbstractNode> SHAMap::getCache (SHAMapHash const& hash) const
+std::shared_ptr<SHAMapAbstractNode> SHAMap::getCache (SHAMapHash const& hash, int depth) const
 {
-    auto ret = f_.treecache().fetch (hash.as_uint256());
+    auto ret = f_.treecache().fetch (hash.as_uint256(), depth);
     assert (!ret || !ret->getSeq());
     return ret;
 }
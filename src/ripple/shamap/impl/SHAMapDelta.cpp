@@ -20,6 +20,9 @@
 #include <BeastConfig.h>
 #include <ripple/basics/contract.h>
 #include <ripple/shamap/SHAMap.h>
+#include <ripple/shamap/impl/WorkerPool.h>
+#include <atomic>
+#include <mutex>
 
 namespace ripple {
 
@@ -30,10 +33,70 @@ namespace ripple {
 // that we will abort early if a node sends a map to us that
 // makes no sense at all. (And our sync algorithm will avoid
 // synchronizing matching branches too.)
+//
+// When the maps differ in many places, the differing subtrees two levels
+// below the roots are compared on several threads.
+
+// Differing subtrees are handed to threads once this many were found at
+// forkDepth, out of at most 256.
+static std::size_t const parallelCompareMinTasks = 64;
+static int const forkDepth = 2;
+
+// Passes differences on to the caller's callback, one thread at a time,
+// until the limit is reached.
+class SHAMap::DeltaSink
+{
+public:
+    DeltaSink (DeltaCallback const& callback, int maxCount)
+        : callback_ (callback)
+        , remaining_ (maxCount)
+    {
+    }
+
+    // Returns false once the limit has been reached
+    bool
+    add (std::shared_ptr<SHAMapItem const> const& ours,
+         std::shared_ptr<SHAMapItem const> const& other)
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        if (full_)
+            return false;
+
+        callback_ (ours, other);
+
+        if (--remaining_ <= 0)
+        {
+            full_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    // Reports an item as only in the first or only in the second map
+    bool
+    addUnmatched (std::shared_ptr<SHAMapItem const> const& item,
+                  bool isFirstMap)
+    {
+        static std::shared_ptr<SHAMapItem const> const none;
+        return isFirstMap ? add (item, none) : add (none, item);
+    }
+
+    bool
+    full () const
+    {
+        return full_;
+    }
+
+private:
+    DeltaCallback const& callback_;
+    std::mutex mutex_;
+    int remaining_;
+    std::atomic<bool> full_ {false};
+};
 
 bool SHAMap::walkBranch (SHAMapAbstractNode* node,
                          std::shared_ptr<SHAMapItem const> const& otherMapItem,
-                         bool isFirstMap,Delta& differences, int& maxCount) const
+                         bool isFirstMap, DeltaSink& sink) const
 {
     // Walk a branch of a SHAMap that's matched by an empty branch or single item in the other map
     std::stack <SHAMapAbstractNode*, std::vector<SHAMapAbstractNode*>> nodeStack;
@@ -62,27 +125,16 @@ bool SHAMap::walkBranch (SHAMapAbstractNode* node,
             if (emptyBranch || (item->key() != otherMapItem->key()))
             {
                 // unmatched
-                if (isFirstMap)
-                    differences.insert (std::make_pair (item->key(),
-                        DeltaRef (item, std::shared_ptr<SHAMapItem const> ())));
-                else
-                    differences.insert (std::make_pair (item->key(),
-                        DeltaRef (std::shared_ptr<SHAMapItem const> (), item)));
-
-                if (--maxCount <= 0)
+                if (!sink.addUnmatched (item, isFirstMap))
                     return false;
             }
-            else if (item->peekData () != otherMapItem->peekData ())
+            else if (item->slice () != otherMapItem->slice ())
             {
                 // non-matching items with same tag
-                if (isFirstMap)
-                    differences.insert (std::make_pair (item->key(),
-                                                DeltaRef (item, otherMapItem)));
-                else
-                    differences.insert (std::make_pair (item->key(),
-                                                DeltaRef (otherMapItem, item)));
-
-                if (--maxCount <= 0)
+                bool const more = isFirstMap ?
+                    sink.add (item, otherMapItem) :
+                    sink.add (otherMapItem, item);
+                if (!more)
                     return false;
 
                 emptyBranch = true;
@@ -98,15 +150,7 @@ bool SHAMap::walkBranch (SHAMapAbstractNode* node,
     if (!emptyBranch)
     {
         // otherMapItem was unmatched, must add
-        if (isFirstMap) // this is first map, so other item is from second
-            differences.insert(std::make_pair(otherMapItem->key(),
-                                              DeltaRef(std::shared_ptr<SHAMapItem const>(),
-                                                       otherMapItem)));
-        else
-            differences.insert(std::make_pair(otherMapItem->key(),
-                DeltaRef(otherMapItem, std::shared_ptr<SHAMapItem const>())));
-
-        if (--maxCount <= 0)
+        if (!sink.addUnmatched (otherMapItem, !isFirstMap))
             return false;
     }
 
@@ -122,21 +166,73 @@ SHAMap::compare (SHAMap const& otherMap,
     // throws on corrupt tables or missing nodes
     // CAUTION: otherMap is not locked and must be immutable
 
+    return compare (otherMap,
+        [&differences](std::shared_ptr<SHAMapItem const> const& ours,
+                       std::shared_ptr<SHAMapItem const> const& other)
+        {
+            differences.insert (std::make_pair (
+                (ours ? ours : other)->key (), DeltaItem (ours, other)));
+        }, maxCount);
+}
+
+bool
+SHAMap::compare (SHAMap const& otherMap,
+                 DeltaCallback const& onDifference, int maxCount) const
+{
     assert (isValid () && otherMap.isValid ());
 
     if (getHash () == otherMap.getHash ())
         return true;
 
-    using StackEntry = std::pair <SHAMapAbstractNode*, SHAMapAbstractNode*>;
+    DeltaSink sink (onDifference, maxCount);
+
+    std::vector<ComparePair> forks;
+    if (!compareSubTree (otherMap, {root_.get(), otherMap.root_.get()}, 0,
+            sink, (compareThreads_ > 1) ? &forks : nullptr))
+        return false;
+
+    if (forks.size () < parallelCompareMinTasks)
+    {
+        for (auto const& fork : forks)
+            if (!compareSubTree (otherMap, fork, forkDepth, sink, nullptr))
+                return false;
+        return true;
+    }
+
+    runParallel (compareThreads_, forks.size (),
+        [&](std::size_t i)
+        {
+            compareSubTree (otherMap, forks[i], forkDepth, sink, nullptr);
+        });
+
+    return !sink.full ();
+}
+
+// Compare two subtrees at the given depth. Given somewhere to put them,
+// differing pairs of inner nodes at forkDepth are left for the caller.
+bool
+SHAMap::compareSubTree (SHAMap const& otherMap, ComparePair start, int depth,
+                        DeltaSink& sink, std::vector<ComparePair>* forks) const
+{
+    struct StackEntry
+    {
+        SHAMapAbstractNode* ours;
+        SHAMapAbstractNode* other;
+        int depth;
+    };
     std::stack <StackEntry, std::vector<StackEntry>> nodeStack; // track nodes we've pushed
 
-    nodeStack.push ({root_.get(), otherMap.root_.get()});
+    nodeStack.push ({start.first, start.second, depth});
     while (!nodeStack.empty ())
     {
-        SHAMapAbstractNode* ourNode = nodeStack.top().first;
-        SHAMapAbstractNode* otherNode = nodeStack.top().second;
+        SHAMapAbstractNode* ourNode = nodeStack.top().ours;
+        SHAMapAbstractNode* otherNode = nodeStack.top().other;
+        depth = nodeStack.top().depth;
         nodeStack.pop ();
 
+        if (sink.full ())
+            return false;
+
         if (!ourNode || !otherNode)
         {
             assert (false);
@@ -150,26 +246,18 @@ SHAMap::compare (SHAMap const& otherMap,
             auto other = static_cast<SHAMapTreeNode*>(otherNode);
             if (ours->peekItem()->key() == other->peekItem()->key())
             {
-                if (ours->peekItem()->peekData () != other->peekItem()->peekData ())
+                if (ours->peekItem()->slice () != other->peekItem()->slice ())
                 {
-                    differences.insert (std::make_pair (ours->peekItem()->key(),
-                                                 DeltaRef (ours->peekItem (),
-                                                 other->peekItem ())));
-                    if (--maxCount <= 0)
+                    if (!sink.add (ours->peekItem (), other->peekItem ()))
                         return false;
                 }
             }
             else
             {
-                differences.insert (std::make_pair(ours->peekItem()->key(),
-                                                   DeltaRef(ours->peekItem(),
-                                                   std::shared_ptr<SHAMapItem const>())));
-                if (--maxCount <= 0)
+                if (!sink.addUnmatched (ours->peekItem (), true))
                     return false;
 
-                differences.insert(std::make_pair(other->peekItem()->key(),
-                    DeltaRef(std::shared_ptr<SHAMapItem const>(), other->peekItem ())));
-                if (--maxCount <= 0)
+                if (!sink.addUnmatched (other->peekItem (), false))
                     return false;
             }
         }
@@ -177,20 +265,24 @@ SHAMap::compare (SHAMap const& otherMap,
         {
             auto ours = static_cast<SHAMapInnerNode*>(ourNode);
             auto other = static_cast<SHAMapTreeNode*>(otherNode);
-            if (!walkBranch (ours, other->peekItem (),
-                    true, differences, maxCount))
+            if (!walkBranch (ours, other->peekItem (), true, sink))
                 return false;
         }
         else if (ourNode->isLeaf () && otherNode->isInner ())
         {
             auto ours = static_cast<SHAMapTreeNode*>(ourNode);
             auto other = static_cast<SHAMapInnerNode*>(otherNode);
-            if (!otherMap.walkBranch (other, ours->peekItem (),
-                                       false, differences, maxCount))
+            if (!otherMap.walkBranch (other, ours->peekItem (), false, sink))
                 return false;
         }
         else if (ourNode->isInner () && otherNode->isInner ())
         {
+            if (forks && (depth == forkDepth))
+            {
+                forks->push_back ({ourNode, otherNode});
+                continue;
+            }
+
             auto ours = static_cast<SHAMapInnerNode*>(ourNode);
             auto other = static_cast<SHAMapInnerNode*>(otherNode);
             for (int i = 0; i < 16; ++i)
@@ -202,7 +294,7 @@ SHAMap::compare (SHAMap const& otherMap,
                         SHAMapAbstractNode* iNode = descendThrow (ours, i);
                         if (!walkBranch (iNode,
                                          std::shared_ptr<SHAMapItem const> (), true,
-                                         differences, maxCount))
+                                         sink))
                             return false;
                     }
                     else if (ours->isEmptyBranch (i))
@@ -212,12 +304,13 @@ SHAMap::compare (SHAMap const& otherMap,
                             otherMap.descendThrow(other, i);
                         if (!otherMap.walkBranch (iNode,
                                                    std::shared_ptr<SHAMapItem const>(),
-                                                   false, differences, maxCount))
+                                                   false, sink))
                             return false;
                     }
                     else // The two trees have different non-empty branches
                         nodeStack.push ({descendThrow (ours, i),
-                                        otherMap.descendThrow (other, i)});
+                                        otherMap.descendThrow (other, i),
+                                        depth + 1});
                 }
         }
         else
@@ -227,6 +320,130 @@ SHAMap::compare (SHAMap const& otherMap,
     return true;
 }
 
+void
+SHAMap::visitDifferences(SHAMap* have,
+                         std::function<bool (SHAMapAbstractNode&)> func) const
+{
+    // Visit every node in this SHAMap that is not present
+    // in the specified SHAMap
+
+    if (root_->getNodeHash ().isZero ())
+        return;
+
+    if (have && (root_->getNodeHash () == have->root_->getNodeHash ()))
+        return;
+
+    if (root_->isLeaf ())
+    {
+        auto leaf = std::static_pointer_cast<SHAMapTreeNode>(root_);
+        if (!have || !have->hasLeafNode(leaf->peekItem()->key(), leaf->getNodeHash()))
+            func (*root_);
+
+        return;
+    }
+
+    // The threads take turns calling func, and all stop once it returns
+    // false
+    std::mutex funcLock;
+    bool stopped = false;
+    auto visit = [&](SHAMapAbstractNode& node)
+    {
+        std::lock_guard<std::mutex> lock (funcLock);
+        if (!stopped && !func (node))
+            stopped = true;
+        return !stopped;
+    };
+
+    std::vector<VisitEntry> forks;
+    if (!visitSubTree (have,
+            {static_cast<SHAMapInnerNode*>(root_.get()), SHAMapNodeID{}},
+            visit, (compareThreads_ > 1) ? &forks : nullptr))
+        return;
+
+    if (forks.size () < parallelCompareMinTasks)
+    {
+        for (auto const& fork : forks)
+            if (!visitSubTree (have, fork, visit, nullptr))
+                return;
+        return;
+    }
+
+    runParallel (compareThreads_, forks.size (),
+        [&](std::size_t i)
+        {
+            visitSubTree (have, forks[i], visit, nullptr);
+        });
+}
+
+// Visit the nodes below an inner node which are not in the other map.
+// Given somewhere to put them, inner nodes at forkDepth are left for the
+// caller. Returns false once func does.
+bool
+SHAMap::visitSubTree (SHAMap* have, VisitEntry start,
+                      std::function<bool (SHAMapAbstractNode&)> const& func,
+                      std::vector<VisitEntry>* forks) const
+{
+    // contains unexplored non-matching inner node entries
+    std::stack <VisitEntry, std::vector<VisitEntry>> stack;
+
+    stack.push (start);
+
+    while (!stack.empty())
+    {
+        SHAMapInnerNode* node;
+        SHAMapNodeID nodeID;
+        std::tie (node, nodeID) = stack.top ();
+        stack.pop ();
+
+        if (forks && (nodeID.getDepth () == forkDepth))
+        {
+            forks->push_back ({node, nodeID});
+            continue;
+        }
+
+        // 1) Add this node to the pack
+        if (!func (*node))
+            return false;
+
+        // 2) push non-matching child inner nodes
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!node->isEmptyBranch (i))
+            {
+                auto const& childHash = node->getChildHash (i);
+                SHAMapNodeID childID = nodeID.getChildNodeID (i);
+                auto next = descendThrow(node, i);
+
+                if (next->isInner ())
+                {
+                    if (!have || !have->hasInnerNode(childID, childHash))
+                        stack.push ({static_cast<SHAMapInnerNode*>(next), childID});
+                }
+                else if (!have || !have->hasLeafNode(
+                         static_cast<SHAMapTreeNode*>(next)->peekItem()->key(),
+                         childHash))
+                {
+                    if (! func (*next))
+                        return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Call work with each index below count, on up to threadLimit threads
+// counting the caller's. The helpers come from one pool shared by every
+// map, so concurrent walks do not multiply the threads.
+void
+SHAMap::runParallel (int threadLimit, std::size_t count,
+                     std::function<void (std::size_t)> const& work) const
+{
+    static WorkerPool pool ("SHAMap", defaultThreads () - 1);
+    pool.run (threadLimit, count, work);
+}
+
 void SHAMap::walkMap (std::vector<SHAMapMissingNode>& missingNodes, int maxMissing) const
 {
     if (!root_->isInner ())  // root_ is only node, and we have it
@@ -20,27 +20,113 @@
 #include <BeastConfig.h>
 #include <ripple/protocol/Serializer.h>
 #include <ripple/shamap/SHAMapItem.h>
+#include <cassert>
+#include <cstring>
 
 namespace ripple {
 
-class SHAMap;
+namespace detail {
 
-SHAMapItem::SHAMapItem (uint256 const& tag, Blob const& data)
-    : tag_(tag)
-    , data_(data)
+// An item whose data follows it in the same allocation
+template <std::size_t Capacity>
+class InlineSHAMapItem
+    : public SHAMapItem
 {
+private:
+    std::uint8_t buffer_[Capacity];
+
+public:
+    InlineSHAMapItem (uint256 const& tag, Slice data)
+        : SHAMapItem (tag, buffer_, data.size ())
+    {
+        assert (data.size () <= Capacity);
+        if (! data.empty ())
+            std::memcpy (buffer_, data.data (), data.size ());
+        countBytes (Capacity);
+    }
+
+    ~InlineSHAMapItem ()
+    {
+        countBytes (-static_cast<std::ptrdiff_t> (Capacity));
+    }
+};
+
+// An item too large to store inline
+class BlobSHAMapItem
+    : public SHAMapItem
+{
+private:
+    Blob blob_;
+
+public:
+    // The blob's buffer is unchanged by the move
+    BlobSHAMapItem (uint256 const& tag, Blob&& data)
+        : SHAMapItem (tag, data.data (), data.size ())
+        , blob_ (std::move (data))
+    {
+        countBytes (sizeof (blob_) + blob_.capacity ());
+    }
+
+    ~BlobSHAMapItem ()
+    {
+        countBytes (-static_cast<std::ptrdiff_t> (
+            sizeof (blob_) + blob_.capacity ()));
+    }
+};
+
+template <std::size_t Capacity>
+std::shared_ptr<SHAMapItem const>
+makeInline (uint256 const& tag, Slice data)
+{
+    return std::make_shared<InlineSHAMapItem<Capacity> const> (tag, data);
 }
 
-SHAMapItem::SHAMapItem (uint256 const& tag, const Serializer& data)
-    : tag_ (tag)
-    , data_(data.peekData())
+} // detail
+
+std::shared_ptr<SHAMapItem const>
+make_shamapitem (uint256 const& tag, Slice data)
 {
+    // Inline capacity is rounded up to a multiple of 32 bytes
+    switch ((data.size () + 31) / 32)
+    {
+    case 0:
+    case 1: return detail::makeInline<32> (tag, data);
+    case 2: return detail::makeInline<64> (tag, data);
+    case 3: return detail::makeInline<96> (tag, data);
+    case 4: return detail::makeInline<128> (tag, data);
+    case 5: return detail::makeInline<160> (tag, data);
+    case 6: return detail::makeInline<192> (tag, data);
+    case 7: return detail::makeInline<224> (tag, data);
+    case 8: return detail::makeInline<256> (tag, data);
+    default:
+        break;
+    }
+
+    static_assert (maxInlineSHAMapItem == 256, "");
+    return std::make_shared<detail::BlobSHAMapItem const> (
+        tag, Blob (data.data (), data.data () + data.size ()));
+}
+
+std::shared_ptr<SHAMapItem const>
+make_shamapitem (uint256 const& tag, Blob const& data)
+{
+    return make_shamapitem (tag, makeSlice (data));
+}
+
+std::shared_ptr<SHAMapItem const>
+make_shamapitem (uint256 const& tag, Blob&& data)
+{
+    if (data.size () <= maxInlineSHAMapItem)
+        return make_shamapitem (tag, makeSlice (data));
+
+    return std::make_shared<detail::BlobSHAMapItem const> (
+        tag, std::move (data));
 }
 
-SHAMapItem::SHAMapItem (uint256 const& tag, Serializer&& data)
-    : tag_ (tag)
-    , data_(std::move(data.modData()))
+std::shared_ptr<SHAMapItem const>
+make_shamapitem (uint256 const& tag, Serializer&& s)
 {
+    return make_shamapitem (tag, std::move (s.modData ()));
 }
 
 } // ripple
@@ -21,6 +21,10 @@
 #include <ripple/shamap/SHAMap.h>
 #include <ripple/nodestore/Database.h>
 #include <beast/unit_test/suite.h>
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <tuple>
 
 namespace ripple {
 
@@ -73,6 +77,7 @@ void SHAMap::visitNodes(std::function<bool (SHAMapAbstractNode&)> const& functio
             uint256 childHash;
             if (!node->isEmptyBranch (pos))
             {
+                readAhead (node.get (), pos);
                 std::shared_ptr<SHAMapAbstractNode> child = descendNoStore (node, pos);
                 if (function (*child))
                     return;
@@ -110,6 +115,96 @@ void SHAMap::visitNodes(std::function<bool (SHAMapAbstractNode&)> const& functio
     }
 }
 
+void
+SHAMap::countResident (SHAMapResidentCounts& counts) const
+{
+    ++counts.maps;
+
+    std::vector <SHAMapAbstractNode*> stack;
+    stack.push_back (root_.get ());
+
+    while (! stack.empty ())
+    {
+        auto const node = stack.back ();
+        stack.pop_back ();
+
+        // Whatever is below a node seen before has been counted with it
+        if (! counts.seen.insert (node).second)
+        {
+            ++counts.shared;
+            continue;
+        }
+
+        auto const bytes = TreeNodeCache::nodeBytes (*node);
+        if (node->isLeaf ())
+        {
+            ++counts.leaf;
+            counts.leafBytes += bytes;
+            continue;
+        }
+
+        ++counts.inner;
+        counts.innerBytes += bytes;
+
+        auto const inner = static_cast<SHAMapInnerNode*> (node);
+        for (int branch = 0; branch < 16; ++branch)
+        {
+            if (inner->isEmptyBranch (branch))
+                continue;
+            if (auto const child = inner->getChildPointer (branch))
+                stack.push_back (child);
+        }
+    }
+}
+
+// Searches resuming from at least this many saved subtrees are split
+// across threads
+static std::size_t const parallelSyncMinStarts = 64;
+
+// The state of one search for missing nodes
+struct SHAMap::MissingNodes
+{
+    MissingNodes (int max_, SHAMapSyncFilter* filter_,
+            std::uint32_t generation_, std::size_t maxDefer_)
+        : max (max_)
+        , filter (filter_)
+        , generation (generation_)
+        , maxDefer (maxDefer_)
+    {
+    }
+
+    int max;                        // room left for missing nodes
+    SHAMapSyncFilter* filter;
+    std::uint32_t generation;
+    std::size_t maxDefer;
+
+    std::vector<SHAMapNodeID> nodeIDs;
+    std::vector<uint256> hashes;
+
+    // Track the missing hashes we have found so far
+    std::set <SHAMapHash> missingHashes;
+
+    // Subtrees there wasn't room to search
+    std::vector<SHAMapNodeID> frontier;
+
+    void
+    merge (MissingNodes&& other)
+    {
+        for (std::size_t i = 0; i < other.nodeIDs.size (); ++i)
+        {
+            if (missingHashes.count (SHAMapHash {other.hashes[i]}) == 0)
+            {
+                nodeIDs.push_back (other.nodeIDs[i]);
+                hashes.push_back (other.hashes[i]);
+            }
+        }
+        missingHashes.insert (
+            other.missingHashes.begin (), other.missingHashes.end ());
+        frontier.insert (frontier.end (),
+            other.frontier.begin (), other.frontier.end ());
+    }
+};
+
 /** Get a list of node IDs and hashes for nodes that are part of this SHAMap
     but not available locally.  The filter can hold alternate sources of
     nodes that are not permanently stored locally
@@ -132,42 +227,264 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
         return;
     }
 
-    if (std::static_pointer_cast<SHAMapInnerNode>(root_)->isFullBelow (generation))
+    auto const root = static_cast<SHAMapInnerNode*>(root_.get());
+
+    if (root->isFullBelow (generation))
     {
+        std::lock_guard<std::mutex> lock (syncFrontierLock_);
+        syncFrontier_.clear ();
         clearSynching ();
         return;
     }
 
-    int const maxDefer = f_.db().getDesiredAsyncReadCount ();
+    MissingNodes mn (max, filter, generation,
+        f_.db().getDesiredAsyncReadCount ());
 
-    // Track the missing hashes we have found so far
-    std::set <SHAMapHash> missingHashes;
+    // Resume from the subtrees saved most recently, a batch at a time.
+    // Taking the newest first makes the acquisition depth first, which
+    // keeps the number of saved subtrees small.
+    while (mn.max > 0)
+    {
+        std::vector<SHAMapNodeID> batch;
+        {
+            std::lock_guard<std::mutex> lock (syncFrontierLock_);
+            auto const n = std::min<std::size_t> (
+                syncFrontier_.size (), mn.max);
+            batch.assign (syncFrontier_.end () - n, syncFrontier_.end ());
+            syncFrontier_.resize (syncFrontier_.size () - n);
+        }
+
+        if (batch.empty ())
+            break;
+
+        gmnResume (std::move (batch), mn);
+    }
+
+    // Searching from the root finds anything the saved subtrees did not
+    // cover, and marks the nodes above complete subtrees full below
+    if (mn.max > 0)
+        gmnWalk ({SyncStart (root, SHAMapNodeID (), -1)}, mn);
+
+    nodeIDs.insert (nodeIDs.end (), mn.nodeIDs.begin (), mn.nodeIDs.end ());
+    hashes.insert (hashes.end (), mn.hashes.begin (), mn.hashes.end ());
+
+    // Save the subtrees we had no room for and then the nodes we asked
+    // for, so the next search starts with those, which are likely to have
+    // arrived by then
+    {
+        std::lock_guard<std::mutex> lock (syncFrontierLock_);
+        syncFrontier_.insert (syncFrontier_.end (),
+            mn.frontier.begin (), mn.frontier.end ());
+        syncFrontier_.insert (syncFrontier_.end (),
+            mn.nodeIDs.begin (), mn.nodeIDs.end ());
+    }
+
+    if (nodeIDs.empty ())
+        clearSynching ();
+}
+
+// Search some of the subtrees saved by earlier searches. Their ancestors
+// were loaded by those searches, so finding them doesn't touch the
+// database.
+void
+SHAMap::gmnResume (std::vector<SHAMapNodeID> frontier, MissingNodes& mn)
+{
+    // Order the subtrees by key so each thread gets neighbouring ones
+    std::sort (frontier.begin (), frontier.end (),
+        [](SHAMapNodeID const& a, SHAMapNodeID const& b)
+        {
+            return std::make_pair (a.getNodeID (), a.getDepth ()) <
+                std::make_pair (b.getNodeID (), b.getDepth ());
+        });
+    frontier.erase (std::unique (frontier.begin (), frontier.end ()),
+        frontier.end ());
+
+    std::vector<SyncStart> starts;
+    starts.reserve (frontier.size ());
 
+    // In this order a subtree comes just before any subtrees inside it,
+    // which searching it covers
+    SHAMapNodeID last;
+
+    for (auto const& id : frontier)
+    {
+        if (id.isRoot ())
+            continue;
+
+        auto node = static_cast<SHAMapInnerNode*>(root_.get());
+        SHAMapNodeID nodeID;
+        int branch = nodeID.selectBranch (id.getNodeID ());
+
+        while (node && (nodeID.getDepth () + 1 < id.getDepth ()))
+        {
+            auto child = node->isEmptyBranch (branch) ?
+                nullptr : node->getChildPointer (branch);
+
+            if (child && child->isInner ())
+            {
+                node = static_cast<SHAMapInnerNode*>(child);
+                nodeID = nodeID.getChildNodeID (branch);
+                branch = nodeID.selectBranch (id.getNodeID ());
+
+                if (nodeID == last)
+                    node = nullptr;
+            }
+            else
+                node = nullptr;
+        }
+
+        if (node && !node->isEmptyBranch (branch))
+        {
+            starts.emplace_back (node, nodeID, branch);
+            last = id;
+        }
+    }
+
+    std::size_t chunks = 1;
+    if (starts.size () >= parallelSyncMinStarts)
+        chunks = std::min<std::size_t> (syncThreads_, mn.max);
+
+    if (chunks <= 1)
+    {
+        gmnWalk (starts, mn);
+        return;
+    }
+
+    // The subtrees are disjoint, so each thread searches its share of
+    // them with its share of the room
+    std::vector<MissingNodes> results (chunks, MissingNodes (
+        (mn.max + chunks - 1) / chunks, mn.filter, mn.generation,
+            mn.maxDefer));
+
+    runParallel (syncThreads_, chunks,
+        [&](std::size_t i)
+        {
+            auto const first = starts.begin () + starts.size () * i / chunks;
+            auto const last = starts.begin () + starts.size () * (i + 1) / chunks;
+            gmnWalk (std::vector<SyncStart> (first, last), results[i]);
+        });
+
+    auto const before = mn.nodeIDs.size ();
+    for (auto& result : results)
+        mn.merge (std::move (result));
+
+    // Leave what the threads found beyond the room we had for next time
+    auto const room = before + mn.max;
+    if (mn.nodeIDs.size () > room)
+    {
+        mn.frontier.insert (mn.frontier.end (),
+            mn.nodeIDs.begin () + room, mn.nodeIDs.end ());
+        mn.nodeIDs.resize (room);
+        mn.hashes.resize (room);
+    }
+    mn.max -= static_cast<int> (mn.nodeIDs.size () - before);
+}
+
+// Search below each start, an inner node or just one branch of it, for
+// missing nodes. Returns false if it ran out of room, leaving the parts
+// it didn't get to in the frontier.
+bool
+SHAMap::gmnWalk (std::vector<SyncStart> const& starts, MissingNodes& mn)
+{
+    // Starts found complete, or missing only nodes already reported
+    std::vector<bool> done (starts.size (), false);
 
     while (1)
     {
         std::vector <std::tuple <SHAMapInnerNode*, int, SHAMapNodeID>> deferredReads;
-        deferredReads.reserve (maxDefer + 16);
+        deferredReads.reserve (mn.maxDefer + 16);
 
         using StackEntry = std::tuple<SHAMapInnerNode*, SHAMapNodeID, int, int, bool>;
         std::stack <StackEntry, std::vector<StackEntry>> stack;
 
         // Traverse the map without blocking
 
-        auto node = static_cast<SHAMapInnerNode*>(root_.get());
+        SHAMapInnerNode* node = nullptr;
         SHAMapNodeID nodeID;
-
-        // The firstChild value is selected randomly so if multiple threads
-        // are traversing the map, each thread will start at a different
-        // (randomly selected) inner node.  This increases the likelihood
-        // that the two threads will produce different request sets (which is
-        // more efficient than sending identical requests).
-        int firstChild = rand() % 256;
-        int currentChild = 0;
+        int onlyBranch = -1;
+        int firstChild = 0;
+        int currentChild = 16;
         bool fullBelow = true;
 
+        std::size_t next = 0;           // the next start to search
+        std::size_t current = 0;        // the start being searched
+        std::size_t deferredBefore = 0; // reads deferred before it
+
+        // Save the subtrees this pass has yet to visit or finish
+        auto saveUnvisited = [&]()
+        {
+            auto save = [&mn](SHAMapInnerNode* inner,
+                SHAMapNodeID const& id, int first, int current)
+            {
+                for (; current < 16; ++current)
+                {
+                    int branch = (first + current) % 16;
+                    if (!inner->isEmptyBranch (branch))
+                        mn.frontier.push_back (id.getChildNodeID (branch));
+                }
+            };
+
+            if (node)
+                save (node, nodeID, firstChild, currentChild);
+
+            for (; !stack.empty (); stack.pop ())
+            {
+                auto const& e = stack.top ();
+                save (std::get<0>(e), std::get<1>(e),
+                    std::get<2>(e), std::get<3>(e));
+            }
+
+            for (auto const& read : deferredReads)
+                mn.frontier.push_back (std::get<2>(read));
+
+            for (; next < starts.size (); ++next)
+            {
+                if (done[next])
+                    continue;
+
+                int const branch = std::get<2>(starts[next]);
+                if (branch < 0)
+                    save (std::get<0>(starts[next]),
+                        std::get<1>(starts[next]), 0, 0);
+                else
+                    mn.frontier.push_back (std::get<1>(starts[next])
+                        .getChildNodeID (branch));
+            }
+        };
+
         do
         {
+            if (!node)
+            {
+                while ((next < starts.size ()) && done[next])
+                    ++next;
+
+                if (next == starts.size ())
+                    break;
+
+                current = next++;
+                deferredBefore = deferredReads.size ();
+                std::tie (node, nodeID, onlyBranch) = starts[current];
+                fullBelow = true;
+
+                if (onlyBranch < 0)
+                {
+                    // The firstChild value is selected randomly so if multiple threads
+                    // are traversing the map, each thread will start at a different
+                    // (randomly selected) inner node.  This increases the likelihood
+                    // that the two threads will produce different request sets (which is
+                    // more efficient than sending identical requests).
+                    firstChild = rand() % 256;
+                    currentChild = 0;
+                }
+                else
+                {
+                    // Visit the one branch only
+                    firstChild = onlyBranch + 1;
+                    currentChild = 15;
+                }
+            }
+
             while (currentChild < 16)
             {
                 int branch = (firstChild + currentChild++) % 16;
@@ -175,7 +492,7 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
                 {
                     auto const& childHash = node->getChildHash (branch);
 
-                    if (missingHashes.count (childHash) != 0)
+                    if (mn.missingHashes.count (childHash) != 0)
                     {
                         fullBelow = false;
                     }
@@ -183,17 +500,21 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
                     {
                         SHAMapNodeID childID = nodeID.getChildNodeID (branch);
                         bool pending = false;
-                        auto d = descendAsync (node, branch, childID, filter, pending);
+                        auto d = descendAsync (node, branch, childID, mn.filter, pending);
 
                         if (!d)
                         {
                             if (!pending)
                             { // node is not in the database
-                                nodeIDs.push_back (childID);
-                                hashes.push_back (childHash.as_uint256());
-
-                                if (--max <= 0)
-                                    return;
+                                mn.nodeIDs.push_back (childID);
+                                mn.hashes.push_back (childHash.as_uint256());
+                                mn.missingHashes.insert (childHash);
+
+                                if (--mn.max <= 0)
+                                {
+                                    saveUnvisited ();
+                                    return false;
+                                }
                             }
                             else
                             {
@@ -204,7 +525,7 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
                             fullBelow = false; // This node is not known full below
                         }
                         else if (d->isInner() &&
-                                 !static_cast<SHAMapInnerNode*>(d)->isFullBelow(generation))
+                                 !static_cast<SHAMapInnerNode*>(d)->isFullBelow(mn.generation))
                         {
                             stack.push (std::make_tuple (node, nodeID,
                                   firstChild, currentChild, fullBelow));
@@ -222,15 +543,22 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
 
             // We are done with this inner node (and thus all of its children)
 
-            if (fullBelow)
+            // A start we searched only one branch of may not be full below
+            if (fullBelow && !(stack.empty () && (onlyBranch >= 0)))
             { // No partial node encountered below this node
-                node->setFullBelowGen (generation);
+                node->setFullBelowGen (mn.generation);
                 if (backed_)
                     f_.fullbelow().insert (node->getNodeHash ().as_uint256());
             }
 
             if (stack.empty ())
-                node = nullptr; // Finished processing the last node, we are done
+            {
+                // Finished this start. Unless it deferred reads, there
+                // is nothing more to find below it in this search.
+                if (deferredReads.size () == deferredBefore)
+                    done[current] = true;
+                node = nullptr;
+            }
             else
             { // Pick up where we left off (above this node)
                 bool was;
@@ -240,11 +568,11 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
             }
 
         }
-        while ((node != nullptr) && (deferredReads.size () <= maxDefer));
+        while (deferredReads.size () <= mn.maxDefer);
 
         // If we didn't defer any reads, we're done
         if (deferredReads.empty ())
-            break;
+            return true;
 
         auto const before = std::chrono::steady_clock::now();
         f_.db().waitReads();
@@ -256,14 +584,14 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
 
         // Process all deferred reads
         int hits = 0;
-        for (auto const& node : deferredReads)
+        for (auto const& read : deferredReads)
         {
-            auto parent = std::get<0>(node);
-            auto branch = std::get<1>(node);
-            auto const& nodeID = std::get<2>(node);
+            auto parent = std::get<0>(read);
+            auto branch = std::get<1>(read);
+            auto const& readID = std::get<2>(read);
             auto const& nodeHash = parent->getChildHash (branch);
 
-            auto nodePtr = fetchNodeNT(nodeID, nodeHash, filter);
+            auto nodePtr = fetchNodeNT(readID, nodeHash, mn.filter);
             if (nodePtr)
             {
                 ++hits;
@@ -271,12 +599,12 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
                     canonicalize (nodeHash, nodePtr);
                 nodePtr = parent->canonicalizeChild (branch, std::move(nodePtr));
             }
-            else if ((max > 0) && (missingHashes.insert (nodeHash).second))
+            else if ((mn.max > 0) && (mn.missingHashes.insert (nodeHash).second))
             {
-                nodeIDs.push_back (nodeID);
-                hashes.push_back (nodeHash.as_uint256());
+                mn.nodeIDs.push_back (readID);
+                mn.hashes.push_back (nodeHash.as_uint256());
 
-                --max;
+                --mn.max;
             }
         }
 
@@ -288,13 +616,12 @@ SHAMap::getMissingNodes(std::vector<SHAMapNodeID>& nodeIDs, std::vector<uint256>
                 count << " nodes (" << hits << " hits) in "
                 << elapsed.count() << " + " << process_time.count()  << " ms";
 
-        if (max <= 0)
-            return;
-
+        if (mn.max <= 0)
+        {
+            saveUnvisited ();
+            return false;
+        }
     }
-
-    if (nodeIDs.empty ())
-        clearSynching ();
 }
 
 std::vector<uint256> SHAMap::getNeededHashes (int max, SHAMapSyncFilter* filter)
@@ -611,7 +938,7 @@ bool SHAMap::deepCompare (SHAMap& other) const
             auto& otherNodePeek = static_cast<SHAMapTreeNode*>(otherNode)->peekItem();
             if (nodePeek->key() != otherNodePeek->key())
                 return false;
-            if (nodePeek->peekData() != otherNodePeek->peekData())
+            if (nodePeek->slice() != otherNodePeek->slice())
                 return false;
         }
         else if (node->isInner ())
@@ -729,68 +1056,4 @@ void SHAMap::getFetchPack (SHAMap* have, bool includeLeaves, int max,
         });
 }
 
-void
-SHAMap::visitDifferences(SHAMap* have,
-                         std::function<bool (SHAMapAbstractNode&)> func) const
-{
-    // Visit every node in this SHAMap that is not present
-    // in the specified SHAMap
-
-    if (root_->getNodeHash ().isZero ())
-        return;
-
-    if (have && (root_->getNodeHash () == have->root_->getNodeHash ()))
-        return;
-
-    if (root_->isLeaf ())
-    {
-        auto leaf = std::static_pointer_cast<SHAMapTreeNode>(root_);
-        if (!have || !have->hasLeafNode(leaf->peekItem()->key(), leaf->getNodeHash()))
-            func (*root_);
-
-        return;
-    }
-    // contains unexplored non-matching inner node entries
-    using StackEntry = std::pair <SHAMapInnerNode*, SHAMapNodeID>;
-    std::stack <StackEntry, std::vector<StackEntry>> stack;
-
-    stack.push ({static_cast<SHAMapInnerNode*>(root_.get()), SHAMapNodeID{}});
-
-    while (!stack.empty())
-    {
-        SHAMapInnerNode* node;
-        SHAMapNodeID nodeID;
-        std::tie (node, nodeID) = stack.top ();
-        stack.pop ();
-
-        // 1) Add this node to the pack
-        if (!func (*node))
-            return;
-
-        // 2) push non-matching child inner nodes
-        for (int i = 0; i < 16; ++i)
-        {
-            if (!node->isEmptyBranch (i))
-            {
-                auto const& childHash = node->getChildHash (i);
-                SHAMapNodeID childID = nodeID.getChildNodeID (i);
-                auto next = descendThrow(node, i);
-
-                if (next->isInner ())
-                {
-                    if (!have || !have->hasInnerNode(childID, childHash))
-                        stack.push ({static_cast<SHAMapInnerNode*>(next), childID});
-                }
-                else if (!have || !have->hasLeafNode(
-                         static_cast<SHAMapTreeNode*>(next)->peekItem()->key(),
-                         childHash))
-                {
-                    if (! func (*next))
-                        return;
-                }
-            }
-        }
-    }
-}
-
 } // ripple
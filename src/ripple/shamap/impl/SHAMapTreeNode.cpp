@@ -42,14 +42,67 @@ SHAMapInnerNode::clone(std::uint32_t seq) const
     auto p = std::make_shared<SHAMapInnerNode>(seq);
     p->mHash = mHash;
     p->mIsBranch = mIsBranch;
+    p->mCapacity = mCapacity;
+    p->mDepth.store (getDepth (), std::memory_order_relaxed);
     p->mFullBelowGen = mFullBelowGen;
-    std::memcpy(p->mHashes, mHashes, sizeof(mHashes));
+    if (mCapacity != 0)
+        p->mBranches.reset (new Branch[mCapacity]);
     std::unique_lock <std::mutex> lock(childLock);
-    for (int i = 0; i < 16; ++i)
-        p->mChildren[i] = mChildren[i];
+    for (int i = 0; i < mCapacity; ++i)
+        p->mBranches[i] = mBranches[i];
     return std::move(p);
 }
 
+// Move the populated branches into the layout for a new set of branches.
+// Branches dropped from the set are discarded; added ones start empty.
+void
+SHAMapInnerNode::reshape (std::uint16_t isBranch)
+{
+    int const capacity = capacityFor (countBranches (isBranch));
+
+    if (capacity == 16 && mCapacity == 16)
+    {
+        // Branches keep their slots
+        mIsBranch = isBranch;
+        return;
+    }
+
+    std::unique_ptr<Branch[]> branches;
+    if (capacity != 0)
+        branches.reset (new Branch[capacity]);
+
+    std::uint16_t const kept = mIsBranch & isBranch;
+    for (int m = 0; m < 16; ++m)
+    {
+        if (kept & (1 << m))
+            branches[slot (isBranch, capacity, m)] =
+                std::move (mBranches[slot (m)]);
+    }
+
+    mBranches = std::move (branches);
+    mIsBranch = isBranch;
+    mCapacity = capacity;
+}
+
+void
+SHAMapInnerNode::setHashes (SHAMapHash const (&hashes)[16])
+{
+    std::uint16_t isBranch = 0;
+    for (int m = 0; m < 16; ++m)
+    {
+        if (hashes[m].isNonZero ())
+            isBranch |= (1 << m);
+    }
+
+    reshape (isBranch);
+
+    for (int m = 0; m < 16; ++m)
+    {
+        if (isBranch & (1 << m))
+            mBranches[slot (m)].hash = hashes[m];
+    }
+}
+
 std::shared_ptr<SHAMapAbstractNode>
 SHAMapTreeNode::clone(std::uint32_t seq) const
 {
@@ -61,7 +114,7 @@ SHAMapTreeNode::SHAMapTreeNode (std::shared_ptr<SHAMapItem const> const& item,
     : SHAMapAbstractNode(type, seq)
     , mItem (item)
 {
-    assert (item->peekData ().size () >= 12);
+    assert (item->size () >= 12);
     updateHash();
 }
 
@@ -70,7 +123,7 @@ SHAMapTreeNode::SHAMapTreeNode (std::shared_ptr<SHAMapItem const> const& item,
     : SHAMapAbstractNode(type, seq, hash)
     , mItem (item)
 {
-    assert (item->peekData ().size () >= 12);
+    assert (item->size () >= 12);
 }
 
 std::shared_ptr<SHAMapAbstractNode>
@@ -92,7 +145,7 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
         if (type == 0)
         {
             // transaction
-            auto item = std::make_shared<SHAMapItem const>(
+            auto item = make_shamapitem (
                 sha512Half(HashPrefix::transactionID,
                     Slice(s.data(), s.size())),
                         s.peekData());
@@ -112,7 +165,7 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
 
             if (u.isZero ()) Throw<std::runtime_error> ("invalid AS node");
 
-            auto item = std::make_shared<SHAMapItem const> (u, s.peekData ());
+            auto item = make_shamapitem (u, s.peekData ());
             if (hashValid)
                 return std::make_shared<SHAMapTreeNode>(item, tnACCOUNT_STATE, seq, hash);
             return std::make_shared<SHAMapTreeNode>(item, tnACCOUNT_STATE, seq);
@@ -124,13 +177,10 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
                 Throw<std::runtime_error> ("invalid FI node");
 
             auto ret = std::make_shared<SHAMapInnerNode>(seq);
+            SHAMapHash hashes[16];
             for (int i = 0; i < 16; ++i)
-            {
-                s.get256 (ret->mHashes[i].as_uint256(), i * 32);
-
-                if (ret->mHashes[i].isNonZero ())
-                    ret->mIsBranch |= (1 << i);
-            }
+                s.get256 (hashes[i].as_uint256(), i * 32);
+            ret->setHashes (hashes);
             if (hashValid)
                 ret->mHash = hash;
             else
@@ -140,6 +190,7 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
         else if (type == 3)
         {
             auto ret = std::make_shared<SHAMapInnerNode>(seq);
+            SHAMapHash hashes[16];
             // compressed inner
             for (int i = 0; i < (len / 33); ++i)
             {
@@ -148,10 +199,9 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
                     Throw<std::runtime_error> ("short CI node");
                 if ((pos < 0) || (pos >= 16))
                 Throw<std::runtime_error> ("invalid CI node");
-                s.get256 (ret->mHashes[pos].as_uint256(), i * 33);
-                if (ret->mHashes[pos].isNonZero ())
-                    ret->mIsBranch |= (1 << pos);
+                s.get256 (hashes[pos].as_uint256(), i * 33);
             }
+            ret->setHashes (hashes);
             if (hashValid)
                 ret->mHash = hash;
             else
@@ -171,7 +221,7 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
             if (u.isZero ())
                 Throw<std::runtime_error> ("invalid TM node");
 
-            auto item = std::make_shared<SHAMapItem const> (u, s.peekData ());
+            auto item = make_shamapitem (u, s.peekData ());
             if (hashValid)
                 return std::make_shared<SHAMapTreeNode>(item, tnTRANSACTION_MD, seq, hash);
             return std::make_shared<SHAMapTreeNode>(item, tnTRANSACTION_MD, seq);
@@ -197,7 +247,7 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
 
         if (prefix == HashPrefix::transactionID)
         {
-            auto item = std::make_shared<SHAMapItem const>(
+            auto item = make_shamapitem (
                 sha512Half(makeSlice(rawNode)),
                     s.peekData ());
             if (hashValid)
@@ -219,7 +269,7 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
                 Throw<std::runtime_error> ("invalid PLN node");
             }
 
-            auto item = std::make_shared<SHAMapItem const> (u, s.peekData ());
+            auto item = make_shamapitem (u, s.peekData ());
             if (hashValid)
                 return std::make_shared<SHAMapTreeNode>(item, tnACCOUNT_STATE, seq, hash);
             return std::make_shared<SHAMapTreeNode>(item, tnACCOUNT_STATE, seq);
@@ -229,13 +279,10 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
             if (s.getLength () != 512)
                 Throw<std::runtime_error> ("invalid PIN node");
             auto ret = std::make_shared<SHAMapInnerNode>(seq);
+            SHAMapHash hashes[16];
             for (int i = 0; i < 16; ++i)
-            {
-                s.get256 (ret->mHashes[i].as_uint256(), i * 32);
-
-                if (ret->mHashes[i].isNonZero ())
-                    ret->mIsBranch |= (1 << i);
-            }
+                s.get256 (hashes[i].as_uint256(), i * 32);
+            ret->setHashes (hashes);
             if (hashValid)
                 ret->mHash = hash;
             else
@@ -251,7 +298,7 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
             uint256 txID;
             s.get256 (txID, s.getLength () - 32);
             s.chop (32);
-            auto item = std::make_shared<SHAMapItem const> (txID, s.peekData ());
+            auto item = make_shamapitem (txID, s.peekData ());
             if (hashValid)
                 return std::make_shared<SHAMapTreeNode>(item, tnTRANSACTION_MD, seq, hash);
             return std::make_shared<SHAMapTreeNode>(item, tnTRANSACTION_MD, seq);
@@ -267,16 +314,90 @@ SHAMapAbstractNode::make(Blob const& rawNode, std::uint32_t seq, SHANodeFormat f
     return{}; // Silence compiler warning.
 }
 
+namespace detail {
+
+// A hasher which keeps what it is given, to be hashed later
+struct hash_input_buffer
+{
+    static beast::endian const endian = beast::endian::big;
+
+    Blob& data;
+
+    void
+    operator()(void const* p, std::size_t size) noexcept
+    {
+        auto const bytes = static_cast<std::uint8_t const*>(p);
+        data.insert (data.end (), bytes, bytes + size);
+    }
+};
+
+} // detail
+
+void
+SHAMapAbstractNode::updateHashes (std::vector<SHAMapAbstractNode*> const& nodes)
+{
+    // Gathered a few at a time, so the messages are still in the
+    // cache when they are hashed
+    std::size_t const chunk = 64;
+
+    Blob data;
+    std::size_t ends[chunk];
+    Slice messages[chunk];
+    uint256 digests[chunk];
+
+    for (std::size_t first = 0; first < nodes.size (); first += chunk)
+    {
+        auto const count = std::min (chunk, nodes.size () - first);
+
+        data.clear ();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            nodes[first + i]->addHashInput (data);
+            ends[i] = data.size ();
+        }
+
+        std::size_t begin = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            messages[i] = Slice (data.data () + begin, ends[i] - begin);
+            begin = ends[i];
+        }
+
+        sha512Half_batch (messages, digests, count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // An inner node without branches hashes as zero
+            auto const node = nodes[first + i];
+            if (node->isInner () &&
+                    static_cast<SHAMapInnerNode*>(node)->isEmpty ())
+                node->mHash.zero ();
+            else
+                node->mHash = SHAMapHash{digests[i]};
+        }
+    }
+}
+
+template <class Hasher>
+void
+SHAMapInnerNode::hashAppend (Hasher& h) const
+{
+    // Empty branches hash as zero
+    using beast::hash_append;
+    hash_append (h, HashPrefix::innerNode);
+    for (int m = 0; m < 16; ++m)
+        hash_append (h, getChildHash (m).as_uint256());
+}
+
 bool
 SHAMapInnerNode::updateHash()
 {
     uint256 nh;
     if (mIsBranch != 0)
     {
-        // VFALCO This code assumes the layout of a base_uint
-        nh = sha512Half(HashPrefix::innerNode,
-            Slice(reinterpret_cast<unsigned char const*>(mHashes),
-                sizeof (mHashes)));
+        sha512_half_hasher h;
+        hashAppend (h);
+        nh = static_cast<typename sha512_half_hasher::result_type>(h);
     }
     if (nh == mHash.as_uint256())
         return false;
@@ -284,40 +405,64 @@ SHAMapInnerNode::updateHash()
     return true;
 }
 
+void
+SHAMapInnerNode::addHashInput (Blob& data) const
+{
+    detail::hash_input_buffer h {data};
+    hashAppend (h);
+}
+
 void
 SHAMapInnerNode::updateHashDeep()
 {
-    for (auto pos = 0; pos < 16; ++pos)
+    updateChildHashes();
+    updateHash();
+}
+
+// Take the hashes of the children which are linked
+void
+SHAMapInnerNode::updateChildHashes()
+{
+    for (auto i = 0; i < mCapacity; ++i)
     {
-        if (mChildren[pos] != nullptr)
-            mHashes[pos] = mChildren[pos]->getNodeHash();
+        if (mBranches[i].child != nullptr)
+            mBranches[i].hash = mBranches[i].child->getNodeHash();
     }
-    updateHash();
 }
 
-bool
-SHAMapTreeNode::updateHash()
+template <class Hasher>
+void
+SHAMapTreeNode::hashAppend (Hasher& h) const
 {
-    uint256 nh;
+    using beast::hash_append;
     if (mType == tnTRANSACTION_NM)
     {
-        nh = sha512Half(HashPrefix::transactionID,
-            makeSlice(mItem->peekData()));
+        hash_append (h, HashPrefix::transactionID,
+            mItem->slice());
     }
     else if (mType == tnACCOUNT_STATE)
     {
-        nh = sha512Half(HashPrefix::leafNode,
-            makeSlice(mItem->peekData()),
+        hash_append (h, HashPrefix::leafNode,
+            mItem->slice(),
                 mItem->key());
     }
     else if (mType == tnTRANSACTION_MD)
     {
-        nh = sha512Half(HashPrefix::txNode,
-            makeSlice(mItem->peekData()),
+        hash_append (h, HashPrefix::txNode,
+            mItem->slice(),
                 mItem->key());
     }
     else
         assert (false);
+}
+
+bool
+SHAMapTreeNode::updateHash()
+{
+    sha512_half_hasher h;
+    hashAppend (h);
+    uint256 const nh =
+        static_cast<typename sha512_half_hasher::result_type>(h);
 
     if (nh == mHash.as_uint256())
         return false;
@@ -326,6 +471,13 @@ SHAMapTreeNode::updateHash()
     return true;
 }
 
+void
+SHAMapTreeNode::addHashInput (Blob& data) const
+{
+    detail::hash_input_buffer h {data};
+    hashAppend (h);
+}
+
 void
 SHAMapInnerNode::addRaw(Serializer& s, SHANodeFormat format) const
 {
@@ -347,7 +499,7 @@ SHAMapInnerNode::addRaw(Serializer& s, SHANodeFormat format) const
             s.add32 (HashPrefix::innerNode);
 
             for (int i = 0; i < 16; ++i)
-                s.add256 (mHashes[i].as_uint256());
+                s.add256 (getChildHash (i).as_uint256());
         }
         else
         {
@@ -357,7 +509,7 @@ SHAMapInnerNode::addRaw(Serializer& s, SHANodeFormat format) const
                 for (int i = 0; i < 16; ++i)
                     if (!isEmptyBranch (i))
                     {
-                        s.add256 (mHashes[i].as_uint256());
+                        s.add256 (getChildHash (i).as_uint256());
                         s.add8 (i);
                     }
 
@@ -366,7 +518,7 @@ SHAMapInnerNode::addRaw(Serializer& s, SHANodeFormat format) const
             else
             {
                 for (int i = 0; i < 16; ++i)
-                    s.add256 (mHashes[i].as_uint256());
+                    s.add256 (getChildHash (i).as_uint256());
 
                 s.add8 (2);
             }
@@ -393,12 +545,12 @@ SHAMapTreeNode::addRaw(Serializer& s, SHANodeFormat format) const
         if (format == snfPREFIX)
         {
             s.add32 (HashPrefix::leafNode);
-            s.addRaw (mItem->peekData ());
+            s.addRaw (mItem->data (), mItem->size ());
             s.add256 (mItem->key());
         }
         else
         {
-            s.addRaw (mItem->peekData ());
+            s.addRaw (mItem->data (), mItem->size ());
             s.add256 (mItem->key());
             s.add8 (1);
         }
@@ -408,11 +560,11 @@ SHAMapTreeNode::addRaw(Serializer& s, SHANodeFormat format) const
         if (format == snfPREFIX)
         {
             s.add32 (HashPrefix::transactionID);
-            s.addRaw (mItem->peekData ());
+            s.addRaw (mItem->data (), mItem->size ());
         }
         else
         {
-            s.addRaw (mItem->peekData ());
+            s.addRaw (mItem->data (), mItem->size ());
             s.add8 (0);
         }
     }
@@ -421,12 +573,12 @@ SHAMapTreeNode::addRaw(Serializer& s, SHANodeFormat format) const
         if (format == snfPREFIX)
         {
             s.add32 (HashPrefix::txNode);
-            s.addRaw (mItem->peekData ());
+            s.addRaw (mItem->data (), mItem->size ());
             s.add256 (mItem->key());
         }
         else
         {
-            s.addRaw (mItem->peekData ());
+            s.addRaw (mItem->data (), mItem->size ());
             s.add256 (mItem->key());
             s.add8 (4);
         }
@@ -452,13 +604,7 @@ bool SHAMapInnerNode::isEmpty () const
 int SHAMapInnerNode::getBranchCount () const
 {
     assert (isInner ());
-    int count = 0;
-
-    for (int i = 0; i < 16; ++i)
-        if (!isEmptyBranch (i))
-            ++count;
-
-    return count;
+    return countBranches (mIsBranch);
 }
 
 #ifdef BEAST_DEBUG
@@ -494,7 +640,7 @@ SHAMapInnerNode::getString(const SHAMapNodeID & id) const
             ret += "\nb";
             ret += beast::lexicalCastThrow <std::string> (i);
             ret += " = ";
-            ret += to_string (mHashes[i]);
+            ret += to_string (getChildHash (i));
         }
     }
     return ret;
@@ -530,13 +676,24 @@ SHAMapInnerNode::setChild(int m, std::shared_ptr<SHAMapAbstractNode> const& chil
     assert (mType == tnINNER);
     assert (mSeq != 0);
     assert (child.get() != this);
-    mHashes[m].zero();
     mHash.zero();
     if (child)
-        mIsBranch |= (1 << m);
-    else
-        mIsBranch &= ~ (1 << m);
-    mChildren[m] = child;
+    {
+        if (isEmptyBranch (m))
+            reshape (mIsBranch | (1 << m));
+        auto& branch = mBranches[slot (m)];
+        branch.hash.zero();
+        branch.child = child;
+        setChildDepth (*child);
+    }
+    else if (!isEmptyBranch (m))
+    {
+        // A dense node keeps the slot, which must hash as zero
+        auto& branch = mBranches[slot (m)];
+        branch.hash.zero();
+        branch.child.reset();
+        reshape (mIsBranch & ~ (1 << m));
+    }
 }
 
 // finished modifying, now make shareable
@@ -547,8 +704,18 @@ void SHAMapInnerNode::shareChild (int m, std::shared_ptr<SHAMapAbstractNode> con
     assert (mSeq != 0);
     assert (child);
     assert (child.get() != this);
+    assert (!isEmptyBranch (m));
+
+    mBranches[slot (m)].child = child;
+    setChildDepth (*child);
+}
 
-    mChildren[m] = child;
+void
+SHAMapInnerNode::setChildDepth (SHAMapAbstractNode& child) const
+{
+    if (child.isInner ())
+        static_cast<SHAMapInnerNode&>(child).mDepth.store (
+            std::min (getDepth () + 1, 255), std::memory_order_relaxed);
 }
 
 SHAMapAbstractNode*
@@ -557,8 +724,11 @@ SHAMapInnerNode::getChildPointer (int branch)
     assert (branch >= 0 && branch < 16);
     assert (isInner());
 
+    if (isEmptyBranch (branch))
+        return nullptr;
+
     std::unique_lock <std::mutex> lock (childLock);
-    return mChildren[branch].get ();
+    return mBranches[slot (branch)].child.get ();
 }
 
 std::shared_ptr<SHAMapAbstractNode>
@@ -567,8 +737,11 @@ SHAMapInnerNode::getChild (int branch)
     assert (branch >= 0 && branch < 16);
     assert (isInner());
 
+    if (isEmptyBranch (branch))
+        return {};
+
     std::unique_lock <std::mutex> lock (childLock);
-    return mChildren[branch];
+    return mBranches[slot (branch)].child;
 }
 
 std::shared_ptr<SHAMapAbstractNode>
@@ -577,18 +750,21 @@ SHAMapInnerNode::canonicalizeChild(int branch, std::shared_ptr<SHAMapAbstractNod
     assert (branch >= 0 && branch < 16);
     assert (isInner());
     assert (node);
-    assert (node->getNodeHash() == mHashes[branch]);
+    assert (node->getNodeHash() == getChildHash (branch));
+
+    auto& child = mBranches[slot (branch)].child;
 
     std::unique_lock <std::mutex> lock (childLock);
-    if (mChildren[branch])
+    if (child)
     {
         // There is already a node hooked up, return it
-        node = mChildren[branch];
+        node = child;
     }
     else
     {
         // Hook this node up
-        mChildren[branch] = node;
+        child = node;
+        setChildDepth (*node);
     }
     return node;
 }
@@ -0,0 +1,813 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/TreeNodeCache.h>
+#include <ripple/shamap/SHAMapTreeNode.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace ripple {
+
+// Share of the budget for the window new nodes go through
+static std::size_t const windowPercent = 1;
+
+// Share of the main cache for the nodes used more than once there
+static std::size_t const protectedPercent = 80;
+
+// Size of a node assumed when sizing the frequency sketch
+static std::size_t const typicalNodeBytes = 256;
+
+std::size_t
+TreeNodeCache::nodeBytes (SHAMapAbstractNode const& node)
+{
+    if (node.isInner ())
+    {
+        auto const& inner = static_cast<SHAMapInnerNode const&> (node);
+        return sizeof (SHAMapInnerNode) + inner.getBranchBytes ();
+    }
+
+    auto const& leaf = static_cast<SHAMapTreeNode const&> (node);
+    return sizeof (SHAMapTreeNode) + sizeof (SHAMapItem) +
+        leaf.peekItem ()->size ();
+}
+
+//------------------------------------------------------------------------------
+
+void
+TreeNodeCache::Sketch::resize (std::size_t entries)
+{
+    entries = std::max<std::size_t> (entries, 1024);
+
+    // Several counters in each row for every entry keeps the estimates
+    // of rarely used keys low
+    std::size_t width = 1024;
+    while (width < 4 * entries)
+        width <<= 1;
+
+    if (width == mask_ + 1)
+        return;
+
+    // Four rows of four bit counters, two to a byte
+    table_.assign (2 * width, 0);
+    mask_ = width - 1;
+    additions_ = 0;
+    sampleSize_ = 10 * entries;
+
+    // Few enough false positives among the keys of one sample
+    doorkeeper_.assign (8 * sampleSize_, false);
+}
+
+template <class Function>
+void
+TreeNodeCache::Sketch::forEachCounter (key_type const& key, Function f) const
+{
+    // Keys are hashes, so each row takes one of the key's words as is
+    std::uint64_t words[4];
+    std::memcpy (words, key.data (), sizeof (words));
+
+    auto const width = mask_ + 1;
+    for (std::size_t row = 0; row < 4; ++row)
+    {
+        auto const counter = (row * width) + (words[row] & mask_);
+        f (counter >> 1, (counter & 1) ? 4 : 0);
+    }
+}
+
+std::size_t
+TreeNodeCache::Sketch::doorkeeperBit (key_type const& key, int i) const
+{
+    // Bits taken from the halves of the key's words the counters don't use
+    std::uint32_t words[8];
+    std::memcpy (words, key.data (), sizeof (words));
+    return words[2 * i + 1] % doorkeeper_.size ();
+}
+
+void
+TreeNodeCache::Sketch::increment (key_type const& key)
+{
+    if (table_.empty ())
+        return;
+
+    bool seen = true;
+    for (int i = 0; i < 3; ++i)
+    {
+        auto const bit = doorkeeperBit (key, i);
+        if (! doorkeeper_[bit])
+        {
+            doorkeeper_[bit] = true;
+            seen = false;
+        }
+    }
+
+    if (seen)
+    {
+        forEachCounter (key,
+            [this](std::size_t byte, int shift)
+            {
+                if (((table_[byte] >> shift) & 0xf) != 0xf)
+                    table_[byte] += (1 << shift);
+            });
+    }
+
+    if (++additions_ >= sampleSize_)
+        age ();
+}
+
+// Halve the counts and forget the doorkeeper, so that what was popular
+// once does not stay so
+void
+TreeNodeCache::Sketch::age ()
+{
+    for (auto& counters : table_)
+        counters = (counters >> 1) & 0x77;
+    doorkeeper_.assign (doorkeeper_.size (), false);
+    additions_ /= 2;
+}
+
+int
+TreeNodeCache::Sketch::estimate (key_type const& key) const
+{
+    if (table_.empty ())
+        return 0;
+
+    int count = 0xf;
+    forEachCounter (key,
+        [this, &count](std::size_t byte, int shift)
+        {
+            count = std::min (count, (table_[byte] >> shift) & 0xf);
+        });
+
+    for (int i = 0; i < 3; ++i)
+        if (! doorkeeper_[doorkeeperBit (key, i)])
+            return count;
+    return count + 1;
+}
+
+void
+TreeNodeCache::Sketch::clear ()
+{
+    std::fill (table_.begin (), table_.end (), 0);
+    doorkeeper_.assign (doorkeeper_.size (), false);
+    additions_ = 0;
+}
+
+//------------------------------------------------------------------------------
+
+TreeNodeCache::TreeNodeCache (std::string const& name, std::size_t targetBytes,
+    clock_type::rep expiration_seconds, clock_type& clock,
+        beast::Journal journal)
+    : m_journal (journal)
+    , m_clock (clock)
+    , m_name (name)
+    , m_target_bytes (targetBytes)
+    , m_target_age (expiration_seconds)
+{
+    for (auto& shard : m_shards)
+        shard.setTargetBytes (targetBytes / shardCount);
+}
+
+std::size_t
+TreeNodeCache::getTargetBytes () const
+{
+    return m_target_bytes;
+}
+
+void
+TreeNodeCache::setTargetBytes (std::size_t bytes)
+{
+    m_target_bytes = bytes;
+    for (auto& shard : m_shards)
+        shard.setTargetBytes (bytes / shardCount);
+
+    if (m_journal.debug) m_journal.debug <<
+        m_name << " target size set to " << bytes << " bytes";
+}
+
+TreeNodeCache::clock_type::rep
+TreeNodeCache::getTargetAge () const
+{
+    return m_target_age;
+}
+
+void
+TreeNodeCache::setTargetAge (clock_type::rep s)
+{
+    m_target_age = s;
+    if (m_journal.debug) m_journal.debug <<
+        m_name << " target age set to " << s << "s";
+}
+
+int
+TreeNodeCache::getCacheSize () const
+{
+    int size = 0;
+    for (auto const& shard : m_shards)
+        size += shard.getCacheSize ();
+    return size;
+}
+
+int
+TreeNodeCache::getTrackSize () const
+{
+    std::size_t size = 0;
+    for (auto const& shard : m_shards)
+        size += shard.getTrackSize ();
+    return size;
+}
+
+std::size_t
+TreeNodeCache::getCacheBytes () const
+{
+    std::size_t bytes = 0;
+    for (auto const& shard : m_shards)
+        bytes += shard.getCacheBytes ();
+    return bytes;
+}
+
+float
+TreeNodeCache::getHitRate () const
+{
+    Stats stats;
+    Counts total;
+    for (auto const& shard : m_shards)
+        shard.addStats (stats, total);
+
+    auto const lookups = static_cast<float> (total.hits + total.misses);
+    return total.hits * (100.0f / std::max (1.0f, lookups));
+}
+
+TreeNodeCache::Stats
+TreeNodeCache::getStats () const
+{
+    Stats stats;
+    Counts total;
+    for (auto const& shard : m_shards)
+        shard.addStats (stats, total);
+
+    auto const last = std::find_if (stats.depths.rbegin (),
+        stats.depths.rend (),
+        [](Counts const& c)
+        {
+            return c.hits || c.misses;
+        });
+    stats.depths.erase (last.base (), stats.depths.end ());
+
+    return stats;
+}
+
+void
+TreeNodeCache::clearStats ()
+{
+    for (auto& shard : m_shards)
+        shard.clearStats ();
+}
+
+void
+TreeNodeCache::clear ()
+{
+    for (auto& shard : m_shards)
+        shard.clear ();
+}
+
+void
+TreeNodeCache::sweep ()
+{
+    int cacheRemovals = 0;
+    int mapRemovals = 0;
+    std::size_t tracked = 0;
+
+    auto const when_expire = m_clock.now () -
+        std::chrono::seconds (m_target_age.load ());
+
+    for (auto& shard : m_shards)
+        shard.sweep (when_expire, cacheRemovals, mapRemovals, tracked);
+
+    if (m_journal.trace && (mapRemovals || cacheRemovals)) m_journal.trace <<
+        m_name << ": cache = " << tracked << "-" << cacheRemovals <<
+            ", map-=" << mapRemovals;
+}
+
+TreeNodeCache::mapped_ptr
+TreeNodeCache::fetch (key_type const& key, int depth)
+{
+    return shard (key).fetch (key, depth, m_clock.now ());
+}
+
+bool
+TreeNodeCache::contains (key_type const& key) const
+{
+    return shard (key).contains (key);
+}
+
+bool
+TreeNodeCache::canonicalize (key_type const& key, mapped_ptr& data,
+    bool replace)
+{
+    return shard (key).canonicalize (key, data, replace, m_clock.now ());
+}
+
+std::vector <TreeNodeCache::key_type>
+TreeNodeCache::getKeys () const
+{
+    std::vector <key_type> v;
+    for (auto const& shard : m_shards)
+        shard.getKeys (v);
+    return v;
+}
+
+TreeNodeCache::Shard&
+TreeNodeCache::shard (key_type const& key)
+{
+    // The sketch and the hash map use the other bytes of the key
+    return m_shards[key.data ()[key.size () - 1] % shardCount];
+}
+
+TreeNodeCache::Shard const&
+TreeNodeCache::shard (key_type const& key) const
+{
+    return m_shards[key.data ()[key.size () - 1] % shardCount];
+}
+
+// The node, its map entry and the map's bucket
+std::uint32_t
+TreeNodeCache::entryBytes (cache_type::value_type const& v)
+{
+    return static_cast<std::uint32_t> (nodeBytes (*v.second.ptr) +
+        sizeof (cache_type::value_type) + 3 * sizeof (void*));
+}
+
+//------------------------------------------------------------------------------
+
+void
+TreeNodeCache::Shard::setTargetBytes (std::size_t bytes)
+{
+    std::vector <mapped_ptr> stuffToSweep;
+    std::lock_guard<std::mutex> lock (m_mutex);
+
+    m_target_bytes = bytes;
+    m_sketch.resize (m_target_bytes / typicalNodeBytes);
+    evict (stuffToSweep);
+}
+
+int
+TreeNodeCache::Shard::getCacheSize () const
+{
+    std::lock_guard<std::mutex> lock (m_mutex);
+    return m_cache_count;
+}
+
+std::size_t
+TreeNodeCache::Shard::getTrackSize () const
+{
+    std::lock_guard<std::mutex> lock (m_mutex);
+    return m_cache.size ();
+}
+
+std::size_t
+TreeNodeCache::Shard::getCacheBytes () const
+{
+    std::lock_guard<std::mutex> lock (m_mutex);
+    return m_window_bytes + m_probation_bytes + m_protected_bytes;
+}
+
+void
+TreeNodeCache::Shard::addStats (Stats& stats, Counts& total) const
+{
+    auto add = [](Counts& to, Counts const& from)
+    {
+        to.hits += from.hits;
+        to.misses += from.misses;
+    };
+
+    std::lock_guard<std::mutex> lock (m_mutex);
+
+    add (stats.inner, m_inner);
+    add (stats.leaf, m_leaf);
+    stats.innerBytes += m_inner_bytes;
+    stats.leafBytes += m_leaf_bytes;
+    total.hits += m_hits;
+    total.misses += m_misses;
+
+    stats.depths.resize (m_depths.size ());
+    for (std::size_t i = 0; i < m_depths.size (); ++i)
+        add (stats.depths[i], m_depths[i]);
+}
+
+void
+TreeNodeCache::Shard::clearStats ()
+{
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_hits = 0;
+    m_misses = 0;
+    m_inner = Counts ();
+    m_leaf = Counts ();
+    m_depths.fill (Counts ());
+}
+
+void
+TreeNodeCache::Shard::clear ()
+{
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_window.clear ();
+    m_probation.clear ();
+    m_protected.clear ();
+    m_cache.clear ();
+    m_sketch.clear ();
+    m_window_bytes = 0;
+    m_probation_bytes = 0;
+    m_protected_bytes = 0;
+    m_inner_bytes = 0;
+    m_leaf_bytes = 0;
+    m_cache_count = 0;
+}
+
+void
+TreeNodeCache::Shard::sweep (clock_type::time_point const& when_expire,
+    int& cacheRemovals, int& mapRemovals, std::size_t& tracked)
+{
+    // Keep references to all the stuff we sweep
+    // so that we can destroy them outside the lock.
+    std::vector <mapped_ptr> stuffToSweep;
+    std::lock_guard<std::mutex> lock (m_mutex);
+
+    stuffToSweep.reserve (m_cache_count);
+
+    auto cit = m_cache.begin ();
+    while (cit != m_cache.end ())
+    {
+        Entry& entry = cit->second;
+
+        if (! entry.isCached ())
+        {
+            if (entry.isExpired ())
+            {
+                ++mapRemovals;
+                cit = m_cache.erase (cit);
+            }
+            else
+            {
+                ++cit;
+            }
+        }
+        else if (entry.last_access <= when_expire)
+        {
+            ++cacheRemovals;
+            unlink (entry);
+            if (entry.ptr.unique ())
+            {
+                stuffToSweep.push_back (std::move (entry.ptr));
+                ++mapRemovals;
+                cit = m_cache.erase (cit);
+            }
+            else
+            {
+                // remains weakly cached
+                entry.ptr.reset ();
+                ++cit;
+            }
+        }
+        else
+        {
+            ++cit;
+        }
+    }
+
+    tracked += m_cache.size ();
+}
+
+TreeNodeCache::mapped_ptr
+TreeNodeCache::Shard::fetch (key_type const& key, int depth,
+    clock_type::time_point const& now)
+{
+    std::vector <mapped_ptr> stuffToSweep;
+    std::lock_guard<std::mutex> lock (m_mutex);
+
+    auto cit = m_cache.find (key);
+
+    if (cit == m_cache.end ())
+    {
+        recordMiss (depth);
+        return mapped_ptr ();
+    }
+
+    Entry& entry = cit->second;
+
+    if (entry.isCached ())
+    {
+        record (entry, depth);
+        touch (entry, now);
+        return entry.ptr;
+    }
+
+    mapped_ptr ret = entry.weak_ptr.lock ();
+
+    if (ret)
+    {
+        // independent of cache size, so not counted as a hit
+        entry.ptr = ret;
+        entry.last_access = now;
+        insert (cit);
+        evict (stuffToSweep);
+        return ret;
+    }
+
+    m_cache.erase (cit);
+    recordMiss (depth);
+    return mapped_ptr ();
+}
+
+bool
+TreeNodeCache::Shard::contains (key_type const& key) const
+{
+    std::lock_guard<std::mutex> lock (m_mutex);
+
+    auto cit = m_cache.find (key);
+    return cit != m_cache.end () &&
+        (cit->second.isCached () || ! cit->second.isExpired ());
+}
+
+bool
+TreeNodeCache::Shard::canonicalize (key_type const& key, mapped_ptr& data,
+    bool replace, clock_type::time_point const& now)
+{
+    std::vector <mapped_ptr> stuffToSweep;
+    std::lock_guard<std::mutex> lock (m_mutex);
+
+    auto cit = m_cache.find (key);
+
+    if (cit == m_cache.end ())
+    {
+        cit = m_cache.emplace (std::piecewise_construct,
+            std::forward_as_tuple (key),
+            std::forward_as_tuple (now, data)).first;
+        ++(data->isInner () ? m_inner : m_leaf).misses;
+        insert (cit);
+        evict (stuffToSweep);
+        return false;
+    }
+
+    Entry& entry = cit->second;
+
+    if (entry.isCached ())
+    {
+        touch (entry, now);
+
+        if (replace)
+        {
+            // The new node may be bigger, smaller or of another kind
+            (entry.ptr->isInner () ? m_inner_bytes : m_leaf_bytes) -=
+                entry.bytes;
+            bytes (entry.segment) -= entry.bytes;
+
+            entry.ptr = data;
+            entry.weak_ptr = data;
+            entry.bytes = entryBytes (*cit);
+
+            (entry.ptr->isInner () ? m_inner_bytes : m_leaf_bytes) +=
+                entry.bytes;
+            bytes (entry.segment) += entry.bytes;
+            evict (stuffToSweep);
+        }
+        else
+        {
+            data = entry.ptr;
+        }
+
+        return true;
+    }
+
+    mapped_ptr cachedData = entry.weak_ptr.lock ();
+    bool const found = cachedData != nullptr;
+
+    if (found && !replace)
+    {
+        data = std::move (cachedData);
+    }
+    else if (! found)
+    {
+        ++(data->isInner () ? m_inner : m_leaf).misses;
+    }
+
+    entry.ptr = data;
+    entry.weak_ptr = data;
+    entry.last_access = now;
+    insert (cit);
+    evict (stuffToSweep);
+
+    return found;
+}
+
+void
+TreeNodeCache::Shard::getKeys (std::vector <key_type>& keys) const
+{
+    std::lock_guard<std::mutex> lock (m_mutex);
+    keys.reserve (keys.size () + m_cache.size ());
+    for (auto const& _ : m_cache)
+        keys.push_back (_.first);
+}
+
+//------------------------------------------------------------------------------
+
+TreeNodeCache::List&
+TreeNodeCache::Shard::list (Segment segment)
+{
+    switch (segment)
+    {
+    case Segment::window:
+        return m_window;
+    case Segment::probation:
+        return m_probation;
+    default:
+        assert (segment == Segment::protect);
+        return m_protected;
+    }
+}
+
+std::size_t&
+TreeNodeCache::Shard::bytes (Segment segment)
+{
+    switch (segment)
+    {
+    case Segment::window:
+        return m_window_bytes;
+    case Segment::probation:
+        return m_probation_bytes;
+    default:
+        assert (segment == Segment::protect);
+        return m_protected_bytes;
+    }
+}
+
+// A node the cache did not hold starts out in the window
+void
+TreeNodeCache::Shard::insert (cache_iterator cit)
+{
+    Entry& entry = cit->second;
+    assert (entry.isCached () && (entry.segment == Segment::none));
+
+    entry.key = &cit->first;
+    entry.bytes = entryBytes (*cit);
+    entry.segment = Segment::window;
+    m_window.push_back (entry);
+    m_window_bytes += entry.bytes;
+    (entry.ptr->isInner () ? m_inner_bytes : m_leaf_bytes) += entry.bytes;
+    ++m_cache_count;
+
+    m_sketch.increment (cit->first);
+}
+
+void
+TreeNodeCache::Shard::touch (Entry& entry, clock_type::time_point const& now)
+{
+    entry.last_access = now;
+    m_sketch.increment (*entry.key);
+
+    if (entry.segment == Segment::probation)
+    {
+        // Used again while in the main cache
+        m_probation.erase (m_probation.iterator_to (entry));
+        m_probation_bytes -= entry.bytes;
+        entry.segment = Segment::protect;
+        m_protected.push_back (entry);
+        m_protected_bytes += entry.bytes;
+
+        auto const mainBytes = m_target_bytes -
+            (m_target_bytes * windowPercent / 100);
+        auto const protectedBytes = mainBytes * protectedPercent / 100;
+        while (m_protected_bytes > protectedBytes)
+        {
+            Entry& demoted = m_protected.front ();
+            m_protected.pop_front ();
+            m_protected_bytes -= demoted.bytes;
+            demoted.segment = Segment::probation;
+            m_probation.push_back (demoted);
+            m_probation_bytes += demoted.bytes;
+        }
+        return;
+    }
+
+    auto& segment = list (entry.segment);
+    segment.erase (segment.iterator_to (entry));
+    segment.push_back (entry);
+}
+
+// The cache no longer holds the node
+void
+TreeNodeCache::Shard::unlink (Entry& entry)
+{
+    assert (entry.isCached () && (entry.segment != Segment::none));
+
+    auto& segment = list (entry.segment);
+    segment.erase (segment.iterator_to (entry));
+    bytes (entry.segment) -= entry.bytes;
+    (entry.ptr->isInner () ? m_inner_bytes : m_leaf_bytes) -= entry.bytes;
+    entry.segment = Segment::none;
+    --m_cache_count;
+}
+
+void
+TreeNodeCache::Shard::release (cache_iterator cit,
+    std::vector <mapped_ptr>& stuffToSweep)
+{
+    Entry& entry = cit->second;
+    unlink (entry);
+
+    if (entry.ptr.unique ())
+    {
+        stuffToSweep.push_back (std::move (entry.ptr));
+        m_cache.erase (cit);
+    }
+    else
+    {
+        // remains weakly cached
+        entry.ptr.reset ();
+    }
+}
+
+// Bring the cache back within its budget. A node leaving the window only
+// gets into the main cache if there is room, or if it was asked for more
+// often than the node it would push out.
+void
+TreeNodeCache::Shard::evict (std::vector <mapped_ptr>& stuffToSweep)
+{
+    auto const windowBytes = m_target_bytes * windowPercent / 100;
+    auto const mainBytes = m_target_bytes - windowBytes;
+
+    auto release = [this, &stuffToSweep](Entry& entry)
+    {
+        this->release (m_cache.find (*entry.key), stuffToSweep);
+    };
+
+    while (m_window_bytes > windowBytes)
+    {
+        Entry& candidate = m_window.front ();
+
+        if (m_probation_bytes + m_protected_bytes + candidate.bytes <=
+            mainBytes)
+        {
+            m_window.pop_front ();
+            m_window_bytes -= candidate.bytes;
+            candidate.segment = Segment::probation;
+            m_probation.push_back (candidate);
+            m_probation_bytes += candidate.bytes;
+            continue;
+        }
+
+        auto& victims = m_probation.empty () ? m_protected : m_probation;
+        if (victims.empty ())
+        {
+            // Too big for the main cache
+            release (candidate);
+            continue;
+        }
+
+        Entry& victim = victims.front ();
+        if (m_sketch.estimate (*candidate.key) >
+                m_sketch.estimate (*victim.key))
+            release (victim);
+        else
+            release (candidate);
+    }
+
+    // The budget may have been lowered
+    while (m_probation_bytes + m_protected_bytes > mainBytes)
+        release (m_probation.empty () ?
+            m_protected.front () : m_probation.front ());
+}
+
+void
+TreeNodeCache::Shard::record (Entry const& entry, int depth)
+{
+    ++m_hits;
+    ++(entry.ptr->isInner () ? m_inner : m_leaf).hits;
+    if (depth >= 0)
+        ++m_depths[std::min (depth, maxTrackedDepth)].hits;
+}
+
+void
+TreeNodeCache::Shard::recordMiss (int depth)
+{
+    ++m_misses;
+    if (depth >= 0)
+        ++m_depths[std::min (depth, maxTrackedDepth)].misses;
+}
+
+} // ripple
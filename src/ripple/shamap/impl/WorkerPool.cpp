@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/impl/WorkerPool.h>
+#include <beast/threads/Thread.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace ripple {
+
+namespace {
+
+// One call to run, shared with the pool threads it asked for help. A
+// request still queued when the walk is over finds it closed and leaves.
+struct Walk
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool closed = false;
+    int running = 0;
+
+    std::atomic<std::size_t> next {0};
+    std::exception_ptr error;
+
+    void
+    work (std::size_t count, std::function<void (std::size_t)> const& f)
+    {
+        try
+        {
+            for (auto i = next++; i < count; i = next++)
+                f (i);
+        }
+        catch (...)
+        {
+            next = count;
+            std::lock_guard<std::mutex> lock (mutex);
+            if (!error)
+                error = std::current_exception ();
+        }
+    }
+};
+
+}
+
+WorkerPool::WorkerPool (std::string const& name, int threads)
+{
+    threads_.reserve (std::max (threads, 0));
+    for (int i = 0; i < threads; ++i)
+    {
+        threads_.emplace_back (&WorkerPool::loop, this,
+            name + " #" + std::to_string (i + 1));
+    }
+}
+
+WorkerPool::~WorkerPool ()
+{
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all ();
+
+    for (auto& thread : threads_)
+        thread.join ();
+}
+
+void
+WorkerPool::loop (std::string const& name)
+{
+    beast::Thread::setCurrentThreadName (name);
+
+    for (;;)
+    {
+        std::function<void ()> task;
+        {
+            std::unique_lock<std::mutex> lock (mutex_);
+            cond_.wait (lock, [this] { return stop_ || !tasks_.empty (); });
+            if (stop_)
+                return;
+            task = std::move (tasks_.front ());
+            tasks_.pop_front ();
+        }
+        task ();
+    }
+}
+
+void
+WorkerPool::run (int threadLimit, std::size_t count,
+    std::function<void (std::size_t)> const& work)
+{
+    auto const helpers = std::min<std::size_t> ({
+        static_cast<std::size_t> (std::max (threadLimit, 1)) - 1,
+        count > 0 ? count - 1 : 0,
+        threads_.size ()});
+
+    auto const walk = std::make_shared<Walk> ();
+
+    if (helpers > 0)
+    {
+        auto const help = [walk, count, f = &work]()
+        {
+            {
+                std::lock_guard<std::mutex> lock (walk->mutex);
+                if (walk->closed)
+                    return;
+                ++walk->running;
+            }
+
+            walk->work (count, *f);
+
+            std::lock_guard<std::mutex> lock (walk->mutex);
+            if (--walk->running == 0)
+                walk->cond.notify_all ();
+        };
+
+        {
+            std::lock_guard<std::mutex> lock (mutex_);
+            for (std::size_t i = 0; i < helpers; ++i)
+                tasks_.emplace_back (help);
+        }
+        cond_.notify_all ();
+    }
+
+    walk->work (count, work);
+
+    {
+        std::unique_lock<std::mutex> lock (walk->mutex);
+        walk->closed = true;
+        walk->cond.wait (lock, [&walk] { return walk->running == 0; });
+    }
+
+    if (walk->error)
+        std::rethrow_exception (walk->error);
+}
+
+}
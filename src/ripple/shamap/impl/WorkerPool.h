@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_SHAMAP_WORKERPOOL_H_INCLUDED
+#define RIPPLE_SHAMAP_WORKERPOOL_H_INCLUDED
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ripple {
+
+/** A fixed set of threads shared by the parallel walks of every SHAMap.
+
+    The threads are started with the pool and live until it is destroyed,
+    so flushing or comparing a map does not pay for creating threads, and
+    however many maps do so at once no more than this many threads help.
+*/
+class WorkerPool
+{
+public:
+    WorkerPool (std::string const& name, int threads);
+    ~WorkerPool ();
+
+    WorkerPool (WorkerPool const&) = delete;
+    WorkerPool& operator= (WorkerPool const&) = delete;
+
+    /** Call work with each index below count.
+
+        The calling thread does the work along with up to threadLimit - 1
+        pool threads. A pool thread busy elsewhere is not waited for, so a
+        walk run from a pool thread can not deadlock. The first exception
+        stops the threads taking more work and is rethrown once they have
+        all finished.
+    */
+    void
+    run (int threadLimit, std::size_t count,
+        std::function<void (std::size_t)> const& work);
+
+    std::size_t
+    size () const
+    {
+        return threads_.size ();
+    }
+
+private:
+    void
+    loop (std::string const& name);
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::function<void ()>> tasks_;
+    bool stop_ = false;
+    std::vector<std::thread> threads_;
+};
+
+}
+
+#endif
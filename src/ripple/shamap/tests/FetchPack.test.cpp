@@ -83,14 +83,13 @@ public:
         beast::Journal mJournal;
     };
 
-    std::shared_ptr <Item>
+    std::shared_ptr <Item const>
     make_random_item (beast::Random& r)
     {
         Serializer s;
         for (int d = 0; d < 3; ++d)
             s.add32 (r.nextInt ());
-        return std::make_shared <Item> (
-            s.getSHA512Half(), s.peekData ());
+        return make_shamapitem (s.getSHA512Half(), s.peekData ());
     }
 
     void
@@ -98,7 +97,7 @@ public:
     {
         while (n--)
         {
-            std::shared_ptr <SHAMapItem> item (
+            std::shared_ptr <SHAMapItem const> item (
                 make_random_item (r));
             auto const result (t.addItem (*item, false, false));
             assert (result);
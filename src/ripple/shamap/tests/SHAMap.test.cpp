@@ -62,27 +62,30 @@ public:
         h5.SetHex ("a92891fe4ef6cee585fdc6fda0e09eb4d386363158ec3321b8123e5a772c6ca7");
 
         SHAMap sMap (SHAMapType::FREE, f);
-        SHAMapItem i1 (h1, IntToVUC (1)), i2 (h2, IntToVUC (2)), i3 (h3, IntToVUC (3)), i4 (h4, IntToVUC (4)), i5 (h5, IntToVUC (5));
-        unexpected (!sMap.addItem (i2, true, false), "no add");
-        unexpected (!sMap.addItem (i1, true, false), "no add");
+        auto i1 = make_shamapitem (h1, IntToVUC (1));
+        auto i2 = make_shamapitem (h2, IntToVUC (2));
+        auto i3 = make_shamapitem (h3, IntToVUC (3));
+        auto i4 = make_shamapitem (h4, IntToVUC (4));
+        unexpected (!sMap.addGiveItem (i2, true, false), "no add");
+        unexpected (!sMap.addGiveItem (i1, true, false), "no add");
 
         auto i = sMap.begin();
         auto e = sMap.end();
-        unexpected (i == e || (*i != i1), "bad traverse");
+        unexpected (i == e || (*i != *i1), "bad traverse");
         ++i;
-        unexpected (i == e || (*i != i2), "bad traverse");
+        unexpected (i == e || (*i != *i2), "bad traverse");
         ++i;
         unexpected (i != e, "bad traverse");
-        sMap.addItem (i4, true, false);
-        sMap.delItem (i2.key());
-        sMap.addItem (i3, true, false);
+        sMap.addGiveItem (i4, true, false);
+        sMap.delItem (i2->key());
+        sMap.addGiveItem (i3, true, false);
         i = sMap.begin();
         e = sMap.end();
-        unexpected (i == e || (*i != i1), "bad traverse");
+        unexpected (i == e || (*i != *i1), "bad traverse");
         ++i;
-        unexpected (i == e || (*i != i3), "bad traverse");
+        unexpected (i == e || (*i != *i3), "bad traverse");
         ++i;
-        unexpected (i == e || (*i != i4), "bad traverse");
+        unexpected (i == e || (*i != *i4), "bad traverse");
         ++i;
         unexpected (i != e, "bad traverse");
 
@@ -122,8 +125,8 @@ public:
             expect (map.getHash() == zero, "bad initial empty map hash");
             for (int i = 0; i < keys.size(); ++i)
             {
-                SHAMapItem item (keys[i], IntToVUC (i));
-                map.addItem (item, true, false);
+                map.addGiveItem (make_shamapitem (keys[i], IntToVUC (i)),
+                    true, false);
                 expect (map.getHash().as_uint256() == hashes[i], "bad buildup map hash");
             }
             for (int i = keys.size() - 1; i >= 0; --i)
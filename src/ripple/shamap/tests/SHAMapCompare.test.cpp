@@ -0,0 +1,170 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/SHAMap.h>
+#include <ripple/shamap/tests/common.h>
+#include <ripple/protocol/digest.h>
+#include <beast/unit_test/suite.h>
+#include <set>
+
+namespace ripple {
+namespace tests {
+
+class SHAMapCompare_test : public beast::unit_test::suite
+{
+    static
+    std::shared_ptr<SHAMapItem const>
+    makeItem (std::uint32_t i, std::uint32_t version)
+    {
+        Serializer s;
+        s.add32 (i);
+        s.add32 (version);
+        s.add32 (~i);
+        return make_shamapitem (
+            sha512Half (i), s.peekData ());
+    }
+
+    // Nodes visited by visitDifferences, by hash
+    static
+    std::set<uint256>
+    visited (SHAMap const& map, SHAMap* have)
+    {
+        std::set<uint256> hashes;
+        map.visitDifferences (have,
+            [&hashes](SHAMapAbstractNode& node)
+            {
+                hashes.insert (node.getNodeHash ().as_uint256 ());
+                return true;
+            });
+        return hashes;
+    }
+
+public:
+    void
+    run()
+    {
+        beast::Journal const j;
+        TestFamily f (j);
+
+        std::uint32_t const count = 20000;
+
+        auto first = std::make_shared<SHAMap> (SHAMapType::STATE, f);
+        for (std::uint32_t i = 0; i < count; ++i)
+            first->addGiveItem (makeItem (i, 1), false, false);
+        first->flushDirty (hotACCOUNT_NODE, 1);
+
+        // Change, remove and add items all over the second map
+        auto second = first->snapShot (true);
+        SHAMap::Delta expected;
+        for (std::uint32_t i = 0; i < count; i += 3)
+        {
+            auto item = makeItem (i, 2);
+            expected[item->key ()] = {makeItem (i, 1), item};
+            second->updateGiveItem (std::move (item), false, false);
+        }
+        for (std::uint32_t i = 1; i < count; i += 7)
+        {
+            auto item = makeItem (i, 1);
+            expected[item->key ()] = {item, nullptr};
+            second->delItem (item->key ());
+        }
+        for (std::uint32_t i = count; i < count + 500; ++i)
+        {
+            auto item = makeItem (i, 1);
+            expected[item->key ()] = {nullptr, item};
+            second->addGiveItem (std::move (item), false, false);
+        }
+        second->flushDirty (hotACCOUNT_NODE, 2);
+        second->setImmutable ();
+        first->setImmutable ();
+
+        auto same = [](SHAMap::Delta const& a, SHAMap::Delta const& b)
+        {
+            return std::equal (a.begin (), a.end (), b.begin (), b.end (),
+                [](SHAMap::Delta::value_type const& x,
+                   SHAMap::Delta::value_type const& y)
+                {
+                    auto data = [](std::shared_ptr<SHAMapItem const> const& p)
+                    {
+                        return p ? p->slice () : Slice ();
+                    };
+                    return (x.first == y.first) &&
+                        (bool (x.second.first) == bool (y.second.first)) &&
+                        (bool (x.second.second) == bool (y.second.second)) &&
+                        (data (x.second.first) == data (y.second.first)) &&
+                        (data (x.second.second) == data (y.second.second));
+                });
+        };
+
+        auto const differences = visited (*second, first.get ());
+
+        for (int threads : {1, 4})
+        {
+            testcase ("compare with " + std::to_string (threads) + " threads");
+
+            first->setCompareThreads (threads);
+            second->setCompareThreads (threads);
+
+            SHAMap::Delta delta;
+            expect (first->compare (*second, delta, count * 2));
+            expect (same (delta, expected));
+
+            // The same differences, the other way around
+            SHAMap::Delta reverse;
+            expect (second->compare (*first, reverse, count * 2));
+            expect (reverse.size () == expected.size ());
+
+            // Stops after the limit
+            SHAMap::Delta limited;
+            expect (! first->compare (*second, limited, 1000));
+            expect (limited.size () == 1000);
+
+            // Streaming
+            std::size_t streamed = 0;
+            expect (first->compare (*second,
+                [&](std::shared_ptr<SHAMapItem const> const& ours,
+                    std::shared_ptr<SHAMapItem const> const& other)
+                {
+                    auto const iter = expected.find (
+                        (ours ? ours : other)->key ());
+                    expect (iter != expected.end ());
+                    ++streamed;
+                }, count * 2));
+            expect (streamed == expected.size ());
+
+            expect (visited (*second, first.get ()) == differences);
+            expect (visited (*second, nullptr).size () > differences.size ());
+
+            // Stops once the visitor does
+            int visits = 0;
+            second->visitDifferences (first.get (),
+                [&visits](SHAMapAbstractNode&)
+                {
+                    return ++visits < 100;
+                });
+            expect (visits == 100);
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SHAMapCompare,shamap,ripple);
+
+} // tests
+} // ripple
@@ -0,0 +1,159 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/SHAMap.h>
+#include <ripple/shamap/tests/common.h>
+#include <ripple/basics/Log.h>
+#include <ripple/core/JobQueue.h>
+#include <ripple/protocol/digest.h>
+#include <beast/insight/NullCollector.h>
+#include <beast/threads/Stoppable.h>
+#include <beast/unit_test/suite.h>
+#include <condition_variable>
+#include <mutex>
+
+namespace ripple {
+namespace tests {
+
+// Walk cold maps from many coroutines that a single job thread serves
+class SHAMapCoro_test : public beast::unit_test::suite
+{
+    Logs logs_;
+    beast::RootStoppable root_ {"test"};
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    int finished_ = 0;
+
+    void
+    finish ()
+    {
+        std::lock_guard <std::mutex> lock (mutex_);
+        ++finished_;
+        cond_.notify_all ();
+    }
+
+    bool
+    wait (int count)
+    {
+        std::unique_lock <std::mutex> lock (mutex_);
+        return cond_.wait_for (lock, std::chrono::seconds (30),
+            [this, count] { return finished_ >= count; });
+    }
+
+    // Jobs of the coroutines' type that ran, counting each resume
+    static
+    unsigned
+    clientJobs (JobQueue& jq)
+    {
+        auto const json = jq.getJson ();
+        for (auto const& pri : json["job_types"])
+        {
+            if (pri["job_type"] == "clientCommand")
+                return pri["run_us"]["count"].asUInt ();
+        }
+        return 0;
+    }
+
+public:
+    void
+    run ()
+    {
+        beast::Journal const j;
+        SHAMapHash hash;
+        std::size_t expected = 0;
+        {
+            TestFamily f (j);
+            SHAMap source (SHAMapType::STATE, f);
+            for (std::uint32_t i = 0; i < 2000; ++i)
+            {
+                Serializer s;
+                for (int k = 0; k < 5; ++k)
+                    s.add32 (i);
+                source.addGiveItem (make_shamapitem (
+                    sha512Half (i, 5), s.peekData ()), false, false);
+            }
+            source.flushDirty (hotACCOUNT_NODE, 1);
+            hash = source.getHash ();
+            for (auto const& item : source)
+                expected += item.key ().begin ()[0];
+        }
+
+        // Another family on the same backend starts with empty caches
+        TestFamily f (j);
+
+        logs_.severity (beast::Journal::kError);
+        JobQueue jq (beast::insight::NullCollector::New (), root_,
+            logs_.journal ("JobQueue"), logs_);
+        jq.setThreadCount (1, false);
+        jq.setReservedThreadCount (0);
+
+        int const walks = 16;
+        std::vector <std::size_t> sums (walks, 0);
+        bool missing = true;
+
+        for (int i = 0; i < walks; ++i)
+        {
+            jq.postCoro (jtCLIENT, "walk",
+                [&, i](std::shared_ptr<JobCoro> coro)
+                {
+                    JobCoro::AsyncReads const reads (coro);
+
+                    SHAMap map (SHAMapType::STATE, hash.as_uint256 (), f);
+                    if (map.fetchRoot (hash, nullptr))
+                    {
+                        map.visitLeaves (
+                            [&sums, i](std::shared_ptr<SHAMapItem const> const& item)
+                            {
+                                sums[i] += item->key ().begin ()[0];
+                            });
+                    }
+                    finish ();
+                });
+        }
+
+        // A node the database does not have is reported as missing
+        jq.postCoro (jtCLIENT, "missing",
+            [&](std::shared_ptr<JobCoro> coro)
+            {
+                JobCoro::AsyncReads const reads (coro);
+
+                auto const absent = SHAMapHash (sha512Half (walks));
+                SHAMap map (SHAMapType::STATE, absent.as_uint256 (), f);
+                missing = ! map.fetchRoot (absent, nullptr);
+                finish ();
+            });
+
+        expect (wait (walks + 1));
+        for (auto const sum : sums)
+            expect (sum == expected);
+        expect (missing);
+
+        // Coroutines gave up the thread while their reads were pending
+        expect (clientJobs (jq) > walks + 1);
+
+        jq.shutdown ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SHAMapCoro,shamap,ripple);
+
+} // tests
+} // ripple
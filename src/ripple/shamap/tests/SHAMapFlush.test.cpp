@@ -0,0 +1,201 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/SHAMap.h>
+#include <ripple/shamap/tests/common.h>
+#include <ripple/protocol/digest.h>
+#include <beast/unit_test/suite.h>
+#include <chrono>
+
+namespace ripple {
+namespace tests {
+
+// Items with keys and contents fixed by their index, so that maps built
+// in different families come out the same. Version 1 adds the item, any
+// later version replaces it.
+static
+std::shared_ptr<SHAMapItem const>
+makeFlushItem (std::uint32_t i, std::uint32_t version)
+{
+    Serializer s;
+    s.add32 (i);
+    s.add32 (version);
+    s.add32 (~i);
+    return make_shamapitem (
+        sha512Half (i), s.peekData ());
+}
+
+static
+void
+fillFlushMap (SHAMap& map, std::uint32_t count, std::uint32_t version)
+{
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        if (version == 1)
+            map.addGiveItem (makeFlushItem (i, version), false, false);
+        else
+            map.updateGiveItem (makeFlushItem (i, version), false, false);
+    }
+}
+
+class SHAMapFlush_test : public beast::unit_test::suite
+{
+    // Everything a flush wrote can be read back without the cache
+    bool
+    stored (TestFamily& f, SHAMapHash const& hash, std::size_t count)
+    {
+        f.treecache ().clear ();
+
+        SHAMap map (SHAMapType::STATE, hash.as_uint256 (), f);
+        if (!map.fetchRoot (hash, nullptr))
+            return false;
+
+        std::vector<SHAMapMissingNode> missing;
+        map.walkMap (missing, 1);
+        if (!missing.empty ())
+            return false;
+
+        return static_cast<std::size_t> (
+            std::distance (map.begin (), map.end ())) == count;
+    }
+
+    void
+    testParallel()
+    {
+        testcase ("parallel matches serial");
+
+        beast::Journal const j;
+        TestFamily serialFamily (j);
+        TestFamily parallelFamily (j);
+
+        std::uint32_t const count = 20000;
+
+        SHAMapHash serialHash;
+        SHAMapHash parallelHash;
+        {
+            auto serial = std::make_shared<SHAMap> (SHAMapType::STATE, serialFamily);
+            auto parallel = std::make_shared<SHAMap> (SHAMapType::STATE, parallelFamily);
+            serial->setFlushThreads (1);
+            parallel->setFlushThreads (4);
+
+            fillFlushMap (*serial, count, 1);
+            fillFlushMap (*parallel, count, 1);
+
+            expect (serial->flushDirty (hotACCOUNT_NODE, 1) ==
+                parallel->flushDirty (hotACCOUNT_NODE, 1));
+            expect (serial->getHash () == parallel->getHash ());
+            expect (serialFamily.db ().getStoreCount () ==
+                parallelFamily.db ().getStoreCount ());
+
+            // Modify a snapshot, so that shared nodes are copied first
+            serial = serial->snapShot (true);
+            parallel = parallel->snapShot (true);
+
+            fillFlushMap (*serial, count / 2, 2);
+            fillFlushMap (*parallel, count / 2, 2);
+
+            expect (serial->flushDirty (hotACCOUNT_NODE, 2) ==
+                parallel->flushDirty (hotACCOUNT_NODE, 2));
+            expect (serial->getHash () == parallel->getHash ());
+            expect (serialFamily.db ().getStoreCount () ==
+                parallelFamily.db ().getStoreCount ());
+
+            serialHash = serial->getHash ();
+            parallelHash = parallel->getHash ();
+        }
+
+        expect (stored (serialFamily, serialHash, count));
+        expect (stored (parallelFamily, parallelHash, count));
+    }
+
+    void
+    testSmall()
+    {
+        testcase ("small maps");
+
+        beast::Journal const j;
+        TestFamily serialFamily (j);
+        TestFamily parallelFamily (j);
+
+        // Too few modified subtrees to start any threads
+        SHAMap serial (SHAMapType::STATE, serialFamily);
+        SHAMap parallel (SHAMapType::STATE, parallelFamily);
+        serial.setFlushThreads (1);
+        parallel.setFlushThreads (4);
+
+        fillFlushMap (serial, 40, 1);
+        fillFlushMap (parallel, 40, 1);
+
+        expect (serial.flushDirty (hotACCOUNT_NODE, 1) ==
+            parallel.flushDirty (hotACCOUNT_NODE, 1));
+        expect (serial.getHash () == parallel.getHash ());
+        expect (stored (parallelFamily, parallel.getHash (), 40));
+    }
+
+public:
+    void
+    run()
+    {
+        testParallel();
+        testSmall();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SHAMapFlush,shamap,ripple);
+
+//------------------------------------------------------------------------------
+
+// Time flushing a million modified leaves with each thread count
+class SHAMapFlushTiming_test : public beast::unit_test::suite
+{
+public:
+    void
+    run()
+    {
+        using namespace std::chrono;
+
+        std::uint32_t const count = 1000000;
+        beast::Journal const j;
+
+        for (int threads : {1, 2, 4, 8})
+        {
+            TestFamily f (j);
+            SHAMap map (SHAMapType::STATE, f);
+            map.setFlushThreads (threads);
+
+            fillFlushMap (map, count, 1);
+
+            auto const start = steady_clock::now ();
+            auto const flushed = map.flushDirty (hotACCOUNT_NODE, 1);
+            auto const elapsed = duration_cast<milliseconds> (
+                steady_clock::now () - start);
+
+            log << threads << " threads: " << flushed <<
+                " nodes in " << elapsed.count () << "ms, root " <<
+                    map.getHash ();
+            pass ();
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(SHAMapFlushTiming,shamap,ripple);
+
+} // tests
+} // ripple
@@ -0,0 +1,216 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/SHAMap.h>
+#include <ripple/shamap/SHAMapTreeNode.h>
+#include <ripple/shamap/tests/common.h>
+#include <ripple/basics/Slice.h>
+#include <ripple/protocol/digest.h>
+#include <ripple/protocol/HashPrefix.h>
+#include <beast/unit_test/suite.h>
+#include <random>
+
+namespace ripple {
+namespace tests {
+
+class SHAMapInnerNode_test : public beast::unit_test::suite
+{
+    // Branches are added and removed at random, so the node moves between
+    // every sparse size and the dense layout, and back.
+    void
+    testLayout()
+    {
+        testcase ("layout");
+
+        std::mt19937 rng;
+        auto inner = std::make_shared<SHAMapInnerNode> (1);
+        std::shared_ptr<SHAMapAbstractNode> children[16];
+
+        for (int i = 0; i < 20000; ++i)
+        {
+            int const m = rng () % 16;
+            if (rng () % 3 == 0)
+            {
+                inner->setChild (m, nullptr);
+                children[m] = nullptr;
+            }
+            else
+            {
+                // Any inner node with a distinct hash will do
+                auto child = std::make_shared<SHAMapInnerNode> (1);
+                child->setChild (rng () % 16,
+                    std::make_shared<SHAMapInnerNode> (1));
+                child->updateHashDeep ();
+                inner->setChild (m, child);
+                children[m] = child;
+            }
+
+            if (i % 7 != 0)
+                continue;
+
+            inner->updateHashDeep ();
+
+            // The hash covers all 16 branches, empty ones as zero
+            uint256 hashes[16];
+            int count = 0;
+            for (int b = 0; b < 16; ++b)
+            {
+                if (children[b])
+                {
+                    hashes[b] = children[b]->getNodeHash ().as_uint256 ();
+                    ++count;
+                }
+            }
+            uint256 expected;
+            if (count != 0)
+                expected = sha512Half (HashPrefix::innerNode,
+                    Slice (reinterpret_cast<unsigned char const*> (hashes),
+                        sizeof (hashes)));
+
+            expect (inner->getNodeHash ().as_uint256 () == expected);
+            expect (inner->getBranchCount () == count);
+
+            auto const copy = std::static_pointer_cast<SHAMapInnerNode> (
+                inner->clone (2));
+            for (int b = 0; b < 16; ++b)
+            {
+                expect (inner->isEmptyBranch (b) == !children[b]);
+                expect (inner->getChild (b) == children[b]);
+                expect (inner->getChildHash (b).as_uint256 () == hashes[b]);
+                expect (copy->getChild (b) == children[b]);
+                expect (copy->getChildHash (b) == inner->getChildHash (b));
+            }
+
+            if (count == 0)
+                continue;
+
+            for (auto format : {snfWIRE, snfPREFIX})
+            {
+                Serializer s;
+                inner->addRaw (s, format);
+                auto const node = SHAMapAbstractNode::make (s.peekData (),
+                    0, format, SHAMapHash (), false, beast::Journal ());
+                expect (node->getNodeHash () == inner->getNodeHash ());
+            }
+        }
+    }
+
+    void
+    testCanonicalize()
+    {
+        testcase ("canonicalize");
+
+        auto child = std::make_shared<SHAMapInnerNode> (1);
+        child->setChild (3, std::make_shared<SHAMapInnerNode> (1));
+        child->updateHashDeep ();
+
+        auto inner = std::make_shared<SHAMapInnerNode> (1);
+        inner->setChild (9, child);
+        inner->updateHashDeep ();
+
+        // Read back without children, as a fetched node would be
+        Serializer s;
+        inner->addRaw (s, snfPREFIX);
+        auto const node = std::static_pointer_cast<SHAMapInnerNode> (
+            SHAMapAbstractNode::make (s.peekData (), 0, snfPREFIX,
+                inner->getNodeHash (), true, beast::Journal ()));
+
+        expect (node->getChild (9) == nullptr);
+        expect (node->getChild (8) == nullptr);
+        expect (node->canonicalizeChild (9, child) == child);
+
+        auto const other = child->clone (0);
+        expect (node->canonicalizeChild (9, other) == child);
+        expect (node->getChildPointer (9) == child.get ());
+    }
+
+public:
+    void
+    run()
+    {
+        testLayout();
+        testCanonicalize();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SHAMapInnerNode,shamap,ripple);
+
+//------------------------------------------------------------------------------
+
+// Report the memory held by the inner nodes of a million leaf state map,
+// against what sixteen fixed branches per node would take.
+class SHAMapInnerNodeMemory_test : public beast::unit_test::suite
+{
+public:
+    void
+    run()
+    {
+        std::uint32_t const count = 1000000;
+        beast::Journal const j;
+
+        TestFamily f (j);
+        SHAMap map (SHAMapType::STATE, f);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            Serializer s;
+            s.add32 (i);
+            s.add32 (i);
+            s.add32 (i);
+            map.addGiveItem (make_shamapitem (
+                sha512Half (i), s.peekData ()), false, false);
+        }
+
+        std::size_t inner = 0;
+        std::size_t sparse = 0;
+        std::size_t branches[17] = {};
+        map.visitNodes ([&](SHAMapAbstractNode& node)
+        {
+            if (node.isInner ())
+            {
+                auto const& n = static_cast<SHAMapInnerNode&> (node);
+                ++inner;
+                ++branches[n.getBranchCount ()];
+                sparse += sizeof (SHAMapInnerNode) + n.getBranchBytes ();
+            }
+            return false;
+        });
+
+        // The same node with all sixteen branches held inline, in place
+        // of the pointer to the populated ones
+        std::size_t const dense = inner * (sizeof (SHAMapInnerNode) -
+            sizeof (void*) + 16 * (sizeof (SHAMapHash) +
+                sizeof (std::shared_ptr<SHAMapAbstractNode>)));
+
+        for (int b = 1; b <= 16; ++b)
+        {
+            if (branches[b] != 0)
+                log << b << " branches: " << branches[b];
+        }
+        log << inner << " inner nodes, per million: " <<
+            (dense * 1000000 / inner) << " bytes dense, " <<
+                (sparse * 1000000 / inner) << " bytes sparse";
+        pass ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(SHAMapInnerNodeMemory,shamap,ripple);
+
+} // tests
+} // ripple
@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/SHAMap.h>
+#include <ripple/shamap/SHAMapItem.h>
+#include <ripple/shamap/tests/common.h>
+#include <ripple/protocol/digest.h>
+#include <beast/unit_test/suite.h>
+#include <chrono>
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define RIPPLE_SHAMAPITEM_MALLINFO 1
+#endif
+
+namespace ripple {
+namespace tests {
+
+class SHAMapItem_test : public beast::unit_test::suite
+{
+    static
+    Blob
+    makeData (std::size_t size)
+    {
+        Blob data (size);
+        for (std::size_t i = 0; i < size; ++i)
+            data[i] = static_cast<std::uint8_t> (i * 7);
+        return data;
+    }
+
+    // True if the item's data lies within the item's own block
+    static
+    bool
+    isInline (SHAMapItem const& item)
+    {
+        auto const begin = reinterpret_cast<char const*> (&item);
+        auto const data = static_cast<char const*> (item.data ());
+        return data >= begin + sizeof (SHAMapItem) &&
+            data + item.size () <=
+                begin + sizeof (SHAMapItem) + maxInlineSHAMapItem;
+    }
+
+    void
+    testInline ()
+    {
+        testcase ("inline");
+
+        for (std::size_t size : {0, 1, 31, 32, 33, 136, 200, 255, 256})
+        {
+            auto const key = sha512Half (size);
+            auto const data = makeData (size);
+            auto const item = make_shamapitem (key, makeSlice (data));
+
+            expect (item->key () == key);
+            expect (item->size () == size);
+            expect (item->slice () == makeSlice (data));
+            expect (isInline (*item), std::to_string (size));
+        }
+    }
+
+    void
+    testLarge ()
+    {
+        testcase ("large");
+
+        for (std::size_t size : {257, 1000, 100000})
+        {
+            auto const key = sha512Half (size);
+            auto const data = makeData (size);
+
+            auto const copied = make_shamapitem (key, makeSlice (data));
+            expect (copied->slice () == makeSlice (data));
+            expect (! isInline (*copied));
+
+            // A large blob is taken over rather than copied
+            Blob blob = data;
+            auto const buffer = blob.data ();
+            auto const moved = make_shamapitem (key, std::move (blob));
+            expect (moved->data () == buffer);
+            expect (moved->slice () == makeSlice (data));
+
+            Serializer s (data.data (), data.size ());
+            auto const fromSerializer = make_shamapitem (key, std::move (s));
+            expect (fromSerializer->slice () == makeSlice (data));
+        }
+    }
+
+    void
+    testMap ()
+    {
+        testcase ("map");
+
+        beast::Journal const j;
+        TestFamily f (j);
+        SHAMap map (SHAMapType::STATE, f);
+
+        for (std::size_t size : {40, 136, 200, 300})
+        {
+            auto const item = make_shamapitem (
+                sha512Half (size), makeData (size));
+            expect (map.addItem (*item, false, false));
+
+            auto const found = map.peekItem (item->key ());
+            expect (found && found != item);
+            expect (found->slice () == item->slice ());
+        }
+        map.flushDirty (hotACCOUNT_NODE, 1);
+
+        // Items read back from the database have the same contents
+        f.treecache ().clear ();
+        SHAMap loaded (SHAMapType::STATE, map.getHash ().as_uint256 (), f);
+        expect (loaded.fetchRoot (map.getHash (), nullptr));
+        for (auto const& item : map)
+        {
+            auto const found = loaded.peekItem (item.key ());
+            expect (found && found->slice () == item.slice ());
+        }
+    }
+
+public:
+    void
+    run()
+    {
+        testInline ();
+        testLarge ();
+        testMap ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SHAMapItem,shamap,ripple);
+
+//------------------------------------------------------------------------------
+
+// Time loading a state map of typical ledger entries from the database
+// and report the heap it occupies once loaded
+class SHAMapItemLoad_test : public beast::unit_test::suite
+{
+    static
+    std::size_t
+    heapInUse ()
+    {
+#ifdef RIPPLE_SHAMAPITEM_MALLINFO
+        return mallinfo2 ().uordblks;
+#else
+        return 0;
+#endif
+    }
+
+public:
+    void
+    run()
+    {
+        using namespace std::chrono;
+
+        std::uint32_t const count = 200000;
+        beast::Journal const j;
+        TestFamily f (j);
+
+        SHAMapHash hash;
+        {
+            SHAMap source (SHAMapType::STATE, f);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                // Sized like AccountRoot and RippleState entries
+                Serializer s;
+                for (int k = (i % 3 == 0) ? 50 : 34; k > 0; --k)
+                    s.add32 (i);
+                source.addGiveItem (make_shamapitem (
+                    sha512Half (i), std::move (s)), false, false);
+            }
+            source.flushDirty (hotACCOUNT_NODE, 1);
+            hash = source.getHash ();
+        }
+        f.treecache ().clear ();
+
+        auto const before = heapInUse ();
+        auto const start = steady_clock::now ();
+
+        SHAMap map (SHAMapType::STATE, hash.as_uint256 (), f);
+        expect (map.fetchRoot (hash, nullptr));
+        std::size_t leaves = 0;
+        map.visitLeaves (
+            [&leaves](std::shared_ptr<SHAMapItem const> const&)
+            {
+                ++leaves;
+            });
+
+        auto const elapsed = duration_cast<milliseconds> (
+            steady_clock::now () - start);
+        auto const after = heapInUse ();
+
+        expect (leaves == count);
+        log << leaves << " leaves loaded in " << elapsed.count () << "ms";
+        if (after > before)
+            log << (after - before) / leaves << " heap bytes per leaf";
+        log << "item and payload: 1 block up to " << maxInlineSHAMapItem <<
+            " bytes, 2 blocks above";
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(SHAMapItemLoad,shamap,ripple);
+
+} // tests
+} // ripple
@@ -0,0 +1,101 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/SHAMap.h>
+#include <ripple/shamap/tests/common.h>
+#include <ripple/protocol/digest.h>
+#include <beast/unit_test/suite.h>
+
+namespace ripple {
+namespace tests {
+
+class SHAMapReadAhead_test : public beast::unit_test::suite
+{
+    // Walk a map whose nodes all have to come from the database
+    std::vector<uint256>
+    iterate (TestFamily& f, SHAMapHash const& hash, int readAhead)
+    {
+        f.treecache ().clear ();
+
+        SHAMap map (SHAMapType::STATE, hash.as_uint256 (), f);
+        map.setReadAhead (readAhead);
+        expect (map.fetchRoot (hash, nullptr));
+
+        std::vector<uint256> keys;
+        for (auto const& item : map)
+            keys.push_back (item.key ());
+        return keys;
+    }
+
+    std::vector<uint256>
+    visit (TestFamily& f, SHAMapHash const& hash, int readAhead)
+    {
+        f.treecache ().clear ();
+
+        SHAMap map (SHAMapType::STATE, hash.as_uint256 (), f);
+        map.setReadAhead (readAhead);
+        expect (map.fetchRoot (hash, nullptr));
+
+        std::vector<uint256> keys;
+        map.visitLeaves (
+            [&keys](std::shared_ptr<SHAMapItem const> const& item)
+            {
+                keys.push_back (item->key ());
+            });
+        return keys;
+    }
+
+public:
+    void
+    run()
+    {
+        beast::Journal const j;
+        TestFamily f (j);
+
+        SHAMap source (SHAMapType::STATE, f);
+        for (std::uint32_t i = 0; i < 5000; ++i)
+        {
+            Serializer s;
+            s.add32 (i);
+            s.add32 (i);
+            s.add32 (i);
+            source.addGiveItem (make_shamapitem (
+                sha512Half (i), s.peekData ()), false, false);
+        }
+        source.flushDirty (hotACCOUNT_NODE, 1);
+        auto const hash = source.getHash ();
+
+        std::vector<uint256> expected;
+        for (auto const& item : source)
+            expected.push_back (item.key ());
+
+        for (int readAhead : {0, 1, 4, 16})
+        {
+            testcase ("read ahead " + std::to_string (readAhead));
+            expect (iterate (f, hash, readAhead) == expected);
+            expect (visit (f, hash, readAhead) == expected);
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SHAMapReadAhead,shamap,ripple);
+
+} // tests
+} // ripple
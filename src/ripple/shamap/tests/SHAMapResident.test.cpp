@@ -0,0 +1,141 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#include <BeastConfig.h>
+#include <ripple/shamap/SHAMap.h>
+#include <ripple/shamap/tests/common.h>
+#include <ripple/protocol/digest.h>
+#include <beast/unit_test/suite.h>
+
+namespace ripple {
+namespace tests {
+
+class SHAMapResident_test : public beast::unit_test::suite
+{
+    static
+    std::shared_ptr<SHAMapItem const>
+    makeItem (std::uint32_t key, std::uint32_t value)
+    {
+        Serializer s;
+        s.add32 (key);
+        s.add32 (value);
+        s.add32 (value);
+        s.add32 (value);
+        return make_shamapitem (sha512Half (key), std::move (s));
+    }
+
+    static
+    std::size_t
+    nodes (SHAMapResidentCounts const& counts)
+    {
+        return counts.inner + counts.leaf;
+    }
+
+public:
+    void
+    run()
+    {
+        std::uint32_t const count = 20000;
+        int const versions = 64;
+        int const changes = 10;
+
+        beast::Journal const j;
+        TestFamily f (j);
+
+        // A run of ledgers, each changing a few entries of the last
+        auto map = std::make_shared<SHAMap> (SHAMapType::STATE, f);
+        for (std::uint32_t i = 0; i < count; ++i)
+            map->addGiveItem (makeItem (i, i), false, false);
+        map->flushDirty (hotACCOUNT_NODE, 1);
+
+        std::vector<std::shared_ptr<SHAMap>> held;
+        std::vector<SHAMapHash> hashes;
+        for (int v = 0; v < versions; ++v)
+        {
+            held.push_back (map->snapShot (false));
+            hashes.push_back (held.back ()->getHash ());
+
+            map = map->snapShot (true);
+            for (int k = 0; k < changes; ++k)
+                map->updateGiveItem (makeItem ((v * 97 + k * 13) % count,
+                    v + count), false, false);
+            map->flushDirty (hotACCOUNT_NODE, v + 2);
+        }
+        map.reset ();
+
+        testcase ("shared");
+
+        SHAMapResidentCounts one;
+        held.front ()->countResident (one);
+        expect (one.maps == 1);
+        expect (one.leaf == count);
+        expect (one.shared == 0);
+        expect (one.leafBytes > one.leaf * (sizeof (SHAMapItem) + 16));
+
+        SHAMapResidentCounts all;
+        for (auto const& m : held)
+            m->countResident (all);
+        expect (all.maps == versions);
+        expect (all.leaf == count + (versions - 1) * changes);
+
+        // Each change copies no more than the path down to its leaf
+        expect (nodes (all) > nodes (one));
+        expect (nodes (all) <= nodes (one) + (versions - 1) * changes * 6,
+            std::to_string (nodes (all)) + " nodes held");
+        expect (all.shared >= (versions - 1) * 15);
+
+        testcase ("reloaded");
+
+        // Ledgers loaded again by hash pick up the nodes already in memory,
+        // even once the cache has let go of them and only tracks them.
+        f.treecache ().setTargetBytes (0);
+        f.treecache ().sweep ();
+
+        std::vector<std::shared_ptr<SHAMap>> loaded;
+        for (auto const& hash : hashes)
+        {
+            loaded.push_back (std::make_shared<SHAMap> (
+                SHAMapType::STATE, hash.as_uint256 (), f));
+            expect (loaded.back ()->fetchRoot (hash, nullptr));
+
+            std::size_t leaves = 0;
+            loaded.back ()->visitLeaves (
+                [&leaves](std::shared_ptr<SHAMapItem const> const&)
+                {
+                    ++leaves;
+                });
+            expect (leaves == count);
+        }
+
+        auto reloaded = all;
+        for (auto const& m : loaded)
+            m->countResident (reloaded);
+        expect (reloaded.maps == 2 * versions);
+        expect (reloaded.inner == all.inner);
+        expect (reloaded.leaf == all.leaf);
+        expect (reloaded.innerBytes + reloaded.leafBytes ==
+            all.innerBytes + all.leafBytes);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SHAMapResident,shamap,ripple);
+
+} // tests
+} // ripple
@@ -23,8 +23,10 @@
 #include <ripple/shamap/tests/common.h>
 #include <ripple/basics/StringUtilities.h>
 #include <ripple/protocol/UInt160.h>
+#include <ripple/protocol/digest.h>
 #include <beast/unit_test/suite.h>
 #include <openssl/rand.h> // DEPRECATED
+#include <chrono>
 
 namespace ripple {
 namespace tests {
@@ -36,14 +38,13 @@ namespace tests {
 class sync_test : public beast::unit_test::suite
 {
 public:
-    static std::shared_ptr<SHAMapItem> makeRandomAS ()
+    static std::shared_ptr<SHAMapItem const> makeRandomAS ()
     {
         Serializer s;
 
         for (int d = 0; d < 3; ++d) s.add32 (rand ());
 
-        return std::make_shared<SHAMapItem>(
-            s.getSHA512Half(), s.peekData ());
+        return make_shamapitem (s.getSHA512Half(), s.peekData ());
     }
 
     bool confuseMap (SHAMap& map, int count)
@@ -56,7 +57,7 @@ public:
 
         for (int i = 0; i < count; ++i)
         {
-            std::shared_ptr<SHAMapItem> item = makeRandomAS ();
+            std::shared_ptr<SHAMapItem const> item = makeRandomAS ();
             items.push_back (item->key());
 
             if (!map.addItem (*item, false, false))
@@ -224,5 +225,168 @@ public:
 
 BEAST_DEFINE_TESTSUITE(sync,shamap,ripple);
 
+//------------------------------------------------------------------------------
+
+// Acquire a map from several peers at once, each serving the subtrees
+// below the root branches assigned to it, as InboundLedger does.
+// Returns the number of rounds of requests it took, and adds the time
+// spent looking for missing nodes to searching.
+static
+int
+acquireMap (SHAMap const& source, SHAMap& destination, int peers, int max,
+    std::chrono::steady_clock::duration* searching = nullptr)
+{
+    std::vector<SHAMapNodeID> nodeIDs;
+    std::vector<Blob> rawNodes;
+
+    if (!source.getNodeFat (SHAMapNodeID (), nodeIDs, rawNodes, false, 0) ||
+        !destination.addRootNode (rawNodes.front (), snfWIRE, nullptr).isGood ())
+        return -1;
+
+    int rounds = 0;
+    while (true)
+    {
+        std::vector<SHAMapNodeID> missing;
+        std::vector<uint256> hashes;
+        auto const start = std::chrono::steady_clock::now ();
+        destination.getMissingNodes (missing, hashes, max, nullptr);
+        if (searching)
+            *searching += std::chrono::steady_clock::now () - start;
+        if (missing.empty ())
+            break;
+        ++rounds;
+
+        std::vector<std::vector<SHAMapNodeID>> shares (peers);
+        for (auto const& id : missing)
+            shares[SHAMapNodeID ().selectBranch (id.getNodeID ()) % peers]
+                .push_back (id);
+
+        for (auto const& share : shares)
+        {
+            nodeIDs.clear ();
+            rawNodes.clear ();
+            for (auto const& id : share)
+            {
+                if (!source.getNodeFat (id, nodeIDs, rawNodes, false, 1))
+                    return -1;
+            }
+            for (std::size_t i = 0; i < nodeIDs.size (); ++i)
+            {
+                if (!destination.addKnownNode (
+                        nodeIDs[i], rawNodes[i], nullptr).isGood ())
+                    return -1;
+            }
+        }
+    }
+
+    destination.clearSynching ();
+    return rounds;
+}
+
+static
+void
+fillSyncMap (SHAMap& map, std::uint32_t count)
+{
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        Serializer s;
+        s.add32 (i);
+        s.add32 (i);
+        s.add32 (i);
+        map.addGiveItem (make_shamapitem (
+            sha512Half (i), std::move (s)), false, false);
+    }
+    map.getHash ();
+    map.setImmutable ();
+}
+
+class SHAMapSyncResume_test : public beast::unit_test::suite
+{
+public:
+    void
+    run()
+    {
+        beast::Journal const j;
+        TestFamily f (j);
+
+        SHAMap source (SHAMapType::FREE, f);
+        fillSyncMap (source, 20000);
+
+        for (int threads : {1, 4})
+        {
+            for (int peers : {1, 3})
+            {
+                testcase (std::to_string (threads) + " threads, " +
+                    std::to_string (peers) + " peers");
+
+                // A family of its own, so nothing is known full below
+                TestFamily df (j);
+                SHAMap destination (SHAMapType::FREE, df);
+                destination.setSyncThreads (threads);
+                destination.setSynching ();
+
+                auto const rounds = acquireMap (source, destination, peers, 64);
+                expect (rounds > 0);
+                expect (destination.getHash () == source.getHash ());
+                expect (source.deepCompare (destination));
+
+                // Searching again finds nothing missing
+                std::vector<SHAMapNodeID> missing;
+                std::vector<uint256> hashes;
+                destination.getMissingNodes (missing, hashes, 64, nullptr);
+                expect (missing.empty ());
+            }
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SHAMapSyncResume,shamap,ripple);
+
+//------------------------------------------------------------------------------
+
+// Time acquiring a large map with different numbers of peers and threads
+class SHAMapSyncTiming_test : public beast::unit_test::suite
+{
+public:
+    void
+    run()
+    {
+        using namespace std::chrono;
+
+        beast::Journal const j;
+        TestFamily f (j);
+
+        SHAMap source (SHAMapType::FREE, f);
+        fillSyncMap (source, 500000);
+
+        for (int threads : {1, 4, 16})
+        {
+            for (int peers : {1, 4})
+            {
+                // A family of its own, so nothing is known full below
+                TestFamily df (j);
+                SHAMap destination (SHAMapType::FREE, df);
+                destination.setSyncThreads (threads);
+                destination.setSynching ();
+
+                steady_clock::duration searching {};
+                auto const start = steady_clock::now ();
+                auto const rounds = acquireMap (
+                    source, destination, peers, 256, &searching);
+                auto const elapsed = duration_cast<milliseconds> (
+                    steady_clock::now () - start);
+
+                expect (destination.getHash () == source.getHash ());
+                log << threads << " threads, " << peers << " peers: " <<
+                    rounds << " rounds in " << elapsed.count () <<
+                        "ms, searching " << duration_cast<milliseconds> (
+                            searching).count () << "ms";
+            }
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(SHAMapSyncTiming,shamap,ripple);
+
 } // tests
 } // ripple
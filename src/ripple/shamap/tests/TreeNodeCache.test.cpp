@@ -0,0 +1,253 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/TreeNodeCache.h>
+#include <ripple/shamap/SHAMapTreeNode.h>
+#include <ripple/basics/chrono.h>
+#include <ripple/protocol/digest.h>
+#include <beast/unit_test/suite.h>
+
+namespace ripple {
+namespace tests {
+
+class TreeNodeCache_test : public beast::unit_test::suite
+{
+    static
+    std::shared_ptr<SHAMapAbstractNode>
+    makeLeaf (std::uint32_t i)
+    {
+        Serializer s;
+        for (int j = 0; j < 25; ++j)
+            s.add32 (i);
+        return std::make_shared<SHAMapTreeNode> (
+            make_shamapitem (sha512Half (i), s.peekData ()),
+                SHAMapAbstractNode::tnACCOUNT_STATE, 0);
+    }
+
+    static
+    uint256
+    keyOf (std::uint32_t i)
+    {
+        return sha512Half (i, i);
+    }
+
+    void
+    testCanonicalize ()
+    {
+        testcase ("canonicalize");
+
+        beast::Journal const j;
+        TestStopwatch clock;
+        TreeNodeCache c ("test", 1 << 20, 1, clock, j);
+
+        auto first = makeLeaf (1);
+        auto second = makeLeaf (1);
+        auto const original = first.get ();
+
+        expect (! c.canonicalize (keyOf (1), first));
+        expect (c.canonicalize (keyOf (1), second));
+        expect (second.get () == original);
+        expect (c.fetch (keyOf (1)).get () == original);
+        expect (c.getCacheSize () == 1);
+        expect (c.getCacheBytes () > 100);
+
+        // Aged out, but still tracked while in use
+        ++clock;
+        c.sweep ();
+        expect (c.getCacheSize () == 0);
+        expect (c.getTrackSize () == 1);
+        expect (c.getCacheBytes () == 0);
+        expect (c.fetch (keyOf (1)).get () == original);
+        expect (c.getCacheSize () == 1);
+
+        first.reset ();
+        second.reset ();
+        ++clock;
+        c.sweep ();
+        expect (c.getTrackSize () == 0);
+        expect (! c.fetch (keyOf (1)));
+    }
+
+    void
+    testReplace ()
+    {
+        testcase ("replace");
+
+        beast::Journal const j;
+        TestStopwatch clock;
+        TreeNodeCache c ("test", 1 << 20, 60, clock, j);
+
+        auto leaf = makeLeaf (1);
+        c.canonicalize (keyOf (1), leaf);
+        auto const leafBytes = c.getCacheBytes ();
+        expect (c.getStats ().leafBytes == leafBytes);
+
+        // The budget counts the node which replaced the other
+        std::shared_ptr<SHAMapAbstractNode> inner =
+            std::make_shared<SHAMapInnerNode> (0);
+        expect (c.canonicalize (keyOf (1), inner, true));
+        expect (c.fetch (keyOf (1)) == inner);
+        expect (c.getCacheSize () == 1);
+
+        auto stats = c.getStats ();
+        expect (stats.leafBytes == 0);
+        expect (stats.innerBytes == c.getCacheBytes ());
+        expect (c.getCacheBytes () != leafBytes);
+
+        auto other = makeLeaf (2);
+        expect (c.canonicalize (keyOf (1), other, true));
+        stats = c.getStats ();
+        expect (stats.innerBytes == 0);
+        expect (stats.leafBytes == leafBytes);
+        expect (c.getCacheBytes () == leafBytes);
+
+        c.clear ();
+        expect (c.getCacheBytes () == 0);
+    }
+
+    void
+    testBudget ()
+    {
+        testcase ("byte budget");
+
+        beast::Journal const j;
+        TestStopwatch clock;
+        std::size_t const budget = 1 << 20;
+        TreeNodeCache c ("test", budget, 60, clock, j);
+
+        for (std::uint32_t i = 0; i < 20000; ++i)
+        {
+            auto node = makeLeaf (i);
+            c.canonicalize (keyOf (i), node);
+            expect (c.getCacheBytes () <= budget);
+        }
+        expect (c.getCacheSize () > 1000);
+        expect (c.getCacheSize () < 20000);
+
+        auto const stats = c.getStats ();
+        expect (stats.innerBytes == 0);
+        expect (stats.leafBytes == c.getCacheBytes ());
+
+        // Lowering the budget lets go of nodes at once
+        c.setTargetBytes (budget / 4);
+        expect (c.getCacheBytes () <= budget / 4);
+
+        c.clear ();
+        expect (c.getCacheSize () == 0);
+        expect (c.getTrackSize () == 0);
+        expect (c.getCacheBytes () == 0);
+    }
+
+    void
+    testScan ()
+    {
+        testcase ("scan resistance");
+
+        beast::Journal const j;
+        TestStopwatch clock;
+        TreeNodeCache c ("test", 1 << 20, 60, clock, j);
+
+        // Nodes used over and over
+        std::uint32_t const hot = 500;
+        for (std::uint32_t i = 0; i < hot; ++i)
+        {
+            auto node = makeLeaf (i);
+            c.canonicalize (keyOf (i), node);
+        }
+        for (int pass = 0; pass < 4; ++pass)
+            for (std::uint32_t i = 0; i < hot; ++i)
+                expect (c.fetch (keyOf (i)) != nullptr);
+
+        // A walk over many more nodes, each used once
+        for (std::uint32_t i = hot; i < hot + 50000; ++i)
+        {
+            auto node = makeLeaf (i);
+            c.canonicalize (keyOf (i), node);
+        }
+
+        std::uint32_t found = 0;
+        for (std::uint32_t i = 0; i < hot; ++i)
+            if (c.fetch (keyOf (i)))
+                ++found;
+        expect (found == hot, std::to_string (found) + " of " +
+            std::to_string (hot) + " kept");
+    }
+
+    void
+    testStats ()
+    {
+        testcase ("statistics");
+
+        beast::Journal const j;
+        TestStopwatch clock;
+        TreeNodeCache c ("test", 1 << 20, 60, clock, j);
+
+        std::shared_ptr<SHAMapAbstractNode> inner =
+            std::make_shared<SHAMapInnerNode> (0);
+        c.canonicalize (keyOf (1), inner);
+        auto leaf = makeLeaf (2);
+        c.canonicalize (keyOf (2), leaf);
+
+        c.fetch (keyOf (1), 0);
+        c.fetch (keyOf (1), 0);
+        c.fetch (keyOf (2), 3);
+        c.fetch (keyOf (3), 3);
+        c.fetch (keyOf (4), 40);
+
+        // Looking without fetching is not counted
+        expect (c.contains (keyOf (1)));
+        expect (c.contains (keyOf (2)));
+        expect (! c.contains (keyOf (3)));
+
+        auto const stats = c.getStats ();
+        expect (stats.inner.hits == 2);
+        expect (stats.inner.misses == 1);
+        expect (stats.leaf.hits == 1);
+        expect (stats.leaf.misses == 1);
+        expect (stats.innerBytes > sizeof (SHAMapInnerNode));
+        expect (stats.leafBytes > stats.innerBytes);
+        expect (stats.depths.size () == TreeNodeCache::maxTrackedDepth + 1);
+        expect (stats.depths[0].hits == 2);
+        expect (stats.depths[3].hits == 1);
+        expect (stats.depths[3].misses == 1);
+        expect (stats.depths[TreeNodeCache::maxTrackedDepth].misses == 1);
+        expect (c.getHitRate () == 60);
+
+        c.clearStats ();
+        expect (c.getStats ().depths.empty ());
+        expect (c.getHitRate () == 0);
+    }
+
+public:
+    void
+    run ()
+    {
+        testCanonicalize ();
+        testReplace ();
+        testBudget ();
+        testScan ();
+        testStats ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(TreeNodeCache,shamap,ripple);
+
+} // tests
+} // ripple
@@ -0,0 +1,157 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <BeastConfig.h>
+#include <ripple/shamap/impl/WorkerPool.h>
+#include <beast/unit_test/suite.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ripple {
+namespace tests {
+
+class WorkerPool_test : public beast::unit_test::suite
+{
+    void
+    testRun ()
+    {
+        testcase ("run");
+
+        WorkerPool pool ("test", 3);
+        expect (pool.size () == 3);
+
+        for (int const limit : {1, 2, 4, 16})
+        {
+            std::vector<std::atomic<int>> calls (1000);
+            for (auto& c : calls)
+                c = 0;
+
+            std::mutex lock;
+            std::set<std::thread::id> threads;
+
+            pool.run (limit, calls.size (), [&](std::size_t i)
+            {
+                ++calls[i];
+                std::lock_guard<std::mutex> l (lock);
+                threads.insert (std::this_thread::get_id ());
+            });
+
+            bool once = true;
+            for (auto& c : calls)
+                once = once && c == 1;
+            expect (once);
+            expect (threads.size () <= std::min<std::size_t> (limit, 4));
+            if (limit == 1)
+                expect (*threads.begin () == std::this_thread::get_id ());
+        }
+
+        pool.run (4, 0, [this](std::size_t) { fail ("no work"); });
+    }
+
+    void
+    testException ()
+    {
+        testcase ("exception");
+
+        WorkerPool pool ("test", 3);
+
+        std::atomic<int> calls (0);
+        try
+        {
+            pool.run (4, 10000, [&](std::size_t i)
+            {
+                ++calls;
+                if (i == 10)
+                    throw std::runtime_error ("stop");
+            });
+            fail ("not rethrown");
+        }
+        catch (std::runtime_error const&)
+        {
+            pass ();
+        }
+
+        // The other threads stopped taking work
+        expect (calls < 10000);
+
+        // And the pool is still usable
+        std::atomic<int> more (0);
+        pool.run (4, 100, [&](std::size_t) { ++more; });
+        expect (more == 100);
+    }
+
+    void
+    testNested ()
+    {
+        testcase ("nested");
+
+        // Every pool thread ends up waiting in a nested run, whose own
+        // requests for help can then only be served by their callers.
+        WorkerPool pool ("test", 2);
+
+        std::atomic<int> calls (0);
+        pool.run (3, 3, [&](std::size_t)
+        {
+            pool.run (3, 50, [&](std::size_t) { ++calls; });
+        });
+        expect (calls == 150);
+    }
+
+    void
+    testShared ()
+    {
+        testcase ("shared");
+
+        WorkerPool pool ("test", 2);
+
+        std::atomic<int> calls (0);
+        std::vector<std::thread> callers;
+        for (int i = 0; i < 4; ++i)
+        {
+            callers.emplace_back ([&]
+            {
+                for (int j = 0; j < 50; ++j)
+                    pool.run (3, 20, [&](std::size_t) { ++calls; });
+            });
+        }
+        for (auto& t : callers)
+            t.join ();
+        expect (calls == 4 * 50 * 20);
+    }
+
+public:
+    void
+    run () override
+    {
+        testRun ();
+        testException ();
+        testNested ();
+        testShared ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(WorkerPool,shamap,ripple);
+
+}
+}
@@ -48,7 +48,7 @@ private:
 
 public:
     TestFamily (beast::Journal j)
-        : treecache_ ("TreeNodeCache", 65536, 60, clock_, j)
+        : treecache_ ("TreeNodeCache", 256 << 20, 60, clock_, j)
         , fullbelow_ ("full_below", clock_)
     {
         Section testSection;
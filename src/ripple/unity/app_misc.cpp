@@ -29,6 +29,10 @@
 #include <ripple/app/misc/Validations.cpp>
 #include <ripple/app/misc/DividendMasterImpl.cpp>
 
+#include <ripple/app/misc/impl/AccountTxCursors.cpp>
 #include <ripple/app/misc/impl/AccountTxPaging.cpp>
+#include <ripple/app/misc/impl/AccountTxSchema.cpp>
+#include <ripple/app/misc/impl/DividendIndex.cpp>
+#include <ripple/app/misc/impl/TxnDBShards.cpp>
 #include <ripple/app/misc/impl/Transaction.cpp>
 #include <ripple/app/misc/impl/TxQ.cpp>
@@ -19,11 +19,13 @@
 
 #include <BeastConfig.h>
 
+#include <ripple/app/tests/AccountTxCursors_test.cpp>
 #include <ripple/app/tests/AccountTxPaging.test.cpp>
 #include <ripple/app/tests/AmendmentTable.test.cpp>
 #include <ripple/app/tests/Asset.test.cpp>
 #include <ripple/app/tests/CrossingLimits_test.cpp>
 #include <ripple/app/tests/DeliverMin.test.cpp>
+#include <ripple/app/tests/DividendIndex_test.cpp>
 #include <ripple/app/tests/HashRouter_test.cpp>
 #include <ripple/app/tests/MultiSign.test.cpp>
 #include <ripple/app/tests/OfferStream.test.cpp>
@@ -36,3 +38,4 @@
 #include <ripple/app/tests/OversizeMeta_test.cpp>
 #include <ripple/app/tests/Taker.test.cpp>
 #include <ripple/app/tests/TxQ_test.cpp>
+#include <ripple/app/tests/TxnDBShards.test.cpp>
@@ -25,6 +25,17 @@
 #include <ripple/shamap/impl/SHAMapNodeID.cpp>
 #include <ripple/shamap/impl/SHAMapSync.cpp>
 #include <ripple/shamap/impl/SHAMapTreeNode.cpp>
+#include <ripple/shamap/impl/TreeNodeCache.cpp>
+#include <ripple/shamap/impl/WorkerPool.cpp>
 #include <ripple/shamap/tests/FetchPack.test.cpp>
 #include <ripple/shamap/tests/SHAMap.test.cpp>
+#include <ripple/shamap/tests/SHAMapCoro.test.cpp>
+#include <ripple/shamap/tests/SHAMapCompare.test.cpp>
+#include <ripple/shamap/tests/SHAMapFlush.test.cpp>
+#include <ripple/shamap/tests/SHAMapInnerNode.test.cpp>
+#include <ripple/shamap/tests/SHAMapItem.test.cpp>
+#include <ripple/shamap/tests/SHAMapReadAhead.test.cpp>
+#include <ripple/shamap/tests/SHAMapResident.test.cpp>
 #include <ripple/shamap/tests/SHAMapSync.test.cpp>
+#include <ripple/shamap/tests/TreeNodeCache.test.cpp>
+#include <ripple/shamap/tests/WorkerPool.test.cpp>